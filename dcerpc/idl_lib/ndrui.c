@@ -660,6 +660,68 @@ void rpc_ss_ndr_unmar_by_copying
     }
 }
 
+/******************************************************************************/
+/*                                                                            */
+/*  Reverse the byte order of a contiguous array of integers in place         */
+/*  The loops are kept free of calls and branches so that the compiler can    */
+/*  vectorize them                                                            */
+/*                                                                            */
+/******************************************************************************/
+static void rpc_ss_ndr_swap_ints
+(
+    /* [in] */  idl_ulong_int element_count,
+    /* [in] */  idl_ulong_int element_size,
+    /* [in,out] */ rpc_void_p_t array_addr
+)
+{
+    idl_ulong_int i;
+    ndr_ushort_int *p_short;
+    ndr_ulong_int *p_long;
+    ndr_ulong_int value;
+
+    switch (element_size)
+    {
+        case 2:
+            p_short = (ndr_ushort_int *)array_addr;
+            for (i=0; i<element_count; i++)
+            {
+                p_short[i] = (ndr_ushort_int)((p_short[i] >> 8)
+                                                | (p_short[i] << 8));
+            }
+            break;
+        case 4:
+            p_long = (ndr_ulong_int *)array_addr;
+            for (i=0; i<element_count; i++)
+            {
+                p_long[i] = (p_long[i] >> 24)
+                            | ((p_long[i] >> 8) & 0x0000ff00)
+                            | ((p_long[i] << 8) & 0x00ff0000)
+                            | (p_long[i] << 24);
+            }
+            break;
+        case 8:
+            /* Swap each half, then exchange the halves */
+            p_long = (ndr_ulong_int *)array_addr;
+            element_count *= 2;
+            for (i=0; i<element_count; i++)
+            {
+                p_long[i] = (p_long[i] >> 24)
+                            | ((p_long[i] >> 8) & 0x0000ff00)
+                            | ((p_long[i] << 8) & 0x00ff0000)
+                            | (p_long[i] << 24);
+            }
+            for (i=0; i<element_count; i+=2)
+            {
+                value = p_long[i];
+                p_long[i] = p_long[i+1];
+                p_long[i+1] = value;
+            }
+            break;
+        default:
+            DCETHREAD_RAISE(rpc_x_coding_error);
+    }
+}
+
 /******************************************************************************/
 /*                                                                            */
 /*  Unmarshall a contiguous set of elements one by one                        */
@@ -685,6 +747,7 @@ void rpc_ss_ndr_unmar_by_looping
     unsigned long xmit_data_size;   /* [transmit_as] - size of xmitted type */
     rpc_void_p_t xmit_data_buff = NULL;     /* Address of storage [transmit_as]
                                                 type can be unmarshalled into */
+    idl_ulong_int int_size;     /* Wire size if elements are plain integers */
 
     if (base_type == IDL_DT_REF_PTR)
     {
@@ -709,6 +772,41 @@ void rpc_ss_ndr_unmar_by_looping
         return;
     }
 
+    switch (base_type)
+    {
+        case IDL_DT_SHORT:
+        case IDL_DT_USHORT:
+            int_size = 2;
+            break;
+        case IDL_DT_LONG:
+        case IDL_DT_ULONG:
+            int_size = 4;
+            break;
+        case IDL_DT_HYPER:
+        case IDL_DT_UHYPER:
+            int_size = 8;
+            break;
+        default:
+            int_size = 0;
+            break;
+    }
+
+    if (int_size != 0)
+    {
+        /*
+         * Integer arrays, typically with a data representation that does
+         * not match ours (otherwise they would have been unmarshalled by
+         * copying).  Copy the whole run out of the receive buffer, then
+         * swap it in place, rather than converting element by element.
+         */
+        IDL_UNMAR_ALIGN_MP( IDL_msp, int_size );
+        rpc_ss_ndr_unmar_by_copying( element_count, int_size, array_addr,
+                                     IDL_msp );
+        if (IDL_msp->IDL_drep.int_rep != ndr_g_local_drep.int_rep)
+            rpc_ss_ndr_swap_ints( element_count, int_size, array_addr );
+        return;
+    }
+
     if ( (base_type == IDL_DT_TRANSMIT_AS)
         || (base_type == IDL_DT_REPRESENT_AS) )
     {
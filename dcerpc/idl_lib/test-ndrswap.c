@@ -0,0 +1,192 @@
+/*
+ * Tests for the integer array path of rpc_ss_ndr_unmar_by_looping, which
+ * copies the whole array out of the receive buffer and swaps it in place
+ * when the sender's integer representation differs from ours.
+ */
+
+#if HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <string.h>
+#include <dce/idlddefs.h>
+#include <ndrui.h>
+#include <moonunit/interface.h>
+
+#define TEST_MAX_BYTES 256
+
+typedef union
+{
+    idl_uhyper_int align;
+    idl_byte bytes[TEST_MAX_BYTES];
+} test_buffer_t;
+
+/*
+ * Fill an array of element_count integers of element_size bytes with a
+ * pattern in which no two bytes are equal, so that any misplaced byte shows.
+ */
+static void
+fill_pattern(
+    idl_byte *data,
+    idl_ulong_int element_count,
+    idl_ulong_int element_size
+    )
+{
+    idl_ulong_int i;
+
+    for (i = 0; i < element_count * element_size; i++)
+    {
+        data[i] = (idl_byte)(i * 7 + 1);
+    }
+}
+
+/*
+ * Lay out the native array "native" as it would arrive on the wire from a
+ * sender whose integer representation is the opposite of ours.
+ */
+static void
+reverse_elements(
+    const idl_byte *native,
+    idl_byte *wire,
+    idl_ulong_int element_count,
+    idl_ulong_int element_size
+    )
+{
+    idl_ulong_int i;
+    idl_ulong_int j;
+
+    for (i = 0; i < element_count; i++)
+    {
+        for (j = 0; j < element_size; j++)
+        {
+            wire[i * element_size + j] =
+                native[i * element_size + (element_size - 1 - j)];
+        }
+    }
+}
+
+/*
+ * Unmarshal element_count integers of type base_type from wire, as sent
+ * with integer representation int_rep, into dest.
+ */
+static void
+unmarshal_ints(
+    idl_byte base_type,
+    idl_ulong_int element_count,
+    idl_ulong_int element_size,
+    unsigned int int_rep,
+    idl_byte *wire,
+    idl_byte *dest
+    )
+{
+    IDL_ms_t ms;
+
+    memset(&ms, 0, sizeof(ms));
+    ms.IDL_buff_addr = wire;
+    ms.IDL_mp = wire;
+    ms.IDL_left_in_buff = element_count * element_size;
+    ms.IDL_drep = ndr_g_local_drep;
+    ms.IDL_drep.int_rep = int_rep;
+
+    rpc_ss_ndr_unmar_by_looping(element_count, base_type, dest,
+                                element_size, 0, &ms);
+
+    MU_ASSERT(ms.IDL_mp == wire + element_count * element_size);
+    MU_ASSERT(ms.IDL_left_in_buff == 0);
+}
+
+static unsigned int
+opposite_int_rep(void)
+{
+    return (ndr_g_local_drep.int_rep == ndr_c_int_big_endian) ?
+        ndr_c_int_little_endian : ndr_c_int_big_endian;
+}
+
+static void
+check_swapped(
+    idl_byte base_type,
+    idl_ulong_int element_count,
+    idl_ulong_int element_size
+    )
+{
+    test_buffer_t native;
+    test_buffer_t wire;
+    test_buffer_t dest;
+
+    MU_ASSERT(element_count * element_size <= TEST_MAX_BYTES);
+
+    fill_pattern(native.bytes, element_count, element_size);
+    reverse_elements(native.bytes, wire.bytes, element_count, element_size);
+    memset(dest.bytes, 0, sizeof(dest.bytes));
+
+    unmarshal_ints(base_type, element_count, element_size,
+                   opposite_int_rep(), wire.bytes, dest.bytes);
+
+    MU_ASSERT(!memcmp(dest.bytes, native.bytes,
+                      element_count * element_size));
+}
+
+MU_TEST(ndrswap, short_opposite_endian)
+{
+    check_swapped(IDL_DT_SHORT, 1, 2);
+    check_swapped(IDL_DT_USHORT, 17, 2);
+    check_swapped(IDL_DT_USHORT, TEST_MAX_BYTES / 2, 2);
+}
+
+MU_TEST(ndrswap, long_opposite_endian)
+{
+    check_swapped(IDL_DT_LONG, 1, 4);
+    check_swapped(IDL_DT_ULONG, 13, 4);
+    check_swapped(IDL_DT_ULONG, TEST_MAX_BYTES / 4, 4);
+}
+
+MU_TEST(ndrswap, hyper_opposite_endian)
+{
+    check_swapped(IDL_DT_HYPER, 1, 8);
+    check_swapped(IDL_DT_UHYPER, 11, 8);
+    check_swapped(IDL_DT_UHYPER, TEST_MAX_BYTES / 8, 8);
+}
+
+MU_TEST(ndrswap, wide_string_opposite_endian)
+{
+    static const char *text = "Opposite-endian string";
+    test_buffer_t native;
+    test_buffer_t wire;
+    test_buffer_t dest;
+    idl_ulong_int count = strlen(text) + 1;
+    idl_ushort_int *chars = (idl_ushort_int *)native.bytes;
+    idl_ushort_int *result = (idl_ushort_int *)dest.bytes;
+    idl_ulong_int i;
+
+    /* A UCS-2 string with its terminator is sent as an array of ushorts */
+    for (i = 0; i < count; i++)
+    {
+        chars[i] = (idl_ushort_int)(unsigned char)text[i];
+    }
+    reverse_elements(native.bytes, wire.bytes, count, 2);
+    memset(dest.bytes, 0xff, sizeof(dest.bytes));
+
+    unmarshal_ints(IDL_DT_USHORT, count, 2, opposite_int_rep(),
+                   wire.bytes, dest.bytes);
+
+    for (i = 0; i < count; i++)
+    {
+        MU_ASSERT(result[i] == (idl_ushort_int)(unsigned char)text[i]);
+    }
+}
+
+MU_TEST(ndrswap, same_endian_passthrough)
+{
+    test_buffer_t native;
+    test_buffer_t wire;
+    test_buffer_t dest;
+
+    fill_pattern(native.bytes, 9, 8);
+    memcpy(wire.bytes, native.bytes, 9 * 8);
+    memset(dest.bytes, 0, sizeof(dest.bytes));
+
+    unmarshal_ints(IDL_DT_UHYPER, 9, 8, ndr_g_local_drep.int_rep,
+                   wire.bytes, dest.bytes);
+
+    MU_ASSERT(!memcmp(dest.bytes, native.bytes, 9 * 8));
+}
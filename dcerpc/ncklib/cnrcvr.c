@@ -1275,12 +1275,12 @@ INTERNAL void receive_dispatch
         }
 
         /*
-         * Unlock the CN global mutex, yield the processor to allow
-         * another thread to run and re-acquire the CN global mutex.
+         * There is no need to yield here: receive_packet() releases the
+         * CN global mutex for every read from the socket. Only fragments
+         * that arrived in the same read are dispatched back to back.
+         * Yielding after every packet only cost a context switch per
+         * packet on every association.
          */
-        RPC_CN_UNLOCK ();
-        dcethread_yield ();
-        RPC_CN_LOCK ();
 
         /*
          * NULL our pointer to the fragment buffer so we'll be forced to get
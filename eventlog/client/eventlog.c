@@ -244,6 +244,7 @@ LwEvtCloseEventlog(
     )
 {
     volatile DWORD dwError = 0;
+    DWORD dwQueueError = 0;
 
     if (pConn == NULL)
     {
@@ -251,6 +252,13 @@ LwEvtCloseEventlog(
         BAIL_ON_EVT_ERROR(dwError);
     }
 
+    if (pConn->pQueue)
+    {
+        // Deliver whatever is still queued before the handles go away
+        dwQueueError = LwEvtFreeWriteQueue(pConn->pQueue);
+        pConn->pQueue = NULL;
+    }
+
     if (pConn->Local)
     {
         dwError = LwmEvtCloseServer(pConn->Local);
@@ -273,6 +281,9 @@ LwEvtCloseEventlog(
     }
 #endif
 
+    dwError = dwQueueError;
+    BAIL_ON_EVT_ERROR(dwError);
+
 cleanup:
     if (pConn)
     {
@@ -400,6 +411,190 @@ error:
 }
 
 
+DWORD
+LwEvtReadRecordPage(
+    IN PLW_EVENTLOG_CONNECTION pConn,
+    IN UINT64 Continuation,
+    IN DWORD MaxResults,
+    IN OPTIONAL PCWSTR pSqlFilter,
+    OUT PUINT64 pNextContinuation,
+    OUT PDWORD pCount,
+    OUT PLW_EVENTLOG_RECORD* ppRecords
+    )
+{
+    DWORD dwError = 0;
+    PWSTR pFilter = NULL;
+    UINT64 nextContinuation = 0;
+    DWORD count = 0;
+    PLW_EVENTLOG_RECORD pRecords = NULL;
+
+    if (pConn->Local)
+    {
+        dwError = LwmEvtReadRecordPage(
+                        pConn->Local,
+                        Continuation,
+                        MaxResults,
+                        pSqlFilter,
+                        NULL,
+                        &nextContinuation,
+                        &count,
+                        &pRecords);
+        BAIL_ON_EVT_ERROR(dwError);
+    }
+    else
+    {
+        // The RPC interface has no cursor; page with a record id filter
+        if (pSqlFilter)
+        {
+            dwError = LwAllocateWc16sPrintfW(
+                            &pFilter,
+                            L"(%ws) AND EventRecordId > %llu",
+                            pSqlFilter,
+                            (long long unsigned)Continuation);
+            BAIL_ON_EVT_ERROR(dwError);
+        }
+        else
+        {
+            dwError = LwAllocateWc16sPrintfW(
+                            &pFilter,
+                            L"EventRecordId > %llu",
+                            (long long unsigned)Continuation);
+            BAIL_ON_EVT_ERROR(dwError);
+        }
+
+        dwError = LwEvtReadRecords(
+                        pConn,
+                        MaxResults,
+                        pFilter,
+                        &count,
+                        &pRecords);
+        BAIL_ON_EVT_ERROR(dwError);
+
+        if (count && count == MaxResults)
+        {
+            nextContinuation = pRecords[count - 1].EventRecordId;
+        }
+    }
+
+    *pNextContinuation = nextContinuation;
+    *pCount = count;
+    *ppRecords = pRecords;
+
+cleanup:
+    LW_SAFE_FREE_MEMORY(pFilter);
+    return dwError;
+
+error:
+    EVT_LOG_ERROR("Failed to read event log page. Error code [%d]\n", dwError);
+
+    *pNextContinuation = 0;
+    *pCount = 0;
+    *ppRecords = NULL;
+    goto cleanup;
+}
+
+DWORD
+LwEvtReadMatchingRecordPage(
+    IN PLW_EVENTLOG_CONNECTION pConn,
+    IN UINT64 Continuation,
+    IN DWORD MaxResults,
+    IN PCLW_EVENTLOG_FILTER pFilter,
+    OUT PUINT64 pNextContinuation,
+    OUT PDWORD pCount,
+    OUT PLW_EVENTLOG_RECORD* ppRecords
+    )
+{
+    DWORD dwError = 0;
+
+    if (!pConn->Local)
+    {
+        // The RPC interface only takes SQL filters
+        dwError = ERROR_NOT_SUPPORTED;
+        BAIL_ON_EVT_ERROR(dwError);
+    }
+
+    dwError = LwmEvtReadRecordPage(
+                    pConn->Local,
+                    Continuation,
+                    MaxResults,
+                    NULL,
+                    pFilter,
+                    pNextContinuation,
+                    pCount,
+                    ppRecords);
+    BAIL_ON_EVT_ERROR(dwError);
+
+cleanup:
+    return dwError;
+
+error:
+    EVT_LOG_ERROR("Failed to read event log page. Error code [%d]\n", dwError);
+
+    *pNextContinuation = 0;
+    *pCount = 0;
+    *ppRecords = NULL;
+    goto cleanup;
+}
+
+DWORD
+LwEvtCountMatchingRecords(
+    IN PLW_EVENTLOG_CONNECTION pConn,
+    IN PCLW_EVENTLOG_FILTER pFilter,
+    OUT PDWORD pNumMatched
+    )
+{
+    DWORD dwError = 0;
+
+    if (!pConn->Local)
+    {
+        dwError = ERROR_NOT_SUPPORTED;
+        BAIL_ON_EVT_ERROR(dwError);
+    }
+
+    dwError = LwmEvtCountMatchingRecords(
+                    pConn->Local,
+                    pFilter,
+                    pNumMatched);
+    BAIL_ON_EVT_ERROR(dwError);
+
+cleanup:
+    return dwError;
+
+error:
+    EVT_LOG_ERROR("Failed to get record count. Error code [%d]\n", dwError);
+
+    *pNumMatched = 0;
+    goto cleanup;
+}
+
+DWORD
+LwEvtDeleteMatchingRecords(
+    IN PLW_EVENTLOG_CONNECTION pConn,
+    IN PCLW_EVENTLOG_FILTER pFilter
+    )
+{
+    DWORD dwError = 0;
+
+    if (!pConn->Local)
+    {
+        dwError = ERROR_NOT_SUPPORTED;
+        BAIL_ON_EVT_ERROR(dwError);
+    }
+
+    dwError = LwmEvtDeleteMatchingRecords(
+                    pConn->Local,
+                    pFilter);
+    BAIL_ON_EVT_ERROR(dwError);
+
+cleanup:
+    return dwError;
+
+error:
+    EVT_LOG_ERROR("Failed to delete records. Error code [%d]\n", dwError);
+
+    goto cleanup;
+}
+
 DWORD
 LwEvtGetRecordCount(
     IN PLW_EVENTLOG_CONNECTION pConn,
@@ -451,12 +646,80 @@ error:
 }
 
 
+DWORD
+LwEvtEnableWriteQueue(
+    IN PLW_EVENTLOG_CONNECTION pConn,
+    IN DWORD MaxBatchRecords,
+    IN DWORD MaxBatchDelayMs
+    )
+{
+    DWORD dwError = 0;
+
+    if (pConn->pQueue)
+    {
+        dwError = ERROR_INVALID_PARAMETER;
+        BAIL_ON_EVT_ERROR(dwError);
+    }
+
+    dwError = LwEvtCreateWriteQueue(
+                    pConn,
+                    MaxBatchRecords,
+                    MaxBatchDelayMs,
+                    &pConn->pQueue);
+    BAIL_ON_EVT_ERROR(dwError);
+
+cleanup:
+    return dwError;
+
+error:
+    EVT_LOG_ERROR("Failed to enable write queue. Error code [%d]\n", dwError);
+
+    goto cleanup;
+}
+
+DWORD
+LwEvtFlushRecords(
+    IN PLW_EVENTLOG_CONNECTION pConn
+    )
+{
+    DWORD dwError = 0;
+
+    if (pConn->pQueue)
+    {
+        dwError = LwEvtFlushWriteQueue(pConn->pQueue);
+        BAIL_ON_EVT_ERROR(dwError);
+    }
+
+cleanup:
+    return dwError;
+
+error:
+    EVT_LOG_ERROR("Failed to flush records. Error code [%d]\n", dwError);
+
+    goto cleanup;
+}
+
 DWORD
 LwEvtWriteRecords(
     IN PLW_EVENTLOG_CONNECTION pConn,
     IN DWORD Count,
     IN PLW_EVENTLOG_RECORD pRecords 
     )
+{
+    if (pConn->pQueue)
+    {
+        return LwEvtQueueRecords(pConn->pQueue, Count, pRecords);
+    }
+
+    return LwEvtSendRecords(pConn, Count, pRecords);
+}
+
+DWORD
+LwEvtSendRecords(
+    IN PLW_EVENTLOG_CONNECTION pConn,
+    IN DWORD Count,
+    IN PLW_EVENTLOG_RECORD pRecords
+    )
 {
     volatile DWORD dwError = 0;
     char pszHostname[1024];
@@ -45,8 +45,17 @@ struct _LW_EVENTLOG_CONNECTION
 {
     PLW_EVT_CLIENT_CONNECTION_CONTEXT Local;
     RPC_LW_EVENTLOG_HANDLE Remote;
+    // Set by LwEvtEnableWriteQueue
+    PLW_EVT_WRITE_QUEUE pQueue;
 };
 
+DWORD
+LwEvtSendRecords(
+    IN PLW_EVENTLOG_CONNECTION pConn,
+    IN DWORD Count,
+    IN PLW_EVENTLOG_RECORD pRecords
+    );
+
 DWORD
 EVTGetRpcError(
     dcethread_exc* exCatch
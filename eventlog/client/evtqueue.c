@@ -0,0 +1,638 @@
+/* Editor Settings: expandtabs and use 4 spaces for indentation
+ * ex: set softtabstop=4 tabstop=8 expandtab shiftwidth=4: *
+ * -*- mode: c, c-basic-offset: 4 -*- */
+
+/*
+ * Copyright © BeyondTrust Software 2004 - 2019
+ * All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * BEYONDTRUST MAKES THIS SOFTWARE AVAILABLE UNDER OTHER LICENSING TERMS AS
+ * WELL. IF YOU HAVE ENTERED INTO A SEPARATE LICENSE AGREEMENT WITH
+ * BEYONDTRUST, THEN YOU MAY ELECT TO USE THE SOFTWARE UNDER THE TERMS OF THAT
+ * SOFTWARE LICENSE AGREEMENT INSTEAD OF THE TERMS OF THE APACHE LICENSE,
+ * NOTWITHSTANDING THE ABOVE NOTICE.  IF YOU HAVE QUESTIONS, OR WISH TO REQUEST
+ * A COPY OF THE ALTERNATE LICENSING TERMS OFFERED BY BEYONDTRUST, PLEASE CONTACT
+ * BEYONDTRUST AT beyondtrust.com/contact
+ */
+
+/*
+ * Module Name:
+ *
+ *        evtqueue.c
+ *
+ * Abstract:
+ *
+ *        Eventlog Client Write Queue
+ *
+ *        Records written through a queued connection are copied into a
+ *        pending list and returned to the caller immediately. A sender thread
+ *        coalesces the pending records of all callers and writes them to
+ *        eventlogd in batches, once MaxBatchRecords have accumulated or the
+ *        oldest record has waited MaxBatchDelayMs. Callers keep filling the
+ *        next batch while the previous one is being written, so eventlogd
+ *        sees a few large transactions instead of one per call.
+ *
+ *        A batch that cannot be delivered is put back at the head of the
+ *        queue and retried. Writers are only told about the failure once the
+ *        queue has no room left for their records.
+ *
+ */
+#include "includes.h"
+
+// How many batches may be pending before writers are held back
+#define EVT_QUEUE_MAX_PENDING_BATCHES 64
+// Minimum delay before a failed batch is retried
+#define EVT_QUEUE_RETRY_DELAY_MS 1000
+
+struct _LW_EVT_WRITE_QUEUE
+{
+    pthread_mutex_t Mutex;
+    // Broadcast when records are queued, a flush or shutdown is requested,
+    // or a send attempt completes
+    pthread_cond_t Changed;
+    pthread_t Thread;
+    BOOLEAN bThreadStarted;
+    BOOLEAN bShutdown;
+    // Set after a failed send attempt until a later attempt succeeds
+    BOOLEAN bBackoff;
+
+    PLW_EVENTLOG_CONNECTION pConn;
+    DWORD MaxBatchRecords;
+    DWORD MaxBatchDelayMs;
+    DWORD MaxPending;
+
+    // Records accepted but not yet delivered, oldest first
+    PLW_EVENTLOG_RECORD pPending;
+    DWORD PendingCount;
+    DWORD PendingCapacity;
+    // Time by which the pending records are sent, or retried after a failure
+    struct timespec Deadline;
+
+    // Running totals since the queue was created
+    UINT64 Queued;
+    UINT64 Delivered;
+    UINT64 Discarded;
+    UINT64 Attempts;
+    // Result of the most recent send attempt
+    DWORD LastError;
+    DWORD FlushWaiters;
+};
+
+static
+VOID
+LwEvtGetDeadline(
+    IN DWORD DelayMs,
+    OUT struct timespec* pDeadline
+    )
+{
+    struct timeval now = { 0 };
+    UINT64 nsec = 0;
+
+    gettimeofday(&now, NULL);
+
+    nsec = (UINT64)now.tv_usec * 1000 + (UINT64)DelayMs * 1000000;
+    pDeadline->tv_sec = now.tv_sec + nsec / 1000000000;
+    pDeadline->tv_nsec = nsec % 1000000000;
+}
+
+static
+BOOLEAN
+LwEvtDeadlinePassed(
+    IN const struct timespec* pDeadline
+    )
+{
+    struct timeval now = { 0 };
+
+    gettimeofday(&now, NULL);
+
+    return now.tv_sec > pDeadline->tv_sec ||
+        (now.tv_sec == pDeadline->tv_sec &&
+         (long)now.tv_usec * 1000 >= pDeadline->tv_nsec);
+}
+
+static
+VOID
+LwEvtFreeRecordContents(
+    IN DWORD Count,
+    IN PLW_EVENTLOG_RECORD pRecords
+    )
+{
+    DWORD index = 0;
+
+    for (index = 0; index < Count; index++)
+    {
+        LW_SAFE_FREE_MEMORY(pRecords[index].pLogname);
+        LW_SAFE_FREE_MEMORY(pRecords[index].pEventType);
+        LW_SAFE_FREE_MEMORY(pRecords[index].pEventSource);
+        LW_SAFE_FREE_MEMORY(pRecords[index].pEventCategory);
+        LW_SAFE_FREE_MEMORY(pRecords[index].pUser);
+        LW_SAFE_FREE_MEMORY(pRecords[index].pComputer);
+        LW_SAFE_FREE_MEMORY(pRecords[index].pDescription);
+        LW_SAFE_FREE_MEMORY(pRecords[index].pData);
+    }
+}
+
+static
+DWORD
+LwEvtCopyOptionalWc16String(
+    OUT PWSTR* ppOutput,
+    IN PCWSTR pInput
+    )
+{
+    if (pInput == NULL)
+    {
+        *ppOutput = NULL;
+        return 0;
+    }
+    return LwAllocateWc16String(ppOutput, pInput);
+}
+
+static
+DWORD
+LwEvtCopyRecords(
+    IN DWORD Count,
+    IN PLW_EVENTLOG_RECORD pRecords,
+    OUT PLW_EVENTLOG_RECORD* ppCopies
+    )
+{
+    DWORD dwError = 0;
+    DWORD index = 0;
+    PLW_EVENTLOG_RECORD pCopies = NULL;
+
+    dwError = LwAllocateMemory(
+                    sizeof(pCopies[0]) * Count,
+                    (PVOID*)&pCopies);
+    BAIL_ON_EVT_ERROR(dwError);
+
+    for (index = 0; index < Count; index++)
+    {
+        pCopies[index].EventRecordId = pRecords[index].EventRecordId;
+        pCopies[index].EventDateTime = pRecords[index].EventDateTime;
+        pCopies[index].EventSourceId = pRecords[index].EventSourceId;
+
+        dwError = LwEvtCopyOptionalWc16String(
+                        &pCopies[index].pLogname,
+                        pRecords[index].pLogname);
+        BAIL_ON_EVT_ERROR(dwError);
+
+        dwError = LwEvtCopyOptionalWc16String(
+                        &pCopies[index].pEventType,
+                        pRecords[index].pEventType);
+        BAIL_ON_EVT_ERROR(dwError);
+
+        dwError = LwEvtCopyOptionalWc16String(
+                        &pCopies[index].pEventSource,
+                        pRecords[index].pEventSource);
+        BAIL_ON_EVT_ERROR(dwError);
+
+        dwError = LwEvtCopyOptionalWc16String(
+                        &pCopies[index].pEventCategory,
+                        pRecords[index].pEventCategory);
+        BAIL_ON_EVT_ERROR(dwError);
+
+        dwError = LwEvtCopyOptionalWc16String(
+                        &pCopies[index].pUser,
+                        pRecords[index].pUser);
+        BAIL_ON_EVT_ERROR(dwError);
+
+        dwError = LwEvtCopyOptionalWc16String(
+                        &pCopies[index].pComputer,
+                        pRecords[index].pComputer);
+        BAIL_ON_EVT_ERROR(dwError);
+
+        dwError = LwEvtCopyOptionalWc16String(
+                        &pCopies[index].pDescription,
+                        pRecords[index].pDescription);
+        BAIL_ON_EVT_ERROR(dwError);
+
+        if (pRecords[index].DataLen)
+        {
+            dwError = LwAllocateMemory(
+                            pRecords[index].DataLen,
+                            (PVOID*)&pCopies[index].pData);
+            BAIL_ON_EVT_ERROR(dwError);
+
+            memcpy(
+                pCopies[index].pData,
+                pRecords[index].pData,
+                pRecords[index].DataLen);
+            pCopies[index].DataLen = pRecords[index].DataLen;
+        }
+    }
+
+    *ppCopies = pCopies;
+
+cleanup:
+    return dwError;
+
+error:
+    LwEvtFreeRecordArray(Count, pCopies);
+    *ppCopies = NULL;
+    goto cleanup;
+}
+
+/*
+ * Moves Count records to the front (bPrepend) or back of the pending list.
+ * The record contents become owned by the queue. Must be called with the
+ * queue locked.
+ */
+static
+DWORD
+LwEvtAddPendingRecords(
+    IN PLW_EVT_WRITE_QUEUE pQueue,
+    IN DWORD Count,
+    IN PLW_EVENTLOG_RECORD pRecords,
+    IN BOOLEAN bPrepend
+    )
+{
+    DWORD dwError = 0;
+    DWORD newCapacity = 0;
+    PLW_EVENTLOG_RECORD pNewPending = NULL;
+
+    if (pQueue->PendingCount + Count > pQueue->PendingCapacity)
+    {
+        newCapacity = pQueue->PendingCapacity * 2;
+        if (newCapacity < pQueue->PendingCount + Count)
+        {
+            newCapacity = pQueue->PendingCount + Count;
+        }
+        if (newCapacity < pQueue->MaxBatchRecords)
+        {
+            newCapacity = pQueue->MaxBatchRecords;
+        }
+
+        dwError = LwReallocMemory(
+                        pQueue->pPending,
+                        (PVOID*)&pNewPending,
+                        sizeof(pNewPending[0]) * newCapacity);
+        BAIL_ON_EVT_ERROR(dwError);
+
+        pQueue->pPending = pNewPending;
+        pQueue->PendingCapacity = newCapacity;
+    }
+
+    if (bPrepend)
+    {
+        memmove(
+            pQueue->pPending + Count,
+            pQueue->pPending,
+            sizeof(pQueue->pPending[0]) * pQueue->PendingCount);
+        memcpy(
+            pQueue->pPending,
+            pRecords,
+            sizeof(pRecords[0]) * Count);
+    }
+    else
+    {
+        memcpy(
+            pQueue->pPending + pQueue->PendingCount,
+            pRecords,
+            sizeof(pRecords[0]) * Count);
+    }
+    pQueue->PendingCount += Count;
+
+error:
+    return dwError;
+}
+
+static
+BOOLEAN
+LwEvtWriteQueueReady(
+    IN PLW_EVT_WRITE_QUEUE pQueue
+    )
+{
+    if (pQueue->PendingCount == 0)
+    {
+        return FALSE;
+    }
+    if (pQueue->bBackoff)
+    {
+        return LwEvtDeadlinePassed(&pQueue->Deadline);
+    }
+    return pQueue->PendingCount >= pQueue->MaxBatchRecords ||
+        pQueue->FlushWaiters ||
+        LwEvtDeadlinePassed(&pQueue->Deadline);
+}
+
+static
+PVOID
+LwEvtWriteQueueThread(
+    IN PVOID pContext
+    )
+{
+    PLW_EVT_WRITE_QUEUE pQueue = pContext;
+    PLW_EVENTLOG_RECORD pBatch = NULL;
+    DWORD batchCount = 0;
+    DWORD sent = 0;
+    DWORD chunk = 0;
+    DWORD dwError = 0;
+
+    pthread_mutex_lock(&pQueue->Mutex);
+
+    while (!pQueue->bShutdown)
+    {
+        if (!LwEvtWriteQueueReady(pQueue))
+        {
+            if (pQueue->PendingCount)
+            {
+                pthread_cond_timedwait(
+                    &pQueue->Changed,
+                    &pQueue->Mutex,
+                    &pQueue->Deadline);
+            }
+            else
+            {
+                pthread_cond_wait(&pQueue->Changed, &pQueue->Mutex);
+            }
+            continue;
+        }
+
+        // Take everything that is pending. Writers start filling a new list
+        // while this one is on its way to eventlogd.
+        pBatch = pQueue->pPending;
+        batchCount = pQueue->PendingCount;
+        pQueue->pPending = NULL;
+        pQueue->PendingCount = 0;
+        pQueue->PendingCapacity = 0;
+
+        pthread_mutex_unlock(&pQueue->Mutex);
+
+        dwError = 0;
+        for (sent = 0; sent < batchCount; sent += chunk)
+        {
+            chunk = LW_MIN(pQueue->MaxBatchRecords, batchCount - sent);
+
+            dwError = LwEvtSendRecords(pQueue->pConn, chunk, pBatch + sent);
+            if (dwError)
+            {
+                break;
+            }
+        }
+
+        LwEvtFreeRecordContents(sent, pBatch);
+
+        pthread_mutex_lock(&pQueue->Mutex);
+
+        pQueue->Attempts++;
+        pQueue->LastError = dwError;
+        pQueue->Delivered += sent;
+
+        if (dwError)
+        {
+            EVT_LOG_ERROR("Failed to deliver %u queued event records. "
+                    "Error code [%u]. Retrying in %u ms.",
+                    batchCount - sent,
+                    dwError,
+                    LW_MAX(pQueue->MaxBatchDelayMs, EVT_QUEUE_RETRY_DELAY_MS));
+
+            if (LwEvtAddPendingRecords(
+                    pQueue,
+                    batchCount - sent,
+                    pBatch + sent,
+                    TRUE))
+            {
+                EVT_LOG_ERROR("Discarding %u undeliverable event records",
+                        batchCount - sent);
+                LwEvtFreeRecordContents(batchCount - sent, pBatch + sent);
+                pQueue->Discarded += batchCount - sent;
+            }
+
+            pQueue->bBackoff = TRUE;
+            LwEvtGetDeadline(
+                LW_MAX(pQueue->MaxBatchDelayMs, EVT_QUEUE_RETRY_DELAY_MS),
+                &pQueue->Deadline);
+        }
+        else
+        {
+            pQueue->bBackoff = FALSE;
+        }
+
+        LW_SAFE_FREE_MEMORY(pBatch);
+        batchCount = 0;
+
+        pthread_cond_broadcast(&pQueue->Changed);
+    }
+
+    pthread_mutex_unlock(&pQueue->Mutex);
+
+    return NULL;
+}
+
+DWORD
+LwEvtCreateWriteQueue(
+    IN PLW_EVENTLOG_CONNECTION pConn,
+    IN DWORD MaxBatchRecords,
+    IN DWORD MaxBatchDelayMs,
+    OUT PLW_EVT_WRITE_QUEUE* ppQueue
+    )
+{
+    DWORD dwError = 0;
+    PLW_EVT_WRITE_QUEUE pQueue = NULL;
+    BOOLEAN bMutexInit = FALSE;
+    BOOLEAN bCondInit = FALSE;
+
+    if (MaxBatchRecords == 0 ||
+        MaxBatchRecords > (DWORD)-1 / EVT_QUEUE_MAX_PENDING_BATCHES)
+    {
+        dwError = ERROR_INVALID_PARAMETER;
+        BAIL_ON_EVT_ERROR(dwError);
+    }
+
+    dwError = LwAllocateMemory(sizeof(*pQueue), (PVOID*)&pQueue);
+    BAIL_ON_EVT_ERROR(dwError);
+
+    pQueue->pConn = pConn;
+    pQueue->MaxBatchRecords = MaxBatchRecords;
+    pQueue->MaxBatchDelayMs = MaxBatchDelayMs;
+    pQueue->MaxPending = MaxBatchRecords * EVT_QUEUE_MAX_PENDING_BATCHES;
+
+    dwError = LwMapErrnoToLwError(pthread_mutex_init(&pQueue->Mutex, NULL));
+    BAIL_ON_EVT_ERROR(dwError);
+    bMutexInit = TRUE;
+
+    dwError = LwMapErrnoToLwError(pthread_cond_init(&pQueue->Changed, NULL));
+    BAIL_ON_EVT_ERROR(dwError);
+    bCondInit = TRUE;
+
+    dwError = LwMapErrnoToLwError(pthread_create(
+                    &pQueue->Thread,
+                    NULL,
+                    LwEvtWriteQueueThread,
+                    pQueue));
+    BAIL_ON_EVT_ERROR(dwError);
+    pQueue->bThreadStarted = TRUE;
+
+    *ppQueue = pQueue;
+
+cleanup:
+    return dwError;
+
+error:
+    if (pQueue)
+    {
+        if (bCondInit)
+        {
+            pthread_cond_destroy(&pQueue->Changed);
+        }
+        if (bMutexInit)
+        {
+            pthread_mutex_destroy(&pQueue->Mutex);
+        }
+        LW_SAFE_FREE_MEMORY(pQueue);
+    }
+    *ppQueue = NULL;
+    goto cleanup;
+}
+
+DWORD
+LwEvtQueueRecords(
+    IN PLW_EVT_WRITE_QUEUE pQueue,
+    IN DWORD Count,
+    IN PLW_EVENTLOG_RECORD pRecords
+    )
+{
+    DWORD dwError = 0;
+    PLW_EVENTLOG_RECORD pCopies = NULL;
+    BOOLEAN bLocked = FALSE;
+    BOOLEAN bWasEmpty = FALSE;
+
+    if (Count == 0)
+    {
+        goto cleanup;
+    }
+
+    // Copy outside of the lock so other writers are not held up
+    dwError = LwEvtCopyRecords(Count, pRecords, &pCopies);
+    BAIL_ON_EVT_ERROR(dwError);
+
+    pthread_mutex_lock(&pQueue->Mutex);
+    bLocked = TRUE;
+
+    // A single oversized write is accepted into an empty queue, otherwise
+    // it could never be queued at all
+    while (pQueue->PendingCount &&
+           pQueue->PendingCount + Count > pQueue->MaxPending)
+    {
+        if (pQueue->LastError)
+        {
+            dwError = pQueue->LastError;
+            BAIL_ON_EVT_ERROR(dwError);
+        }
+        pthread_cond_wait(&pQueue->Changed, &pQueue->Mutex);
+    }
+
+    bWasEmpty = (pQueue->PendingCount == 0);
+
+    dwError = LwEvtAddPendingRecords(pQueue, Count, pCopies, FALSE);
+    BAIL_ON_EVT_ERROR(dwError);
+    LW_SAFE_FREE_MEMORY(pCopies);
+
+    pQueue->Queued += Count;
+
+    if (bWasEmpty && !pQueue->bBackoff)
+    {
+        LwEvtGetDeadline(pQueue->MaxBatchDelayMs, &pQueue->Deadline);
+    }
+
+    if (bWasEmpty || pQueue->PendingCount >= pQueue->MaxBatchRecords)
+    {
+        pthread_cond_broadcast(&pQueue->Changed);
+    }
+
+cleanup:
+    if (bLocked)
+    {
+        pthread_mutex_unlock(&pQueue->Mutex);
+    }
+    return dwError;
+
+error:
+    LwEvtFreeRecordArray(Count, pCopies);
+    goto cleanup;
+}
+
+DWORD
+LwEvtFlushWriteQueue(
+    IN PLW_EVT_WRITE_QUEUE pQueue
+    )
+{
+    DWORD dwError = 0;
+    UINT64 target = 0;
+    UINT64 attempts = 0;
+
+    pthread_mutex_lock(&pQueue->Mutex);
+
+    target = pQueue->Queued;
+    attempts = pQueue->Attempts;
+
+    pQueue->FlushWaiters++;
+    pthread_cond_broadcast(&pQueue->Changed);
+
+    while (pQueue->Delivered + pQueue->Discarded < target)
+    {
+        // Give up once an attempt made after the flush started has failed
+        if (pQueue->Attempts != attempts && pQueue->LastError)
+        {
+            dwError = pQueue->LastError;
+            break;
+        }
+        pthread_cond_wait(&pQueue->Changed, &pQueue->Mutex);
+    }
+
+    pQueue->FlushWaiters--;
+
+    pthread_mutex_unlock(&pQueue->Mutex);
+
+    return dwError;
+}
+
+DWORD
+LwEvtFreeWriteQueue(
+    IN PLW_EVT_WRITE_QUEUE pQueue
+    )
+{
+    DWORD dwError = 0;
+
+    if (pQueue == NULL)
+    {
+        goto cleanup;
+    }
+
+    if (pQueue->bThreadStarted)
+    {
+        dwError = LwEvtFlushWriteQueue(pQueue);
+
+        pthread_mutex_lock(&pQueue->Mutex);
+        pQueue->bShutdown = TRUE;
+        pthread_cond_broadcast(&pQueue->Changed);
+        pthread_mutex_unlock(&pQueue->Mutex);
+
+        pthread_join(pQueue->Thread, NULL);
+    }
+
+    if (pQueue->PendingCount)
+    {
+        EVT_LOG_ERROR("Discarding %u undelivered event records",
+                pQueue->PendingCount);
+    }
+    LwEvtFreeRecordArray(pQueue->PendingCount, pQueue->pPending);
+
+    pthread_cond_destroy(&pQueue->Changed);
+    pthread_mutex_destroy(&pQueue->Mutex);
+    LW_SAFE_FREE_MEMORY(pQueue);
+
+cleanup:
+    return dwError;
+}
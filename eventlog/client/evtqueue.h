@@ -0,0 +1,72 @@
+/* Editor Settings: expandtabs and use 4 spaces for indentation
+ * ex: set softtabstop=4 tabstop=8 expandtab shiftwidth=4: *
+ * -*- mode: c, c-basic-offset: 4 -*- */
+
+/*
+ * Copyright © BeyondTrust Software 2004 - 2019
+ * All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * BEYONDTRUST MAKES THIS SOFTWARE AVAILABLE UNDER OTHER LICENSING TERMS AS
+ * WELL. IF YOU HAVE ENTERED INTO A SEPARATE LICENSE AGREEMENT WITH
+ * BEYONDTRUST, THEN YOU MAY ELECT TO USE THE SOFTWARE UNDER THE TERMS OF THAT
+ * SOFTWARE LICENSE AGREEMENT INSTEAD OF THE TERMS OF THE APACHE LICENSE,
+ * NOTWITHSTANDING THE ABOVE NOTICE.  IF YOU HAVE QUESTIONS, OR WISH TO REQUEST
+ * A COPY OF THE ALTERNATE LICENSING TERMS OFFERED BY BEYONDTRUST, PLEASE CONTACT
+ * BEYONDTRUST AT beyondtrust.com/contact
+ */
+
+/*
+ * Module Name:
+ *
+ *        evtqueue.h
+ *
+ * Abstract:
+ *
+ *        Eventlog Client Write Queue
+ *
+ */
+#ifndef __EVTQUEUE_H__
+#define __EVTQUEUE_H__
+
+struct _LW_EVT_WRITE_QUEUE;
+typedef struct _LW_EVT_WRITE_QUEUE
+    LW_EVT_WRITE_QUEUE, *PLW_EVT_WRITE_QUEUE;
+
+DWORD
+LwEvtCreateWriteQueue(
+    IN PLW_EVENTLOG_CONNECTION pConn,
+    IN DWORD MaxBatchRecords,
+    IN DWORD MaxBatchDelayMs,
+    OUT PLW_EVT_WRITE_QUEUE* ppQueue
+    );
+
+DWORD
+LwEvtQueueRecords(
+    IN PLW_EVT_WRITE_QUEUE pQueue,
+    IN DWORD Count,
+    IN PLW_EVENTLOG_RECORD pRecords
+    );
+
+DWORD
+LwEvtFlushWriteQueue(
+    IN PLW_EVT_WRITE_QUEUE pQueue
+    );
+
+DWORD
+LwEvtFreeWriteQueue(
+    IN PLW_EVT_WRITE_QUEUE pQueue
+    );
+
+#endif /* __EVTQUEUE_H__ */
@@ -44,6 +44,7 @@
 #include "eventlog_h.h"
 #include "binding_p.h"
 #include "lwmsg-client.h"
+#include "evtqueue.h"
 #include "eventlog_p.h"
 
 #ifndef   NI_MAXHOST
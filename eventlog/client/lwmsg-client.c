@@ -320,6 +320,130 @@ error:
     goto cleanup;
 }
 
+DWORD
+LwmEvtReadRecordPage(
+    PLW_EVT_CLIENT_CONNECTION_CONTEXT pConn,
+    IN UINT64 StartAfterRecordId,
+    IN DWORD MaxResults,
+    IN PCWSTR pSqlFilter,
+    IN PCLW_EVENTLOG_FILTER pFilter,
+    OUT PUINT64 pNextRecordId,
+    OUT PDWORD pCount,
+    OUT PLW_EVENTLOG_RECORD* ppRecords
+    )
+{
+    DWORD dwError = 0;
+    PEVT_IPC_GENERIC_ERROR pError = NULL;
+    EVT_IPC_READ_PAGE_REQ req = { 0 };
+    PEVT_IPC_RECORD_PAGE pRes = NULL;
+
+    LWMsgParams in = LWMSG_PARAMS_INITIALIZER;
+    LWMsgParams out = LWMSG_PARAMS_INITIALIZER;
+    LWMsgCall* pCall = NULL;
+
+    dwError = LwmEvtAcquireCall(pConn, &pCall);
+    BAIL_ON_EVT_ERROR(dwError);
+
+    req.StartAfterRecordId = StartAfterRecordId;
+    req.MaxResults = MaxResults;
+    req.pFilter = pSqlFilter;
+    req.pQuery = (PLW_EVENTLOG_FILTER)pFilter;
+
+    in.tag = EVT_Q_READ_PAGE;
+    in.data = &req;
+
+    dwError = MAP_LWMSG_ERROR(lwmsg_call_dispatch(pCall, &in, &out, NULL, NULL));
+    BAIL_ON_EVT_ERROR(dwError);
+
+    switch (out.tag)
+    {
+    case EVT_R_READ_PAGE:
+        pRes = (PEVT_IPC_RECORD_PAGE)out.data;
+        *pNextRecordId = pRes->NextRecordId;
+        *pCount = pRes->Count;
+        *ppRecords = pRes->pRecords;
+        pRes->Count = 0;
+        pRes->pRecords = NULL;
+        break;
+    case EVT_R_GENERIC_ERROR:
+        pError = (PEVT_IPC_GENERIC_ERROR) out.data;
+        dwError = pError->Error;
+        BAIL_ON_EVT_ERROR(dwError);
+        break;
+    default:
+        dwError = LW_ERROR_INTERNAL;
+        BAIL_ON_EVT_ERROR(dwError);
+    }
+
+cleanup:
+    if (pCall)
+    {
+        lwmsg_call_destroy_params(pCall, &out);
+        lwmsg_call_release(pCall);
+    }
+    return dwError;
+
+error:
+    *pNextRecordId = 0;
+    *pCount = 0;
+    *ppRecords = NULL;
+    goto cleanup;
+}
+
+DWORD
+LwmEvtCountMatchingRecords(
+    PLW_EVT_CLIENT_CONNECTION_CONTEXT pConn,
+    IN PCLW_EVENTLOG_FILTER pFilter,
+    OUT PDWORD pNumMatched
+    )
+{
+    DWORD dwError = 0;
+    PEVT_IPC_GENERIC_ERROR pError = NULL;
+
+    LWMsgParams in = LWMSG_PARAMS_INITIALIZER;
+    LWMsgParams out = LWMSG_PARAMS_INITIALIZER;
+    LWMsgCall* pCall = NULL;
+
+    dwError = LwmEvtAcquireCall(pConn, &pCall);
+    BAIL_ON_EVT_ERROR(dwError);
+
+    in.tag = EVT_Q_COUNT_MATCHING;
+    in.data = (PVOID)pFilter;
+
+    dwError = MAP_LWMSG_ERROR(lwmsg_call_dispatch(pCall, &in, &out, NULL, NULL));
+    BAIL_ON_EVT_ERROR(dwError);
+    
+    switch (out.tag)
+    {
+    case EVT_R_GET_RECORD_COUNT:
+        *pNumMatched = *(PDWORD)out.data;
+        break;
+    case EVT_R_GENERIC_ERROR:
+        pError = (PEVT_IPC_GENERIC_ERROR) out.data;
+        dwError = pError->Error;
+        BAIL_ON_EVT_ERROR(dwError);
+        break;
+    default:
+        dwError = LW_ERROR_INTERNAL;
+        BAIL_ON_EVT_ERROR(dwError);
+    }
+
+cleanup:
+    if (pCall)
+    {
+        lwmsg_call_destroy_params(pCall, &out);
+        lwmsg_call_release(pCall);
+    }
+    return dwError;
+
+error:
+    if (pNumMatched)
+    {
+        *pNumMatched = 0;
+    }
+    goto cleanup;
+}
+
 DWORD
 LwmEvtWriteRecords(
     PLW_EVT_CLIENT_CONNECTION_CONTEXT pConn,
@@ -420,3 +544,51 @@ cleanup:
 error:
     goto cleanup;
 }
+
+DWORD
+LwmEvtDeleteMatchingRecords(
+    PLW_EVT_CLIENT_CONNECTION_CONTEXT pConn,
+    IN PCLW_EVENTLOG_FILTER pFilter
+    )
+{
+    DWORD dwError = 0;
+    PEVT_IPC_GENERIC_ERROR pError = NULL;
+
+    LWMsgParams in = LWMSG_PARAMS_INITIALIZER;
+    LWMsgParams out = LWMSG_PARAMS_INITIALIZER;
+    LWMsgCall* pCall = NULL;
+
+    dwError = LwmEvtAcquireCall(pConn, &pCall);
+    BAIL_ON_EVT_ERROR(dwError);
+
+    in.tag = EVT_Q_DELETE_MATCHING;
+    in.data = (PVOID)pFilter;
+
+    dwError = MAP_LWMSG_ERROR(lwmsg_call_dispatch(pCall, &in, &out, NULL, NULL));
+    BAIL_ON_EVT_ERROR(dwError);
+    
+    switch (out.tag)
+    {
+    case EVT_R_GENERIC_SUCCESS:
+        break;
+    case EVT_R_GENERIC_ERROR:
+        pError = (PEVT_IPC_GENERIC_ERROR) out.data;
+        dwError = pError->Error;
+        BAIL_ON_EVT_ERROR(dwError);
+        break;
+    default:
+        dwError = LW_ERROR_INTERNAL;
+        BAIL_ON_EVT_ERROR(dwError);
+    }
+
+cleanup:
+    if (pCall)
+    {
+        lwmsg_call_destroy_params(pCall, &out);
+        lwmsg_call_release(pCall);
+    }
+    return dwError;
+
+error:
+    goto cleanup;
+}
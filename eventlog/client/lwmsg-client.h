@@ -80,6 +80,25 @@ LwmEvtReadRecords(
     OUT PLW_EVENTLOG_RECORD* ppRecords
     );
 
+DWORD
+LwmEvtReadRecordPage(
+    PLW_EVT_CLIENT_CONNECTION_CONTEXT pConn,
+    IN UINT64 StartAfterRecordId,
+    IN DWORD MaxResults,
+    IN PCWSTR pSqlFilter,
+    IN PCLW_EVENTLOG_FILTER pFilter,
+    OUT PUINT64 pNextRecordId,
+    OUT PDWORD pCount,
+    OUT PLW_EVENTLOG_RECORD* ppRecords
+    );
+
+DWORD
+LwmEvtCountMatchingRecords(
+    PLW_EVT_CLIENT_CONNECTION_CONTEXT pConn,
+    IN PCLW_EVENTLOG_FILTER pFilter,
+    OUT PDWORD pNumMatched
+    );
+
 DWORD
 LwmEvtWriteRecords(
     PLW_EVT_CLIENT_CONNECTION_CONTEXT pConn,
@@ -93,4 +112,10 @@ LwmEvtDeleteRecords(
     IN PCWSTR pSqlFilter
     );
 
+DWORD
+LwmEvtDeleteMatchingRecords(
+    PLW_EVT_CLIENT_CONNECTION_CONTEXT pConn,
+    IN PCLW_EVENTLOG_FILTER pFilter
+    );
+
 #endif /* __LWMSG_CLIENT_H__ */
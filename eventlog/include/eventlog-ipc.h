@@ -69,6 +69,22 @@ typedef struct _EVT_IPC_RECORD_ARRAY {
     PLW_EVENTLOG_RECORD pRecords;
 } EVT_IPC_RECORD_ARRAY, *PEVT_IPC_RECORD_ARRAY;
 
+typedef struct _EVT_IPC_READ_PAGE_REQ {
+    // Continuation token; 0 starts with the oldest record
+    UINT64 StartAfterRecordId;
+    DWORD MaxResults;
+    // SQL filter, or a structured one; at most one of them
+    PCWSTR pFilter;
+    PLW_EVENTLOG_FILTER pQuery;
+} EVT_IPC_READ_PAGE_REQ, *PEVT_IPC_READ_PAGE_REQ;
+
+typedef struct _EVT_IPC_RECORD_PAGE {
+    // Continuation token for the next page; 0 after the last page
+    UINT64 NextRecordId;
+    DWORD Count;
+    PLW_EVENTLOG_RECORD pRecords;
+} EVT_IPC_RECORD_PAGE, *PEVT_IPC_RECORD_PAGE;
+
 typedef enum _EVT_IPC_TAG
 {
     EVT_R_GENERIC_ERROR,
@@ -81,6 +97,12 @@ typedef enum _EVT_IPC_TAG
     // generic success or error
     EVT_Q_DELETE_RECORDS,
     // generic success or error
+    EVT_Q_READ_PAGE,
+    EVT_R_READ_PAGE,
+    EVT_Q_COUNT_MATCHING,
+    // EVT_R_GET_RECORD_COUNT or error
+    EVT_Q_DELETE_MATCHING,
+    // generic success or error
 } EVT_IPC_TAG;
 
 LWMsgProtocolSpec*
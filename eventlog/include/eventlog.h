@@ -61,6 +61,55 @@
 
 #include <eventlog-record.h>
 
+// Record fields a structured filter can test
+typedef enum _LW_EVENTLOG_FIELD
+{
+    LW_EVENTLOG_FIELD_RECORD_ID,
+    LW_EVENTLOG_FIELD_LOGNAME,
+    LW_EVENTLOG_FIELD_EVENT_TYPE,
+    LW_EVENTLOG_FIELD_DATE_TIME,
+    LW_EVENTLOG_FIELD_SOURCE,
+    LW_EVENTLOG_FIELD_CATEGORY,
+    LW_EVENTLOG_FIELD_SOURCE_ID,
+    LW_EVENTLOG_FIELD_USER,
+    LW_EVENTLOG_FIELD_COMPUTER,
+    LW_EVENTLOG_FIELD_SENTINEL
+} LW_EVENTLOG_FIELD;
+
+typedef enum _LW_EVENTLOG_OPERATOR
+{
+    LW_EVENTLOG_OPERATOR_EQUAL,
+    LW_EVENTLOG_OPERATOR_NOT_EQUAL,
+    LW_EVENTLOG_OPERATOR_LESS,
+    LW_EVENTLOG_OPERATOR_LESS_OR_EQUAL,
+    LW_EVENTLOG_OPERATOR_GREATER,
+    LW_EVENTLOG_OPERATOR_GREATER_OR_EQUAL,
+    LW_EVENTLOG_OPERATOR_SENTINEL
+} LW_EVENTLOG_OPERATOR;
+
+// Compares Field with Number for the record id, date time and source id
+// fields, and with pString for the others.
+typedef struct _LW_EVENTLOG_CONDITION
+{
+    LW_EVENTLOG_FIELD Field;
+    LW_EVENTLOG_OPERATOR Operator;
+    UINT64 Number;
+    PWSTR pString;
+} LW_EVENTLOG_CONDITION, *PLW_EVENTLOG_CONDITION;
+
+// Matches the records that meet all of the conditions; at most
+// LW_EVENTLOG_MAX_CONDITIONS. Filters on the user or the source together
+// with a date time range, or on the source id, are served from an index.
+typedef struct _LW_EVENTLOG_FILTER
+{
+    DWORD Count;
+    PLW_EVENTLOG_CONDITION pConditions;
+} LW_EVENTLOG_FILTER, *PLW_EVENTLOG_FILTER;
+
+typedef const LW_EVENTLOG_FILTER *PCLW_EVENTLOG_FILTER;
+
+#define LW_EVENTLOG_MAX_CONDITIONS 16
+
 struct _LW_EVENTLOG_CONNECTION;
 typedef struct _LW_EVENTLOG_CONNECTION
     LW_EVENTLOG_CONNECTION, *PLW_EVENTLOG_CONNECTION;
@@ -94,6 +143,47 @@ LwEvtReadRecords(
     OUT PLW_EVENTLOG_RECORD* ppRecords
     );
 
+// Reads the records in record id order, one page at a time. Pass 0 as
+// Continuation for the first page and the returned *pNextContinuation for the
+// following ones; it is 0 after the last page. A page holds at most
+// MaxResults records and may hold fewer than requested before the end.
+DWORD
+LwEvtReadRecordPage(
+    IN PLW_EVENTLOG_CONNECTION pConn,
+    IN UINT64 Continuation,
+    IN DWORD MaxResults,
+    IN OPTIONAL PCWSTR pSqlFilter,
+    OUT PUINT64 pNextContinuation,
+    OUT PDWORD pCount,
+    OUT PLW_EVENTLOG_RECORD* ppRecords
+    );
+
+// Like LwEvtReadRecordPage, with a structured filter. Only supported on
+// local connections.
+DWORD
+LwEvtReadMatchingRecordPage(
+    IN PLW_EVENTLOG_CONNECTION pConn,
+    IN UINT64 Continuation,
+    IN DWORD MaxResults,
+    IN PCLW_EVENTLOG_FILTER pFilter,
+    OUT PUINT64 pNextContinuation,
+    OUT PDWORD pCount,
+    OUT PLW_EVENTLOG_RECORD* ppRecords
+    );
+
+DWORD
+LwEvtCountMatchingRecords(
+    IN PLW_EVENTLOG_CONNECTION pConn,
+    IN PCLW_EVENTLOG_FILTER pFilter,
+    OUT PDWORD pNumMatched
+    );
+
+DWORD
+LwEvtDeleteMatchingRecords(
+    IN PLW_EVENTLOG_CONNECTION pConn,
+    IN PCLW_EVENTLOG_FILTER pFilter
+    );
+
 DWORD
 LwEvtWriteRecords(
     IN PLW_EVENTLOG_CONNECTION pConn,
@@ -101,6 +191,27 @@ LwEvtWriteRecords(
     IN PLW_EVENTLOG_RECORD pRecords 
     );
 
+// Makes LwEvtWriteRecords on this connection asynchronous. Records are
+// copied and returned immediately; a background thread coalesces the records
+// of all writers and sends them once MaxBatchRecords are pending or the
+// oldest has waited MaxBatchDelayMs. Batches that fail are retried. A write
+// only fails if the queue is full and the last send attempt failed.
+// LwEvtCloseEventlog delivers any remaining records before closing.
+DWORD
+LwEvtEnableWriteQueue(
+    IN PLW_EVENTLOG_CONNECTION pConn,
+    IN DWORD MaxBatchRecords,
+    IN DWORD MaxBatchDelayMs
+    );
+
+// Waits until all records written so far have been delivered. Returns the
+// error of the failed send attempt if they could not be. Does nothing on a
+// connection without a write queue.
+DWORD
+LwEvtFlushRecords(
+    IN PLW_EVENTLOG_CONNECTION pConn
+    );
+
 DWORD
 LwEvtDeleteRecords(
     IN PLW_EVENTLOG_CONNECTION pConn,
@@ -44,6 +44,7 @@
 #endif
 
   #include <sys/types.h>
+  #include <sys/time.h>
   #include <pthread.h>
   #include <syslog.h>
   #include <signal.h>
@@ -130,6 +130,64 @@ static LWMsgTypeSpec gEvtIpcRecordArraySpec[] =
     LWMSG_TYPE_END
 };
 
+static LWMsgTypeSpec gLwEventLogConditionSpec[] =
+{
+    LWMSG_STRUCT_BEGIN(LW_EVENTLOG_CONDITION),
+    LWMSG_MEMBER_UINT32(LW_EVENTLOG_CONDITION, Field),
+    LWMSG_MEMBER_UINT32(LW_EVENTLOG_CONDITION, Operator),
+    LWMSG_MEMBER_UINT64(LW_EVENTLOG_CONDITION, Number),
+    LWMSG_MEMBER_PWSTR(LW_EVENTLOG_CONDITION, pString),
+    LWMSG_STRUCT_END,
+    LWMSG_TYPE_END
+};
+
+static LWMsgTypeSpec gLwEventLogFilterSpec[] =
+{
+    LWMSG_STRUCT_BEGIN(LW_EVENTLOG_FILTER),
+    LWMSG_MEMBER_UINT32(LW_EVENTLOG_FILTER, Count),
+    LWMSG_MEMBER_POINTER_BEGIN(LW_EVENTLOG_FILTER, pConditions),
+    LWMSG_TYPESPEC(gLwEventLogConditionSpec),
+    LWMSG_POINTER_END,
+    LWMSG_ATTR_LENGTH_MEMBER(LW_EVENTLOG_FILTER, Count),
+    LWMSG_STRUCT_END,
+    LWMSG_TYPE_END
+};
+
+static LWMsgTypeSpec gEvtIpcQuerySpec[] =
+{
+    LWMSG_POINTER_BEGIN,
+    LWMSG_TYPESPEC(gLwEventLogFilterSpec),
+    LWMSG_POINTER_END,
+    LWMSG_ATTR_NOT_NULL,
+    LWMSG_TYPE_END
+};
+
+static LWMsgTypeSpec gEvtIpcReadPageReqSpec[] =
+{
+    LWMSG_STRUCT_BEGIN(EVT_IPC_READ_PAGE_REQ),
+    LWMSG_MEMBER_UINT64(EVT_IPC_READ_PAGE_REQ, StartAfterRecordId),
+    LWMSG_MEMBER_UINT32(EVT_IPC_READ_PAGE_REQ, MaxResults),
+    LWMSG_MEMBER_PWSTR(EVT_IPC_READ_PAGE_REQ, pFilter),
+    LWMSG_MEMBER_POINTER_BEGIN(EVT_IPC_READ_PAGE_REQ, pQuery),
+    LWMSG_TYPESPEC(gLwEventLogFilterSpec),
+    LWMSG_POINTER_END,
+    LWMSG_STRUCT_END,
+    LWMSG_TYPE_END
+};
+
+static LWMsgTypeSpec gEvtIpcRecordPageSpec[] =
+{
+    LWMSG_STRUCT_BEGIN(EVT_IPC_RECORD_PAGE),
+    LWMSG_MEMBER_UINT64(EVT_IPC_RECORD_PAGE, NextRecordId),
+    LWMSG_MEMBER_UINT32(EVT_IPC_RECORD_PAGE, Count),
+    LWMSG_MEMBER_POINTER_BEGIN(EVT_IPC_RECORD_PAGE, pRecords),
+    LWMSG_TYPESPEC(gLwEventLogRecordSpec),
+    LWMSG_POINTER_END,
+    LWMSG_ATTR_LENGTH_MEMBER(EVT_IPC_RECORD_PAGE, Count),
+    LWMSG_STRUCT_END,
+    LWMSG_TYPE_END
+};
+
 static LWMsgProtocolSpec gLwEvtIPCSpec[] =
 {
     LWMSG_MESSAGE(EVT_R_GENERIC_ERROR, gLwEvtIpcGenericErrorSpec),
@@ -142,6 +200,10 @@ static LWMsgProtocolSpec gLwEvtIPCSpec[] =
     // generic success
     LWMSG_MESSAGE(EVT_Q_DELETE_RECORDS, gLwEvtIpcFilterSpec), //PCWSTR
     // generic success
+    LWMSG_MESSAGE(EVT_Q_READ_PAGE, gEvtIpcReadPageReqSpec),
+    LWMSG_MESSAGE(EVT_R_READ_PAGE, gEvtIpcRecordPageSpec),
+    LWMSG_MESSAGE(EVT_Q_COUNT_MATCHING, gEvtIpcQuerySpec),
+    LWMSG_MESSAGE(EVT_Q_DELETE_MATCHING, gEvtIpcQuerySpec),
     LWMSG_PROTOCOL_END
 };
 
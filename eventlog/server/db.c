@@ -104,6 +104,75 @@
                              ORDER BY EventRecordId ASC  \
                              LIMIT %ld"
 
+//One page of records after a record id. One more row than the page
+//holds is read to tell whether there is another page.
+#define DB_QUERY_PAGE       L"SELECT EventRecordId,        \
+                                    EventTableCategoryId, \
+                                    EventType,            \
+                                    EventDateTime,        \
+                                    EventSource,          \
+                                    EventCategory,        \
+                                    EventSourceId,        \
+                                    User,                 \
+                                    Computer,             \
+                                    Description,          \
+                                    Data                  \
+                             FROM     lwievents           \
+                             WHERE  EventRecordId > ?1    \
+                             ORDER BY EventRecordId ASC  \
+                             LIMIT ?2"
+
+#define DB_QUERY_PAGE_WITH_FILTER L"SELECT EventRecordId,  \
+                                    EventTableCategoryId, \
+                                    EventType,            \
+                                    EventDateTime,        \
+                                    EventSource,          \
+                                    EventCategory,        \
+                                    EventSourceId,        \
+                                    User,                 \
+                                    Computer,             \
+                                    Description,          \
+                                    Data                  \
+                             FROM     lwievents           \
+                             WHERE  EventRecordId > ?1 AND (%ws) \
+                             ORDER BY EventRecordId ASC  \
+                             LIMIT ?2"
+
+//Structured filters compile to one of these, with " AND <column> <op> ?n"
+//appended to the WHERE clause for every condition. The page query binds the
+//conditions from ?3 on, the others from ?1.
+#define DB_QUERY_PAGE_MATCHING "SELECT EventRecordId,    \
+                                    EventTableCategoryId, \
+                                    EventType,            \
+                                    EventDateTime,        \
+                                    EventSource,          \
+                                    EventCategory,        \
+                                    EventSourceId,        \
+                                    User,                 \
+                                    Computer,             \
+                                    Description,          \
+                                    Data                  \
+                             FROM     lwievents           \
+                             WHERE  EventRecordId > ?1%s  \
+                             ORDER BY EventRecordId ASC  \
+                             LIMIT ?2"
+
+#define DB_QUERY_COUNT_MATCHING "SELECT COUNT(*)        \
+                             FROM     lwievents           \
+                             WHERE  1%s"
+
+#define DB_QUERY_DELETE_MATCHING "DELETE FROM lwievents  \
+                             WHERE  1%s"
+
+//Indexes for the structured filters, added to existing databases at startup
+#define DB_QUERY_CREATE_FILTER_INDEXES \
+    "CREATE INDEX IF NOT EXISTS lwindex_userDateTime        \
+        ON lwievents(User, EventDateTime);                  \
+     CREATE INDEX IF NOT EXISTS lwindex_sourceDateTime      \
+        ON lwievents(EventSource, EventDateTime);           \
+     CREATE INDEX IF NOT EXISTS lwindex_sourceId            \
+        ON lwievents(EventSourceId)"
+
 #define DB_QUERY_COUNT_ALL  L"SELECT COUNT(*)  \
                              FROM     lwievents"
 
@@ -113,6 +182,13 @@
 
 #define DB_QUERY_DROP_EVENTS_TABLE "DROP TABLE lwievents"
 
+#define DB_QUERY_JOURNAL_MODE_WAL    "PRAGMA journal_mode = WAL"
+
+#define DB_QUERY_JOURNAL_MODE_DELETE "PRAGMA journal_mode = DELETE"
+
+//Safe against corruption in WAL mode; a power loss may lose the last commits
+#define DB_QUERY_SYNCHRONOUS_NORMAL  "PRAGMA synchronous = NORMAL"
+
 #define DB_QUERY_DELETE     L"DELETE FROM     lwievents    \
                              WHERE  (%ws)"
 
@@ -144,34 +220,28 @@
                                         ?9,                    \
                                         ?10)"
 
-//Delete the record over 'n' entries
-#define DB_QUERY_DELETE_AT_LIMIT    "DELETE FROM lwievents \
-                                    WHERE EventRecordId IN ( \
-                                        SELECT EventRecordId \
-                                        FROM lwievents \
-                                        ORDER BY EventRecordId ASC \
-                                        LIMIT max( \
-                                            (SELECT count(*) FROM lwievents) - \
-                                            %lu, 0 \
-                                        ) \
-                                    )"
-
-//Delete the first 'n' entries
-#define DB_QUERY_DELETE_COUNT       "DELETE FROM     lwievents      \
+//Lowest record id, i.e. the oldest record
+#define DB_QUERY_MIN_RECORD_ID      "SELECT MIN(EventRecordId) FROM lwievents"
+
+//Oldest event time, served from the dateTime index
+#define DB_QUERY_MIN_DATE_TIME      "SELECT MIN(EventDateTime) FROM lwievents"
+
+//Delete the records below a record id
+#define DB_QUERY_DELETE_BELOW_ID    "DELETE FROM     lwievents      \
+                                     WHERE  EventRecordId < ?1"
+
+//Delete up to 'n' records written before a time
+#define DB_QUERY_DELETE_OLDER_THAN  "DELETE FROM     lwievents      \
                                      WHERE  EventRecordId IN (      \
                                        SELECT EventRecordId         \
                                        FROM     lwievents           \
-                                       ORDER BY EventRecordId ASC   \
-                                       LIMIT %lu                    \
+                                       WHERE  EventDateTime < ?1    \
+                                       LIMIT ?2                     \
                                      )"
 
-//To delete records 'n' days older than current date.
-#define DB_QUERY_DELETE_OLDER_THAN  "DELETE FROM     lwievents    \
-                                     WHERE  (EventDateTime < strftime('%%s', 'now', '-%d day'))"
-
-//To get count of records that are older  than 'n' days
-#define DB_QUERY_COUNT_OLDER_THAN  "SELECT COUNT (EventRecordId) FROM  lwievents    \
-                                     WHERE  (EventDateTime < strftime('%%s', 'now','-%d day'))"
+#define DB_QUERY_PAGE_SIZE          "PRAGMA page_size"
+#define DB_QUERY_PAGE_COUNT         "PRAGMA page_count"
+#define DB_QUERY_FREELIST_COUNT     "PRAGMA freelist_count"
 
 //To sort the record depending upon the date
 #define DB_QUERY_SORT_ON_DATE       "SELECT (*) FROM  lwievents    \
@@ -191,36 +261,48 @@ LwEvtDbCheckSqlFilter(
 static
 DWORD
 LwEvtDbMaintainDB_inlock(
-    sqlite3 *pDb
+    sqlite3 *pDb,
+    BOOLEAN bFullCheck
     );
 
 static
 DWORD
-LwEvtDbEventLogCountOlderThan_inlock(
+LwEvtDbQueryInt64_inlock(
     sqlite3 *pDb,
-    DWORD dwOlderThan,
-    PDWORD pdwNumMatched
+    PCSTR pszQuery,
+    sqlite_int64* pValue,
+    PBOOLEAN pbFound
     );
 
 static
 DWORD
-LwEvtDbLimitDatabaseSize_inlock(
+LwEvtDbDeleteChunk_inlock(
     sqlite3 *pDb,
-    DWORD dwMaxLogSize
+    PCSTR pszQuery,
+    sqlite_int64 Argument1,
+    sqlite_int64 Argument2,
+    PDWORD pdwDeleted
+    );
+
+static
+DWORD
+LwEvtDbLimitRecordCount_inlock(
+    sqlite3 *pDb,
+    sqlite_int64 MaxRecords
     );
 
 static
 DWORD
-LwEvtDbDeleteOlderThanCurDate_inlock(
+LwEvtDbDeleteOlderThan_inlock(
     sqlite3 *pDb,
-    DWORD dwOlderThan
+    DWORD dwMaxAge
     );
 
 static
 DWORD
-LwEvtDbDeleteIfCountExceeds_inlock(
+LwEvtDbLimitDatabaseSize_inlock(
     sqlite3 *pDb,
-    DWORD dwOlderThan
+    DWORD dwMaxLogSize
     );
 
 static
@@ -231,18 +313,205 @@ LwEvtDbGetRecordCount_inlock(
     DWORD * pNumMatched
     );
 
+/*
+ * In write-ahead log mode readers see a snapshot and never block the
+ * writer, so they do not take the database lock. Set once at startup.
+ */
+static BOOLEAN gbWriteAheadLog = FALSE;
+
+#define ENTER_DB_READER_LOCK(inLock) \
+    do \
+    { \
+        if (!gbWriteAheadLog) \
+        { \
+            ENTER_RW_READER_LOCK(inLock); \
+        } \
+    } \
+    while (FALSE)
+
+/*
+ * Read-only connections kept open between read requests.
+ */
+static pthread_mutex_t gReaderPoolLock = PTHREAD_MUTEX_INITIALIZER;
+static sqlite3* gpIdleReaders[EVT_DB_MAX_IDLE_READERS];
+static DWORD gIdleReaderCount = 0;
+
+/*
+ * Number of rows in lwievents, kept up to date by every insert and delete
+ * under the writer lock so retention never has to count the table. It is
+ * -1 until the first write counts the table once.
+ */
+static sqlite_int64 gRecordCount = -1;
+
+/*
+ * Columns and comparisons of the structured filters, indexed by
+ * LW_EVENTLOG_FIELD and LW_EVENTLOG_OPERATOR.
+ */
+static const struct
+{
+    PCSTR pszColumn;
+    BOOLEAN bString;
+} gEvtDbFilterFields[] =
+{
+    { "EventRecordId", FALSE },
+    { "EventTableCategoryId", TRUE },
+    { "EventType", TRUE },
+    { "EventDateTime", FALSE },
+    { "EventSource", TRUE },
+    { "EventCategory", TRUE },
+    { "EventSourceId", FALSE },
+    { "User", TRUE },
+    { "Computer", TRUE },
+};
+
+static PCSTR gpszEvtDbFilterOperators[] =
+{
+    "=",
+    "<>",
+    "<",
+    "<=",
+    ">",
+    ">=",
+};
+
+static
+DWORD
+LwEvtDbCompileFilter(
+    PCSTR pszQueryFormat,
+    PCLW_EVENTLOG_FILTER pFilter,
+    int FirstParameter,
+    PSTR pszQuery,
+    size_t QuerySize
+    );
+
+static
+DWORD
+LwEvtDbBindFilter(
+    sqlite3 *pDb,
+    sqlite3_stmt *pStatement,
+    PCLW_EVENTLOG_FILTER pFilter,
+    int FirstParameter
+    );
+
+static
+DWORD
+LwEvtDbPrepareCached(
+    sqlite3 *pDb,
+    PCSTR pszQuery,
+    sqlite3_stmt **ppStatement
+    );
+
+static
+VOID
+LwEvtDbReleaseCached(
+    sqlite3_stmt *pStatement
+    );
+
 //public interface
 
 DWORD
 LwEvtDbInitEventDatabase()
 {
+    DWORD dwError = 0;
+    sqlite3* pDb = NULL;
+    sqlite3_stmt *pStatement = NULL;
+    BOOLEAN bWriteAheadLog = FALSE;
+    PCSTR pszMode = NULL;
+    PSTR pszError = NULL;
+
     pthread_rwlock_init(&g_dbLock, NULL);
-    return 0;
+
+    dwError = EVTGetWriteAheadLog(&bWriteAheadLog);
+    BAIL_ON_EVT_ERROR(dwError);
+
+    // The bundled sqlite predates write-ahead logging. Keeping the rollback
+    // journal there also keeps readers under the database lock below.
+    if (bWriteAheadLog &&
+        sqlite3_libversion_number() < EVT_DB_MIN_WAL_SQLITE_VERSION)
+    {
+        EVT_LOG_INFO("evtdb: sqlite %s has no write-ahead log support; "
+                     "ignoring EventDbWriteAheadLog",
+                     sqlite3_libversion());
+        bWriteAheadLog = FALSE;
+    }
+
+    dwError = sqlite3_open(EVENTLOG_DB, &pDb);
+    BAIL_ON_EVT_ERROR(dwError);
+
+    // The journal mode is stored in the database file, so it also has to be
+    // switched back when the setting is turned off.
+    dwError = sqlite3_prepare_v2(
+                    pDb,
+                    bWriteAheadLog ?
+                        DB_QUERY_JOURNAL_MODE_WAL :
+                        DB_QUERY_JOURNAL_MODE_DELETE,
+                    -1,
+                    &pStatement,
+                    NULL);
+    BAIL_ON_SQLITE3_ERROR(dwError, sqlite3_errmsg(pDb));
+
+    dwError = sqlite3_step(pStatement);
+    if (dwError == SQLITE_ROW)
+    {
+        dwError = 0;
+        pszMode = (PCSTR)sqlite3_column_text(pStatement, 0);
+    }
+    else if (dwError == SQLITE_DONE)
+    {
+        dwError = 0;
+    }
+    BAIL_ON_SQLITE3_ERROR(dwError, sqlite3_errmsg(pDb));
+
+    // The pragma answers with the mode actually in effect
+    gbWriteAheadLog = pszMode && !strcasecmp(pszMode, "wal");
+
+    if (bWriteAheadLog && !gbWriteAheadLog)
+    {
+        EVT_LOG_WARNING("evtdb: Could not switch the event database to write-ahead logging; "
+                        "readers will block writers");
+    }
+
+    EVT_LOG_INFO("evtdb: Journal mode is %s", LW_SAFE_LOG_STRING(pszMode));
+
+    dwError = sqlite3_exec(
+                    pDb,
+                    DB_QUERY_CREATE_FILTER_INDEXES,
+                    NULL,
+                    NULL,
+                    &pszError);
+    BAIL_ON_SQLITE3_ERROR(dwError, pszError);
+
+cleanup:
+    if (pszError)
+    {
+        sqlite3_free(pszError);
+    }
+    if (pStatement)
+    {
+        sqlite3_finalize(pStatement);
+    }
+    if (pDb)
+    {
+        sqlite3_close(pDb);
+    }
+    return dwError;
+
+error:
+    goto cleanup;
 }
 
 DWORD
 LwEvtDbShutdownEventDatabase()
 {
+    pthread_mutex_lock(&gReaderPoolLock);
+
+    while (gIdleReaderCount)
+    {
+        LwEvtDbClose(gpIdleReaders[--gIdleReaderCount]);
+    }
+
+    pthread_mutex_unlock(&gReaderPoolLock);
+
     return 0;
 }
 
@@ -253,13 +522,32 @@ LwEvtDbOpen(
 {
     DWORD dwError = 0;
     sqlite3* pDb = NULL;
+    PSTR pszError = NULL;
 
     dwError = sqlite3_open(EVENTLOG_DB, &pDb);
     BAIL_ON_EVT_ERROR(dwError);
 
+    dwError = sqlite3_busy_timeout(pDb, EVT_DB_BUSY_TIMEOUT_MS);
+    BAIL_ON_SQLITE3_ERROR(dwError, sqlite3_errmsg(pDb));
+
+    if (gbWriteAheadLog)
+    {
+        dwError = sqlite3_exec(
+                        pDb,
+                        DB_QUERY_SYNCHRONOUS_NORMAL,
+                        NULL,
+                        NULL,
+                        &pszError);
+        BAIL_ON_SQLITE3_ERROR(dwError, pszError);
+    }
+
     *ppDb = pDb;
 
 cleanup:
+    if (pszError)
+    {
+        sqlite3_free(pszError);
+    }
     return dwError;
 
 error:
@@ -277,9 +565,16 @@ LwEvtDbClose(
     )
 {
     DWORD dwError = 0;
+    sqlite3_stmt *pStatement = NULL;
 
     if (pDb)
     {
+        // Cached filter queries stay prepared until the connection closes
+        while ((pStatement = sqlite3_next_stmt(pDb, NULL)) != NULL)
+        {
+            sqlite3_finalize(pStatement);
+        }
+
         dwError = sqlite3_close(pDb);
         BAIL_ON_SQLITE3_ERROR(dwError, sqlite3_errmsg(pDb));
     }
@@ -290,6 +585,72 @@ error:
     goto cleanup;
 }
 
+/*
+ * Returns a read-only connection for LwEvtDbGetRecordCount and
+ * LwEvtDbReadRecords, reusing an idle one when there is one. Give it back
+ * with LwEvtDbCloseReader.
+ */
+DWORD
+LwEvtDbOpenReader(
+    sqlite3** ppDb
+    )
+{
+    DWORD dwError = 0;
+    sqlite3* pDb = NULL;
+
+    pthread_mutex_lock(&gReaderPoolLock);
+    if (gIdleReaderCount)
+    {
+        pDb = gpIdleReaders[--gIdleReaderCount];
+    }
+    pthread_mutex_unlock(&gReaderPoolLock);
+
+    if (!pDb)
+    {
+        dwError = sqlite3_open_v2(
+                        EVENTLOG_DB,
+                        &pDb,
+                        SQLITE_OPEN_READONLY,
+                        NULL);
+        BAIL_ON_EVT_ERROR(dwError);
+
+        dwError = sqlite3_busy_timeout(pDb, EVT_DB_BUSY_TIMEOUT_MS);
+        BAIL_ON_SQLITE3_ERROR(dwError, sqlite3_errmsg(pDb));
+    }
+
+    *ppDb = pDb;
+
+cleanup:
+    return dwError;
+
+error:
+    if (pDb)
+    {
+        sqlite3_close(pDb);
+    }
+    *ppDb = NULL;
+    goto cleanup;
+}
+
+DWORD
+LwEvtDbCloseReader(
+    sqlite3* pDb
+    )
+{
+    if (pDb)
+    {
+        pthread_mutex_lock(&gReaderPoolLock);
+        if (gIdleReaderCount < EVT_DB_MAX_IDLE_READERS)
+        {
+            gpIdleReaders[gIdleReaderCount++] = pDb;
+            pDb = NULL;
+        }
+        pthread_mutex_unlock(&gReaderPoolLock);
+    }
+
+    return LwEvtDbClose(pDb);
+}
+
 static
 DWORD
 LwEvtDbCheckSqlFilter(
@@ -378,7 +739,7 @@ LwEvtDbGetRecordCount(
     DWORD error = 0;
     BOOLEAN inLock = FALSE;
 
-    ENTER_RW_READER_LOCK(inLock);
+    ENTER_DB_READER_LOCK(inLock);
 
     error = LwEvtDbGetRecordCount_inlock(
                 pDb,
@@ -734,10 +1095,11 @@ LwEvtDbReadRecords(
         BAIL_ON_EVT_ERROR(dwError);
     }
 
-    ENTER_RW_READER_LOCK(inLock);
+    ENTER_DB_READER_LOCK(inLock);
 
     // This statement needs to be in the lock because it can fail with
-    // SQLITE_BUSY if some other thread is accessing the database.
+    // SQLITE_BUSY if some other thread is accessing the database. In
+    // write-ahead log mode it reads a snapshot instead.
     dwError = sqlite3_prepare16_v2(
                     pDb,
                     pQuery,
@@ -821,29 +1183,265 @@ error:
     goto cleanup;
 }
 
-
+/*
+ * Reads up to MaxResults records (at most EVT_MAX_RECORD_PAGE) with an id
+ * above StartAfterRecordId. The starting key is a range on the primary key,
+ * so every page costs the same however far into the table it is.
+ * *pNextRecordId receives the id to continue after, or 0 if this was the
+ * last page.
+ *
+ * The records can be restricted with either a SQL filter or a structured
+ * one. Structured filters are compiled once per connection and reused.
+ */
 DWORD
-LwEvtDbWriteRecords(
+LwEvtDbReadRecordPage(
+    DWORD (*pAllocate)(DWORD, PVOID*),
+    VOID (*pFree)(PVOID),
     sqlite3 *pDb,
-    DWORD Count,
-    const LW_EVENTLOG_RECORD *pRecords 
+    UINT64 StartAfterRecordId,
+    DWORD MaxResults,
+    PCWSTR pSqlFilter,
+    PCLW_EVENTLOG_FILTER pFilter,
+    PUINT64 pNextRecordId,
+    PDWORD pCount,
+    PLW_EVENTLOG_RECORD* ppRecords
     )
 {
     DWORD dwError = 0;
+    PLW_EVENTLOG_RECORD pRecords = NULL;
+    DWORD count = 0;
+    DWORD pageSize = LW_MIN(MaxResults, EVT_MAX_RECORD_PAGE);
+    UINT64 nextRecordId = 0;
     sqlite3_stmt *pStatement = NULL;
-    int iColumnPos = 1;
-    const LW_EVENTLOG_RECORD* pRecord = NULL;
-    DWORD index = 0;
-    PSTR pError = NULL;
+    PWSTR pQuery = NULL;
+    CHAR szQuery[2048];
     BOOLEAN inLock = FALSE;
-    BOOLEAN removeAsNeeded = FALSE;
 
-    EVT_LOG_VERBOSE("server::evtdb.c Writing %u records (pDb=%.16X)\n",
-                    Count, pDb);
+    if (pageSize == 0 || (pSqlFilter && pFilter))
+    {
+        dwError = ERROR_INVALID_PARAMETER;
+        BAIL_ON_EVT_ERROR(dwError);
+    }
 
-    ENTER_RW_WRITER_LOCK(inLock);
+    if (pSqlFilter == NULL)
+    {
+        dwError = LwEvtDbCompileFilter(
+                        DB_QUERY_PAGE_MATCHING,
+                        pFilter,
+                        3,
+                        szQuery,
+                        sizeof(szQuery));
+        BAIL_ON_EVT_ERROR(dwError);
+    }
+    else
+    {
+        dwError = LwEvtDbCheckSqlFilter(pSqlFilter);
+        BAIL_ON_EVT_ERROR(dwError);
 
-    // This statement needs to be in the lock because it can fail with
+        dwError = LwAllocateWc16sPrintfW(
+                        &pQuery,
+                        DB_QUERY_PAGE_WITH_FILTER,
+                        pSqlFilter);
+        BAIL_ON_EVT_ERROR(dwError);
+    }
+
+    dwError = pAllocate(
+                    sizeof(pRecords[0]) * pageSize,
+                    (PVOID*)&pRecords);
+    BAIL_ON_EVT_ERROR(dwError);
+
+    ENTER_DB_READER_LOCK(inLock);
+
+    if (pQuery)
+    {
+        dwError = sqlite3_prepare16_v2(
+                        pDb,
+                        pQuery,
+                        -1,
+                        &pStatement,
+                        NULL);
+        BAIL_ON_SQLITE3_ERROR(dwError, sqlite3_errmsg(pDb));
+    }
+    else
+    {
+        dwError = LwEvtDbPrepareCached(pDb, szQuery, &pStatement);
+        BAIL_ON_EVT_ERROR(dwError);
+
+        dwError = LwEvtDbBindFilter(pDb, pStatement, pFilter, 3);
+        BAIL_ON_EVT_ERROR(dwError);
+    }
+
+    dwError = sqlite3_bind_int64(
+                    pStatement,
+                    1,
+                    (sqlite_int64)StartAfterRecordId);
+    BAIL_ON_SQLITE3_ERROR(dwError, sqlite3_errmsg(pDb));
+
+    dwError = sqlite3_bind_int64(
+                    pStatement,
+                    2,
+                    (sqlite_int64)pageSize + 1);
+    BAIL_ON_SQLITE3_ERROR(dwError, sqlite3_errmsg(pDb));
+
+    while (1)
+    {
+        dwError = sqlite3_step(pStatement);
+        if (dwError == SQLITE_DONE || dwError == SQLITE_OK)
+        {
+            dwError = 0;
+            break;
+        }
+        else if (dwError == SQLITE_ROW)
+        {
+            dwError = 0;
+        }
+        else
+        {
+            BAIL_ON_SQLITE3_ERROR(dwError, sqlite3_errmsg(pDb));
+        }
+
+        if (count == pageSize)
+        {
+            // There is at least one more record
+            nextRecordId = pRecords[count - 1].EventRecordId;
+            break;
+        }
+
+        dwError = LwEvtDbUnpackRecord(
+                        pAllocate,
+                        pFree,
+                        pStatement,
+                        &pRecords[count]);
+        BAIL_ON_EVT_ERROR(dwError);
+        count++;
+    }
+
+    *pNextRecordId = nextRecordId;
+    *pCount = count;
+    *ppRecords = pRecords;
+
+cleanup:
+    if (pQuery)
+    {
+        sqlite3_finalize(pStatement);
+    }
+    else if (pStatement)
+    {
+        LwEvtDbReleaseCached(pStatement);
+    }
+    LEAVE_RW_READER_LOCK(inLock);
+
+    LW_SAFE_FREE_MEMORY(pQuery);
+    return dwError;
+
+error:
+    *pNextRecordId = 0;
+    *pCount = 0;
+    *ppRecords = NULL;
+    while (count)
+    {
+        count--;
+        LwEvtDbFreeRecord(pFree, &pRecords[count]);
+    }
+    if (pRecords)
+    {
+        pFree(pRecords);
+    }
+    goto cleanup;
+}
+
+/*
+ * Counts the records that match a structured filter; NULL matches all of
+ * them.
+ */
+DWORD
+LwEvtDbCountMatchingRecords(
+    sqlite3 *pDb,
+    PCLW_EVENTLOG_FILTER pFilter,
+    PDWORD pNumMatched
+    )
+{
+    DWORD dwError = 0;
+    CHAR szQuery[2048];
+    sqlite3_stmt *pStatement = NULL;
+    sqlite_int64 recordCount = 0;
+    BOOLEAN inLock = FALSE;
+
+    dwError = LwEvtDbCompileFilter(
+                    DB_QUERY_COUNT_MATCHING,
+                    pFilter,
+                    1,
+                    szQuery,
+                    sizeof(szQuery));
+    BAIL_ON_EVT_ERROR(dwError);
+
+    ENTER_DB_READER_LOCK(inLock);
+
+    dwError = LwEvtDbPrepareCached(pDb, szQuery, &pStatement);
+    BAIL_ON_EVT_ERROR(dwError);
+
+    dwError = LwEvtDbBindFilter(pDb, pStatement, pFilter, 1);
+    BAIL_ON_EVT_ERROR(dwError);
+
+    dwError = sqlite3_step(pStatement);
+    if (dwError == SQLITE_ROW)
+    {
+        dwError = 0;
+        recordCount = sqlite3_column_int64(pStatement, 0);
+    }
+    else if (dwError == SQLITE_DONE || dwError == SQLITE_OK)
+    {
+        dwError = ERROR_BADDB;
+        BAIL_ON_EVT_ERROR(dwError);
+    }
+    else
+    {
+        BAIL_ON_SQLITE3_ERROR(dwError, sqlite3_errmsg(pDb));
+    }
+
+    if ((DWORD)recordCount != recordCount)
+    {
+        dwError = ERROR_ARITHMETIC_OVERFLOW;
+        BAIL_ON_EVT_ERROR(dwError);
+    }
+    *pNumMatched = (DWORD)recordCount;
+
+cleanup:
+    if (pStatement)
+    {
+        LwEvtDbReleaseCached(pStatement);
+    }
+    LEAVE_RW_READER_LOCK(inLock);
+
+    return dwError;
+
+error:
+    *pNumMatched = 0;
+    goto cleanup;
+}
+
+DWORD
+LwEvtDbWriteRecords(
+    sqlite3 *pDb,
+    DWORD Count,
+    const LW_EVENTLOG_RECORD *pRecords 
+    )
+{
+    DWORD dwError = 0;
+    sqlite3_stmt *pStatement = NULL;
+    int iColumnPos = 1;
+    const LW_EVENTLOG_RECORD* pRecord = NULL;
+    DWORD index = 0;
+    PSTR pError = NULL;
+    BOOLEAN inLock = FALSE;
+    BOOLEAN removeAsNeeded = FALSE;
+
+    EVT_LOG_VERBOSE("server::evtdb.c Writing %u records (pDb=%.16X)\n",
+                    Count, pDb);
+
+    ENTER_RW_WRITER_LOCK(inLock);
+
+    // This statement needs to be in the lock because it can fail with
     // SQLITE_BUSY if some other thread is accessing the database.
     dwError = sqlite3_prepare_v2(
                     pDb,
@@ -973,20 +1571,29 @@ LwEvtDbWriteRecords(
 
     EVT_LOG_VERBOSE("Write finished");
 
-    gdwNewEventCount += Count;
-    if (gdwNewEventCount >= EVT_MAINTAIN_EVENT_COUNT)
+    if (gRecordCount >= 0)
     {
-        dwError = EVTGetRemoveAsNeeded(&removeAsNeeded);
-        BAIL_ON_EVT_ERROR(dwError);
+        gRecordCount += Count;
     }
 
+    dwError = EVTGetRemoveAsNeeded(&removeAsNeeded);
+    BAIL_ON_EVT_ERROR(dwError);
+
     if (removeAsNeeded)
     {
-        //Trim the DB
-        dwError = LwEvtDbMaintainDB_inlock(pDb);
+        // The record limit is checked on every write since the count is
+        // known; age and disk usage only every few writes.
+        gdwNewEventCount += Count;
+
+        dwError = LwEvtDbMaintainDB_inlock(
+                        pDb,
+                        gdwNewEventCount >= EVT_MAINTAIN_EVENT_COUNT);
         BAIL_ON_EVT_ERROR(dwError);
 
-        gdwNewEventCount = 0;
+        if (gdwNewEventCount >= EVT_MAINTAIN_EVENT_COUNT)
+        {
+            gdwNewEventCount = 0;
+        }
     }
 
  cleanup:
@@ -1013,22 +1620,25 @@ LwEvtDbWriteRecords(
     goto cleanup;
 }
 
-/* A routine to trim the database*/
+/*
+ * A routine to trim the database. The oldest records are dropped first, a
+ * bounded chunk of record ids at a time, so the table behaves like a ring
+ * buffer and the cost depends on what is removed rather than on the size
+ * of the table.
+ */
 static
 DWORD
 LwEvtDbMaintainDB_inlock(
-    sqlite3 *pDb
+    sqlite3 *pDb,
+    BOOLEAN bFullCheck
     )
 {
     DWORD dwError = 0;
     DWORD dwRecordCount = 0;
-    DWORD dwCountOlderThan = 0;
     DWORD dwMaxRecords = 0;
     DWORD dwMaxAge = 0;
     DWORD dwMaxLogSize = 0;
-    DWORD dwActualSize = 0;
 
-    EVT_LOG_VERBOSE("In Maintain DB ...............");
     //Get Max records,max age and max log size from the global list
     dwError = EVTGetMaxRecords(&dwMaxRecords);
     BAIL_ON_EVT_ERROR(dwError);
@@ -1039,59 +1649,48 @@ LwEvtDbMaintainDB_inlock(
     dwError = EVTGetMaxLogSize(&dwMaxLogSize);
     BAIL_ON_EVT_ERROR(dwError);
 
-    //Get the count of the records
-    dwError = LwEvtDbGetRecordCount_inlock(pDb, NULL, &dwRecordCount);
-    BAIL_ON_EVT_ERROR(dwError);
-
-    //Get the count of the records which are older than 'n' days
-    dwError = LwEvtDbEventLogCountOlderThan_inlock(
-                  pDb,
-                  dwMaxAge,
-                  &dwCountOlderThan);
-    BAIL_ON_EVT_ERROR(dwError);
-
-    //Get the File size
-    dwError = EVTGetFileSize(EVENTLOG_DB,&dwActualSize);
-    BAIL_ON_EVT_ERROR(dwError);
-
-    EVT_LOG_VERBOSE("Max Records = %d",dwMaxRecords);
-    EVT_LOG_VERBOSE("Max Age = %d",dwMaxAge);
-    EVT_LOG_VERBOSE("Max Log size = %d",dwMaxLogSize);
-    EVT_LOG_VERBOSE("EventLog record count older than curdate = %d",dwCountOlderThan);
-    EVT_LOG_VERBOSE("EventLog Record count = %d",dwRecordCount);
-    EVT_LOG_VERBOSE("Actual Log size = %d ",dwActualSize);
-
-    //Regular house keeping
-    if (dwCountOlderThan) {
-        EVT_LOG_VERBOSE("Deleting the record as older than current date");
-        dwError = LwEvtDbDeleteOlderThanCurDate_inlock(pDb, dwMaxAge);
+    if (gRecordCount < 0)
+    {
+        dwError = LwEvtDbGetRecordCount_inlock(pDb, NULL, &dwRecordCount);
         BAIL_ON_EVT_ERROR(dwError);
 
-        //Since already some records got deleted get the latest record count
-        dwError = LwEvtDbGetRecordCount_inlock(pDb, NULL, &dwRecordCount);
+        gRecordCount = dwRecordCount;
+    }
+
+    if (bFullCheck)
+    {
+        EVT_LOG_VERBOSE("In Maintain DB ...............");
+        EVT_LOG_VERBOSE("Max Records = %u", dwMaxRecords);
+        EVT_LOG_VERBOSE("Max Age = %u", dwMaxAge);
+        EVT_LOG_VERBOSE("Max Log size = %u", dwMaxLogSize);
+        EVT_LOG_VERBOSE("EventLog Record count = %lld", (long long)gRecordCount);
+
+        //Regular house keeping
+        dwError = LwEvtDbDeleteOlderThan_inlock(pDb, dwMaxAge);
         BAIL_ON_EVT_ERROR(dwError);
     }
 
     //If the record count is greater than the Max Records
-    if (dwRecordCount >= dwMaxRecords) {
-
-        EVT_LOG_VERBOSE("Record Count = %d which is more than max records set = %d",dwRecordCount,dwMaxRecords);
-        EVT_LOG_VERBOSE("DB size exceeds the Max Records Size");
-        EVT_LOG_VERBOSE("Going to trim DB.........");
+    if (gRecordCount >= dwMaxRecords)
+    {
+        EVT_LOG_VERBOSE("Record Count = %lld which is more than max records set = %u",
+                        (long long)gRecordCount, dwMaxRecords);
 
-        //If records not aged out,then delete the records above Max Records
-        dwError = LwEvtDbDeleteIfCountExceeds_inlock(pDb, dwMaxRecords);
+        // Delete 10 extra records so we only need to trim on 1/10 of the
+        // writes.
+        dwError = LwEvtDbLimitRecordCount_inlock(
+                        pDb,
+                        dwMaxRecords > 10 ? dwMaxRecords - 10 : dwMaxRecords);
         BAIL_ON_EVT_ERROR(dwError);
     }
 
-    if (dwActualSize >= dwMaxLogSize)
+    if (bFullCheck)
     {
-        EVT_LOG_VERBOSE("Log Size is exceeds the maximum limit set");
         dwError = LwEvtDbLimitDatabaseSize_inlock(pDb, dwMaxLogSize);
         BAIL_ON_EVT_ERROR(dwError);
+
+        EVT_LOG_VERBOSE("Pruned DB returning");
     }
-	
-    EVT_LOG_VERBOSE("Pruned DB returning");
 
 cleanup:
     return dwError;
@@ -1157,6 +1756,15 @@ LwEvtDbDeleteRecords(
         BAIL_ON_SQLITE3_ERROR(dwError, sqlite3_errmsg(pDb));
     }
 
+    if (pSqlFilter == NULL)
+    {
+        gRecordCount = 0;
+    }
+    else if (gRecordCount >= 0)
+    {
+        gRecordCount = LW_MAX(gRecordCount - sqlite3_changes(pDb), 0);
+    }
+
 cleanup:
     // sqlite3 API docs say passing NULL is okay
     sqlite3_finalize(pStatement);
@@ -1170,194 +1778,547 @@ error:
     goto cleanup;
 }
 
-//To get count of records that are older than 'n' days.
-static
 DWORD
-LwEvtDbEventLogCountOlderThan_inlock(
+LwEvtDbDeleteMatchingRecords(
     sqlite3 *pDb,
-    DWORD dwOlderThan,
-    PDWORD pdwNumMatched
+    PCLW_EVENTLOG_FILTER pFilter
     )
 {
-
     DWORD dwError = 0;
-    CHAR  szQuery[8092];
-    DWORD nRows = 0;
-    DWORD nCols = 0;
-    PSTR* ppszResult = NULL;
+    CHAR szQuery[2048];
+    sqlite3_stmt *pStatement = NULL;
+    BOOLEAN inLock = FALSE;
 
-    sprintf(szQuery, DB_QUERY_COUNT_OLDER_THAN, dwOlderThan);
+    dwError = LwEvtDbCompileFilter(
+                    DB_QUERY_DELETE_MATCHING,
+                    pFilter,
+                    1,
+                    szQuery,
+                    sizeof(szQuery));
+    BAIL_ON_EVT_ERROR(dwError);
 
-    dwError = LwEvtDbQueryEventLog(pDb, szQuery, &nRows, &nCols, &ppszResult);
+    ENTER_RW_WRITER_LOCK(inLock);
 
-    if (nRows == 1) {
-        *pdwNumMatched = (DWORD) atoi(ppszResult[1]);
-        BAIL_ON_EVT_ERROR(dwError);
-    } else {
+    dwError = LwEvtDbPrepareCached(pDb, szQuery, &pStatement);
+    BAIL_ON_EVT_ERROR(dwError);
 
-        EVT_LOG_VERBOSE("Could not find count of event logs in database");
+    dwError = LwEvtDbBindFilter(pDb, pStatement, pFilter, 1);
+    BAIL_ON_EVT_ERROR(dwError);
+
+    dwError = sqlite3_step(pStatement);
+    if (dwError == SQLITE_DONE || dwError == SQLITE_OK)
+    {
+        dwError = 0;
+    }
+    else
+    {
+        BAIL_ON_SQLITE3_ERROR(dwError, sqlite3_errmsg(pDb));
     }
 
- cleanup:
-    if (ppszResult) {
-        sqlite3_free_table(ppszResult);
+    if (gRecordCount >= 0)
+    {
+        gRecordCount = LW_MAX(gRecordCount - sqlite3_changes(pDb), 0);
     }
 
+cleanup:
+    if (pStatement)
+    {
+        LwEvtDbReleaseCached(pStatement);
+    }
+    LEAVE_RW_WRITER_LOCK(inLock);
+
     return dwError;
- error:
-    goto cleanup;
 
+error:
+    goto cleanup;
 }
 
+/*
+ * Formats pszQueryFormat with a "AND <column> <operator> ?<n>" term for
+ * every condition of pFilter, numbering the parameters from
+ * FirstParameter. The values are bound by LwEvtDbBindFilter, so the text
+ * only depends on the shape of the filter and the compiled statement can be
+ * reused for other values.
+ */
 static
 DWORD
-LwEvtDbLimitDatabaseSize_inlock(
-    sqlite3 *pDb,
-    DWORD dwMaxLogSize
+LwEvtDbCompileFilter(
+    PCSTR pszQueryFormat,
+    PCLW_EVENTLOG_FILTER pFilter,
+    int FirstParameter,
+    PSTR pszQuery,
+    size_t QuerySize
     )
 {
     DWORD dwError = 0;
-    CHAR  szQuery[8092];
-    DWORD nRows = 0;
-    DWORD nCols = 0;
-    PSTR* ppszResult = NULL;
-    DWORD dwCurrentCount = 0;
-    DWORD dwActualSize = 0;
-    DWORD dwDeleteCount = 0;
+    CHAR szConditions[1024] = "";
+    size_t length = 0;
+    int written = 0;
+    DWORD index = 0;
+    const LW_EVENTLOG_CONDITION *pCondition = NULL;
 
-    while (1)
+    if (pFilter)
     {
-        dwError = EVTGetFileSize(EVENTLOG_DB, &dwActualSize);
-        BAIL_ON_EVT_ERROR(dwError);
-
-        if (dwActualSize < dwMaxLogSize)
+        if (pFilter->Count > LW_EVENTLOG_MAX_CONDITIONS ||
+            (pFilter->Count && !pFilter->pConditions))
         {
-            // The file size is now acceptable
-            break;
+            dwError = ERROR_INVALID_PARAMETER;
+            BAIL_ON_EVT_ERROR(dwError);
         }
 
-        if (ppszResult) {
-            sqlite3_free_table(ppszResult);
+        for (index = 0; index < pFilter->Count; index++)
+        {
+            pCondition = &pFilter->pConditions[index];
+
+            if ((DWORD)pCondition->Field >= LW_EVENTLOG_FIELD_SENTINEL ||
+                (DWORD)pCondition->Operator >= LW_EVENTLOG_OPERATOR_SENTINEL ||
+                (gEvtDbFilterFields[pCondition->Field].bString &&
+                 !pCondition->pString))
+            {
+                dwError = ERROR_INVALID_PARAMETER;
+                BAIL_ON_EVT_ERROR(dwError);
+            }
+
+            written = snprintf(
+                        szConditions + length,
+                        sizeof(szConditions) - length,
+                        " AND %s %s ?%d",
+                        gEvtDbFilterFields[pCondition->Field].pszColumn,
+                        gpszEvtDbFilterOperators[pCondition->Operator],
+                        FirstParameter + (int)index);
+            if (written < 0 || (size_t)written >= sizeof(szConditions) - length)
+            {
+                dwError = ERROR_BUFFER_OVERFLOW;
+                BAIL_ON_EVT_ERROR(dwError);
+            }
+            length += written;
         }
+    }
 
-        dwError = LwEvtDbGetRecordCount_inlock(
-                        pDb,
-                        NULL,
-                        &dwCurrentCount);
+    written = snprintf(pszQuery, QuerySize, pszQueryFormat, szConditions);
+    if (written < 0 || (size_t)written >= QuerySize)
+    {
+        dwError = ERROR_BUFFER_OVERFLOW;
         BAIL_ON_EVT_ERROR(dwError);
+    }
+
+cleanup:
+    return dwError;
+
+error:
+    if (QuerySize)
+    {
+        pszQuery[0] = 0;
+    }
+    goto cleanup;
+}
+
+static
+DWORD
+LwEvtDbBindFilter(
+    sqlite3 *pDb,
+    sqlite3_stmt *pStatement,
+    PCLW_EVENTLOG_FILTER pFilter,
+    int FirstParameter
+    )
+{
+    DWORD dwError = 0;
+    DWORD index = 0;
+    const LW_EVENTLOG_CONDITION *pCondition = NULL;
 
-        if (dwCurrentCount == 0)
+    for (index = 0; pFilter && index < pFilter->Count; index++)
+    {
+        pCondition = &pFilter->pConditions[index];
+
+        if (gEvtDbFilterFields[pCondition->Field].bString)
         {
-            EVT_LOG_ERROR("evtdb: The current database size ( %d ) is larger than the max ( %d ), but since it contains no records, it cannot be further trimmed.", dwActualSize, dwMaxLogSize);
-            break;
+            dwError = sqlite3_bind_text16(
+                            pStatement,
+                            FirstParameter + (int)index,
+                            pCondition->pString,
+                            -1,
+                            SQLITE_STATIC);
         }
+        else
+        {
+            dwError = sqlite3_bind_int64(
+                            pStatement,
+                            FirstParameter + (int)index,
+                            (sqlite_int64)pCondition->Number);
+        }
+        BAIL_ON_SQLITE3_ERROR(dwError, sqlite3_errmsg(pDb));
+    }
 
-        // Assume every record takes the same amount of space and figure out
-        // how many need to be cleared. Also, clear 10% more than necessary so
-        // this delete operation is not run every time.
+cleanup:
+    return dwError;
+
+error:
+    goto cleanup;
+}
+
+/*
+ * Returns a prepared statement for pszQuery, reusing the one the connection
+ * compiled earlier if there is one. A connection serves one request at a
+ * time, so every statement it holds is idle here. Hand the statement back
+ * with LwEvtDbReleaseCached; LwEvtDbClose finalizes them.
+ */
+static
+DWORD
+LwEvtDbPrepareCached(
+    sqlite3 *pDb,
+    PCSTR pszQuery,
+    sqlite3_stmt **ppStatement
+    )
+{
+    DWORD dwError = 0;
+    sqlite3_stmt *pStatement = NULL;
+    PCSTR pszSql = NULL;
+    DWORD cached = 0;
 
-        dwDeleteCount = dwCurrentCount -
-                        9 * dwCurrentCount * dwMaxLogSize / dwActualSize / 10;
-        if (dwDeleteCount < 1)
+    while ((pStatement = sqlite3_next_stmt(pDb, pStatement)) != NULL)
+    {
+        pszSql = sqlite3_sql(pStatement);
+        if (pszSql && !strcmp(pszSql, pszQuery))
         {
-            // This breaks an infinite loop that might be caused from rounding
-            // errors
-            dwDeleteCount = 1;
+            break;
         }
-        EVT_LOG_INFO("evtdb: Deleting %d record(s) (out of %d) in an attempt to lower the current database size ( %d ), to lower than %d", dwDeleteCount, dwCurrentCount, dwActualSize, dwMaxLogSize);
+        cached++;
+    }
 
-        if (ppszResult) {
-            sqlite3_free_table(ppszResult);
+    if (!pStatement)
+    {
+        if (cached >= EVT_DB_MAX_CACHED_STATEMENTS)
+        {
+            while ((pStatement = sqlite3_next_stmt(pDb, NULL)) != NULL)
+            {
+                sqlite3_finalize(pStatement);
+            }
         }
-        sprintf(szQuery, DB_QUERY_DELETE_COUNT, (unsigned long)dwDeleteCount);
-
-        dwError = LwEvtDbQueryEventLog(pDb, szQuery, &nRows, &nCols, &ppszResult);
-        BAIL_ON_EVT_ERROR(dwError);
 
-        // Run the vacuum command so the filesize actually shrinks
-        if (ppszResult) {
-            sqlite3_free_table(ppszResult);
-        }
-        dwError = LwEvtDbQueryEventLog(pDb, "VACUUM", &nRows, &nCols, &ppszResult);
-        BAIL_ON_EVT_ERROR(dwError);
+        dwError = sqlite3_prepare_v2(
+                        pDb,
+                        pszQuery,
+                        -1,
+                        &pStatement,
+                        NULL);
+        BAIL_ON_SQLITE3_ERROR(dwError, sqlite3_errmsg(pDb));
     }
 
+    *ppStatement = pStatement;
+
 cleanup:
-    if (ppszResult) {
-        sqlite3_free_table(ppszResult);
+    return dwError;
+
+error:
+    *ppStatement = NULL;
+    goto cleanup;
+}
+
+static
+VOID
+LwEvtDbReleaseCached(
+    sqlite3_stmt *pStatement
+    )
+{
+    // Resetting also ends the statement's read transaction
+    sqlite3_reset(pStatement);
+    sqlite3_clear_bindings(pStatement);
+}
+
+static
+DWORD
+LwEvtDbQueryInt64_inlock(
+    sqlite3 *pDb,
+    PCSTR pszQuery,
+    sqlite_int64* pValue,
+    PBOOLEAN pbFound
+    )
+{
+    DWORD dwError = 0;
+    sqlite3_stmt *pStatement = NULL;
+    sqlite_int64 value = 0;
+    BOOLEAN bFound = FALSE;
+
+    dwError = sqlite3_prepare_v2(
+                    pDb,
+                    pszQuery,
+                    -1,
+                    &pStatement,
+                    NULL);
+    BAIL_ON_SQLITE3_ERROR(dwError, sqlite3_errmsg(pDb));
+
+    dwError = sqlite3_step(pStatement);
+    if (dwError == SQLITE_ROW)
+    {
+        dwError = 0;
+        if (sqlite3_column_type(pStatement, 0) != SQLITE_NULL)
+        {
+            value = sqlite3_column_int64(pStatement, 0);
+            bFound = TRUE;
+        }
+    }
+    else if (dwError == SQLITE_DONE)
+    {
+        dwError = 0;
     }
+    else
+    {
+        BAIL_ON_SQLITE3_ERROR(dwError, sqlite3_errmsg(pDb));
+    }
+
+    *pValue = value;
+    *pbFound = bFound;
 
+cleanup:
+    sqlite3_finalize(pStatement);
     return dwError;
 
 error:
+    *pValue = 0;
+    *pbFound = FALSE;
     goto cleanup;
 }
 
-//Delete the record over 'n' entries
 static
 DWORD
-LwEvtDbDeleteIfCountExceeds_inlock(
+LwEvtDbDeleteChunk_inlock(
     sqlite3 *pDb,
-    DWORD dwOlderThan
+    PCSTR pszQuery,
+    sqlite_int64 Argument1,
+    sqlite_int64 Argument2,
+    PDWORD pdwDeleted
     )
 {
-
     DWORD dwError = 0;
-    CHAR  szQuery[8092];
-    DWORD nRows = 0;
-    DWORD nCols = 0;
-    PSTR* ppszResult = NULL;
+    sqlite3_stmt *pStatement = NULL;
+    DWORD dwDeleted = 0;
 
-    // Delete 10 extra records so we only need to trim on 1/10 of the runs.
-    if (dwOlderThan > 10)
+    dwError = sqlite3_prepare_v2(
+                    pDb,
+                    pszQuery,
+                    -1,
+                    &pStatement,
+                    NULL);
+    BAIL_ON_SQLITE3_ERROR(dwError, sqlite3_errmsg(pDb));
+
+    dwError = sqlite3_bind_int64(pStatement, 1, Argument1);
+    BAIL_ON_SQLITE3_ERROR(dwError, sqlite3_errmsg(pDb));
+
+    if (sqlite3_bind_parameter_count(pStatement) > 1)
     {
-        dwOlderThan -= 10;
+        dwError = sqlite3_bind_int64(pStatement, 2, Argument2);
+        BAIL_ON_SQLITE3_ERROR(dwError, sqlite3_errmsg(pDb));
     }
 
-    sprintf(szQuery, DB_QUERY_DELETE_AT_LIMIT, (unsigned long)dwOlderThan);
+    dwError = sqlite3_step(pStatement);
+    if (dwError == SQLITE_DONE)
+    {
+        dwError = 0;
+    }
+    BAIL_ON_SQLITE3_ERROR(dwError, sqlite3_errmsg(pDb));
 
-    dwError = LwEvtDbQueryEventLog(pDb, szQuery, &nRows, &nCols, &ppszResult);
-    BAIL_ON_EVT_ERROR(dwError);
+    dwDeleted = sqlite3_changes(pDb);
 
- cleanup:
-    if (ppszResult) {
-        sqlite3_free_table(ppszResult);
+    if (gRecordCount >= 0)
+    {
+        gRecordCount = LW_MAX(gRecordCount - dwDeleted, 0);
     }
 
+    *pdwDeleted = dwDeleted;
+
+cleanup:
+    sqlite3_finalize(pStatement);
     return dwError;
- error:
+
+error:
+    *pdwDeleted = 0;
     goto cleanup;
+}
+
+//Delete the oldest records until at most 'n' are left
+static
+DWORD
+LwEvtDbLimitRecordCount_inlock(
+    sqlite3 *pDb,
+    sqlite_int64 MaxRecords
+    )
+{
+    DWORD dwError = 0;
+    sqlite_int64 firstRecordId = 0;
+    sqlite_int64 chunk = 0;
+    BOOLEAN bFound = FALSE;
+    DWORD dwDeleted = 0;
+
+    while (gRecordCount > MaxRecords)
+    {
+        dwError = LwEvtDbQueryInt64_inlock(
+                        pDb,
+                        DB_QUERY_MIN_RECORD_ID,
+                        &firstRecordId,
+                        &bFound);
+        BAIL_ON_EVT_ERROR(dwError);
+
+        if (!bFound)
+        {
+            // The table is empty; the count was off
+            gRecordCount = 0;
+            break;
+        }
+
+        // Record ids only grow, so the oldest records are the ones right
+        // above the lowest id. Ids removed by filtered deletes leave gaps,
+        // which only makes a chunk smaller.
+        chunk = LW_MIN(gRecordCount - MaxRecords, EVT_PRUNE_CHUNK_RECORDS);
 
+        dwError = LwEvtDbDeleteChunk_inlock(
+                        pDb,
+                        DB_QUERY_DELETE_BELOW_ID,
+                        firstRecordId + chunk,
+                        0,
+                        &dwDeleted);
+        BAIL_ON_EVT_ERROR(dwError);
+
+        EVT_LOG_VERBOSE("evtdb: Deleted %u record(s) below id %lld",
+                        dwDeleted, (long long)(firstRecordId + chunk));
+    }
+
+cleanup:
+    return dwError;
+
+error:
+    goto cleanup;
 }
 
 //To delete records 'n' days older than current date.
 static
 DWORD
-LwEvtDbDeleteOlderThanCurDate_inlock(
+LwEvtDbDeleteOlderThan_inlock(
     sqlite3 *pDb,
-    DWORD dwOlderThan
+    DWORD dwMaxAge
     )
 {
     DWORD dwError = 0;
-    CHAR  szQuery[8092];
-    DWORD nRows = 0;
-    DWORD nCols = 0;
-    PSTR* ppszResult = NULL;
+    sqlite_int64 oldest = 0;
+    sqlite_int64 cutoff = 0;
+    BOOLEAN bFound = FALSE;
+    DWORD dwDeleted = 0;
 
-    sprintf(szQuery, DB_QUERY_DELETE_OLDER_THAN, dwOlderThan);
+    cutoff = (sqlite_int64)time(NULL) - (sqlite_int64)dwMaxAge * 24 * 60 * 60;
 
-    dwError = LwEvtDbQueryEventLog(pDb, szQuery, &nRows, &nCols, &ppszResult);
+    dwError = LwEvtDbQueryInt64_inlock(
+                    pDb,
+                    DB_QUERY_MIN_DATE_TIME,
+                    &oldest,
+                    &bFound);
     BAIL_ON_EVT_ERROR(dwError);
 
- cleanup:
-    if (ppszResult) {
-        sqlite3_free_table(ppszResult);
+    if (!bFound || oldest >= cutoff)
+    {
+        goto cleanup;
     }
 
+    EVT_LOG_VERBOSE("Deleting the records older than %u days", dwMaxAge);
+
+    do
+    {
+        dwError = LwEvtDbDeleteChunk_inlock(
+                        pDb,
+                        DB_QUERY_DELETE_OLDER_THAN,
+                        cutoff,
+                        EVT_PRUNE_CHUNK_RECORDS,
+                        &dwDeleted);
+        BAIL_ON_EVT_ERROR(dwError);
+    } while (dwDeleted == EVT_PRUNE_CHUNK_RECORDS);
+
+cleanup:
     return dwError;
- error:
+
+error:
     goto cleanup;
+}
+
+/*
+ * Sqlite reuses the pages of deleted records, so the size limit is applied
+ * to the pages in use rather than to the file: trimming keeps the file from
+ * growing without rewriting it. The file is only vacuumed when it is well
+ * over the limit, which happens when the limit was lowered.
+ */
+static
+DWORD
+LwEvtDbLimitDatabaseSize_inlock(
+    sqlite3 *pDb,
+    DWORD dwMaxLogSize
+    )
+{
+    DWORD dwError = 0;
+    sqlite_int64 pageSize = 0;
+    sqlite_int64 pageCount = 0;
+    sqlite_int64 freePages = 0;
+    sqlite_int64 usedSize = 0;
+    sqlite_int64 deleteCount = 0;
+    BOOLEAN bFound = FALSE;
+    DWORD dwActualSize = 0;
+    PSTR pszError = NULL;
+
+    dwError = LwEvtDbQueryInt64_inlock(pDb, DB_QUERY_PAGE_SIZE, &pageSize, &bFound);
+    BAIL_ON_EVT_ERROR(dwError);
+
+    dwError = LwEvtDbQueryInt64_inlock(pDb, DB_QUERY_PAGE_COUNT, &pageCount, &bFound);
+    BAIL_ON_EVT_ERROR(dwError);
+
+    dwError = LwEvtDbQueryInt64_inlock(pDb, DB_QUERY_FREELIST_COUNT, &freePages, &bFound);
+    BAIL_ON_EVT_ERROR(dwError);
+
+    usedSize = (pageCount - freePages) * pageSize;
 
+    if (usedSize >= dwMaxLogSize)
+    {
+        if (gRecordCount == 0)
+        {
+            EVT_LOG_ERROR("evtdb: The current database size ( %lld ) is larger than the max ( %u ), but since it contains no records, it cannot be further trimmed.", (long long)usedSize, dwMaxLogSize);
+            goto cleanup;
+        }
+
+        // Assume every record takes the same amount of space and figure out
+        // how many need to be cleared. Also, clear 10% more than necessary so
+        // this delete operation is not run every time.
+        deleteCount = gRecordCount -
+                      9 * gRecordCount * dwMaxLogSize / usedSize / 10;
+        if (deleteCount < 1)
+        {
+            deleteCount = 1;
+        }
+
+        EVT_LOG_INFO("evtdb: Deleting %lld record(s) (out of %lld) in an attempt to lower the current database size ( %lld ), to lower than %u", (long long)deleteCount, (long long)gRecordCount, (long long)usedSize, dwMaxLogSize);
+
+        dwError = LwEvtDbLimitRecordCount_inlock(
+                        pDb,
+                        gRecordCount - deleteCount);
+        BAIL_ON_EVT_ERROR(dwError);
+    }
+
+    dwError = EVTGetFileSize(EVENTLOG_DB, &dwActualSize);
+    BAIL_ON_EVT_ERROR(dwError);
+
+    if (dwActualSize > dwMaxLogSize + dwMaxLogSize / 10)
+    {
+        EVT_LOG_INFO("evtdb: Compacting the database file ( %u ) to below %u",
+                     dwActualSize, dwMaxLogSize);
+
+        dwError = sqlite3_exec(pDb, "VACUUM", NULL, NULL, &pszError);
+        BAIL_ON_SQLITE3_ERROR(dwError, pszError);
+    }
+
+cleanup:
+    if (pszError)
+    {
+        sqlite3_free(pszError);
+    }
+
+    return dwError;
+
+error:
+    goto cleanup;
 }
 
 //helper functions
@@ -79,6 +79,16 @@ LwEvtDbClose(
     sqlite3* pDb
     );
 
+DWORD
+LwEvtDbOpenReader(
+    sqlite3** ppDb
+    );
+
+DWORD
+LwEvtDbCloseReader(
+    sqlite3* pDb
+    );
+
 DWORD
 LwEvtDbGetRecordCount(
     sqlite3 *pDb,
@@ -103,6 +113,27 @@ LwEvtDbReadRecords(
     PLW_EVENTLOG_RECORD* ppRecords
     );
 
+DWORD
+LwEvtDbReadRecordPage(
+    DWORD (*pAllocate)(DWORD, PVOID*),
+    VOID (*pFree)(PVOID),
+    sqlite3 *pDb,
+    UINT64 StartAfterRecordId,
+    DWORD MaxResults,
+    PCWSTR pSqlFilter,
+    PCLW_EVENTLOG_FILTER pFilter,
+    PUINT64 pNextRecordId,
+    PDWORD pCount,
+    PLW_EVENTLOG_RECORD* ppRecords
+    );
+
+DWORD
+LwEvtDbCountMatchingRecords(
+    sqlite3 *pDb,
+    PCLW_EVENTLOG_FILTER pFilter,
+    PDWORD pNumMatched
+    );
+
 DWORD
 LwEvtDbWriteRecords(
     sqlite3 *pDb,
@@ -116,6 +147,12 @@ LwEvtDbDeleteRecords(
     PCWSTR pSqlFilter
     );
 
+DWORD
+LwEvtDbDeleteMatchingRecords(
+    sqlite3 *pDb,
+    PCLW_EVENTLOG_FILTER pFilter
+    );
+
 //helper functions
 DWORD
 LwEvtDbQueryEventLog(
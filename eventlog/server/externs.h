@@ -123,7 +123,14 @@ extern DWORD gdwNewEventCount;
 #define EVT_DEFAULT_MAX_AGE         90 //days
 #define EVT_DEFAULT_PURGE_INTERVAL  1 //days
 #define EVT_MAINTAIN_EVENT_COUNT  50
+#define EVT_PRUNE_CHUNK_RECORDS   1000 //records deleted per statement when trimming
 #define EVT_DEFAULT_BOOL_REMOVE_RECORDS_AS_NEEDED TRUE
 #define EVT_DEFAULT_BOOL_REGISTER_TCP_IP FALSE
+#define EVT_DEFAULT_BOOL_WRITE_AHEAD_LOG FALSE
+#define EVT_DB_MAX_IDLE_READERS   8 //read-only connections kept open between requests
+#define EVT_DB_BUSY_TIMEOUT_MS    5000
+#define EVT_DB_MIN_WAL_SQLITE_VERSION 3007000 //first sqlite with journal_mode=WAL
+#define EVT_MAX_RECORD_PAGE       1000 //records returned per cursor read
+#define EVT_DB_MAX_CACHED_STATEMENTS 32 //compiled filter queries kept per connection
 
 #endif /* __SERVER_EXTERNS_H__ */
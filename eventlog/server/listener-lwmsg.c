@@ -56,6 +56,9 @@ static LWMsgDispatchSpec gMessageHandlers[] =
     LWMSG_DISPATCH_BLOCK(EVT_Q_READ_RECORDS, LwmEvtSrvReadRecords),
     LWMSG_DISPATCH_BLOCK(EVT_Q_WRITE_RECORDS, LwmEvtSrvWriteRecords),
     LWMSG_DISPATCH_BLOCK(EVT_Q_DELETE_RECORDS, LwmEvtSrvDeleteRecords),
+    LWMSG_DISPATCH_BLOCK(EVT_Q_READ_PAGE, LwmEvtSrvReadRecordPage),
+    LWMSG_DISPATCH_BLOCK(EVT_Q_COUNT_MATCHING, LwmEvtSrvCountMatchingRecords),
+    LWMSG_DISPATCH_BLOCK(EVT_Q_DELETE_MATCHING, LwmEvtSrvDeleteMatchingRecords),
     LWMSG_DISPATCH_END
 };
 
@@ -56,6 +56,7 @@ EVTSERVERINFO gServerInfo =
     0,                          /* Purge records at interval*/
     TRUE,                          /* Enable/disable Remove records a boolean value TRUE or FALSE*/
     FALSE,                       /* Register TCP/IP RPC endpoints*/
+    FALSE,                       /* Write-ahead log journal */
     NULL,
 };
 
@@ -303,6 +304,22 @@ EVTGetRegisterTcpIp(
     return (dwError);
 }
 
+DWORD
+EVTGetWriteAheadLog(
+    PBOOLEAN pbWriteAheadLog
+    )
+{
+    DWORD dwError = 0;
+
+    EVT_LOCK_SERVERINFO;
+
+    *pbWriteAheadLog = gServerInfo.bWriteAheadLog;
+
+    EVT_UNLOCK_SERVERINFO;
+
+    return (dwError);
+}
+
 DWORD
 EVTGetPrefixPath(
     PSTR* ppszPath
@@ -340,6 +357,7 @@ EVTSetConfigDefaults()
     gServerInfo.dwPurgeInterval = EVT_DEFAULT_PURGE_INTERVAL;
     gServerInfo.bRemoveAsNeeded = EVT_DEFAULT_BOOL_REMOVE_RECORDS_AS_NEEDED;
     gServerInfo.bRegisterTcpIp = EVT_DEFAULT_BOOL_REGISTER_TCP_IP;
+    gServerInfo.bWriteAheadLog = EVT_DEFAULT_BOOL_WRITE_AHEAD_LOG;
 
     EVTFreeSecurityDescriptor(gServerInfo.pAccess);
     gServerInfo.pAccess = NULL;
@@ -436,6 +454,16 @@ static LWREG_CONFIG_ITEM gConfigDescription[] =
         &(gServerInfo.bRegisterTcpIp),
         NULL
     },
+    {
+        "EventDbWriteAheadLog",
+        TRUE,
+        LwRegTypeBoolean,
+        0,
+        -1,
+        NULL,
+        &(gServerInfo.bWriteAheadLog),
+        NULL
+    },
     {
         "AllowReadTo",
         TRUE,
@@ -484,6 +512,7 @@ EVTLogConfigReload(
                  "     Max Event Lifespan:              %d\r\n" \
                  "     Remove Events As Needed:         %s\r\n" \
                  "     Register TCP/IP RPC endpoints:   %s\r\n" \
+                 "     Write-ahead log journal:         %s\r\n" \
                  "     Allow Read   To :                %s\r\n" \
                  "     Allow Write  To :                %s\r\n" \
                  "     Allow Delete To :                %s\r\n",
@@ -492,6 +521,7 @@ EVTLogConfigReload(
                  gServerInfo.dwMaxAge,
                  gServerInfo.bRemoveAsNeeded? "true" : "false",
                  gServerInfo.bRegisterTcpIp ? "true" : "false",
+                 gServerInfo.bWriteAheadLog ? "true" : "false",
                  gServerInfo.pszAllowReadTo ?
                     gServerInfo.pszAllowReadTo: "",
                  gServerInfo.pszAllowWriteTo ?
@@ -69,6 +69,8 @@ typedef struct {
     BOOLEAN bRemoveAsNeeded;
     /* Flag to Register TCP/IP RPC endpoints */
     BOOLEAN bRegisterTcpIp;
+    /* Flag to keep the database in write-ahead log mode */
+    BOOLEAN bWriteAheadLog;
 
     /* Who is allowed to read, write, and delete events. The security
      * descriptor is set when all of the users/groups can be resolved. */
@@ -126,6 +128,11 @@ EVTGetMaxLogSize(
     DWORD* pdwMaxLogSize
     );
 
+DWORD
+EVTGetWriteAheadLog(
+    PBOOLEAN pbWriteAheadLog
+    );
+
 DWORD
 EVTGetRemoveEventsFlag(
     PBOOLEAN pbRemoveEvents
@@ -252,7 +252,7 @@ LwmEvtSrvGetRecordCount(
     }
     else
     {
-        dwError = LwEvtDbOpen(&pDb);
+        dwError = LwEvtDbOpenReader(&pDb);
         BAIL_ON_EVT_ERROR(dwError);
 
         dwError = LwAllocateMemory(sizeof(*pRes), (PVOID*) &pRes);
@@ -281,7 +281,72 @@ LwmEvtSrvGetRecordCount(
 cleanup:
     if (pDb != NULL)
     {
-        LwEvtDbClose(pDb);
+        LwEvtDbCloseReader(pDb);
+    }
+    LW_SAFE_FREE_MEMORY(pRes);
+    return MAP_LW_ERROR_IPC(dwError);
+
+error:
+    goto cleanup;
+}
+
+DWORD
+LwmEvtSrvCountMatchingRecords(
+    LWMsgCall* pCall,
+    const LWMsgParams* pIn,
+    LWMsgParams* pOut,
+    void* data
+    )
+{
+    DWORD dwError = 0;
+    PLW_EVENTLOG_FILTER pFilter = pIn->data;
+    PDWORD pRes = NULL;
+    PEVT_IPC_GENERIC_ERROR pError = NULL;
+    sqlite3 *pDb = NULL;
+    PLWMSG_LW_EVENTLOG_CONNECTION pConn = NULL;
+
+    dwError = LwmEvtSrvGetConnection(
+                    pCall,
+                    &pConn);
+    if (dwError)
+    {
+    }
+    else if (!pConn->ReadAllowed)
+    {
+        dwError = ERROR_ACCESS_DENIED;
+    }
+    else
+    {
+        dwError = LwEvtDbOpenReader(&pDb);
+        BAIL_ON_EVT_ERROR(dwError);
+
+        dwError = LwAllocateMemory(sizeof(*pRes), (PVOID*) &pRes);
+        BAIL_ON_EVT_ERROR(dwError);
+
+        dwError = LwEvtDbCountMatchingRecords(
+                        pDb,
+                        pFilter,
+                        pRes);
+    }
+    if (!dwError)
+    {
+        pOut->tag = EVT_R_GET_RECORD_COUNT;
+        pOut->data = pRes;
+        pRes = NULL;
+    }
+    else
+    {
+        dwError = LwmEvtSrvCreateError(dwError, NULL, &pError);
+        BAIL_ON_EVT_ERROR(dwError);
+
+        pOut->tag = EVT_R_GENERIC_ERROR;
+        pOut->data = pError;
+    }
+
+cleanup:
+    if (pDb != NULL)
+    {
+        LwEvtDbCloseReader(pDb);
     }
     LW_SAFE_FREE_MEMORY(pRes);
     return MAP_LW_ERROR_IPC(dwError);
@@ -317,7 +382,7 @@ LwmEvtSrvReadRecords(
     }
     else
     {
-        dwError = LwEvtDbOpen(&pDb);
+        dwError = LwEvtDbOpenReader(&pDb);
         BAIL_ON_EVT_ERROR(dwError);
 
         dwError = LwAllocateMemory(sizeof(*pRes), (PVOID*) &pRes);
@@ -350,7 +415,85 @@ LwmEvtSrvReadRecords(
 cleanup:
     if (pDb != NULL)
     {
-        LwEvtDbClose(pDb);
+        LwEvtDbCloseReader(pDb);
+    }
+    if (pRes)
+    {
+        LwEvtFreeRecordArray(
+            pRes->Count,
+            pRes->pRecords);
+        LW_SAFE_FREE_MEMORY(pRes);
+    }
+    return MAP_LW_ERROR_IPC(dwError);
+
+error:
+    goto cleanup;
+}
+
+DWORD
+LwmEvtSrvReadRecordPage(
+    LWMsgCall* pCall,
+    const LWMsgParams* pIn,
+    LWMsgParams* pOut,
+    void* data
+    )
+{
+    DWORD dwError = 0;
+    PEVT_IPC_READ_PAGE_REQ pReq = pIn->data;
+    PEVT_IPC_RECORD_PAGE pRes = NULL;
+    PEVT_IPC_GENERIC_ERROR pError = NULL;
+    sqlite3 *pDb = NULL;
+    PLWMSG_LW_EVENTLOG_CONNECTION pConn = NULL;
+
+    dwError = LwmEvtSrvGetConnection(
+                    pCall,
+                    &pConn);
+    if (dwError)
+    {
+    }
+    else if (!pConn->ReadAllowed)
+    {
+        dwError = ERROR_ACCESS_DENIED;
+    }
+    else
+    {
+        dwError = LwEvtDbOpenReader(&pDb);
+        BAIL_ON_EVT_ERROR(dwError);
+
+        dwError = LwAllocateMemory(sizeof(*pRes), (PVOID*) &pRes);
+        BAIL_ON_EVT_ERROR(dwError);
+
+        dwError = LwEvtDbReadRecordPage(
+                        LwAllocateMemory,
+                        LwFreeMemory,
+                        pDb,
+                        pReq->StartAfterRecordId,
+                        pReq->MaxResults,
+                        pReq->pFilter,
+                        pReq->pQuery,
+                        &pRes->NextRecordId,
+                        &pRes->Count,
+                        &pRes->pRecords);
+    }
+    if (!dwError)
+    {
+        pOut->tag = EVT_R_READ_PAGE;
+        pOut->data = pRes;
+        pRes = NULL;
+    }
+    else
+    {
+        dwError = LwmEvtSrvCreateError(dwError, NULL, &pError);
+        BAIL_ON_EVT_ERROR(dwError);
+
+        pOut->tag = EVT_R_GENERIC_ERROR;
+        pOut->data = pError;
+    }
+
+cleanup:
+    if (pDb != NULL)
+    {
+        LwEvtDbCloseReader(pDb);
     }
     if (pRes)
     {
@@ -485,6 +628,64 @@ error:
     goto cleanup;
 }
 
+DWORD
+LwmEvtSrvDeleteMatchingRecords(
+    LWMsgCall* pCall,
+    const LWMsgParams* pIn,
+    LWMsgParams* pOut,
+    void* data
+    )
+{
+    DWORD dwError = 0;
+    PLW_EVENTLOG_FILTER pFilter = pIn->data;
+    PEVT_IPC_GENERIC_ERROR pError = NULL;
+    sqlite3 *pDb = NULL;
+    PLWMSG_LW_EVENTLOG_CONNECTION pConn = NULL;
+
+    dwError = LwmEvtSrvGetConnection(
+                    pCall,
+                    &pConn);
+    if (dwError)
+    {
+    }
+    else if (!pConn->WriteAllowed)
+    {
+        dwError = ERROR_ACCESS_DENIED;
+    }
+    else
+    {
+        dwError = LwEvtDbOpen(&pDb);
+        BAIL_ON_EVT_ERROR(dwError);
+
+        dwError = LwEvtDbDeleteMatchingRecords(
+                        pDb,
+                        pFilter);
+    }
+    if (!dwError)
+    {
+        pOut->tag = EVT_R_GENERIC_SUCCESS;
+        pOut->data = NULL;
+    }
+    else
+    {
+        dwError = LwmEvtSrvCreateError(dwError, NULL, &pError);
+        BAIL_ON_EVT_ERROR(dwError);
+
+        pOut->tag = EVT_R_GENERIC_ERROR;
+        pOut->data = pError;
+    }
+
+cleanup:
+    if (pDb != NULL)
+    {
+        LwEvtDbClose(pDb);
+    }
+    return MAP_LW_ERROR_IPC(dwError);
+
+error:
+    goto cleanup;
+}
+
 /*
 local variables:
 mode: c
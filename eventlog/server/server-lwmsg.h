@@ -72,6 +72,14 @@ LwmEvtSrvGetRecordCount(
     void* data
     );
 
+DWORD
+LwmEvtSrvCountMatchingRecords(
+    LWMsgCall* pCall,
+    const LWMsgParams* pIn,
+    LWMsgParams* pOut,
+    void* data
+    );
+
 DWORD
 LwmEvtSrvReadRecords(
     LWMsgCall* pCall,
@@ -80,6 +88,14 @@ LwmEvtSrvReadRecords(
     void* data
     );
 
+DWORD
+LwmEvtSrvReadRecordPage(
+    LWMsgCall* pCall,
+    const LWMsgParams* pIn,
+    LWMsgParams* pOut,
+    void* data
+    );
+
 DWORD
 LwmEvtSrvWriteRecords(
     LWMsgCall* pCall,
@@ -96,6 +112,14 @@ LwmEvtSrvDeleteRecords(
     void* data
     );
 
+DWORD
+LwmEvtSrvDeleteMatchingRecords(
+    LWMsgCall* pCall,
+    const LWMsgParams* pIn,
+    LWMsgParams* pOut,
+    void* data
+    );
+
 /*
 local variables:
 mode: c
@@ -182,7 +182,7 @@ SrvRpcEvtGetRecordCount(
         BAIL_ON_EVT_ERROR(dwError);
     }
 
-    dwError = LwEvtDbOpen(&pDb);
+    dwError = LwEvtDbOpenReader(&pDb);
     BAIL_ON_EVT_ERROR(dwError);
 
     dwError =  LwEvtDbGetRecordCount(
@@ -194,7 +194,7 @@ SrvRpcEvtGetRecordCount(
 cleanup:
     if (pDb != NULL)
     {
-        LwEvtDbClose(pDb);
+        LwEvtDbCloseReader(pDb);
     }
 
     return dwError;
@@ -255,7 +255,7 @@ SrvRpcEvtReadRecords(
         BAIL_ON_EVT_ERROR(dwError);
     }
 
-    dwError = LwEvtDbOpen(&pDb);
+    dwError = LwEvtDbOpenReader(&pDb);
     BAIL_ON_EVT_ERROR(dwError);
 
     dwError = LwEvtDbReadRecords(
@@ -271,7 +271,7 @@ SrvRpcEvtReadRecords(
 cleanup:
     if (pDb != NULL)
     {
-        LwEvtDbClose(pDb);
+        LwEvtDbCloseReader(pDb);
     }
     return dwError;
 
@@ -0,0 +1,319 @@
+/* Editor Settings: expandtabs and use 4 spaces for indentation
+ * ex: set softtabstop=4 tabstop=8 expandtab shiftwidth=4: *
+ * -*- mode: c, c-basic-offset: 4 -*- */
+
+/*
+ * Copyright © BeyondTrust Software 2004 - 2019
+ * All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * BEYONDTRUST MAKES THIS SOFTWARE AVAILABLE UNDER OTHER LICENSING TERMS AS
+ * WELL. IF YOU HAVE ENTERED INTO A SEPARATE LICENSE AGREEMENT WITH
+ * BEYONDTRUST, THEN YOU MAY ELECT TO USE THE SOFTWARE UNDER THE TERMS OF THAT
+ * SOFTWARE LICENSE AGREEMENT INSTEAD OF THE TERMS OF THE APACHE LICENSE,
+ * NOTWITHSTANDING THE ABOVE NOTICE.  IF YOU HAVE QUESTIONS, OR WISH TO REQUEST
+ * A COPY OF THE ALTERNATE LICENSING TERMS OFFERED BY BEYONDTRUST, PLEASE CONTACT
+ * BEYONDTRUST AT beyondtrust.com/contact
+ */
+
+/*
+ * Module Name:
+ *
+ *        main.c
+ *
+ * Abstract:
+ *
+ *        Eventlog write throughput test
+ *
+ *        Several threads write single records to eventlogd through one
+ *        connection, first synchronously and then through the client write
+ *        queue, and the records per second of both runs are printed. The
+ *        records are tagged with their own event source and deleted again
+ *        afterwards unless -k is given.
+ *
+ *        Usage: eventlog-write-bench [-n records] [-t threads]
+ *                   [-b batch records] [-d batch delay ms] [-k]
+ *
+ */
+#include "config.h"
+#include "eventsys.h"
+#include "eventlog.h"
+#include "eventdefs.h"
+#include <lwstr.h>
+#include <lwmem.h>
+#include <lwdef.h>
+#include <lwerror.h>
+
+#define BENCH_EVENT_SOURCE "eventlog-write-bench"
+
+typedef struct _BENCH_WRITER
+{
+    PLW_EVENTLOG_CONNECTION pConn;
+    DWORD Count;
+    DWORD dwError;
+} BENCH_WRITER, *PBENCH_WRITER;
+
+static
+double
+BenchNow(
+    VOID
+    )
+{
+    struct timeval now = { 0 };
+
+    gettimeofday(&now, NULL);
+    return now.tv_sec + now.tv_usec / 1000000.0;
+}
+
+static
+PVOID
+BenchWriterThread(
+    PVOID pContext
+    )
+{
+    PBENCH_WRITER pWriter = pContext;
+    LW_EVENTLOG_RECORD record = { 0 };
+    DWORD dwError = 0;
+    DWORD index = 0;
+
+    dwError = LwMbsToWc16s("Application", &record.pLogname);
+    BAIL_ON_EVT_ERROR(dwError);
+    dwError = LwMbsToWc16s("Information", &record.pEventType);
+    BAIL_ON_EVT_ERROR(dwError);
+    dwError = LwMbsToWc16s(BENCH_EVENT_SOURCE, &record.pEventSource);
+    BAIL_ON_EVT_ERROR(dwError);
+    dwError = LwMbsToWc16s("Benchmark", &record.pEventCategory);
+    BAIL_ON_EVT_ERROR(dwError);
+    dwError = LwMbsToWc16s("root", &record.pUser);
+    BAIL_ON_EVT_ERROR(dwError);
+    dwError = LwMbsToWc16s(
+                    "Synthetic event written by the eventlog write benchmark",
+                    &record.pDescription);
+    BAIL_ON_EVT_ERROR(dwError);
+
+    for (index = 0; index < pWriter->Count; index++)
+    {
+        record.EventSourceId = index;
+        record.EventDateTime = time(NULL);
+
+        dwError = LwEvtWriteRecords(pWriter->pConn, 1, &record);
+        BAIL_ON_EVT_ERROR(dwError);
+    }
+
+error:
+    LW_SAFE_FREE_MEMORY(record.pLogname);
+    LW_SAFE_FREE_MEMORY(record.pEventType);
+    LW_SAFE_FREE_MEMORY(record.pEventSource);
+    LW_SAFE_FREE_MEMORY(record.pEventCategory);
+    LW_SAFE_FREE_MEMORY(record.pUser);
+    LW_SAFE_FREE_MEMORY(record.pDescription);
+
+    pWriter->dwError = dwError;
+    return NULL;
+}
+
+static
+DWORD
+BenchRun(
+    DWORD Records,
+    DWORD Threads,
+    DWORD BatchRecords,
+    DWORD BatchDelayMs,
+    double* pRate
+    )
+{
+    DWORD dwError = 0;
+    PLW_EVENTLOG_CONNECTION pConn = NULL;
+    PBENCH_WRITER pWriters = NULL;
+    pthread_t* pThreads = NULL;
+    DWORD started = 0;
+    DWORD index = 0;
+    double start = 0;
+    double elapsed = 0;
+
+    dwError = LwAllocateMemory(sizeof(*pWriters) * Threads, (PVOID*)&pWriters);
+    BAIL_ON_EVT_ERROR(dwError);
+    dwError = LwAllocateMemory(sizeof(*pThreads) * Threads, (PVOID*)&pThreads);
+    BAIL_ON_EVT_ERROR(dwError);
+
+    dwError = LwEvtOpenEventlog(NULL, &pConn);
+    BAIL_ON_EVT_ERROR(dwError);
+
+    if (BatchRecords)
+    {
+        dwError = LwEvtEnableWriteQueue(pConn, BatchRecords, BatchDelayMs);
+        BAIL_ON_EVT_ERROR(dwError);
+    }
+
+    start = BenchNow();
+
+    for (started = 0; started < Threads; started++)
+    {
+        pWriters[started].pConn = pConn;
+        pWriters[started].Count = Records / Threads +
+            (started < Records % Threads ? 1 : 0);
+
+        dwError = LwMapErrnoToLwError(pthread_create(
+                        &pThreads[started],
+                        NULL,
+                        BenchWriterThread,
+                        &pWriters[started]));
+        BAIL_ON_EVT_ERROR(dwError);
+    }
+
+error:
+    for (index = 0; index < started; index++)
+    {
+        pthread_join(pThreads[index], NULL);
+        if (!dwError)
+        {
+            dwError = pWriters[index].dwError;
+        }
+    }
+
+    if (!dwError && pConn)
+    {
+        // Only count the queued records once eventlogd has them
+        dwError = LwEvtFlushRecords(pConn);
+    }
+
+    elapsed = BenchNow() - start;
+    *pRate = (!dwError && elapsed > 0) ? Records / elapsed : 0;
+
+    if (pConn)
+    {
+        LwEvtCloseEventlog(pConn);
+    }
+    LW_SAFE_FREE_MEMORY(pWriters);
+    LW_SAFE_FREE_MEMORY(pThreads);
+
+    return dwError;
+}
+
+static
+DWORD
+BenchDeleteRecords(
+    VOID
+    )
+{
+    DWORD dwError = 0;
+    PLW_EVENTLOG_CONNECTION pConn = NULL;
+    PWSTR pFilter = NULL;
+
+    dwError = LwMbsToWc16s(
+                    "EventSource = '" BENCH_EVENT_SOURCE "'",
+                    &pFilter);
+    BAIL_ON_EVT_ERROR(dwError);
+
+    dwError = LwEvtOpenEventlog(NULL, &pConn);
+    BAIL_ON_EVT_ERROR(dwError);
+
+    dwError = LwEvtDeleteRecords(pConn, pFilter);
+    BAIL_ON_EVT_ERROR(dwError);
+
+error:
+    if (pConn)
+    {
+        LwEvtCloseEventlog(pConn);
+    }
+    LW_SAFE_FREE_MEMORY(pFilter);
+
+    return dwError;
+}
+
+static
+VOID
+ShowUsage(
+    PCSTR pszProgram
+    )
+{
+    fprintf(stderr,
+            "Usage: %s [-n records] [-t threads] [-b batch records] "
+            "[-d batch delay ms] [-k]\n",
+            pszProgram);
+}
+
+int
+main(
+    int argc,
+    char** argv
+    )
+{
+    DWORD dwError = 0;
+    DWORD records = 20000;
+    DWORD threads = 4;
+    DWORD batchRecords = 500;
+    DWORD batchDelayMs = 100;
+    BOOLEAN bKeep = FALSE;
+    double syncRate = 0;
+    double queuedRate = 0;
+    int opt = 0;
+
+    while ((opt = getopt(argc, argv, "n:t:b:d:k")) != -1)
+    {
+        switch (opt)
+        {
+            case 'n':
+                records = atoi(optarg);
+                break;
+            case 't':
+                threads = atoi(optarg);
+                break;
+            case 'b':
+                batchRecords = atoi(optarg);
+                break;
+            case 'd':
+                batchDelayMs = atoi(optarg);
+                break;
+            case 'k':
+                bKeep = TRUE;
+                break;
+            default:
+                ShowUsage(argv[0]);
+                return 1;
+        }
+    }
+
+    if (records == 0 || threads == 0 || batchRecords == 0)
+    {
+        ShowUsage(argv[0]);
+        return 1;
+    }
+
+    printf("%u records, %u threads, batches of up to %u records or %u ms\n",
+           records, threads, batchRecords, batchDelayMs);
+
+    dwError = BenchRun(records, threads, 0, 0, &syncRate);
+    BAIL_ON_EVT_ERROR(dwError);
+    printf("synchronous: %10.0f records/s\n", syncRate);
+
+    dwError = BenchRun(records, threads, batchRecords, batchDelayMs, &queuedRate);
+    BAIL_ON_EVT_ERROR(dwError);
+    printf("queued:      %10.0f records/s\n", queuedRate);
+
+error:
+    if (!bKeep)
+    {
+        BenchDeleteRecords();
+    }
+
+    if (dwError)
+    {
+        fprintf(stderr, "Failed with error %u (%s)\n",
+                dwError, LW_SAFE_LOG_STRING(LwWin32ExtErrorToName(dwError)));
+        return 1;
+    }
+
+    return 0;
+}
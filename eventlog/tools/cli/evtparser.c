@@ -279,8 +279,7 @@ ReadAndExportEvents(
     const DWORD pageSize = 2000;
     DWORD entriesRead = 0;
     PLW_EVENTLOG_RECORD records = NULL;
-    UINT64 startRecordId = 0;
-    PWSTR pFilter = NULL;
+    UINT64 continuation = 0;
 
     if (fpExport == NULL) return -1;
     if (pEventLogHandle == NULL) return -1;
@@ -303,14 +302,6 @@ ReadAndExportEvents(
 
     do
     {
-        LW_SAFE_FREE_MEMORY(pFilter);
-        dwError = LwAllocateWc16sPrintfW(
-                        &pFilter,
-                        L"(%ws) AND EventRecordId >= %llu",
-                        pwszSqlFilter,
-                        (long long unsigned)startRecordId);
-        BAIL_ON_EVT_ERROR(dwError);
-
         if (records)
         {
             LwEvtFreeRecordArray(
@@ -318,27 +309,27 @@ ReadAndExportEvents(
                 records);
             records = NULL;
         }
-        dwError = LwEvtReadRecords(
+        dwError = LwEvtReadRecordPage(
                     pEventLogHandle,
+                    continuation,
                     pageSize,
-                    pFilter,
+                    pwszSqlFilter,
+                    &continuation,
                     &entriesRead,
                     &records);
         BAIL_ON_EVT_ERROR(dwError);
 
         for (i = 0; i < entriesRead; i++)
         {
-            startRecordId = records[i].EventRecordId + 1;
             dwError = ExportEventRecord(&(records[i]), fpExport);
             BAIL_ON_EVT_ERROR(dwError);
         }
 
         fflush(fpExport);
-    } while (entriesRead == pageSize && entriesRead > 0);
+    } while (continuation);
 
  cleanup:
 
-    LW_SAFE_FREE_MEMORY(pFilter);
     if (records)
     {
         LwEvtFreeRecordArray(
@@ -264,7 +264,7 @@ main(
     PLW_EVENTLOG_CONNECTION pEventLogHandle = NULL;
     PLW_EVENTLOG_RECORD pEventRecords = NULL;
     DWORD nRecords = 0;
-    UINT64 startRecordId = 0;
+    UINT64 continuation = 0;
     DWORD currentRecord = 0;
     DWORD nRecordsPerPage = 500;
 
@@ -283,7 +283,6 @@ main(
     DWORD dwHoursForFilter = 0;
     DWORD dwMinutesForFilter = 0;
     DWORD dwSecondsForFilter = 0;
-    PWSTR pFilter = NULL;
 
     struct poptOption optionsTable[] =
     {
@@ -556,25 +555,6 @@ main(
     {
         do
         {
-            LW_SAFE_FREE_MEMORY(pFilter);
-            if (pwszSqlFilter)
-            {
-                dwError = LwAllocateWc16sPrintfW(
-                                &pFilter,
-                                L"(%ws) AND EventRecordId >= %llu",
-                                pwszSqlFilter,
-                                (long long unsigned)startRecordId);
-                BAIL_ON_EVT_ERROR(dwError);
-            }
-            else
-            {
-                dwError = LwAllocateWc16sPrintfW(
-                                &pFilter,
-                                L"EventRecordId >= %llu",
-                                (long long unsigned)startRecordId);
-                BAIL_ON_EVT_ERROR(dwError);
-            }
-
             if (pEventRecords)
             {
                 LwEvtFreeRecordArray(
@@ -582,44 +562,23 @@ main(
                     pEventRecords);
                 pEventRecords = NULL;
             }
-            dwError = LwEvtReadRecords(
+            dwError = LwEvtReadRecordPage(
                         pEventLogHandle,
+                        continuation,
                         nRecordsPerPage,
-                        pFilter,
+                        pwszSqlFilter,
+                        &continuation,
                         &nRecords,
                         &pEventRecords);
             BAIL_ON_EVT_ERROR(dwError);
 
             PrintEventRecords(stdout, pEventRecords, nRecords, &currentRecord);
-            if (nRecords > 0)
-            {
-                startRecordId = pEventRecords[nRecords - 1].EventRecordId + 1;
-            }
-        } while (nRecords == nRecordsPerPage && nRecords > 0);
+        } while (continuation);
     }
     else if (dwFinalAction == ACTION_TABLE)
     {
         do
         {
-            LW_SAFE_FREE_MEMORY(pFilter);
-            if (pwszSqlFilter)
-            {
-                dwError = LwAllocateWc16sPrintfW(
-                                &pFilter,
-                                L"(%ws) AND EventRecordId >= %llu",
-                                pwszSqlFilter,
-                                (long long unsigned)startRecordId);
-                BAIL_ON_EVT_ERROR(dwError);
-            }
-            else
-            {
-                dwError = LwAllocateWc16sPrintfW(
-                                &pFilter,
-                                L"EventRecordId >= %llu",
-                                (long long unsigned)startRecordId);
-                BAIL_ON_EVT_ERROR(dwError);
-            }
-
             if (pEventRecords)
             {
                 LwEvtFreeRecordArray(
@@ -627,20 +586,18 @@ main(
                     pEventRecords);
                 pEventRecords = NULL;
             }
-            dwError = LwEvtReadRecords(
+            dwError = LwEvtReadRecordPage(
                         pEventLogHandle,
+                        continuation,
                         nRecordsPerPage,
-                        pFilter,
+                        pwszSqlFilter,
+                        &continuation,
                         &nRecords,
                         &pEventRecords);
             BAIL_ON_EVT_ERROR(dwError);
 
             PrintEventRecordsTable(stdout, pEventRecords, nRecords, &currentRecord);
-            if (nRecords > 0)
-            {
-                startRecordId = pEventRecords[nRecords - 1].EventRecordId + 1;
-            }
-        } while (nRecords == nRecordsPerPage && nRecords > 0);
+        } while (continuation);
     }
     else if (dwFinalAction == ACTION_DELETE)
     {
@@ -662,7 +619,6 @@ main(
         fprintf(stderr, "The operation failed with error code (%u): %s\n", dwError, LwWin32ExtErrorToName(dwError));
     }
     LW_SAFE_FREE_MEMORY(pwszSqlFilter);
-    LW_SAFE_FREE_MEMORY(pFilter);
     if (pEventLogHandle)
     {
         LwEvtCloseEventlog(pEventLogHandle);
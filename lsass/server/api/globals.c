@@ -88,6 +88,13 @@ LsaSrvApiInit(
 
     pthread_rwlock_init(&gpRpcServerList_rwlock, NULL);
 
+    /*
+     * Configuration (including what PAM and NSS clients fetch from us) is
+     * re-read from the registry on every refresh and request; lwregd
+     * invalidates these cached values whenever anything changes.
+     */
+    RegEnableValueCache(TRUE);
+
     dwError = LsaSrvApiInitConfig(&gAPIConfig);
     BAIL_ON_LSA_ERROR(dwError);
 
@@ -818,6 +818,7 @@ ADCacheDuplicateMembershipContents(
     pDest->bIsInPacOnly = pSrc->bIsInPacOnly;
     pDest->bIsInLdap = pSrc->bIsInLdap;
     pDest->bIsDomainPrimaryGroup = pSrc->bIsDomainPrimaryGroup;
+    pDest->bIsInTokenGroups = pSrc->bIsInTokenGroups;
 
 cleanup:
     return dwError;
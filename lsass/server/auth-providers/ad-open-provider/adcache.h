@@ -117,6 +117,11 @@
 // *              (bIsInLdap) D -> NX
 // The membership was found through LDAP (pac was never received), but it is no
 // longer in LDAP.
+//
+// bIsInTokenGroups is set on LDAP memberships of a user that were read from
+// its tokenGroups attribute. Those include groups the user is only in through
+// nesting, so storing a group's direct members must not remove them. They
+// are replaced the next time the user's own memberships are stored.
 typedef struct __LSA_GROUP_MEMBERSHIP
 {
     LSA_SECURITY_OBJECT_VERSION_INFO version;
@@ -126,6 +131,7 @@ typedef struct __LSA_GROUP_MEMBERSHIP
     BOOLEAN bIsInPacOnly;
     BOOLEAN bIsInLdap;
     BOOLEAN bIsDomainPrimaryGroup;
+    BOOLEAN bIsInTokenGroups;
 } LSA_GROUP_MEMBERSHIP, *PLSA_GROUP_MEMBERSHIP;
 
 typedef struct __LSA_DB_PASSWORD_VERIFIER
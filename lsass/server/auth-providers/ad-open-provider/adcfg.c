@@ -128,6 +128,7 @@ AD_InitializeConfig(
     pConfig->bSyncSystemTime  = TRUE;
     pConfig->dwCacheEntryExpirySecs   = AD_CACHE_ENTRY_EXPIRY_DEFAULT_SECS;
     pConfig->dwCacheSizeCap           = 0;
+    pConfig->dwCacheReadConnections   = AD_DEFAULT_CACHE_READ_CONNECTIONS;
     pConfig->dwMachinePasswordSyncLifetime = AD_MACHINE_PASSWORD_SYNC_DEFAULT_SECS;
     pConfig->pszServicePrincipalNameList = NULL;
     pConfig->dwUmask          = AD_DEFAULT_UMASK;
@@ -141,6 +142,9 @@ AD_InitializeConfig(
     pConfig->bNssGroupMembersCacheOnlyEnabled = TRUE;
     pConfig->bNssUserMembershipCacheOnlyEnabled = FALSE;
     pConfig->bNssEnumerationEnabled = FALSE;
+    pConfig->dwBatchDomainParallelism = AD_DEFAULT_BATCH_DOMAIN_PARALLELISM;
+    pConfig->bTokenGroupsMembershipEnabled = FALSE;
+    pConfig->bTrustPacMembershipEnabled = FALSE;
 
     pConfig->DomainManager.dwCheckDomainOnlineSeconds = 5 * LSA_SECONDS_IN_MINUTE;
     pConfig->DomainManager.dwUnknownDomainCacheTimeoutSeconds = 1 * LSA_SECONDS_IN_HOUR;
@@ -367,6 +371,16 @@ AD_ReadRegistry(
             &StagingConfig.dwCacheSizeCap,
             NULL
         },
+        {
+            "CacheReadConnections",
+            TRUE,
+            LwRegTypeDword,
+            0,
+            AD_MAXIMUM_CACHE_READ_CONNECTIONS,
+            NULL,
+            &StagingConfig.dwCacheReadConnections,
+            NULL
+        },
         {
             "LdapSignAndSeal",
             TRUE,
@@ -517,6 +531,36 @@ AD_ReadRegistry(
             &StagingConfig.bNssEnumerationEnabled,
             NULL
         },
+        {
+            "BatchDomainQueryParallelism",
+            TRUE,
+            LwRegTypeDword,
+            1,
+            64,
+            NULL,
+            &StagingConfig.dwBatchDomainParallelism,
+            NULL
+        },
+        {
+            "TokenGroupsMembershipEnabled",
+            TRUE,
+            LwRegTypeBoolean,
+            0,
+            MAXDWORD,
+            NULL,
+            &StagingConfig.bTokenGroupsMembershipEnabled,
+            NULL
+        },
+        {
+            "TrustPacMembership",
+            TRUE,
+            LwRegTypeBoolean,
+            0,
+            MAXDWORD,
+            NULL,
+            &StagingConfig.bTrustPacMembershipEnabled,
+            NULL
+        },
         {
             "DomainManagerCheckDomainOnlineInterval",
             TRUE,
@@ -1987,6 +2031,23 @@ AD_GetCacheSizeCap(
     return dwResult;
 }
 
+DWORD
+AD_GetCacheReadConnections(
+    IN PLSA_AD_PROVIDER_STATE pState
+    )
+{
+    DWORD dwResult = 0;
+    BOOLEAN bInLock = FALSE;
+
+    ENTER_AD_CONFIG_RW_READER_LOCK(bInLock, pState);
+
+    dwResult = pState->config.dwCacheReadConnections;
+
+    LEAVE_AD_CONFIG_RW_READER_LOCK(bInLock, pState);
+
+    return dwResult;
+}
+
 BOOLEAN
 AD_GetTrimUserMembershipEnabled(
     IN PLSA_AD_PROVIDER_STATE pState
@@ -2055,6 +2116,55 @@ AD_GetNssEnumerationEnabled(
     return result;
 }
 
+DWORD
+AD_GetBatchDomainParallelism(
+    IN PLSA_AD_PROVIDER_STATE pState
+    )
+{
+    DWORD result = 0;
+    BOOLEAN bInLock = FALSE;
+
+    ENTER_AD_CONFIG_RW_READER_LOCK(bInLock, pState);
+    result = pState->config.dwBatchDomainParallelism;
+    LEAVE_AD_CONFIG_RW_READER_LOCK(bInLock, pState);
+
+    return result;
+}
+
+BOOLEAN
+AD_GetTokenGroupsMembershipEnabled(
+    IN PLSA_AD_PROVIDER_STATE pState
+    )
+{
+    BOOLEAN result = FALSE;
+    BOOLEAN bInLock = FALSE;
+
+    ENTER_AD_CONFIG_RW_READER_LOCK(bInLock, pState);
+
+    result = pState->config.bTokenGroupsMembershipEnabled;
+
+    LEAVE_AD_CONFIG_RW_READER_LOCK(bInLock, pState);
+
+    return result;
+}
+
+BOOLEAN
+AD_GetTrustPacMembershipEnabled(
+    IN PLSA_AD_PROVIDER_STATE pState
+    )
+{
+    BOOLEAN result = FALSE;
+    BOOLEAN bInLock = FALSE;
+
+    ENTER_AD_CONFIG_RW_READER_LOCK(bInLock, pState);
+
+    result = pState->config.bTrustPacMembershipEnabled;
+
+    LEAVE_AD_CONFIG_RW_READER_LOCK(bInLock, pState);
+
+    return result;
+}
+
 DWORD
 AD_GetDomainManagerCheckDomainOnlineSeconds(
     IN PLSA_AD_PROVIDER_STATE pState
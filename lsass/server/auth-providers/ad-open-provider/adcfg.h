@@ -286,6 +286,11 @@ AD_GetCacheSizeCap(
     IN PLSA_AD_PROVIDER_STATE pState
     );
 
+DWORD
+AD_GetCacheReadConnections(
+    IN PLSA_AD_PROVIDER_STATE pState
+    );
+
 BOOLEAN
 AD_GetTrimUserMembershipEnabled(
     IN PLSA_AD_PROVIDER_STATE pState
@@ -306,6 +311,21 @@ AD_GetNssEnumerationEnabled(
     IN PLSA_AD_PROVIDER_STATE pState
     );
 
+DWORD
+AD_GetBatchDomainParallelism(
+    IN PLSA_AD_PROVIDER_STATE pState
+    );
+
+BOOLEAN
+AD_GetTokenGroupsMembershipEnabled(
+    IN PLSA_AD_PROVIDER_STATE pState
+    );
+
+BOOLEAN
+AD_GetTrustPacMembershipEnabled(
+    IN PLSA_AD_PROVIDER_STATE pState
+    );
+
 DWORD
 AD_GetDomainManagerCheckDomainOnlineSeconds(
     IN PLSA_AD_PROVIDER_STATE pState
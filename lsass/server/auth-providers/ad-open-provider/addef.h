@@ -50,6 +50,9 @@
 #define AD_DEFAULT_SHELL            "/bin/sh"
 
 #define AD_DEFAULT_UMASK            022
+#define AD_DEFAULT_BATCH_DOMAIN_PARALLELISM 4
+#define AD_DEFAULT_CACHE_READ_CONNECTIONS   4
+#define AD_MAXIMUM_CACHE_READ_CONNECTIONS   64
 
 #define AD_DEFAULT_HOMEDIR_TEMPLATE "%H/local/%D/%U"
 
@@ -1266,6 +1266,119 @@ ADLdap_FreeHashStringValue(
     }
 }
 
+// Reads the constructed tokenGroups attribute of pszDN, which lists the
+// SIDs of every security group the object is a member of, directly or
+// through nesting.  SIDs outside the NT domain prefix (BUILTIN and
+// other well-known groups) are left out.
+static
+DWORD
+ADLdap_GetTokenGroupSids(
+    IN PLSA_DM_LDAP_CONNECTION pConn,
+    IN PCSTR pszDN,
+    OUT PDWORD pdwSidCount,
+    OUT PSTR** pppszSids
+    )
+{
+    DWORD dwError = 0;
+    PSTR szAttributeList[] = {
+        AD_LDAP_TOKEN_GROUPS_TAG,
+        NULL
+    };
+    // Do not free. This is owned by pConn
+    HANDLE hDirectory = NULL;
+    LDAPMessage* pMessage = NULL;
+    // Do not free. This is owned by pConn
+    LDAP* pLd = NULL;
+    // Do not free
+    LDAPMessage* pCurrentMessage = NULL;
+    struct berval** ppValues = NULL;
+    DWORD dwValueCount = 0;
+    DWORD dwSidCount = 0;
+    PSTR* ppszSids = NULL;
+    PSTR pszSid = NULL;
+    DWORD i = 0;
+
+    // tokenGroups can only be read with a base scoped search.
+    dwError = LsaDmLdapDirectorySearch(
+                    pConn,
+                    pszDN,
+                    LDAP_SCOPE_BASE,
+                    "(objectClass=*)",
+                    szAttributeList,
+                    &hDirectory,
+                    &pMessage);
+    BAIL_ON_LSA_ERROR(dwError);
+
+    pLd = LwLdapGetSession(hDirectory);
+
+    pCurrentMessage = ldap_first_entry(pLd, pMessage);
+    if (pCurrentMessage)
+    {
+        ppValues = ldap_get_values_len(
+                        pLd,
+                        pCurrentMessage,
+                        AD_LDAP_TOKEN_GROUPS_TAG);
+        dwValueCount = ppValues ? ldap_count_values_len(ppValues) : 0;
+    }
+
+    if (!dwValueCount)
+    {
+        // Every user has at least its primary group, so nothing coming
+        // back means the machine account may not read tokenGroups.
+        LSA_LOG_ERROR("Could not read %s of %s; check that the computer "
+                      "account may read it or disable "
+                      "TokenGroupsMembershipEnabled",
+                      AD_LDAP_TOKEN_GROUPS_TAG,
+                      pszDN);
+        dwError = LW_ERROR_NO_ATTRIBUTE_VALUE;
+        BAIL_ON_LSA_ERROR(dwError);
+    }
+
+    dwError = LwAllocateMemory(
+                    sizeof(*ppszSids) * dwValueCount,
+                    OUT_PPVOID(&ppszSids));
+    BAIL_ON_LSA_ERROR(dwError);
+
+    for (i = 0; i < dwValueCount; i++)
+    {
+        dwError = LsaSidBytesToString(
+                        (UCHAR*)ppValues[i]->bv_val,
+                        (DWORD)ppValues[i]->bv_len,
+                        &pszSid);
+        BAIL_ON_LSA_ERROR(dwError);
+
+        if (AdIsSpecialDomainSidPrefix(pszSid))
+        {
+            LW_SAFE_FREE_STRING(pszSid);
+            continue;
+        }
+
+        ppszSids[dwSidCount++] = pszSid;
+        pszSid = NULL;
+    }
+
+    *pdwSidCount = dwSidCount;
+    *pppszSids = ppszSids;
+
+cleanup:
+    LW_SAFE_FREE_STRING(pszSid);
+    if (ppValues)
+    {
+        ldap_value_free_len(ppValues);
+    }
+    if (pMessage)
+    {
+        ldap_msgfree(pMessage);
+    }
+    return dwError;
+
+error:
+    *pdwSidCount = 0;
+    *pppszSids = NULL;
+    LwFreeStringArray(ppszSids, dwSidCount);
+    goto cleanup;
+}
+
 DWORD
 ADLdap_GetObjectGroupMembership(
     IN PAD_PROVIDER_CONTEXT pContext,
@@ -1292,6 +1405,7 @@ ADLdap_GetObjectGroupMembership(
     DWORD index = 0;
     DWORD totalSidCount = 0;
     PSTR* ppTotalSidList = NULL;
+    BOOLEAN bUseTokenGroups = FALSE;
 
     // If we cannot get dn, then we cannot get DN information for this objects, hence BAIL
     if (LW_IS_NULL_OR_EMPTY_STR(pObject->pszDN))
@@ -1323,7 +1437,29 @@ ADLdap_GetObjectGroupMembership(
     LSA_ASSERT(LSA_TRUST_DIRECTION_TWO_WAY == trustDirection ||
             LSA_TRUST_DIRECTION_SELF == trustDirection);
 
-    if (trustMode != LSA_TRUST_MODE_EXTERNAL)
+    bUseTokenGroups = pObject->type == LSA_OBJECT_TYPE_USER &&
+                      AD_GetTokenGroupsMembershipEnabled(pContext->pState);
+
+    if (bUseTokenGroups)
+    {
+        // The user's DC computes tokenGroups from the whole forest
+        // (asking a GC for universal groups itself), so this one search
+        // replaces the memberOf queries below and already includes
+        // nested groups.
+        dwError = LsaDmLdapOpenDc(
+                      pContext,
+                      pszFullDomainName,
+                      &pConn);
+        BAIL_ON_LSA_ERROR(dwError);
+
+        dwError = ADLdap_GetTokenGroupSids(
+                        pConn,
+                        pObject->pszDN,
+                        &dcMembershipCount,
+                        &ppDcMembershipList);
+        BAIL_ON_LSA_ERROR(dwError);
+    }
+    else if (trustMode != LSA_TRUST_MODE_EXTERNAL)
     {
         // Get forest info from domain's GC since there is a forest trust.
         // This will only include universal group information.  (The domain
@@ -1348,21 +1484,24 @@ ADLdap_GetObjectGroupMembership(
         pConn = NULL;
     }
 
-    dwError = LsaDmLdapOpenDc(
-                  pContext,
-                  pszFullDomainName,
-                  &pConn);
-    BAIL_ON_LSA_ERROR(dwError);
+    if (!bUseTokenGroups)
+    {
+        dwError = LsaDmLdapOpenDc(
+                      pContext,
+                      pszFullDomainName,
+                      &pConn);
+        BAIL_ON_LSA_ERROR(dwError);
 
-    dwError = ADLdap_GetAttributeValuesList(
-                    pConn,
-                    pObject->pszDN,
-                    AD_LDAP_MEMBEROF_TAG,
-                    TRUE,
-                    TRUE,
-                    &dcMembershipCount,
-                    &ppDcMembershipList);
-    BAIL_ON_LSA_ERROR(dwError);
+        dwError = ADLdap_GetAttributeValuesList(
+                        pConn,
+                        pObject->pszDN,
+                        AD_LDAP_MEMBEROF_TAG,
+                        TRUE,
+                        TRUE,
+                        &dcMembershipCount,
+                        &ppDcMembershipList);
+        BAIL_ON_LSA_ERROR(dwError);
+    }
 
     dwError = LwHashCreate(
                     (dcMembershipCount + gcMembershipCount + 1) * 2,
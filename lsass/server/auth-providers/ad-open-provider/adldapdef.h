@@ -61,6 +61,7 @@
 #define AD_LDAP_SHELL_TAG        "loginShell"
 #define AD_LDAP_MEMBER_TAG       "member"
 #define AD_LDAP_MEMBEROF_TAG     "memberOf"
+#define AD_LDAP_TOKEN_GROUPS_TAG "tokenGroups"
 #define AD_LDAP_SEC_DESC_TAG     "nTSecurityDescriptor"
 #define AD_LDAP_KEYWORDS_TAG     "keywords"
 #define AD_LDAP_DESCRIPTION_TAG  "description"
@@ -58,6 +58,28 @@ typedef struct _LSA_SCHANNEL_STATE {
     pthread_mutex_t *pSchannelLock;
 } LSA_SCHANNEL_STATE;
 
+// Idle pooled policies are closed once unused for this long.
+#define AD_LSA_POLICY_MAX_IDLE_SECONDS 60
+// Upper bound on idle policies kept across all DCs.
+#define AD_LSA_POLICY_POOL_MAX_IDLE 8
+
+typedef struct _LSA_POOLED_POLICY {
+    PSTR pszHostname;
+    LSA_BINDING hBinding;
+    POLICY_HANDLE hPolicy;
+    // Set when handed out from the pool rather than freshly opened.
+    BOOLEAN bReused;
+    time_t LastUsedTime;
+    struct _LSA_POOLED_POLICY* pNext;
+} LSA_POOLED_POLICY, *PLSA_POOLED_POLICY;
+
+typedef struct _LSA_POLICY_POOL {
+    PLSA_POOLED_POLICY pIdleList;
+    DWORD dwIdleCount;
+    pthread_mutex_t Lock;
+    pthread_mutex_t *pLock;
+} LSA_POLICY_POOL;
+
 static
 BOOLEAN
 AD_NtStatusIsTgtRevokedError(
@@ -88,6 +110,31 @@ AD_ClearSchannelStateInLock(
     IN PLSA_SCHANNEL_STATE pSchannelState
     );
 
+static
+DWORD
+AD_NetAcquireLsaPolicy(
+    IN PLSA_AD_PROVIDER_STATE pState,
+    IN PCSTR pszHostname,
+    IN PWSTR pwcHost,
+    IN LW_PIO_CREDS pCreds,
+    OUT PLSA_POOLED_POLICY* ppPolicy,
+    OUT PBOOLEAN pbIsNetworkError
+    );
+
+static
+VOID
+AD_NetReleaseLsaPolicy(
+    IN PLSA_AD_PROVIDER_STATE pState,
+    IN PLSA_POOLED_POLICY pPolicy,
+    IN BOOLEAN bReusable
+    );
+
+static
+VOID
+AD_NetClosePooledPolicy(
+    IN PLSA_POOLED_POLICY pPolicy
+    );
+
 static
 DWORD
 AD_GetSystemCreds(
@@ -236,6 +283,273 @@ AD_NetDestroySchannelState(
     LwFreeMemory(pSchannelState);
 }
 
+DWORD
+AD_NetCreateLsaPolicyPool(
+    OUT PLSA_POLICY_POOL* ppPool
+    )
+{
+    DWORD dwError = 0;
+    PLSA_POLICY_POOL pPool = NULL;
+
+    dwError = LwAllocateMemory(
+                  sizeof(*pPool),
+                  (PVOID*)&pPool);
+    BAIL_ON_LSA_ERROR(dwError);
+
+    dwError = LwMapErrnoToLwError(pthread_mutex_init(&pPool->Lock, NULL));
+    BAIL_ON_LSA_ERROR(dwError);
+
+    pPool->pLock = &pPool->Lock;
+
+    *ppPool = pPool;
+
+cleanup:
+
+    return dwError;
+
+error:
+
+    *ppPool = NULL;
+
+    if (pPool)
+    {
+        AD_NetDestroyLsaPolicyPool(pPool);
+    }
+
+    goto cleanup;
+}
+
+VOID
+AD_NetDestroyLsaPolicyPool(
+    IN PLSA_POLICY_POOL pPool
+    )
+{
+    PLSA_POOLED_POLICY pPolicy = NULL;
+
+    while (pPool->pIdleList)
+    {
+        pPolicy = pPool->pIdleList;
+        pPool->pIdleList = pPolicy->pNext;
+
+        AD_NetClosePooledPolicy(pPolicy);
+    }
+
+    if (pPool->pLock)
+    {
+        pthread_mutex_destroy(pPool->pLock);
+    }
+
+    LwFreeMemory(pPool);
+}
+
+static
+VOID
+AD_NetClosePooledPolicy(
+    IN PLSA_POOLED_POLICY pPolicy
+    )
+{
+    NTSTATUS status = 0;
+
+    if (pPolicy->hPolicy)
+    {
+        status = LsaClose(pPolicy->hBinding, pPolicy->hPolicy);
+        if (status != 0)
+        {
+            LSA_LOG_DEBUG("LsaClose() failed with %u (0x%08x)", status, status);
+        }
+    }
+
+    if (pPolicy->hBinding)
+    {
+        LsaFreeBinding(&pPolicy->hBinding);
+    }
+
+    LW_SAFE_FREE_STRING(pPolicy->pszHostname);
+    LwFreeMemory(pPolicy);
+}
+
+/*
+ * Hands out an LSA binding to pszHostname with a policy handle open for
+ * name/SID lookups.  An idle one from the pool is preferred; otherwise a
+ * new one is opened using the thread's current credentials.  Idle
+ * entries past AD_LSA_POLICY_MAX_IDLE_SECONDS are closed on the way.
+ */
+static
+DWORD
+AD_NetAcquireLsaPolicy(
+    IN PLSA_AD_PROVIDER_STATE pState,
+    IN PCSTR pszHostname,
+    IN PWSTR pwcHost,
+    IN LW_PIO_CREDS pCreds,
+    OUT PLSA_POOLED_POLICY* ppPolicy,
+    OUT PBOOLEAN pbIsNetworkError
+    )
+{
+    DWORD dwError = 0;
+    NTSTATUS status = 0;
+    PLSA_POLICY_POOL pPool = pState->hLsaPolicyPool;
+    PLSA_POOLED_POLICY pPolicy = NULL;
+    PLSA_POOLED_POLICY pExpired = NULL;
+    PLSA_POOLED_POLICY pEntry = NULL;
+    PLSA_POOLED_POLICY* ppLink = NULL;
+    BOOLEAN bIsNetworkError = FALSE;
+    time_t now = time(NULL);
+
+    pthread_mutex_lock(pPool->pLock);
+
+    ppLink = &pPool->pIdleList;
+    while (*ppLink)
+    {
+        pEntry = *ppLink;
+
+        if (now < pEntry->LastUsedTime ||
+            now - pEntry->LastUsedTime > AD_LSA_POLICY_MAX_IDLE_SECONDS)
+        {
+            *ppLink = pEntry->pNext;
+            pPool->dwIdleCount--;
+            pEntry->pNext = pExpired;
+            pExpired = pEntry;
+        }
+        else if (!pPolicy &&
+                 LwRtlCStringIsEqual(pEntry->pszHostname, pszHostname, FALSE))
+        {
+            *ppLink = pEntry->pNext;
+            pPool->dwIdleCount--;
+            pEntry->pNext = NULL;
+            pPolicy = pEntry;
+        }
+        else
+        {
+            ppLink = &pEntry->pNext;
+        }
+    }
+
+    pthread_mutex_unlock(pPool->pLock);
+
+    // Closing talks to the DC, so do it outside the pool lock.
+    while (pExpired)
+    {
+        pEntry = pExpired;
+        pExpired = pEntry->pNext;
+
+        AD_NetClosePooledPolicy(pEntry);
+    }
+
+    if (pPolicy)
+    {
+        pPolicy->bReused = TRUE;
+        goto cleanup;
+    }
+
+    dwError = LwAllocateMemory(
+                  sizeof(*pPolicy),
+                  (PVOID*)&pPolicy);
+    BAIL_ON_LSA_ERROR(dwError);
+
+    dwError = LwAllocateString(pszHostname, &pPolicy->pszHostname);
+    BAIL_ON_LSA_ERROR(dwError);
+
+    status = LsaInitBindingDefault(&pPolicy->hBinding, pwcHost, pCreds);
+    if (status != 0)
+    {
+        LSA_LOG_DEBUG("LsaInitBindingDefault() failed with %u (0x%08x)", status, status);
+        dwError = LW_ERROR_RPC_LSABINDING_FAILED;
+        bIsNetworkError = TRUE;
+        BAIL_ON_LSA_ERROR(dwError);
+    }
+
+    if (pPolicy->hBinding == NULL)
+    {
+        dwError = LW_ERROR_RPC_LSABINDING_FAILED;
+        BAIL_ON_LSA_ERROR(dwError);
+    }
+
+    status = LsaOpenPolicy2(pPolicy->hBinding,
+                            pwcHost,
+                            NULL,
+                            LSA_ACCESS_LOOKUP_NAMES_SIDS,
+                            &pPolicy->hPolicy);
+    if (status != 0)
+    {
+        LSA_LOG_DEBUG("LsaOpenPolicy2() failed with %u (0x%08x)", status, status);
+
+        if (AD_NtStatusIsTgtRevokedError(status))
+        {
+            bIsNetworkError = TRUE;
+            dwError = LW_ERROR_KRB5KDC_ERR_TGT_REVOKED;
+        }
+        else
+        {
+            if (AD_NtStatusIsConnectionError(status))
+            {
+                bIsNetworkError = TRUE;
+            }
+
+            dwError = LW_ERROR_RPC_OPENPOLICY_FAILED;
+        }
+        BAIL_ON_LSA_ERROR(dwError);
+    }
+
+cleanup:
+
+    *ppPolicy = pPolicy;
+    *pbIsNetworkError = bIsNetworkError;
+
+    return dwError;
+
+error:
+
+    if (pPolicy)
+    {
+        AD_NetClosePooledPolicy(pPolicy);
+        pPolicy = NULL;
+    }
+
+    goto cleanup;
+}
+
+/*
+ * Returns a policy to the pool, or closes it if the last call on it
+ * failed or the pool is full.
+ */
+static
+VOID
+AD_NetReleaseLsaPolicy(
+    IN PLSA_AD_PROVIDER_STATE pState,
+    IN PLSA_POOLED_POLICY pPolicy,
+    IN BOOLEAN bReusable
+    )
+{
+    PLSA_POLICY_POOL pPool = pState->hLsaPolicyPool;
+
+    if (!pPolicy)
+    {
+        return;
+    }
+
+    if (bReusable)
+    {
+        pthread_mutex_lock(pPool->pLock);
+
+        if (pPool->dwIdleCount < AD_LSA_POLICY_POOL_MAX_IDLE)
+        {
+            pPolicy->bReused = FALSE;
+            pPolicy->LastUsedTime = time(NULL);
+            pPolicy->pNext = pPool->pIdleList;
+            pPool->pIdleList = pPolicy;
+            pPool->dwIdleCount++;
+            pPolicy = NULL;
+        }
+
+        pthread_mutex_unlock(pPool->pLock);
+    }
+
+    if (pPolicy)
+    {
+        AD_NetClosePooledPolicy(pPolicy);
+    }
+}
+
 DWORD
 AD_NetUserChangePassword(
     PCSTR pszDomainName,
@@ -440,9 +754,8 @@ AD_NetLookupObjectSidsByNames(
     DWORD dwError = 0;
     PWSTR pwcHost = NULL;
     NTSTATUS status = 0;
-    LSA_BINDING lsa_binding = (HANDLE)NULL;
-    DWORD dwAccess_rights = LSA_ACCESS_LOOKUP_NAMES_SIDS;
-    POLICY_HANDLE hPolicy = NULL;
+    PLSA_POOLED_POLICY pPolicy = NULL;
+    BOOLEAN bPolicyReusable = FALSE;
     DWORD dwLevel;
     DWORD dwFoundSidsCount = 0;
     PWSTR* ppwcNames = NULL;
@@ -472,21 +785,6 @@ AD_NetLookupObjectSidsByNames(
     dwError = LwNtStatusToWin32Error(status);
     BAIL_ON_LSA_ERROR(dwError);
 
-    status = LsaInitBindingDefault(&lsa_binding, pwcHost, pCreds);
-    if (status != 0)
-    {
-        LSA_LOG_DEBUG("LsaInitBindingDefault() failed with %u (0x%08x)", status, status);
-        dwError = LW_ERROR_RPC_LSABINDING_FAILED;
-        bIsNetworkError = TRUE;
-        BAIL_ON_LSA_ERROR(dwError);
-    }
-
-    if (lsa_binding == NULL)
-    {
-        dwError = LW_ERROR_RPC_LSABINDING_FAILED;
-        BAIL_ON_LSA_ERROR(dwError);
-    }
-
     // Convert ppszNames to ppwcNames
     dwError = LwAllocateMemory(
                     sizeof(*ppwcNames)*dwNamesCount,
@@ -501,43 +799,54 @@ AD_NetLookupObjectSidsByNames(
         BAIL_ON_LSA_ERROR(dwError);
     }
 
-    status = LsaOpenPolicy2(lsa_binding,
-                            pwcHost,
-                            NULL,
-                            dwAccess_rights,
-                            &hPolicy);
-    if (status != 0)
+    /* Lookup name to sid */
+    dwLevel = 1;
+    for (;;)
     {
-        LSA_LOG_DEBUG("LsaOpenPolicy2() failed with %u (0x%08x)", status, status);
+        dwError = AD_NetAcquireLsaPolicy(
+                      pState,
+                      pszHostname,
+                      pwcHost,
+                      pCreds,
+                      &pPolicy,
+                      &bIsNetworkError);
+        BAIL_ON_LSA_ERROR(dwError);
 
-        if (AD_NtStatusIsTgtRevokedError(status))
+        status = LsaLookupNames2(
+                       pPolicy->hBinding,
+                       pPolicy->hPolicy,
+                       dwNamesCount,
+                       ppwcNames,
+                       &pDomains,
+                       &pSids,
+                       dwLevel,
+                       &dwFoundSidsCount);
+        if (!pPolicy->bReused || !AD_NtStatusIsConnectionError(status))
         {
-            bIsNetworkError = TRUE;
-            dwError = LW_ERROR_KRB5KDC_ERR_TGT_REVOKED;
+            break;
         }
-        else
-        {
-            if (AD_NtStatusIsConnectionError(status))
-            {
-                bIsNetworkError = TRUE;
-            }
 
-            dwError = LW_ERROR_RPC_OPENPOLICY_FAILED;
+        // The pooled connection went stale while idle; retry on a new one.
+        LSA_LOG_DEBUG("LsaLookupNames2() on pooled binding failed with %u (0x%08x), reconnecting",
+                      status, status);
+        if (pDomains)
+        {
+            LsaRpcFreeMemory(pDomains);
+            pDomains = NULL;
         }
-        BAIL_ON_LSA_ERROR(dwError);
+        if (pSids)
+        {
+            LsaRpcFreeMemory(pSids);
+            pSids = NULL;
+        }
+        AD_NetReleaseLsaPolicy(pState, pPolicy, FALSE);
+        pPolicy = NULL;
     }
 
-    /* Lookup name to sid */
-    dwLevel = 1;
-    status = LsaLookupNames2(
-                   lsa_binding,
-                   hPolicy,
-                   dwNamesCount,
-                   ppwcNames,
-                   &pDomains,
-                   &pSids,
-                   dwLevel,
-                   &dwFoundSidsCount);
+    bPolicyReusable = (status == 0 ||
+                       status == LW_STATUS_NONE_MAPPED ||
+                       status == LW_STATUS_SOME_NOT_MAPPED);
+
     if (status != 0)
     {
         if (LW_STATUS_NONE_MAPPED == status)
@@ -676,16 +985,7 @@ cleanup:
         LsaRpcFreeMemory(pSids);
     }
     LW_SAFE_FREE_MEMORY(pObject_sid);
-    status = LsaClose(lsa_binding, hPolicy);
-    if (status != 0 && dwError == 0)
-    {
-        LSA_LOG_DEBUG("LsaClose() failed with %u (0x%08x)", status, status);
-        dwError = LW_ERROR_RPC_CLOSEPOLICY_FAILED;
-    }
-    if (lsa_binding)
-    {
-        LsaFreeBinding(&lsa_binding);
-    }
+    AD_NetReleaseLsaPolicy(pState, pPolicy, bPolicyReusable);
     if (bChangedToken)
     {
         LwIoSetThreadCreds(pOldToken);
@@ -804,9 +1104,8 @@ AD_NetLookupObjectNamesBySids(
     DWORD dwError = 0;
     PWSTR pwcHost = NULL;
     NTSTATUS status = 0;
-    LSA_BINDING lsa_binding = (HANDLE)NULL;
-    DWORD dwAccess_rights = LSA_ACCESS_LOOKUP_NAMES_SIDS;
-    POLICY_HANDLE hPolicy = NULL;
+    PLSA_POOLED_POLICY pPolicy = NULL;
+    BOOLEAN bPolicyReusable = FALSE;
     SID_ARRAY sid_array  = {0};
     DWORD dwLevel = 1;
     DWORD dwFoundNamesCount = 0;
@@ -839,21 +1138,6 @@ AD_NetLookupObjectNamesBySids(
     dwError = LwNtStatusToWin32Error(status);
     BAIL_ON_LSA_ERROR(dwError);
 
-    status = LsaInitBindingDefault(&lsa_binding, pwcHost, pCreds);
-    if (status != 0)
-    {
-        LSA_LOG_DEBUG("LsaInitBindingDefault() failed with %u (0x%08x)", status, status);
-        dwError = LW_ERROR_RPC_LSABINDING_FAILED;
-        bIsNetworkError = TRUE;
-        BAIL_ON_LSA_ERROR(dwError);
-    }
-
-    if (lsa_binding == NULL)
-    {
-        dwError = LW_ERROR_RPC_LSABINDING_FAILED;
-        BAIL_ON_LSA_ERROR(dwError);
-    }
-
     // Convert ppszObjectSids to sid_array
     sid_array.dwNumSids = dwSidsCount;
     dwError = LwAllocateMemory(
@@ -872,41 +1156,52 @@ AD_NetLookupObjectNamesBySids(
         pObjectSID = NULL;
     }
 
-    status = LsaOpenPolicy2(lsa_binding,
-                            pwcHost,
-                            NULL,
-                            dwAccess_rights,
-                            &hPolicy);
-    if (status != 0)
+    /* Lookup sid to name */
+    for (;;)
     {
-        LSA_LOG_DEBUG("LsaOpenPolicy2() failed with %u (0x%08x)", status, status);
+        dwError = AD_NetAcquireLsaPolicy(
+                      pState,
+                      pszHostname,
+                      pwcHost,
+                      pCreds,
+                      &pPolicy,
+                      &bIsNetworkError);
+        BAIL_ON_LSA_ERROR(dwError);
 
-        if (AD_NtStatusIsTgtRevokedError(status))
+        status = LsaLookupSids(
+                       pPolicy->hBinding,
+                       pPolicy->hPolicy,
+                       &sid_array,
+                       &pDomains,
+                       &name_array,
+                       dwLevel,
+                       &dwFoundNamesCount);
+        if (!pPolicy->bReused || !AD_NtStatusIsConnectionError(status))
         {
-            bIsNetworkError = TRUE;
-            dwError = LW_ERROR_KRB5KDC_ERR_TGT_REVOKED;
+            break;
         }
-        else
-        {
-            if (AD_NtStatusIsConnectionError(status))
-            {
-                bIsNetworkError = TRUE;
-            }
 
-            dwError = LW_ERROR_RPC_OPENPOLICY_FAILED;
+        // The pooled connection went stale while idle; retry on a new one.
+        LSA_LOG_DEBUG("LsaLookupSids() on pooled binding failed with %u (0x%08x), reconnecting",
+                      status, status);
+        if (pDomains)
+        {
+            LsaRpcFreeMemory(pDomains);
+            pDomains = NULL;
         }
-        BAIL_ON_LSA_ERROR(dwError);
+        if (name_array)
+        {
+            LsaRpcFreeMemory(name_array);
+            name_array = NULL;
+        }
+        AD_NetReleaseLsaPolicy(pState, pPolicy, FALSE);
+        pPolicy = NULL;
     }
 
-    /* Lookup sid to name */
-    status = LsaLookupSids(
-                   lsa_binding,
-                   hPolicy,
-                   &sid_array,
-                   &pDomains,
-                   &name_array,
-                   dwLevel,
-                   &dwFoundNamesCount);
+    bPolicyReusable = (status == 0 ||
+                       status == LW_STATUS_NONE_MAPPED ||
+                       status == LW_STATUS_SOME_NOT_MAPPED);
+
     if (status != 0)
     {
         if (LW_STATUS_NONE_MAPPED == status)
@@ -1085,16 +1380,7 @@ cleanup:
 
     LW_SAFE_FREE_MEMORY(pObjectSID);
 
-    status = LsaClose(lsa_binding, hPolicy);
-    if (status != 0 && dwError == 0){
-        LSA_LOG_DEBUG("LsaClose() failed with %u (0x%08x)", status, status);
-        dwError = LW_ERROR_RPC_CLOSEPOLICY_FAILED;
-    }
-
-    if (lsa_binding)
-    {
-        LsaFreeBinding(&lsa_binding);
-    }
+    AD_NetReleaseLsaPolicy(pState, pPolicy, bPolicyReusable);
     if (bChangedToken)
     {
         LwIoSetThreadCreds(pOldToken);
@@ -62,6 +62,7 @@ typedef struct _LSA_TRANSLATED_NAME_OR_SID {
 } LSA_TRANSLATED_NAME_OR_SID, *PLSA_TRANSLATED_NAME_OR_SID;
 
 typedef struct _LSA_SCHANNEL_STATE* PLSA_SCHANNEL_STATE;
+typedef struct _LSA_POLICY_POOL* PLSA_POLICY_POOL;
 
 DWORD
 AD_SetSystemAccess(
@@ -79,6 +80,16 @@ AD_NetDestroySchannelState(
     IN PLSA_SCHANNEL_STATE pSchannelState
     );
 
+DWORD
+AD_NetCreateLsaPolicyPool(
+    OUT PLSA_POLICY_POOL* ppPool
+    );
+
+VOID
+AD_NetDestroyLsaPolicyPool(
+    IN PLSA_POLICY_POOL pPool
+    );
+
 DWORD
 AD_NetUserChangePassword(
     PCSTR pszDomainName,
@@ -73,6 +73,7 @@ typedef struct _LSA_AD_CONFIG {
 
     DWORD               dwCacheEntryExpirySecs;
     DWORD               dwCacheSizeCap;
+    DWORD               dwCacheReadConnections;
     BOOLEAN             bEnableEventLog;
     BOOLEAN             bShouldLogNetworkConnectionEvents;
     BOOLEAN             bCreateK5Login;
@@ -99,6 +100,9 @@ typedef struct _LSA_AD_CONFIG {
     BOOLEAN             bNssGroupMembersCacheOnlyEnabled;
     BOOLEAN             bNssUserMembershipCacheOnlyEnabled;
     BOOLEAN             bNssEnumerationEnabled;
+    DWORD               dwBatchDomainParallelism;
+    BOOLEAN             bTokenGroupsMembershipEnabled;
+    BOOLEAN             bTrustPacMembershipEnabled;
     struct {
         DWORD           dwCheckDomainOnlineSeconds;
         DWORD           dwUnknownDomainCacheTimeoutSeconds;
@@ -127,6 +131,10 @@ struct _LSA_SCHANNEL_STATE;
 typedef struct _LSA_SCHANNEL_STATE *LSA_SCHANNEL_STATE_HANDLE;
 typedef struct _LSA_SCHANNEL_STATE **PLSA_SCHANNEL_STATE_HANDLE;
 
+struct _LSA_POLICY_POOL;
+typedef struct _LSA_POLICY_POOL *LSA_POLICY_POOL_HANDLE;
+typedef struct _LSA_POLICY_POOL **PLSA_POLICY_POOL_HANDLE;
+
 struct _LSA_MACHINEPWD_CACHE;
 typedef struct _LSA_MACHINEPWD_CACHE *LSA_MACHINEPWD_CACHE_HANDLE;
 typedef struct _LSA_MACHINEPWD_CACHE **PLSA_MACHINEPWD_CACHE_HANDLE;
@@ -200,6 +208,10 @@ typedef struct _LSA_AD_PROVIDER_STATE {
     LSA_MACHINEPWD_STATE_HANDLE hMachinePwdState;
 
     LSA_SCHANNEL_STATE_HANDLE hSchannelState;
+
+    /// Idle LSA bindings with open policy handles, shared by the
+    /// name/SID lookups.
+    LSA_POLICY_POOL_HANDLE hLsaPolicyPool;
 } LSA_AD_PROVIDER_STATE, *PLSA_AD_PROVIDER_STATE;
 
 typedef struct __AD_PROVIDER_CONTEXT
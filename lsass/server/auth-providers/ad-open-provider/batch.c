@@ -1117,6 +1117,152 @@ error:
     goto cleanup;
 }
 
+typedef struct _LSA_AD_BATCH_DOMAIN_WORK {
+    PAD_PROVIDER_CONTEXT pContext;
+    LSA_AD_BATCH_QUERY_TYPE QueryType;
+    BOOLEAN bResolvePseudoObjects;
+    DWORD dwEntryCount;
+    PLSA_AD_BATCH_DOMAIN_ENTRY* ppEntries;
+    // Result of each entry's lookup, in domain list order
+    PDWORD pdwErrors;
+    // Next entry to pick up, protected by Mutex
+    DWORD dwNextEntry;
+    pthread_mutex_t Mutex;
+} LSA_AD_BATCH_DOMAIN_WORK, *PLSA_AD_BATCH_DOMAIN_WORK;
+
+static
+VOID
+LsaAdBatchRunDomainWork(
+    IN OUT PLSA_AD_BATCH_DOMAIN_WORK pWork
+    )
+{
+    DWORD dwIndex = 0;
+
+    for (;;)
+    {
+        pthread_mutex_lock(&pWork->Mutex);
+        dwIndex = pWork->dwNextEntry++;
+        pthread_mutex_unlock(&pWork->Mutex);
+
+        if (dwIndex >= pWork->dwEntryCount)
+        {
+            break;
+        }
+
+        pWork->pdwErrors[dwIndex] = LsaAdBatchFindObjectsForDomainEntry(
+                                        pWork->pContext,
+                                        pWork->QueryType,
+                                        pWork->bResolvePseudoObjects,
+                                        pWork->ppEntries[dwIndex]);
+    }
+}
+
+static
+PVOID
+LsaAdBatchDomainWorkThread(
+    IN PVOID pData
+    )
+{
+    DWORD dwError = 0;
+    PLSA_AD_BATCH_DOMAIN_WORK pWork = (PLSA_AD_BATCH_DOMAIN_WORK)pData;
+
+    // The krb5 cache path is per thread.  Use the machine credentials
+    // of this provider instance, as the calling thread does.
+    dwError = LwKrb5SetThreadDefaultCachePath(
+                  pWork->pContext->pState->MachineCreds.pszCachePath,
+                  NULL);
+    if (dwError)
+    {
+        // The calling thread picks up the entries this one would have
+        // looked up.
+        LSA_LOG_DEBUG("Could not set credentials cache for batch domain "
+                      "lookup thread (error = %u)", dwError);
+        goto cleanup;
+    }
+
+    LsaAdBatchRunDomainWork(pWork);
+
+    LwKrb5SetThreadDefaultCachePath(NULL, NULL);
+
+cleanup:
+    return NULL;
+}
+
+// Looks up every entry in ppEntries, querying up to the configured
+// number of domains at once.  Each domain entry owns its batch item
+// list, so the lookups do not share any state.  The calling thread
+// takes part, so no threads are started for a single domain.
+static
+DWORD
+LsaAdBatchFindObjectsForDomainEntries(
+    IN PAD_PROVIDER_CONTEXT pContext,
+    IN LSA_AD_BATCH_QUERY_TYPE QueryType,
+    IN BOOLEAN bResolvePseudoObjects,
+    IN DWORD dwEntryCount,
+    IN PLSA_AD_BATCH_DOMAIN_ENTRY* ppEntries,
+    OUT PDWORD pdwErrors
+    )
+{
+    DWORD dwError = 0;
+    LSA_AD_BATCH_DOMAIN_WORK work = { 0 };
+    pthread_t* pThreads = NULL;
+    DWORD dwThreadCount = 0;
+    DWORD dwStarted = 0;
+    DWORD i = 0;
+
+    work.pContext = pContext;
+    work.QueryType = QueryType;
+    work.bResolvePseudoObjects = bResolvePseudoObjects;
+    work.dwEntryCount = dwEntryCount;
+    work.ppEntries = ppEntries;
+    work.pdwErrors = pdwErrors;
+
+    dwError = LwMapErrnoToLwError(pthread_mutex_init(&work.Mutex, NULL));
+    BAIL_ON_LSA_ERROR(dwError);
+
+    dwThreadCount = LSA_MIN(AD_GetBatchDomainParallelism(pContext->pState),
+                            dwEntryCount);
+    if (dwThreadCount > 1)
+    {
+        dwThreadCount--;
+
+        dwError = LwAllocateMemory(
+                        sizeof(*pThreads) * dwThreadCount,
+                        (PVOID*)&pThreads);
+        BAIL_ON_LSA_ERROR(dwError);
+
+        for (dwStarted = 0; dwStarted < dwThreadCount; dwStarted++)
+        {
+            if (pthread_create(&pThreads[dwStarted],
+                               NULL,
+                               LsaAdBatchDomainWorkThread,
+                               &work))
+            {
+                // The threads already running and this one pick up
+                // the rest.
+                LSA_LOG_DEBUG("Could not start batch domain lookup thread");
+                break;
+            }
+        }
+    }
+
+    LsaAdBatchRunDomainWork(&work);
+
+    for (i = 0; i < dwStarted; i++)
+    {
+        pthread_join(pThreads[i], NULL);
+    }
+
+    pthread_mutex_destroy(&work.Mutex);
+
+cleanup:
+    LW_SAFE_FREE_MEMORY(pThreads);
+    return dwError;
+
+error:
+    goto cleanup;
+}
+
 static
 DWORD
 LsaAdBatchResolveObjectsForDomainList(
@@ -1140,7 +1286,29 @@ LsaAdBatchResolveObjectsForDomainList(
     DWORD dwOfflineDomains = 0;
     PSTR *ppszOfflineDomains = NULL;
     DWORD dwOfflineDomainsIndex = 0;
+    PLSA_AD_BATCH_DOMAIN_ENTRY* ppEntries = NULL;
+    PDWORD pdwEntryErrors = NULL;
+    DWORD dwEntryCount = 0;
+    DWORD i = 0;
 
+    for (pLinks = pDomainList->Next;
+         pLinks != pDomainList;
+         pLinks = pLinks->Next)
+    {
+        dwEntryCount++;
+    }
+
+    dwError = LwAllocateMemory(
+                dwEntryCount * sizeof(*ppEntries),
+                (PVOID*)&ppEntries);
+    BAIL_ON_LSA_ERROR(dwError);
+
+    dwError = LwAllocateMemory(
+                dwEntryCount * sizeof(*pdwEntryErrors),
+                (PVOID*)&pdwEntryErrors);
+    BAIL_ON_LSA_ERROR(dwError);
+
+    dwEntryCount = 0;
     for (pLinks = pDomainList->Next;
          pLinks != pDomainList;
          pLinks = pLinks->Next)
@@ -1152,11 +1320,25 @@ LsaAdBatchResolveObjectsForDomainList(
             continue;
         }
 
-        dwError = LsaAdBatchFindObjectsForDomainEntry(
-                      pContext,
-                      QueryType,
-                      bResolvePseudoObjects,
-                      pEntry);
+        ppEntries[dwEntryCount++] = pEntry;
+    }
+
+    dwError = LsaAdBatchFindObjectsForDomainEntries(
+                  pContext,
+                  QueryType,
+                  bResolvePseudoObjects,
+                  dwEntryCount,
+                  ppEntries,
+                  pdwEntryErrors);
+    BAIL_ON_LSA_ERROR(dwError);
+
+    // Look at the results in domain list order so that the error
+    // reported does not depend on which lookup finished first.
+    for (i = 0; i < dwEntryCount; i++)
+    {
+        PLSA_AD_BATCH_DOMAIN_ENTRY pEntry = ppEntries[i];
+
+        dwError = pdwEntryErrors[i];
         if (dwError == LW_ERROR_DOMAIN_IS_OFFLINE)
         {
             SetFlag(pEntry->Flags, LSA_AD_BATCH_DOMAIN_ENTRY_FLAG_OFFLINE);
@@ -1243,6 +1425,8 @@ LsaAdBatchResolveObjectsForDomainList(
     *pppszOfflineDomains = ppszOfflineDomains;
 
 cleanup:
+    LW_SAFE_FREE_MEMORY(ppEntries);
+    LW_SAFE_FREE_MEMORY(pdwEntryErrors);
     return dwError;
 
 error:
@@ -2078,7 +2262,13 @@ LsaAdBatchResolveRealObjects(
     PLSA_DM_LDAP_CONNECTION pConn = NULL;
     LDAP* pLd = NULL;
     PSTR pszScopeDn = NULL;
-    PSTR pszQuery = 0;
+    PSTR ppszQueries[LSA_AD_BATCH_MAX_OUTSTANDING_QUERIES] = { NULL };
+    LDAPMessage* ppMessages[LSA_AD_BATCH_MAX_OUTSTANDING_QUERIES] = { NULL };
+    PLSA_LIST_LINKS ppFirstLinks[LSA_AD_BATCH_MAX_OUTSTANDING_QUERIES] = { NULL };
+    PLSA_LIST_LINKS ppEndLinks[LSA_AD_BATCH_MAX_OUTSTANDING_QUERIES] = { NULL };
+    DWORD pdwQueryCounts[LSA_AD_BATCH_MAX_OUTSTANDING_QUERIES] = { 0 };
+    DWORD dwQueries = 0;
+    DWORD i = 0;
     PSTR szAttributeList[] =
     {
         // AD attributes:
@@ -2109,11 +2299,10 @@ LsaAdBatchResolveRealObjects(
         AD_LDAP_LOCALWINDOWSHOMEFOLDER_TAG,
         NULL
     };
-    LDAPMessage* pMessage = NULL;
     PLSA_LIST_LINKS pLinks = NULL;
-    PLSA_LIST_LINKS pNextLinks = NULL;
     DWORD dwMaxQuerySize = LsaAdBatchGetMaxQuerySize();
-    DWORD dwMaxQueryCount = LsaAdBatchGetMaxQueryCount();
+    DWORD dwMaxQueryCount = LSA_MIN(LsaAdBatchGetMaxQueryCount(),
+                                    LSA_AD_BATCH_PIPELINED_QUERY_COUNT);
 
     dwError = LwLdapConvertDomainToDN(
                        pszDnsDomainName,
@@ -2126,83 +2315,101 @@ LsaAdBatchResolveRealObjects(
                   &pConn);
     BAIL_ON_LSA_ERROR(dwError);
 
-    for (pLinks = pBatchItemList->Next;
-         pLinks != pBatchItemList;
-         pLinks = pNextLinks)
+    pLinks = pBatchItemList->Next;
+    while (pLinks != pBatchItemList)
     {
-        DWORD dwQueryCount = 0;
-        DWORD dwCount = 0;
-        LDAPMessage* pCurrentMessage = NULL;
-
-        pNextLinks = NULL;
-
-        LW_SAFE_FREE_STRING(pszQuery);
-        if (pMessage)
+        for (i = 0; i < dwQueries; i++)
         {
-            ldap_msgfree(pMessage);
-            pMessage = NULL;
+            LW_SAFE_FREE_STRING(ppszQueries[i]);
+            if (ppMessages[i])
+            {
+                ldap_msgfree(ppMessages[i]);
+                ppMessages[i] = NULL;
+            }
         }
 
-        dwError = LsaAdBatchBuildQueryForReal(
-                        pState->pProviderData,
-                        QueryType,
-                        pLinks,
-                        pBatchItemList,
-                        &pNextLinks,
-                        dwMaxQuerySize,
-                        dwMaxQueryCount,
-                        &dwQueryCount,
-                        &pszQuery);
-        BAIL_ON_LSA_ERROR(dwError);
+        // Build a window of queries and send them all before waiting
+        // on any of the results.
+        for (dwQueries = 0;
+             dwQueries < LSA_AD_BATCH_MAX_OUTSTANDING_QUERIES &&
+             pLinks != pBatchItemList;
+             dwQueries++)
+        {
+            ppFirstLinks[dwQueries] = pLinks;
 
-        dwError = LsaDmLdapDirectorySearch(
+            dwError = LsaAdBatchBuildQueryForReal(
+                            pState->pProviderData,
+                            QueryType,
+                            pLinks,
+                            pBatchItemList,
+                            &ppEndLinks[dwQueries],
+                            dwMaxQuerySize,
+                            dwMaxQueryCount,
+                            &pdwQueryCounts[dwQueries],
+                            &ppszQueries[dwQueries]);
+            BAIL_ON_LSA_ERROR(dwError);
+
+            pLinks = ppEndLinks[dwQueries];
+        }
+
+        dwError = LsaDmLdapDirectorySearchMany(
                         pConn,
                         pszScopeDn,
                         LDAP_SCOPE_SUBTREE,
-                        pszQuery,
+                        dwQueries,
+                        ppszQueries,
                         szAttributeList,
                         &hDirectory,
-                        &pMessage);
+                        ppMessages);
         BAIL_ON_LSA_ERROR(dwError);
 
         pLd = LwLdapGetSession(hDirectory);
 
-        dwCount = ldap_count_entries(pLd, pMessage);
-        if (dwCount > dwQueryCount)
+        for (i = 0; i < dwQueries; i++)
         {
-            LSA_LOG_ERROR("Too many results returned (got %u, expected %u)",
-                          dwCount, dwQueryCount);
-            dwError = LW_ERROR_LDAP_ERROR;
-            BAIL_ON_LSA_ERROR(dwError);
-        }
-        else if (dwCount == 0)
-        {
-            continue;
-        }
+            DWORD dwCount = 0;
+            LDAPMessage* pCurrentMessage = NULL;
 
-        pCurrentMessage = ldap_first_entry(pLd, pMessage);
-        while (pCurrentMessage)
-        {
-            dwError = LsaAdBatchProcessRealObject(
-                            pState->pProviderData,
-                            QueryType,
-                            pLinks,
-                            pNextLinks,
-                            hDirectory,
-                            pCurrentMessage);
-            BAIL_ON_LSA_ERROR(dwError);
+            dwCount = ldap_count_entries(pLd, ppMessages[i]);
+            if (dwCount > pdwQueryCounts[i])
+            {
+                LSA_LOG_ERROR("Too many results returned (got %u, expected %u)",
+                              dwCount, pdwQueryCounts[i]);
+                dwError = LW_ERROR_LDAP_ERROR;
+                BAIL_ON_LSA_ERROR(dwError);
+            }
+            else if (dwCount == 0)
+            {
+                continue;
+            }
 
-            pCurrentMessage = ldap_next_entry(pLd, pCurrentMessage);
+            pCurrentMessage = ldap_first_entry(pLd, ppMessages[i]);
+            while (pCurrentMessage)
+            {
+                dwError = LsaAdBatchProcessRealObject(
+                                pState->pProviderData,
+                                QueryType,
+                                ppFirstLinks[i],
+                                ppEndLinks[i],
+                                hDirectory,
+                                pCurrentMessage);
+                BAIL_ON_LSA_ERROR(dwError);
+
+                pCurrentMessage = ldap_next_entry(pLd, pCurrentMessage);
+            }
         }
     }
 
 cleanup:
     LsaDmLdapClose(pConn);
     LW_SAFE_FREE_STRING(pszScopeDn);
-    LW_SAFE_FREE_STRING(pszQuery);
-    if (pMessage)
+    for (i = 0; i < LSA_AD_BATCH_MAX_OUTSTANDING_QUERIES; i++)
     {
-        ldap_msgfree(pMessage);
+        LW_SAFE_FREE_STRING(ppszQueries[i]);
+        if (ppMessages[i])
+        {
+            ldap_msgfree(ppMessages[i]);
+        }
     }
     return dwError;
 
@@ -2781,7 +2988,14 @@ LsaAdBatchResolvePseudoObjectsInternalDefaultSchema(
     PLSA_AD_PROVIDER_STATE pState = pContext->pState;
     HANDLE hDirectory = NULL;
     LDAP* pLd = NULL;
-    PSTR pszQuery = 0;
+    PSTR ppszQueries[LSA_AD_BATCH_MAX_OUTSTANDING_QUERIES] = { NULL };
+    LDAPMessage* ppMessages[LSA_AD_BATCH_MAX_OUTSTANDING_QUERIES] = { NULL };
+    PLSA_LIST_LINKS ppFirstLinks[LSA_AD_BATCH_MAX_OUTSTANDING_QUERIES] = { NULL };
+    PLSA_LIST_LINKS ppEndLinks[LSA_AD_BATCH_MAX_OUTSTANDING_QUERIES] = { NULL };
+    DWORD pdwQueryCounts[LSA_AD_BATCH_MAX_OUTSTANDING_QUERIES] = { 0 };
+    DWORD dwQueries = 0;
+    BOOLEAN bLastWindow = FALSE;
+    DWORD i = 0;
     PSTR szAttributeList[] =
     {
         AD_LDAP_OBJECTCLASS_TAG,
@@ -2805,11 +3019,10 @@ LsaAdBatchResolvePseudoObjectsInternalDefaultSchema(
         AD_LDAP_LOCALWINDOWSHOMEFOLDER_TAG,
         NULL
     };
-    LDAPMessage* pMessage = NULL;
     PLSA_LIST_LINKS pLinks = NULL;
-    PLSA_LIST_LINKS pNextLinks = NULL;
     DWORD dwMaxQuerySize = LsaAdBatchGetMaxQuerySize();
-    DWORD dwMaxQueryCount = LsaAdBatchGetMaxQueryCount();
+    DWORD dwMaxQueryCount = LSA_MIN(LsaAdBatchGetMaxQueryCount(),
+                                    LSA_AD_BATCH_PIPELINED_QUERY_COUNT);
     DWORD dwTotalItemFoundCount = 0;
     PLSA_DM_LDAP_CONNECTION pConn = NULL;
     PSTR pszDomainDN = NULL;
@@ -2830,85 +3043,106 @@ LsaAdBatchResolvePseudoObjectsInternalDefaultSchema(
                                        &pszDomainDN);
     BAIL_ON_LSA_ERROR(dwError);
 
-    for (pLinks = pBatchItemList->Next;
-         pLinks != pBatchItemList;
-         pLinks = pNextLinks)
+    pLinks = pBatchItemList->Next;
+    while (!bLastWindow && pLinks != pBatchItemList)
     {
-        DWORD dwQueryCount = 0;
-        DWORD dwCount = 0;
-        LDAPMessage* pCurrentMessage = NULL;
-
-        pNextLinks = NULL;
-
-        LW_SAFE_FREE_STRING(pszQuery);
-        if (pMessage)
+        for (i = 0; i < dwQueries; i++)
         {
-            ldap_msgfree(pMessage);
-            pMessage = NULL;
+            LW_SAFE_FREE_STRING(ppszQueries[i]);
+            if (ppMessages[i])
+            {
+                ldap_msgfree(ppMessages[i]);
+                ppMessages[i] = NULL;
+            }
         }
 
-        dwError = LsaAdBatchBuildQueryForPseudoDefaultSchema(
-                        pState->pProviderData,
-                        QueryType,
-                        pLinks,
-                        pBatchItemList,
-                        &pNextLinks,
-                        dwMaxQuerySize,
-                        dwMaxQueryCount,
-                        &dwQueryCount,
-                        &pszQuery);
-        BAIL_ON_LSA_ERROR(dwError);
+        // Build a window of queries and send them all before waiting
+        // on any of the results.
+        for (dwQueries = 0;
+             dwQueries < LSA_AD_BATCH_MAX_OUTSTANDING_QUERIES &&
+             pLinks != pBatchItemList;
+             dwQueries++)
+        {
+            ppFirstLinks[dwQueries] = pLinks;
+
+            dwError = LsaAdBatchBuildQueryForPseudoDefaultSchema(
+                            pState->pProviderData,
+                            QueryType,
+                            pLinks,
+                            pBatchItemList,
+                            &ppEndLinks[dwQueries],
+                            dwMaxQuerySize,
+                            dwMaxQueryCount,
+                            &pdwQueryCounts[dwQueries],
+                            &ppszQueries[dwQueries]);
+            BAIL_ON_LSA_ERROR(dwError);
 
-        if (LW_IS_NULL_OR_EMPTY_STR(pszQuery))
+            if (LW_IS_NULL_OR_EMPTY_STR(ppszQueries[dwQueries]))
+            {
+                LW_SAFE_FREE_STRING(ppszQueries[dwQueries]);
+                bLastWindow = TRUE;
+                break;
+            }
+
+            pLinks = ppEndLinks[dwQueries];
+        }
+
+        if (!dwQueries)
         {
             break;
         }
 
-        dwError = LsaDmLdapDirectorySearch(
+        dwError = LsaDmLdapDirectorySearchMany(
                         pConn,
                         pszDomainDN,
                         LDAP_SCOPE_SUBTREE,
-                        pszQuery,
+                        dwQueries,
+                        ppszQueries,
                         szAttributeList,
                         &hDirectory,
-                        &pMessage);
+                        ppMessages);
         BAIL_ON_LSA_ERROR(dwError);
 
         pLd = LwLdapGetSession(hDirectory);
 
-        dwCount = ldap_count_entries(pLd, pMessage);
-        if (dwCount > dwQueryCount)
+        for (i = 0; i < dwQueries; i++)
         {
-            LSA_LOG_ERROR("Too many results returned (got %u, expected %u)",
-                          dwCount, dwQueryCount);
-            dwError = LW_ERROR_LDAP_ERROR;
-            BAIL_ON_LSA_ERROR(dwError);
-        }
-        else if (dwCount == 0)
-        {
-            continue;
-        }
+            DWORD dwCount = 0;
+            LDAPMessage* pCurrentMessage = NULL;
 
-        dwCount = 0;
+            dwCount = ldap_count_entries(pLd, ppMessages[i]);
+            if (dwCount > pdwQueryCounts[i])
+            {
+                LSA_LOG_ERROR("Too many results returned (got %u, expected %u)",
+                              dwCount, pdwQueryCounts[i]);
+                dwError = LW_ERROR_LDAP_ERROR;
+                BAIL_ON_LSA_ERROR(dwError);
+            }
+            else if (dwCount == 0)
+            {
+                continue;
+            }
 
-        pCurrentMessage = ldap_first_entry(pLd, pMessage);
-        while (pCurrentMessage)
-        {
-            dwError = LsaAdBatchProcessPseudoObjectDefaultSchema(
-                            QueryType,
-                            pLinks,
-                            pNextLinks,
-                            hDirectory,
-                            pCurrentMessage);
-            BAIL_ON_LSA_ERROR(dwError);
-            dwCount++;
+            dwCount = 0;
 
-            pCurrentMessage = ldap_next_entry(pLd, pCurrentMessage);
-        }
+            pCurrentMessage = ldap_first_entry(pLd, ppMessages[i]);
+            while (pCurrentMessage)
+            {
+                dwError = LsaAdBatchProcessPseudoObjectDefaultSchema(
+                                QueryType,
+                                ppFirstLinks[i],
+                                ppEndLinks[i],
+                                hDirectory,
+                                pCurrentMessage);
+                BAIL_ON_LSA_ERROR(dwError);
+                dwCount++;
 
-        dwTotalItemFoundCount += dwCount;
-    }
+                pCurrentMessage = ldap_next_entry(pLd, pCurrentMessage);
+            }
 
+            dwTotalItemFoundCount += dwCount;
+        }
+    }
 
     if (pdwTotalItemFoundCount)
     {
@@ -2917,11 +3151,14 @@ LsaAdBatchResolvePseudoObjectsInternalDefaultSchema(
 
 cleanup:
     LsaDmLdapClose(pConn);
-    LW_SAFE_FREE_STRING(pszQuery);
     LW_SAFE_FREE_STRING(pszDomainDN);
-    if (pMessage)
+    for (i = 0; i < LSA_AD_BATCH_MAX_OUTSTANDING_QUERIES; i++)
     {
-        ldap_msgfree(pMessage);
+        LW_SAFE_FREE_STRING(ppszQueries[i]);
+        if (ppMessages[i])
+        {
+            ldap_msgfree(ppMessages[i]);
+        }
     }
     return dwError;
 
@@ -2953,7 +3190,14 @@ LsaAdBatchResolvePseudoObjectsInternalDefaultOrCell(
     HANDLE hDirectory = NULL;
     LDAP* pLd = NULL;
     PSTR pszScopeDn = NULL;
-    PSTR pszQuery = 0;
+    PSTR ppszQueries[LSA_AD_BATCH_MAX_OUTSTANDING_QUERIES] = { NULL };
+    LDAPMessage* ppMessages[LSA_AD_BATCH_MAX_OUTSTANDING_QUERIES] = { NULL };
+    PLSA_LIST_LINKS ppFirstLinks[LSA_AD_BATCH_MAX_OUTSTANDING_QUERIES] = { NULL };
+    PLSA_LIST_LINKS ppEndLinks[LSA_AD_BATCH_MAX_OUTSTANDING_QUERIES] = { NULL };
+    DWORD pdwQueryCounts[LSA_AD_BATCH_MAX_OUTSTANDING_QUERIES] = { 0 };
+    DWORD dwQueries = 0;
+    BOOLEAN bLastWindow = FALSE;
+    DWORD i = 0;
     PSTR szAttributeList[] =
     {
         // AD attributes:
@@ -2993,11 +3237,10 @@ LsaAdBatchResolvePseudoObjectsInternalDefaultOrCell(
         AD_LDAP_LOCALWINDOWSHOMEFOLDER_TAG,
         NULL
     };
-    LDAPMessage* pMessage = NULL;
     PLSA_LIST_LINKS pLinks = NULL;
-    PLSA_LIST_LINKS pNextLinks = NULL;
     DWORD dwMaxQuerySize = LsaAdBatchGetMaxQuerySize();
-    DWORD dwMaxQueryCount = LsaAdBatchGetMaxQueryCount();
+    DWORD dwMaxQueryCount = LSA_MIN(LsaAdBatchGetMaxQueryCount(),
+                                    LSA_AD_BATCH_PIPELINED_QUERY_COUNT);
     PSTR pszDomainName = NULL;
     DWORD dwTotalItemFoundCount = 0;
     PSTR pUserPseudoDN = NULL;
@@ -3045,110 +3288,132 @@ LsaAdBatchResolvePseudoObjectsInternalDefaultOrCell(
         BAIL_ON_LSA_ERROR(dwError);
     }
 
-    for (pLinks = pBatchItemList->Next;
-         pLinks != pBatchItemList;
-         pLinks = pNextLinks)
+    pLinks = pBatchItemList->Next;
+    while (!bLastWindow && pLinks != pBatchItemList)
     {
-        DWORD dwQueryCount = 0;
-        DWORD dwFoundCount = 0;
-        LDAPMessage* pCurrentMessage = NULL;
-
-        pNextLinks = NULL;
-
-        LW_SAFE_FREE_STRING(pszQuery);
-        if (pMessage)
+        for (i = 0; i < dwQueries; i++)
         {
-            ldap_msgfree(pMessage);
-            pMessage = NULL;
+            LW_SAFE_FREE_STRING(ppszQueries[i]);
+            if (ppMessages[i])
+            {
+                ldap_msgfree(ppMessages[i]);
+                ppMessages[i] = NULL;
+            }
         }
 
-        dwError = LsaAdBatchBuildQueryForPseudo(
-                        pState->pProviderData,
-                        (adMode == SchemaMode),
-                        QueryType,
-                        pLinks,
-                        pBatchItemList,
-                        &pNextLinks,
-                        dwMaxQuerySize,
-                        dwMaxQueryCount,
-                        &dwQueryCount,
-                        &pszQuery);
-        BAIL_ON_LSA_ERROR(dwError);
+        // Build a window of queries and send them all before waiting
+        // on any of the results.
+        for (dwQueries = 0;
+             dwQueries < LSA_AD_BATCH_MAX_OUTSTANDING_QUERIES &&
+             pLinks != pBatchItemList;
+             dwQueries++)
+        {
+            ppFirstLinks[dwQueries] = pLinks;
 
-        if (LW_IS_NULL_OR_EMPTY_STR(pszQuery))
+            dwError = LsaAdBatchBuildQueryForPseudo(
+                            pState->pProviderData,
+                            (adMode == SchemaMode),
+                            QueryType,
+                            pLinks,
+                            pBatchItemList,
+                            &ppEndLinks[dwQueries],
+                            dwMaxQuerySize,
+                            dwMaxQueryCount,
+                            &pdwQueryCounts[dwQueries],
+                            &ppszQueries[dwQueries]);
+            BAIL_ON_LSA_ERROR(dwError);
+
+            if (LW_IS_NULL_OR_EMPTY_STR(ppszQueries[dwQueries]))
+            {
+                LW_SAFE_FREE_STRING(ppszQueries[dwQueries]);
+                bLastWindow = TRUE;
+                break;
+            }
+
+            pLinks = ppEndLinks[dwQueries];
+        }
+
+        if (!dwQueries)
         {
             break;
         }
 
-        dwError = LsaDmLdapDirectorySearch(
+        dwError = LsaDmLdapDirectorySearchMany(
                         pConn,
                         pszScopeDn,
                         LDAP_SCOPE_SUBTREE,
-                        pszQuery,
+                        dwQueries,
+                        ppszQueries,
                         szAttributeList,
                         &hDirectory,
-                        &pMessage);
+                        ppMessages);
         BAIL_ON_LSA_ERROR(dwError);
 
         pLd = LwLdapGetSession(hDirectory);
 
-        dwFoundCount = ldap_count_entries(pLd, pMessage);
-        // In Default Non-schema mode, we might get entries in non-default cells due to the GC search
-        // Hence, dwCount can be more than dwQueryCount
-        if (!(NonSchemaMode == adMode && bDoGCSearch) &&
-             dwFoundCount > dwQueryCount)
+        for (i = 0; i < dwQueries; i++)
         {
-            LSA_LOG_ERROR("Too many results returned (got %u, expected %u)",
-                          dwFoundCount, dwQueryCount);
-        }
-        else if (dwFoundCount == 0)
-        {
-            continue;
-        }
+            DWORD dwFoundCount = 0;
+            LDAPMessage* pCurrentMessage = NULL;
+
+            dwFoundCount = ldap_count_entries(pLd, ppMessages[i]);
+            // In Default Non-schema mode, we might get entries in non-default cells due to the GC search
+            // Hence, dwCount can be more than dwQueryCount
+            if (!(NonSchemaMode == adMode && bDoGCSearch) &&
+                 dwFoundCount > pdwQueryCounts[i])
+            {
+                LSA_LOG_ERROR("Too many results returned (got %u, expected %u)",
+                              dwFoundCount, pdwQueryCounts[i]);
+            }
+            else if (dwFoundCount == 0)
+            {
+                continue;
+            }
 
-        dwFoundCount = 0;
+            dwFoundCount = 0;
 
-        pCurrentMessage = ldap_first_entry(pLd, pMessage);
-        while (pCurrentMessage)
-        {
-            // Default Non-schema mode doing a GC search
-            if (NonSchemaMode == adMode && bDoGCSearch)
+            pCurrentMessage = ldap_first_entry(pLd, ppMessages[i]);
+            while (pCurrentMessage)
             {
-                LW_SAFE_FREE_STRING(pUserPseudoDN);
+                // Default Non-schema mode doing a GC search
+                if (NonSchemaMode == adMode && bDoGCSearch)
+                {
+                    LW_SAFE_FREE_STRING(pUserPseudoDN);
 
-                dwError = LwLdapGetDN(
-                             hDirectory,
-                             pCurrentMessage,
-                             &pUserPseudoDN);
-                BAIL_ON_LSA_ERROR(dwError);
+                    dwError = LwLdapGetDN(
+                                 hDirectory,
+                                 pCurrentMessage,
+                                 &pUserPseudoDN);
+                    BAIL_ON_LSA_ERROR(dwError);
 
-                LwStrToUpper(pUserPseudoDN);
+                    LwStrToUpper(pUserPseudoDN);
 
-                // Make sure the found pseudo object is enabled in default cell;
-                // Otherwise, skip this pCurrentMessage
-                if (!strstr(pUserPseudoDN, ",CN=$LIKEWISEIDENTITYCELL,DC="))
-                {
-                    pCurrentMessage = ldap_next_entry(pLd, pCurrentMessage);
-                    continue;
+                    // Make sure the found pseudo object is enabled in default cell;
+                    // Otherwise, skip this pCurrentMessage
+                    if (!strstr(pUserPseudoDN, ",CN=$LIKEWISEIDENTITYCELL,DC="))
+                    {
+                        pCurrentMessage = ldap_next_entry(pLd, pCurrentMessage);
+                        continue;
+                    }
                 }
-            }
 
-            dwError = LsaAdBatchProcessPseudoObject(
-                            pState->pProviderData,
-                            QueryType,
-                            pLinks,
-                            pNextLinks,
-                            &dwFoundCount,
-                            bDoGCSearch,
-                            (adMode == SchemaMode),
-                            hDirectory,
-                            pCurrentMessage);
-            BAIL_ON_LSA_ERROR(dwError);
+                dwError = LsaAdBatchProcessPseudoObject(
+                                pState->pProviderData,
+                                QueryType,
+                                ppFirstLinks[i],
+                                ppEndLinks[i],
+                                &dwFoundCount,
+                                bDoGCSearch,
+                                (adMode == SchemaMode),
+                                hDirectory,
+                                pCurrentMessage);
+                BAIL_ON_LSA_ERROR(dwError);
 
-            pCurrentMessage = ldap_next_entry(pLd, pCurrentMessage);
-        }
+                pCurrentMessage = ldap_next_entry(pLd, pCurrentMessage);
+            }
 
-        dwTotalItemFoundCount += dwFoundCount;
+            dwTotalItemFoundCount += dwFoundCount;
+        }
     }
 
     if (pdwTotalItemFoundCount)
@@ -3160,11 +3425,14 @@ cleanup:
     LsaDmLdapClose(pConn);
     LW_SAFE_FREE_STRING(pszDomainName);
     LW_SAFE_FREE_STRING(pszScopeDn);
-    LW_SAFE_FREE_STRING(pszQuery);
     LW_SAFE_FREE_STRING(pUserPseudoDN);
-    if (pMessage)
+    for (i = 0; i < LSA_AD_BATCH_MAX_OUTSTANDING_QUERIES; i++)
     {
-        ldap_msgfree(pMessage);
+        LW_SAFE_FREE_STRING(ppszQueries[i]);
+        if (ppMessages[i])
+        {
+            ldap_msgfree(ppMessages[i]);
+        }
     }
     return dwError;
 
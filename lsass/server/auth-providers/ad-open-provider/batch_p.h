@@ -51,6 +51,11 @@
 // zero means unlimited
 #define LSA_AD_BATCH_MAX_QUERY_SIZE 0
 #define LSA_AD_BATCH_MAX_QUERY_COUNT 1000
+// Batch lookups are split into smaller queries that are sent together
+// on the batch's own connection, so the DC can work on them concurrently.
+// Only the queries of one batch share a connection.
+#define LSA_AD_BATCH_PIPELINED_QUERY_COUNT 200
+#define LSA_AD_BATCH_MAX_OUTSTANDING_QUERIES 8
 
 typedef DWORD LSA_PROVISIONING_MODE, *PLSA_PROVISIONING_MODE;
 #define LSA_PROVISIONING_MODE_DEFAULT_CELL     1
@@ -3535,6 +3535,138 @@ error:
     goto cleanup;
 }
 
+static
+DWORD
+LsaDmpLdapDirectorySearchMany(
+    IN HANDLE hDirectory,
+    IN PCSTR pszObjectDN,
+    IN int scope,
+    IN DWORD dwQueryCount,
+    IN PSTR* ppszQueries,
+    IN PSTR* ppszAttributeList,
+    OUT LDAPMessage** ppMessages
+    )
+{
+    DWORD dwError = 0;
+    int* pMessageIds = NULL;
+    DWORD dwStarted = 0;
+    DWORD dwFinished = 0;
+    DWORD i = 0;
+
+    dwError = LwAllocateMemory(
+                    sizeof(*pMessageIds) * dwQueryCount,
+                    (PVOID*)&pMessageIds);
+    BAIL_ON_LSA_ERROR(dwError);
+
+    for (dwStarted = 0; dwStarted < dwQueryCount; dwStarted++)
+    {
+        dwError = LwLdapDirectorySearchAsync(
+                        hDirectory,
+                        pszObjectDN,
+                        scope,
+                        ppszQueries[dwStarted],
+                        ppszAttributeList,
+                        &pMessageIds[dwStarted]);
+        BAIL_ON_LSA_ERROR(dwError);
+    }
+
+    while (dwFinished < dwQueryCount)
+    {
+        dwError = LwLdapDirectorySearchWait(
+                        hDirectory,
+                        pMessageIds[dwFinished],
+                        &ppMessages[dwFinished]);
+        dwFinished++;
+        BAIL_ON_LSA_ERROR(dwError);
+    }
+
+cleanup:
+
+    LW_SAFE_FREE_MEMORY(pMessageIds);
+
+    return dwError;
+
+error:
+
+    // Searches that were started but not collected are abandoned.
+    for (i = dwFinished; i < dwStarted; i++)
+    {
+        LwLdapDirectorySearchAbandon(hDirectory, pMessageIds[i]);
+    }
+
+    for (i = 0; i < dwQueryCount; i++)
+    {
+        if (ppMessages[i])
+        {
+            ldap_msgfree(ppMessages[i]);
+            ppMessages[i] = NULL;
+        }
+    }
+
+    goto cleanup;
+}
+
+DWORD
+LsaDmLdapDirectorySearchMany(
+    IN PLSA_DM_LDAP_CONNECTION pConn,
+    IN PCSTR pszObjectDN,
+    IN int scope,
+    IN DWORD dwQueryCount,
+    IN PSTR* ppszQueries,
+    IN PSTR* ppszAttributeList,
+    OUT HANDLE* phDirectory,
+    OUT LDAPMessage** ppMessages
+    )
+{
+    DWORD dwError = 0;
+    HANDLE hDirectory = NULL;
+    DWORD dwTry = 0;
+
+    memset(ppMessages, 0, sizeof(*ppMessages) * dwQueryCount);
+
+    while (TRUE)
+    {
+        hDirectory = LsaDmpGetLdapHandle(pConn);
+        dwError = LsaDmpLdapDirectorySearchMany(
+                    hDirectory,
+                    pszObjectDN,
+                    scope,
+                    dwQueryCount,
+                    ppszQueries,
+                    ppszAttributeList,
+                    ppMessages);
+        if (LsaDmpLdapIsRetryError(dwError) && dwTry < 3)
+        {
+            if (dwTry > 0)
+            {
+                LSA_LOG_ERROR("Error code %u occurred during attempt %u of a ldap search. Retrying.", dwError, dwTry);
+            }
+            dwError = LsaDmpLdapReconnect(pConn);
+            BAIL_ON_LSA_ERROR(dwError);
+            dwTry++;
+        }
+        else if(dwError)
+        {
+            BAIL_ON_LSA_ERROR(dwError);
+        }
+        else
+        {
+            break;
+        }
+    }
+
+    *phDirectory = hDirectory;
+
+cleanup:
+
+    return dwError;
+
+error:
+
+    *phDirectory = NULL;
+    goto cleanup;
+}
+
 DWORD
 LsaDmLdapDirectoryExtendedDNSearch(
     IN PLSA_DM_LDAP_CONNECTION pConn,
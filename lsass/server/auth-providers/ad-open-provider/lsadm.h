@@ -525,6 +525,22 @@ LsaDmLdapDirectorySearch(
     OUT LDAPMessage** ppMessage
     );
 
+// Runs dwQueryCount searches over pConn with all of them outstanding at
+// once.  ppMessages receives one result per query, in query order.
+// pConn stays checked out by the caller for the whole call; searches
+// from other threads are not multiplexed onto it.
+DWORD
+LsaDmLdapDirectorySearchMany(
+    IN PLSA_DM_LDAP_CONNECTION pConn,
+    IN PCSTR pszObjectDN,
+    IN int scope,
+    IN DWORD dwQueryCount,
+    IN PSTR* ppszQueries,
+    IN PSTR* ppszAttributeList,
+    OUT HANDLE* phDirectory,
+    OUT LDAPMessage** ppMessages
+    );
+
 DWORD
 LsaDmLdapDirectoryExtendedDNSearch(
     IN PLSA_DM_LDAP_CONNECTION pConn,
@@ -47,9 +47,10 @@
 typedef enum __MemCachePersistTag
 {
     MEM_CACHE_OBJECT_V1,
-    MEM_CACHE_MEMBERSHIP,
+    MEM_CACHE_MEMBERSHIP_V1,
     MEM_CACHE_PASSWORD,
-    MEM_CACHE_OBJECT
+    MEM_CACHE_OBJECT,
+    MEM_CACHE_MEMBERSHIP
 } MemCachePersistTag;
 
 static LWMsgTypeSpec gLsaObjectTypeSpec[] =
@@ -72,6 +73,21 @@ static LWMsgTypeSpec gLsaCacheSecurityObjectVersionSpec[] =
     LWMSG_TYPE_END
 };
 
+// Membership records written before bIsInTokenGroups was added
+static LWMsgTypeSpec gLsaGroupMembershipV1Spec[] =
+{
+    LWMSG_STRUCT_BEGIN(LSA_GROUP_MEMBERSHIP),
+    LWMSG_MEMBER_TYPESPEC(LSA_GROUP_MEMBERSHIP, version, gLsaCacheSecurityObjectVersionSpec),
+    LWMSG_MEMBER_PSTR(LSA_GROUP_MEMBERSHIP, pszParentSid),
+    LWMSG_MEMBER_PSTR(LSA_GROUP_MEMBERSHIP, pszChildSid),
+    LWMSG_MEMBER_UINT8(LSA_GROUP_MEMBERSHIP, bIsInPac),
+    LWMSG_MEMBER_UINT8(LSA_GROUP_MEMBERSHIP, bIsInPacOnly),
+    LWMSG_MEMBER_UINT8(LSA_GROUP_MEMBERSHIP, bIsInLdap),
+    LWMSG_MEMBER_UINT8(LSA_GROUP_MEMBERSHIP, bIsDomainPrimaryGroup),
+    LWMSG_STRUCT_END,
+    LWMSG_TYPE_END
+};
+
 static LWMsgTypeSpec gLsaGroupMembershipSpec[] =
 {
     LWMSG_STRUCT_BEGIN(LSA_GROUP_MEMBERSHIP),
@@ -82,6 +98,7 @@ static LWMsgTypeSpec gLsaGroupMembershipSpec[] =
     LWMSG_MEMBER_UINT8(LSA_GROUP_MEMBERSHIP, bIsInPacOnly),
     LWMSG_MEMBER_UINT8(LSA_GROUP_MEMBERSHIP, bIsInLdap),
     LWMSG_MEMBER_UINT8(LSA_GROUP_MEMBERSHIP, bIsDomainPrimaryGroup),
+    LWMSG_MEMBER_UINT8(LSA_GROUP_MEMBERSHIP, bIsInTokenGroups),
     LWMSG_STRUCT_END,
     LWMSG_TYPE_END
 };
@@ -218,9 +235,10 @@ static LWMsgTypeSpec gLsaCacheSecurityObjectSpec[] =
 static LWMsgProtocolSpec gMemCachePersistence[] = 
 {
     LWMSG_MESSAGE(MEM_CACHE_OBJECT_V1, gLsaCacheSecurityObjectV1Spec),
-    LWMSG_MESSAGE(MEM_CACHE_MEMBERSHIP, gLsaGroupMembershipSpec),
+    LWMSG_MESSAGE(MEM_CACHE_MEMBERSHIP_V1, gLsaGroupMembershipV1Spec),
     LWMSG_MESSAGE(MEM_CACHE_PASSWORD, gLsaPasswordVerifierSpec),
     LWMSG_MESSAGE(MEM_CACHE_OBJECT, gLsaCacheSecurityObjectSpec),
+    LWMSG_MESSAGE(MEM_CACHE_MEMBERSHIP, gLsaGroupMembershipSpec),
     LWMSG_PROTOCOL_END
 };
 
@@ -567,6 +585,7 @@ MemCacheLoadFile(
                 message.tag = -1;
                 BAIL_ON_LSA_ERROR(dwError);
                 break;
+            case MEM_CACHE_MEMBERSHIP_V1:
             case MEM_CACHE_MEMBERSHIP:
                 dwError = MemCacheDuplicateMembership(
                                 &pMemCacheMembership,
@@ -3206,8 +3225,11 @@ MemCacheStoreGroupMembership(
     while(pPos != pGuardian)
     {
         pExistingMembership = PARENT_NODE_TO_MEMBERSHIP(pPos);
+        // tokenGroups entries are the child's expanded memberships, which
+        // the direct member list of this group does not describe.
         if (pExistingMembership->membership.bIsInPac ||
-            pExistingMembership->membership.bIsDomainPrimaryGroup)
+            pExistingMembership->membership.bIsDomainPrimaryGroup ||
+            pExistingMembership->membership.bIsInTokenGroups)
         {
             dwError = LwHashGetValue(
                             pCombined,
@@ -3233,6 +3255,8 @@ MemCacheStoreGroupMembership(
                 pExistingMembership->membership.bIsInPac;
             pMembership->membership.bIsDomainPrimaryGroup |= 
                 pExistingMembership->membership.bIsDomainPrimaryGroup;
+            pMembership->membership.bIsInTokenGroups |=
+                pExistingMembership->membership.bIsInTokenGroups;
             pMembership->membership.bIsInPacOnly = 
                 pMembership->membership.bIsInPac && !pMembership->membership.bIsInLdap;
 
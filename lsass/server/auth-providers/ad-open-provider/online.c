@@ -860,12 +860,17 @@ AD_PacMembershipFilterWithLdap(
     BOOLEAN bGroupsMatch = TRUE;
     BOOLEAN bExpired = FALSE;
     BOOLEAN bIsComplete = FALSE;
+    BOOLEAN bIsClosure = FALSE;
 
     if (LSA_TRUST_DIRECTION_ONE_WAY == dwTrustDirection)
     {
         goto cleanup;
     }
 
+    // LDAP returns the user's tokenGroups closure when it is enabled
+    bIsClosure = pUserInfo->type == LSA_OBJECT_TYPE_USER &&
+                 AD_GetTokenGroupsMembershipEnabled(pContext->pState);
+
     dwError = LwHashCreate(
                     dwMembershipCount,
                     LwHashCaselessStringCompare,
@@ -925,6 +930,8 @@ AD_PacMembershipFilterWithLdap(
                 pMembership->bIsDomainPrimaryGroup =
                     ppCacheMemberships[i]->bIsDomainPrimaryGroup;
                 pMembership->bIsInLdap = ppCacheMemberships[i]->bIsInLdap;
+                pMembership->bIsInTokenGroups =
+                    ppCacheMemberships[i]->bIsInTokenGroups;
             }
             else if (dwError == ERROR_NOT_FOUND)
             {
@@ -963,6 +970,7 @@ AD_PacMembershipFilterWithLdap(
         {
             ppMemberships[i]->bIsDomainPrimaryGroup = FALSE;
             ppMemberships[i]->bIsInLdap = FALSE;
+            ppMemberships[i]->bIsInTokenGroups = FALSE;
         }
     }
 
@@ -995,6 +1003,7 @@ AD_PacMembershipFilterWithLdap(
                 pMembership->bIsDomainPrimaryGroup = TRUE;
             }
             pMembership->bIsInLdap = TRUE;
+            pMembership->bIsInTokenGroups = bIsClosure;
         }
         else if (dwError == ERROR_NOT_FOUND)
         {
@@ -1016,6 +1025,67 @@ error:
     goto cleanup;
 }
 
+// Resolves all of the PAC's groups in one batch so that the lookups
+// following a login find them in the cache.  Failures are only logged
+// since the groups can still be resolved one at a time later.
+static
+VOID
+AD_PrefetchPacGroups(
+    IN PAD_PROVIDER_CONTEXT pContext,
+    IN DWORD dwGroupSidCount,
+    IN PSTR* ppszGroupSidList
+    )
+{
+    DWORD dwError = 0;
+    PSTR* ppszSids = NULL;
+    size_t sSidCount = 0;
+    PLSA_SECURITY_OBJECT* ppObjects = NULL;
+    DWORD i = 0;
+
+    if (!dwGroupSidCount)
+    {
+        goto cleanup;
+    }
+
+    dwError = LwAllocateMemory(
+                    sizeof(ppszSids[0]) * dwGroupSidCount,
+                    (PVOID*)&ppszSids);
+    BAIL_ON_LSA_ERROR(dwError);
+
+    for (i = 0; i < dwGroupSidCount; i++)
+    {
+        if (ppszGroupSidList[i] &&
+            !AdIsSpecialDomainSidPrefix(ppszGroupSidList[i]))
+        {
+            ppszSids[sSidCount++] = ppszGroupSidList[i];
+        }
+    }
+
+    if (!sSidCount)
+    {
+        goto cleanup;
+    }
+
+    dwError = AD_FindObjectsBySidList(
+                    pContext,
+                    sSidCount,
+                    ppszSids,
+                    NULL,
+                    &ppObjects);
+    BAIL_ON_LSA_ERROR(dwError);
+
+cleanup:
+    ADCacheSafeFreeObjectList(sSidCount, &ppObjects);
+    // Do not free the strings. They are borrowed from ppszGroupSidList.
+    LW_SAFE_FREE_MEMORY(ppszSids);
+    return;
+
+error:
+    LSA_LOG_VERBOSE("Failed to resolve PAC groups ahead of use (error = %u)",
+                    dwError);
+    goto cleanup;
+}
+
 DWORD
 AD_CacheGroupMembershipFromPac(
     IN PAD_PROVIDER_CONTEXT pContext,
@@ -1034,6 +1104,7 @@ AD_CacheGroupMembershipFromPac(
     DWORD dwMembershipIndex = 0;
     PLSA_GROUP_MEMBERSHIP pMembershipBuffers = NULL;
     PSTR pszPrimaryGroupSid = NULL;
+    BOOLEAN bTrustPac = FALSE;
 
     LSA_LOG_VERBOSE(
             "Updating user group membership for uid %lu with PAC information",
@@ -1079,7 +1150,11 @@ AD_CacheGroupMembershipFromPac(
     ppMemberships[dwMembershipIndex]->version.qwDbId = -1;
     ppMemberships[dwMembershipIndex]->pszChildSid = pUserInfo->pszObjectSid;
 
-    if (AD_GetTrimUserMembershipEnabled(pContext->pState))
+    bTrustPac = AD_GetTrustPacMembershipEnabled(pContext->pState);
+
+    // A trusted PAC is authoritative, so there is nothing to trim
+    // against LDAP.
+    if (!bTrustPac && AD_GetTrimUserMembershipEnabled(pContext->pState))
     {
         dwError = AD_PacMembershipFilterWithLdap(
                         pContext,
@@ -1098,6 +1173,14 @@ AD_CacheGroupMembershipFromPac(
                         TRUE);
     BAIL_ON_LSA_ERROR(dwError);
 
+    if (bTrustPac)
+    {
+        AD_PrefetchPacGroups(
+            pContext,
+            dwGroupSidCount,
+            ppszGroupSidList);
+    }
+
     /* Create primary group sid from pac */
     dwError = LsaReplaceSidRid(
         pUserInfo->pszObjectSid,
@@ -1960,6 +2043,7 @@ AD_CacheMembershipFromRelatedObjects(
     IN PCSTR pszSid,
     IN int iPrimaryGroupIndex,
     IN BOOLEAN bIsParent,
+    IN BOOLEAN bIsInTokenGroups,
     IN size_t sCount,
     IN PLSA_SECURITY_OBJECT* ppRelatedObjects
     )
@@ -2016,6 +2100,7 @@ AD_CacheMembershipFromRelatedObjects(
                 {
                     pMembership->bIsDomainPrimaryGroup = TRUE;
                 }
+                pMembership->bIsInTokenGroups = bIsInTokenGroups;
             }
             pMembership->bIsInLdap = TRUE;
             sMembershipCount++;
@@ -4077,6 +4162,8 @@ AD_OnlineQueryMemberOfForSid(
     int iPrimaryGroupIndex = -1;
     PLSA_SECURITY_OBJECT pUserInfo = NULL;
     DWORD dwIndex = 0;
+    BOOLEAN bIsClosure = FALSE;
+    BOOLEAN bTrustPac = FALSE;
 
     LSA_LOG_DEBUG("Online query member of for SID=%s", LSA_SAFE_LOG_STRING(pszSid));
 
@@ -4094,6 +4181,15 @@ AD_OnlineQueryMemberOfForSid(
     }
     BAIL_ON_LSA_ERROR(dwError);
 
+    // With tokenGroups, a user's cached and LDAP memberships are already
+    // the flattened closure of its groups, so they are not expanded
+    // further.
+    bIsClosure = pUserInfo->type == LSA_OBJECT_TYPE_USER &&
+                 AD_GetTokenGroupsMembershipEnabled(pContext->pState);
+    // The same holds for memberships stored from a trusted PAC.
+    bTrustPac = pUserInfo->type == LSA_OBJECT_TYPE_USER &&
+                AD_GetTrustPacMembershipEnabled(pContext->pState);
+
     dwError = ADCacheGetGroupsForUser(
                     pContext->pState->hCacheConnection,
                     pszSid,
@@ -4184,6 +4280,7 @@ AD_OnlineQueryMemberOfForSid(
                         pszSid,
                         iPrimaryGroupIndex,
                         FALSE,
+                        bIsClosure,
                         sResultsCount,
                         ppResults);
         BAIL_ON_LSA_ERROR(dwError);
@@ -4208,6 +4305,16 @@ AD_OnlineQueryMemberOfForSid(
                 dwError = LwHashSetValue(pGroupHash, pszGroupSid, pszGroupSid);
                 BAIL_ON_LSA_ERROR(dwError);
 
+                // Only the rows that came from tokenGroups are already
+                // expanded; direct rows stored by older code or from
+                // a group's member list still need their parents.
+                if ((bIsClosure && ppMemberships[dwIndex]->bIsInTokenGroups) ||
+                    (bTrustPac && ppMemberships[dwIndex]->bIsInPac))
+                {
+                    pszGroupSid = NULL;
+                    continue;
+                }
+
                 dwError = AD_OnlineQueryMemberOfForSid(
                     pContext,
                     FindFlags,
@@ -4237,7 +4344,13 @@ AD_OnlineQueryMemberOfForSid(
                 
                 dwError = LwHashSetValue(pGroupHash, pszGroupSid, pszGroupSid);
                 BAIL_ON_LSA_ERROR(dwError);
-                
+
+                if (bIsClosure)
+                {
+                    pszGroupSid = NULL;
+                    continue;
+                }
+
                 dwError = AD_OnlineQueryMemberOfForSid(
                     pContext,
                     FindFlags,
@@ -4515,6 +4628,7 @@ AD_OnlineGetGroupMemberSids(
                         pszSid,
                         -1,
                         TRUE,
+                        FALSE,
                         sResultsCount,
                         ppResults);
         BAIL_ON_LSA_ERROR(dwError);
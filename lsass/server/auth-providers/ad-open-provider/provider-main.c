@@ -722,6 +722,12 @@ LsaAdProviderStateDestroy(
             pState->hSchannelState = NULL;
         }
 
+        if (pState->hLsaPolicyPool)
+        {
+            AD_NetDestroyLsaPolicyPool(pState->hLsaPolicyPool);
+            pState->hLsaPolicyPool = NULL;
+        }
+
         AD_FreeAllowedSIDs_InLock(pState);
 
         if (pState->MediaSenseHandle)
@@ -863,6 +869,9 @@ LsaAdProviderStateCreate(
     dwError = AD_NetCreateSchannelState(&pState->hSchannelState);
     BAIL_ON_LSA_ERROR(dwError);
 
+    dwError = AD_NetCreateLsaPolicyPool(&pState->hLsaPolicyPool);
+    BAIL_ON_LSA_ERROR(dwError);
+
     dwError = AD_InitializeConfig(&config);
     BAIL_ON_LSA_ERROR(dwError);
 
@@ -69,6 +69,59 @@ LsaDbStoreObjectEntries(
     PLSA_SECURITY_OBJECT* ppObjects
     );
 
+static
+DWORD
+LsaDbEnableWriteAheadLog(
+    IN sqlite3* pDb,
+    OUT PBOOLEAN pbEnabled
+    )
+{
+    DWORD dwError = 0;
+    sqlite3_stmt* pstQuery = NULL;
+    PCSTR pszMode = NULL;
+    BOOLEAN bEnabled = FALSE;
+
+    // The pragma reports the journal mode in effect afterwards. Versions
+    // without WAL support ignore the request and report the old mode.
+    dwError = sqlite3_prepare_v2(
+                    pDb,
+                    "PRAGMA journal_mode=WAL",
+                    -1,
+                    &pstQuery,
+                    NULL);
+    BAIL_ON_SQLITE3_ERROR(dwError, sqlite3_errmsg(pDb));
+
+    dwError = sqlite3_step(pstQuery);
+    if (dwError == SQLITE_ROW)
+    {
+        pszMode = (PCSTR)sqlite3_column_text(pstQuery, 0);
+        bEnabled = pszMode && !strcasecmp(pszMode, "wal");
+        dwError = 0;
+    }
+    else if (dwError == SQLITE_DONE)
+    {
+        dwError = 0;
+    }
+    BAIL_ON_SQLITE3_ERROR(dwError, sqlite3_errmsg(pDb));
+
+    *pbEnabled = bEnabled;
+
+cleanup:
+
+    if (pstQuery)
+    {
+        sqlite3_finalize(pstQuery);
+    }
+
+    return dwError;
+
+error:
+
+    *pbEnabled = FALSE;
+
+    goto cleanup;
+}
+
 static
 DWORD
 LsaDbSetup(
@@ -98,16 +151,12 @@ error:
 
 static
 DWORD
-LsaDbOpen(
-    IN PCSTR pszDbPath,
-    IN PLSA_AD_PROVIDER_STATE pState,
-    OUT PLSA_DB_HANDLE phDb
+LsaDbPrepareReadStatements(
+    IN sqlite3* pDb,
+    IN OUT PLSA_DB_READER pReader
     )
 {
     DWORD dwError = 0;
-    BOOLEAN bLockCreated = FALSE;
-    PLSA_DB_CONNECTION pConn = NULL;
-    BOOLEAN bExists = FALSE;
     PSTR pszQuery = NULL;
     PCSTR pszEitherQueryFormat =
         "select "
@@ -136,51 +185,7 @@ LsaDbOpen(
             LSA_DB_TABLE_NAME_GROUPS ".ObjectSid = " LSA_DB_TABLE_NAME_USERS ".ObjectSid "
         "where " LSA_DB_TABLE_NAME_CACHE_TAGS ".CacheId = " LSA_DB_TABLE_NAME_OBJECTS ".CacheId AND "
             "%s";
-    PCSTR pszRemoveBySidFormat =
-        "delete from %s where ObjectSid = ?1;";
-    PSTR pszDbDir = NULL;
-
-    dwError = LsaGetDirectoryFromPath(
-                    pszDbPath,
-                    &pszDbDir);
-    BAIL_ON_LSA_ERROR(dwError);
 
-    dwError = LwAllocateMemory(
-                    sizeof(LSA_DB_CONNECTION),
-                    (PVOID*)&pConn);
-    BAIL_ON_LSA_ERROR(dwError);
-
-    pConn->pProviderState = pState;
-
-    dwError = pthread_rwlock_init(&pConn->lock, NULL);
-    BAIL_ON_LSA_ERROR(dwError);
-    bLockCreated = TRUE;
-
-    dwError = LsaCheckDirectoryExists(pszDbDir, &bExists);
-    BAIL_ON_LSA_ERROR(dwError);
-
-    if (!bExists)
-    {
-        mode_t cacheDirMode = S_IRWXU|S_IRGRP|S_IXGRP|S_IROTH|S_IXOTH;
-
-        dwError = LsaCreateDirectory(pszDbDir, cacheDirMode);
-        BAIL_ON_LSA_ERROR(dwError);
-    }
-
-    /* restrict access to u+rwx to the db folder */
-    dwError = LsaChangeOwnerAndPermissions(pszDbDir, 0, 0, S_IRWXU);
-    BAIL_ON_LSA_ERROR(dwError);
-
-    dwError = sqlite3_open(pszDbPath, &pConn->pDb);
-    BAIL_ON_LSA_ERROR(dwError);
-
-    dwError = LsaChangeOwnerAndPermissions(pszDbPath, 0, 0, S_IRWXU);
-    BAIL_ON_LSA_ERROR(dwError);
-
-    dwError = LsaDbSetup(pConn->pDb);
-    BAIL_ON_LSA_ERROR(dwError);
-
-    LW_SAFE_FREE_STRING(pszQuery);
     dwError = LwAllocateStringPrintf(
         &pszQuery,
         pszUserQueryFormat,
@@ -189,12 +194,12 @@ LsaDbOpen(
     BAIL_ON_LSA_ERROR(dwError);
 
     dwError = sqlite3_prepare_v2(
-            pConn->pDb,
+            pDb,
             pszQuery,
             -1, //search for null termination in szQuery to get length
-            &pConn->pstFindUserByUPN,
+            &pReader->pstFindUserByUPN,
             NULL);
-    BAIL_ON_SQLITE3_ERROR(dwError, sqlite3_errmsg(pConn->pDb));
+    BAIL_ON_SQLITE3_ERROR(dwError, sqlite3_errmsg(pDb));
 
     LW_SAFE_FREE_STRING(pszQuery);
     dwError = LwAllocateStringPrintf(
@@ -206,12 +211,12 @@ LsaDbOpen(
     BAIL_ON_LSA_ERROR(dwError);
 
     dwError = sqlite3_prepare_v2(
-            pConn->pDb,
+            pDb,
             pszQuery,
             -1, //search for null termination in szQuery to get length
-            &pConn->pstFindObjectByNT4,
+            &pReader->pstFindObjectByNT4,
             NULL);
-    BAIL_ON_SQLITE3_ERROR(dwError, sqlite3_errmsg(pConn->pDb));
+    BAIL_ON_SQLITE3_ERROR(dwError, sqlite3_errmsg(pDb));
 
     LW_SAFE_FREE_STRING(pszQuery);
     dwError = LwAllocateStringPrintf(
@@ -222,12 +227,12 @@ LsaDbOpen(
     BAIL_ON_LSA_ERROR(dwError);
 
     dwError = sqlite3_prepare_v2(
-            pConn->pDb,
+            pDb,
             pszQuery,
             -1, //search for null termination in szQuery to get length
-            &pConn->pstFindUserByAlias,
+            &pReader->pstFindUserByAlias,
             NULL);
-    BAIL_ON_SQLITE3_ERROR(dwError, sqlite3_errmsg(pConn->pDb));
+    BAIL_ON_SQLITE3_ERROR(dwError, sqlite3_errmsg(pDb));
 
     LW_SAFE_FREE_STRING(pszQuery);
     dwError = LwAllocateStringPrintf(
@@ -237,12 +242,12 @@ LsaDbOpen(
         LSA_DB_TABLE_NAME_GROUPS ".AliasName = ?1");
 
     dwError = sqlite3_prepare_v2(
-            pConn->pDb,
+            pDb,
             pszQuery,
             -1, //search for null termination in szQuery to get length
-            &pConn->pstFindGroupByAlias,
+            &pReader->pstFindGroupByAlias,
             NULL);
-    BAIL_ON_SQLITE3_ERROR(dwError, sqlite3_errmsg(pConn->pDb));
+    BAIL_ON_SQLITE3_ERROR(dwError, sqlite3_errmsg(pDb));
 
     LW_SAFE_FREE_STRING(pszQuery);
     dwError = LwAllocateStringPrintf(
@@ -253,12 +258,12 @@ LsaDbOpen(
     BAIL_ON_LSA_ERROR(dwError);
 
     dwError = sqlite3_prepare_v2(
-            pConn->pDb,
+            pDb,
             pszQuery,
             -1, //search for null termination in szQuery to get length
-            &pConn->pstFindUserById,
+            &pReader->pstFindUserById,
             NULL);
-    BAIL_ON_SQLITE3_ERROR(dwError, sqlite3_errmsg(pConn->pDb));
+    BAIL_ON_SQLITE3_ERROR(dwError, sqlite3_errmsg(pDb));
 
     LW_SAFE_FREE_STRING(pszQuery);
     dwError = LwAllocateStringPrintf(
@@ -269,12 +274,12 @@ LsaDbOpen(
     BAIL_ON_LSA_ERROR(dwError);
 
     dwError = sqlite3_prepare_v2(
-            pConn->pDb,
+            pDb,
             pszQuery,
             -1, //search for null termination in szQuery to get length
-            &pConn->pstFindGroupById,
+            &pReader->pstFindGroupById,
             NULL);
-    BAIL_ON_SQLITE3_ERROR(dwError, sqlite3_errmsg(pConn->pDb));
+    BAIL_ON_SQLITE3_ERROR(dwError, sqlite3_errmsg(pDb));
 
     LW_SAFE_FREE_STRING(pszQuery);
     dwError = LwAllocateStringPrintf(
@@ -285,12 +290,12 @@ LsaDbOpen(
     BAIL_ON_LSA_ERROR(dwError);
 
     dwError = sqlite3_prepare_v2(
-            pConn->pDb,
+            pDb,
             pszQuery,
             -1, //search for null termination in szQuery to get length
-            &pConn->pstFindObjectByDN,
+            &pReader->pstFindObjectByDN,
             NULL);
-    BAIL_ON_SQLITE3_ERROR(dwError, sqlite3_errmsg(pConn->pDb));
+    BAIL_ON_SQLITE3_ERROR(dwError, sqlite3_errmsg(pDb));
 
     LW_SAFE_FREE_STRING(pszQuery);
     dwError = LwAllocateStringPrintf(
@@ -301,12 +306,12 @@ LsaDbOpen(
     BAIL_ON_LSA_ERROR(dwError);
 
     dwError = sqlite3_prepare_v2(
-            pConn->pDb,
+            pDb,
             pszQuery,
             -1, //search for null termination in szQuery to get length
-            &pConn->pstFindObjectBySid,
+            &pReader->pstFindObjectBySid,
             NULL);
-    BAIL_ON_SQLITE3_ERROR(dwError, sqlite3_errmsg(pConn->pDb));
+    BAIL_ON_SQLITE3_ERROR(dwError, sqlite3_errmsg(pDb));
 
     LW_SAFE_FREE_STRING(pszQuery);
     dwError = LwAllocateStringPrintf(
@@ -320,12 +325,12 @@ LsaDbOpen(
     BAIL_ON_LSA_ERROR(dwError);
 
     dwError = sqlite3_prepare_v2(
-            pConn->pDb,
+            pDb,
             pszQuery,
             -1, //search for null termination in szQuery to get length
-            &pConn->pstEnumUsers,
+            &pReader->pstEnumUsers,
             NULL);
-    BAIL_ON_SQLITE3_ERROR(dwError, sqlite3_errmsg(pConn->pDb));
+    BAIL_ON_SQLITE3_ERROR(dwError, sqlite3_errmsg(pDb));
 
     LW_SAFE_FREE_STRING(pszQuery);
     dwError = LwAllocateStringPrintf(
@@ -338,12 +343,177 @@ LsaDbOpen(
     BAIL_ON_LSA_ERROR(dwError);
 
     dwError = sqlite3_prepare_v2(
-            pConn->pDb,
+            pDb,
             pszQuery,
             -1, //search for null termination in szQuery to get length
-            &pConn->pstEnumGroups,
+            &pReader->pstEnumGroups,
             NULL);
-    BAIL_ON_SQLITE3_ERROR(dwError, sqlite3_errmsg(pConn->pDb));
+    BAIL_ON_SQLITE3_ERROR(dwError, sqlite3_errmsg(pDb));
+
+    dwError = sqlite3_prepare_v2(
+            pDb,
+            "select "
+            LSA_DB_TABLE_NAME_CACHE_TAGS ".CacheId, "
+            LSA_DB_TABLE_NAME_CACHE_TAGS ".LastUpdated, "
+            LSA_DB_TABLE_NAME_MEMBERSHIP ".ParentSid, "
+            LSA_DB_TABLE_NAME_MEMBERSHIP ".ChildSid, "
+            LSA_DB_TABLE_NAME_MEMBERSHIP ".IsInPac, "
+            LSA_DB_TABLE_NAME_MEMBERSHIP ".IsInPacOnly, "
+            LSA_DB_TABLE_NAME_MEMBERSHIP ".IsInLdap, "
+            LSA_DB_TABLE_NAME_MEMBERSHIP ".IsDomainPrimaryGroup, "
+            LSA_DB_TABLE_NAME_MEMBERSHIP ".IsInTokenGroups "
+            "from " LSA_DB_TABLE_NAME_CACHE_TAGS ", " LSA_DB_TABLE_NAME_MEMBERSHIP " "
+            "where " LSA_DB_TABLE_NAME_CACHE_TAGS ".CacheId = " LSA_DB_TABLE_NAME_MEMBERSHIP ".CacheId "
+                "AND " LSA_DB_TABLE_NAME_MEMBERSHIP ".ParentSid = ?1",
+            -1, //search for null termination in szQuery to get length
+            &pReader->pstGetGroupMembers,
+            NULL);
+    BAIL_ON_SQLITE3_ERROR(dwError, sqlite3_errmsg(pDb));
+
+    dwError = sqlite3_prepare_v2(
+            pDb,
+            "select "
+            LSA_DB_TABLE_NAME_CACHE_TAGS ".CacheId, "
+            LSA_DB_TABLE_NAME_CACHE_TAGS ".LastUpdated, "
+            LSA_DB_TABLE_NAME_MEMBERSHIP ".ParentSid, "
+            LSA_DB_TABLE_NAME_MEMBERSHIP ".ChildSid, "
+            LSA_DB_TABLE_NAME_MEMBERSHIP ".IsInPac, "
+            LSA_DB_TABLE_NAME_MEMBERSHIP ".IsInPacOnly, "
+            LSA_DB_TABLE_NAME_MEMBERSHIP ".IsInLdap, "
+            LSA_DB_TABLE_NAME_MEMBERSHIP ".IsDomainPrimaryGroup, "
+            LSA_DB_TABLE_NAME_MEMBERSHIP ".IsInTokenGroups "
+            "from " LSA_DB_TABLE_NAME_CACHE_TAGS ", " LSA_DB_TABLE_NAME_MEMBERSHIP " "
+            "where " LSA_DB_TABLE_NAME_CACHE_TAGS ".CacheId = " LSA_DB_TABLE_NAME_MEMBERSHIP ".CacheId "
+                "AND " LSA_DB_TABLE_NAME_MEMBERSHIP ".ChildSid = ?1",
+            -1, //search for null termination in szQuery to get length
+            &pReader->pstGetGroupsForUser,
+            NULL);
+    BAIL_ON_SQLITE3_ERROR(dwError, sqlite3_errmsg(pDb));
+
+    dwError = sqlite3_prepare_v2(
+            pDb,
+            "select "
+            LSA_DB_TABLE_NAME_CACHE_TAGS ".CacheId, "
+            LSA_DB_TABLE_NAME_CACHE_TAGS ".LastUpdated, "
+            LSA_DB_TABLE_NAME_VERIFIERS ".ObjectSid, "
+            LSA_DB_TABLE_NAME_VERIFIERS ".PasswordVerifier "
+            "from " LSA_DB_TABLE_NAME_CACHE_TAGS ", " LSA_DB_TABLE_NAME_VERIFIERS " "
+            "where " LSA_DB_TABLE_NAME_CACHE_TAGS ".CacheId = " LSA_DB_TABLE_NAME_VERIFIERS ".CacheId "
+                "AND " LSA_DB_TABLE_NAME_VERIFIERS ".ObjectSid = ?1",
+            -1, //search for null termination in szQuery to get length
+            &pReader->pstGetPasswordVerifier,
+            NULL);
+    BAIL_ON_SQLITE3_ERROR(dwError, sqlite3_errmsg(pDb));
+
+cleanup:
+
+    LW_SAFE_FREE_STRING(pszQuery);
+
+    return dwError;
+
+error:
+
+    goto cleanup;
+}
+
+static
+DWORD
+LsaDbOpen(
+    IN PCSTR pszDbPath,
+    IN PLSA_AD_PROVIDER_STATE pState,
+    OUT PLSA_DB_HANDLE phDb
+    )
+{
+    DWORD dwError = 0;
+    BOOLEAN bLockCreated = FALSE;
+    PLSA_DB_CONNECTION pConn = NULL;
+    BOOLEAN bExists = FALSE;
+    BOOLEAN bWriteAheadLog = FALSE;
+    PSTR pszQuery = NULL;
+    PCSTR pszRemoveBySidFormat =
+        "delete from %s where ObjectSid = ?1;";
+    PSTR pszDbDir = NULL;
+
+    dwError = LsaGetDirectoryFromPath(
+                    pszDbPath,
+                    &pszDbDir);
+    BAIL_ON_LSA_ERROR(dwError);
+
+    dwError = LwAllocateMemory(
+                    sizeof(LSA_DB_CONNECTION),
+                    (PVOID*)&pConn);
+    BAIL_ON_LSA_ERROR(dwError);
+
+    pConn->pProviderState = pState;
+
+    dwError = pthread_rwlock_init(&pConn->lock, NULL);
+    BAIL_ON_LSA_ERROR(dwError);
+    bLockCreated = TRUE;
+
+    dwError = pthread_mutex_init(&pConn->readerLock, NULL);
+    BAIL_ON_LSA_ERROR(dwError);
+    pConn->bReaderLockCreated = TRUE;
+
+    pConn->dwMaxReaders = AD_GetCacheReadConnections(pState);
+
+    dwError = LwAllocateString(pszDbPath, &pConn->pszDbPath);
+    BAIL_ON_LSA_ERROR(dwError);
+
+    dwError = LsaCheckDirectoryExists(pszDbDir, &bExists);
+    BAIL_ON_LSA_ERROR(dwError);
+
+    if (!bExists)
+    {
+        mode_t cacheDirMode = S_IRWXU|S_IRGRP|S_IXGRP|S_IROTH|S_IXOTH;
+
+        dwError = LsaCreateDirectory(pszDbDir, cacheDirMode);
+        BAIL_ON_LSA_ERROR(dwError);
+    }
+
+    /* restrict access to u+rwx to the db folder */
+    dwError = LsaChangeOwnerAndPermissions(pszDbDir, 0, 0, S_IRWXU);
+    BAIL_ON_LSA_ERROR(dwError);
+
+    dwError = sqlite3_open(pszDbPath, &pConn->pDb);
+    BAIL_ON_LSA_ERROR(dwError);
+
+    dwError = LsaChangeOwnerAndPermissions(pszDbPath, 0, 0, S_IRWXU);
+    BAIL_ON_LSA_ERROR(dwError);
+
+    dwError = LsaDbSetup(pConn->pDb);
+    BAIL_ON_LSA_ERROR(dwError);
+
+    if (pConn->dwMaxReaders)
+    {
+        // The pooled read connections only help with a write-ahead log,
+        // where they keep reading while an update commits. Without one
+        // (sqlite before 3.7.0, including the bundled 3.6.18) a reader
+        // would hold a shared lock that makes updates fail with
+        // SQLITE_BUSY, so every lookup stays on the main connection.
+        dwError = LsaDbEnableWriteAheadLog(pConn->pDb, &bWriteAheadLog);
+        BAIL_ON_LSA_ERROR(dwError);
+
+        if (!bWriteAheadLog)
+        {
+            LSA_LOG_INFO("sqlite %s has no write-ahead log support; "
+                         "ignoring CacheReadConnections",
+                         sqlite3_libversion());
+            pConn->dwMaxReaders = 0;
+        }
+    }
+
+    if (pConn->dwMaxReaders)
+    {
+        dwError = sqlite3_busy_timeout(
+                        pConn->pDb,
+                        LSA_DB_BUSY_TIMEOUT_MSECS);
+        BAIL_ON_SQLITE3_ERROR(dwError, sqlite3_errmsg(pConn->pDb));
+    }
+
+    pConn->reader.pDb = pConn->pDb;
+
+    dwError = LsaDbPrepareReadStatements(pConn->pDb, &pConn->reader);
+    BAIL_ON_LSA_ERROR(dwError);
 
     LW_SAFE_FREE_STRING(pszQuery);
     dwError = LwAllocateStringPrintf(
@@ -390,59 +560,6 @@ LsaDbOpen(
             NULL);
     BAIL_ON_SQLITE3_ERROR(dwError, sqlite3_errmsg(pConn->pDb));
 
-    dwError = sqlite3_prepare_v2(
-            pConn->pDb,
-            "select "
-            LSA_DB_TABLE_NAME_CACHE_TAGS ".CacheId, "
-            LSA_DB_TABLE_NAME_CACHE_TAGS ".LastUpdated, "
-            LSA_DB_TABLE_NAME_MEMBERSHIP ".ParentSid, "
-            LSA_DB_TABLE_NAME_MEMBERSHIP ".ChildSid, "
-            LSA_DB_TABLE_NAME_MEMBERSHIP ".IsInPac, "
-            LSA_DB_TABLE_NAME_MEMBERSHIP ".IsInPacOnly, "
-            LSA_DB_TABLE_NAME_MEMBERSHIP ".IsInLdap, "
-            LSA_DB_TABLE_NAME_MEMBERSHIP ".IsDomainPrimaryGroup "
-            "from " LSA_DB_TABLE_NAME_CACHE_TAGS ", " LSA_DB_TABLE_NAME_MEMBERSHIP " "
-            "where " LSA_DB_TABLE_NAME_CACHE_TAGS ".CacheId = " LSA_DB_TABLE_NAME_MEMBERSHIP ".CacheId "
-                "AND " LSA_DB_TABLE_NAME_MEMBERSHIP ".ParentSid = ?1",
-            -1, //search for null termination in szQuery to get length
-            &pConn->pstGetGroupMembers,
-            NULL);
-    BAIL_ON_SQLITE3_ERROR(dwError, sqlite3_errmsg(pConn->pDb));
-
-    dwError = sqlite3_prepare_v2(
-            pConn->pDb,
-            "select "
-            LSA_DB_TABLE_NAME_CACHE_TAGS ".CacheId, "
-            LSA_DB_TABLE_NAME_CACHE_TAGS ".LastUpdated, "
-            LSA_DB_TABLE_NAME_MEMBERSHIP ".ParentSid, "
-            LSA_DB_TABLE_NAME_MEMBERSHIP ".ChildSid, "
-            LSA_DB_TABLE_NAME_MEMBERSHIP ".IsInPac, "
-            LSA_DB_TABLE_NAME_MEMBERSHIP ".IsInPacOnly, "
-            LSA_DB_TABLE_NAME_MEMBERSHIP ".IsInLdap, "
-            LSA_DB_TABLE_NAME_MEMBERSHIP ".IsDomainPrimaryGroup "
-            "from " LSA_DB_TABLE_NAME_CACHE_TAGS ", " LSA_DB_TABLE_NAME_MEMBERSHIP " "
-            "where " LSA_DB_TABLE_NAME_CACHE_TAGS ".CacheId = " LSA_DB_TABLE_NAME_MEMBERSHIP ".CacheId "
-                "AND " LSA_DB_TABLE_NAME_MEMBERSHIP ".ChildSid = ?1",
-            -1, //search for null termination in szQuery to get length
-            &pConn->pstGetGroupsForUser,
-            NULL);
-    BAIL_ON_SQLITE3_ERROR(dwError, sqlite3_errmsg(pConn->pDb));
-
-    dwError = sqlite3_prepare_v2(
-            pConn->pDb,
-            "select "
-            LSA_DB_TABLE_NAME_CACHE_TAGS ".CacheId, "
-            LSA_DB_TABLE_NAME_CACHE_TAGS ".LastUpdated, "
-            LSA_DB_TABLE_NAME_VERIFIERS ".ObjectSid, "
-            LSA_DB_TABLE_NAME_VERIFIERS ".PasswordVerifier "
-            "from " LSA_DB_TABLE_NAME_CACHE_TAGS ", " LSA_DB_TABLE_NAME_VERIFIERS " "
-            "where " LSA_DB_TABLE_NAME_CACHE_TAGS ".CacheId = " LSA_DB_TABLE_NAME_VERIFIERS ".CacheId "
-                "AND " LSA_DB_TABLE_NAME_VERIFIERS ".ObjectSid = ?1",
-            -1, //search for null termination in szQuery to get length
-            &pConn->pstGetPasswordVerifier,
-            NULL);
-    BAIL_ON_SQLITE3_ERROR(dwError, sqlite3_errmsg(pConn->pDb));
-
     dwError = sqlite3_prepare_v2(
             pConn->pDb,
             "insert into " LSA_DB_TABLE_NAME_CACHE_TAGS " ("
@@ -485,6 +602,17 @@ LsaDbOpen(
             NULL);
     BAIL_ON_SQLITE3_ERROR(dwError, sqlite3_errmsg(pConn->pDb));
 
+    dwError = sqlite3_prepare_v2(
+            pConn->pDb,
+            "update OR IGNORE " LSA_DB_TABLE_NAME_MEMBERSHIP " set "
+                "CacheId = ?1,"
+                "IsInTokenGroups = 1"
+            " where ParentSid = ?2 AND ChildSid = ?3",
+            -1,
+            &pConn->pstSetTokenGroupsMembership,
+            NULL);
+    BAIL_ON_SQLITE3_ERROR(dwError, sqlite3_errmsg(pConn->pDb));
+
     dwError = sqlite3_prepare_v2(
             pConn->pDb,
             "insert OR IGNORE into " LSA_DB_TABLE_NAME_MEMBERSHIP " ("
@@ -494,7 +622,8 @@ LsaDbOpen(
                 "IsInPac, "
                 "IsInPacOnly, "
                 "IsInLdap, "
-                "IsDomainPrimaryGroup"
+                "IsDomainPrimaryGroup, "
+                "IsInTokenGroups"
             ") values ("
                 "?1,"
                 "?2,"
@@ -502,7 +631,8 @@ LsaDbOpen(
                 "?4,"
                 "?5,"
                 "?6,"
-                "?7)",
+                "?7,"
+                "?8)",
             -1,
             &pConn->pstAddMembership,
             NULL);
@@ -524,6 +654,11 @@ error:
         {
             pthread_rwlock_destroy(&pConn->lock);
         }
+        if (pConn->bReaderLockCreated)
+        {
+            pthread_mutex_destroy(&pConn->readerLock);
+        }
+        LW_SAFE_FREE_STRING(pConn->pszDbPath);
         LsaDbFreePreparedStatements(pConn);
 
         if (pConn->pDb != NULL)
@@ -538,44 +673,75 @@ error:
 }
 
 
+static
 DWORD
-LsaDbFreePreparedStatements(
-    IN OUT PLSA_DB_CONNECTION pConn
+LsaDbFinalizeReadStatements(
+    IN OUT PLSA_DB_READER pReader
     )
 {
     int i;
     DWORD dwError = LW_ERROR_SUCCESS;
     sqlite3_stmt * * const pppstFreeList[] = {
-        &pConn->pstFindObjectByNT4,
-        &pConn->pstFindObjectByDN,
-        &pConn->pstFindObjectBySid,
+        &pReader->pstFindObjectByNT4,
+        &pReader->pstFindObjectByDN,
+        &pReader->pstFindObjectBySid,
 
-        &pConn->pstFindUserByUPN,
-        &pConn->pstFindUserByAlias,
-        &pConn->pstFindUserById,
+        &pReader->pstFindUserByUPN,
+        &pReader->pstFindUserByAlias,
+        &pReader->pstFindUserById,
 
-        &pConn->pstFindGroupByAlias,
-        &pConn->pstFindGroupById,
+        &pReader->pstFindGroupByAlias,
+        &pReader->pstFindGroupById,
 
-        &pConn->pstRemoveObjectBySid,
-        &pConn->pstRemoveUserBySid,
-        &pConn->pstRemoveGroupBySid,
+        &pReader->pstEnumUsers,
+        &pReader->pstEnumGroups,
+
+        &pReader->pstGetGroupMembers,
+        &pReader->pstGetGroupsForUser,
+
+        &pReader->pstGetPasswordVerifier,
+    };
+
+    for (i = 0; i < sizeof(pppstFreeList)/sizeof(pppstFreeList[0]); i++)
+    {
+        if (*pppstFreeList[i] != NULL)
+        {
+            dwError = sqlite3_finalize(*pppstFreeList[i]);
+            BAIL_ON_SQLITE3_ERROR(dwError, sqlite3_errmsg(pReader->pDb));
+            *pppstFreeList[i] = NULL;
+        }
+    }
 
-        &pConn->pstEnumUsers,
-        &pConn->pstEnumGroups,
+cleanup:
+    return dwError;
 
-        &pConn->pstGetGroupMembers,
-        &pConn->pstGetGroupsForUser,
+error:
+    goto cleanup;
+}
 
-        &pConn->pstGetPasswordVerifier,
+DWORD
+LsaDbFreePreparedStatements(
+    IN OUT PLSA_DB_CONNECTION pConn
+    )
+{
+    int i;
+    DWORD dwError = LW_ERROR_SUCCESS;
+    sqlite3_stmt * * const pppstFreeList[] = {
+        &pConn->pstRemoveObjectBySid,
+        &pConn->pstRemoveUserBySid,
+        &pConn->pstRemoveGroupBySid,
 
         &pConn->pstInsertCacheTag,
         &pConn->pstGetLastInsertedRow,
         &pConn->pstSetLdapMembership,
         &pConn->pstSetPrimaryGroupMembership,
+        &pConn->pstSetTokenGroupsMembership,
         &pConn->pstAddMembership,
     };
 
+    dwError = LsaDbFinalizeReadStatements(&pConn->reader);
+    BAIL_ON_LSA_ERROR(dwError);
+
     for (i = 0; i < sizeof(pppstFreeList)/sizeof(pppstFreeList[0]); i++)
     {
         if (*pppstFreeList[i] != NULL)
@@ -593,6 +759,163 @@ error:
     goto cleanup;
 }
 
+static
+VOID
+LsaDbCloseReader(
+    IN OUT PLSA_DB_READER pReader
+    )
+{
+    DWORD dwError = LW_ERROR_SUCCESS;
+
+    dwError = LsaDbFinalizeReadStatements(pReader);
+    if (dwError != LW_ERROR_SUCCESS)
+    {
+        LSA_LOG_ERROR("Error freeing prepared statements [%u]", dwError);
+    }
+
+    if (pReader->pDb != NULL)
+    {
+        sqlite3_close(pReader->pDb);
+    }
+
+    LwFreeMemory(pReader);
+}
+
+static
+DWORD
+LsaDbOpenReader(
+    IN PCSTR pszDbPath,
+    OUT PLSA_DB_READER* ppReader
+    )
+{
+    DWORD dwError = 0;
+    PLSA_DB_READER pReader = NULL;
+
+    dwError = LwAllocateMemory(
+                    sizeof(*pReader),
+                    (PVOID*)&pReader);
+    BAIL_ON_LSA_ERROR(dwError);
+
+    // Opened read-write so that it can map the WAL index with any sqlite
+    // version, but it only ever runs the lookup statements.
+    dwError = sqlite3_open_v2(
+                    pszDbPath,
+                    &pReader->pDb,
+                    SQLITE_OPEN_READWRITE,
+                    NULL);
+    BAIL_ON_LSA_ERROR(dwError);
+
+    dwError = sqlite3_busy_timeout(
+                    pReader->pDb,
+                    LSA_DB_BUSY_TIMEOUT_MSECS);
+    BAIL_ON_SQLITE3_ERROR(dwError, sqlite3_errmsg(pReader->pDb));
+
+    dwError = LsaDbPrepareReadStatements(pReader->pDb, pReader);
+    BAIL_ON_LSA_ERROR(dwError);
+
+    *ppReader = pReader;
+
+cleanup:
+
+    return dwError;
+
+error:
+
+    if (pReader != NULL)
+    {
+        LsaDbCloseReader(pReader);
+    }
+    *ppReader = NULL;
+
+    goto cleanup;
+}
+
+// Returns a pooled read connection, opening a new one while the pool is
+// below its configured size. When none is available the lookup runs on the
+// main connection, holding the lock until LsaDbReleaseReader.
+static
+PLSA_DB_READER
+LsaDbAcquireReader(
+    IN PLSA_DB_CONNECTION pConn
+    )
+{
+    DWORD dwError = 0;
+    PLSA_DB_READER pReader = NULL;
+    BOOLEAN bOpenReader = FALSE;
+
+    pthread_mutex_lock(&pConn->readerLock);
+
+    if (pConn->pFreeReaders != NULL)
+    {
+        pReader = pConn->pFreeReaders;
+        pConn->pFreeReaders = pReader->pNext;
+        pReader->pNext = NULL;
+    }
+    else if (pConn->dwReaderCount < pConn->dwMaxReaders)
+    {
+        pConn->dwReaderCount++;
+        bOpenReader = TRUE;
+    }
+
+    pthread_mutex_unlock(&pConn->readerLock);
+
+    if (bOpenReader)
+    {
+        dwError = LsaDbOpenReader(pConn->pszDbPath, &pReader);
+        if (dwError)
+        {
+            LSA_LOG_ERROR("Cannot open a read connection to the cache "
+                          "database [%u]; limiting the pool to %u "
+                          "connections",
+                          dwError,
+                          pConn->dwReaderCount - 1);
+
+            // Stop growing the pool rather than retrying on every lookup
+            pthread_mutex_lock(&pConn->readerLock);
+            pConn->dwReaderCount--;
+            pConn->dwMaxReaders = pConn->dwReaderCount;
+            pthread_mutex_unlock(&pConn->readerLock);
+        }
+    }
+
+    if (pReader == NULL)
+    {
+        pthread_rwlock_wrlock(&pConn->lock);
+        pReader = &pConn->reader;
+    }
+
+    return pReader;
+}
+
+static
+VOID
+LsaDbReleaseReader(
+    IN PLSA_DB_CONNECTION pConn,
+    IN OUT PLSA_DB_READER* ppReader
+    )
+{
+    PLSA_DB_READER pReader = *ppReader;
+
+    if (pReader == NULL)
+    {
+        return;
+    }
+
+    if (pReader == &pConn->reader)
+    {
+        pthread_rwlock_unlock(&pConn->lock);
+    }
+    else
+    {
+        pthread_mutex_lock(&pConn->readerLock);
+        pReader->pNext = pConn->pFreeReaders;
+        pConn->pFreeReaders = pReader;
+        pthread_mutex_unlock(&pConn->readerLock);
+    }
+
+    *ppReader = NULL;
+}
+
 static
 void
 LsaDbSafeClose(
@@ -623,6 +946,14 @@ LsaDbSafeClose(
         dwError = LW_ERROR_SUCCESS;
     }
 
+    while (pConn->pFreeReaders != NULL)
+    {
+        PLSA_DB_READER pReader = pConn->pFreeReaders;
+
+        pConn->pFreeReaders = pReader->pNext;
+        LsaDbCloseReader(pReader);
+    }
+
     if (pConn->pDb != NULL)
     {
         sqlite3_close(pConn->pDb);
@@ -635,6 +966,15 @@ LsaDbSafeClose(
         LSA_LOG_ERROR("Error destroying lock [%u]", dwError);
         dwError = LW_ERROR_SUCCESS;
     }
+
+    dwError = pthread_mutex_destroy(&pConn->readerLock);
+    if (dwError != LW_ERROR_SUCCESS)
+    {
+        LSA_LOG_ERROR("Error destroying lock [%u]", dwError);
+        dwError = LW_ERROR_SUCCESS;
+    }
+
+    LW_SAFE_FREE_STRING(pConn->pszDbPath);
     LW_SAFE_FREE_MEMORY(pConn);
 
     *phDb = (HANDLE)0;
@@ -654,13 +994,13 @@ LsaDbFindUserByName(
 {
     DWORD dwError = 0;
     PLSA_DB_CONNECTION pConn = (PLSA_DB_CONNECTION)hDb;
-    BOOLEAN bInLock = FALSE;
+    PLSA_DB_READER pReader = NULL;
     // do not free
     sqlite3_stmt *pstQuery = NULL;
     PLSA_SECURITY_OBJECT pObject = NULL;
     PSTR pszDnsDomain = NULL;
 
-    ENTER_SQLITE_LOCK(&pConn->lock, bInLock);
+    pReader = LsaDbAcquireReader(pConn);
 
     switch (pUserNameInfo->nameType)
     {
@@ -685,7 +1025,7 @@ LsaDbFindUserByName(
                             NULL);
             BAIL_ON_LSA_ERROR(dwError);
 
-            pstQuery = pConn->pstFindUserByUPN;
+            pstQuery = pReader->pstFindUserByUPN;
             dwError = sqlite3_bind_text(
                     pstQuery,
                     1,
@@ -693,7 +1033,7 @@ LsaDbFindUserByName(
                     -1, // let sqlite calculate the length
                     SQLITE_TRANSIENT //let sqlite make its own copy
                     );
-            BAIL_ON_SQLITE3_ERROR(dwError, sqlite3_errmsg(pConn->pDb));
+            BAIL_ON_SQLITE3_ERROR(dwError, sqlite3_errmsg(pReader->pDb));
 
             dwError = sqlite3_bind_text(
                     pstQuery,
@@ -702,10 +1042,10 @@ LsaDbFindUserByName(
                     -1, // let sqlite calculate the length
                     SQLITE_TRANSIENT //let sqlite make its own copy
                     );
-            BAIL_ON_SQLITE3_ERROR(dwError, sqlite3_errmsg(pConn->pDb));
+            BAIL_ON_SQLITE3_ERROR(dwError, sqlite3_errmsg(pReader->pDb));
             break;
        case NameType_NT4:
-            pstQuery = pConn->pstFindObjectByNT4;
+            pstQuery = pReader->pstFindObjectByNT4;
             dwError = sqlite3_bind_text(
                     pstQuery,
                     1,
@@ -713,7 +1053,7 @@ LsaDbFindUserByName(
                     -1, // let sqlite calculate the length
                     SQLITE_TRANSIENT //let sqlite make its own copy
                     );
-            BAIL_ON_SQLITE3_ERROR(dwError, sqlite3_errmsg(pConn->pDb));
+            BAIL_ON_SQLITE3_ERROR(dwError, sqlite3_errmsg(pReader->pDb));
 
             dwError = sqlite3_bind_text(
                     pstQuery,
@@ -722,10 +1062,10 @@ LsaDbFindUserByName(
                     -1, // let sqlite calculate the length
                     SQLITE_TRANSIENT //let sqlite make its own copy
                     );
-            BAIL_ON_SQLITE3_ERROR(dwError, sqlite3_errmsg(pConn->pDb));
+            BAIL_ON_SQLITE3_ERROR(dwError, sqlite3_errmsg(pReader->pDb));
             break;
        case NameType_Alias:
-            pstQuery = pConn->pstFindUserByAlias;
+            pstQuery = pReader->pstFindUserByAlias;
             dwError = sqlite3_bind_text(
                     pstQuery,
                     1,
@@ -733,7 +1073,7 @@ LsaDbFindUserByName(
                     -1, // let sqlite calculate the length
                     SQLITE_TRANSIENT //let sqlite make its own copy
                     );
-            BAIL_ON_SQLITE3_ERROR(dwError, sqlite3_errmsg(pConn->pDb));
+            BAIL_ON_SQLITE3_ERROR(dwError, sqlite3_errmsg(pReader->pDb));
             break;
        default:
             dwError = LW_ERROR_INTERNAL;
@@ -753,7 +1093,7 @@ LsaDbFindUserByName(
 
 cleanup:
     LW_SAFE_FREE_STRING(pszDnsDomain);
-    LEAVE_SQLITE_LOCK(&pConn->lock, bInLock);
+    LsaDbReleaseReader(pConn, &pReader);
 
     return dwError;
 
@@ -774,20 +1114,20 @@ LsaDbFindUserById(
 {
     DWORD dwError = 0;
     PLSA_DB_CONNECTION pConn = (PLSA_DB_CONNECTION)hDb;
-    BOOLEAN bInLock = FALSE;
+    PLSA_DB_READER pReader = NULL;
     // do not free
     sqlite3_stmt *pstQuery = NULL;
     PLSA_SECURITY_OBJECT pObject = NULL;
 
-    ENTER_SQLITE_LOCK(&pConn->lock, bInLock);
+    pReader = LsaDbAcquireReader(pConn);
 
-    pstQuery = pConn->pstFindUserById;
+    pstQuery = pReader->pstFindUserById;
     dwError = sqlite3_bind_int64(
             pstQuery,
             1,
             (uint64_t)uid
             );
-    BAIL_ON_SQLITE3_ERROR(dwError, sqlite3_errmsg(pConn->pDb));
+    BAIL_ON_SQLITE3_ERROR(dwError, sqlite3_errmsg(pReader->pDb));
 
     dwError = LsaDbQueryObject(pstQuery, &pObject);
     BAIL_ON_LSA_ERROR(dwError);
@@ -801,7 +1141,7 @@ LsaDbFindUserById(
     *ppObject = pObject;
 
 cleanup:
-    LEAVE_SQLITE_LOCK(&pConn->lock, bInLock);
+    LsaDbReleaseReader(pConn, &pReader);
 
     return dwError;
 
@@ -821,17 +1161,17 @@ LsaDbFindGroupByName(
 {
     DWORD dwError = 0;
     PLSA_DB_CONNECTION pConn = (PLSA_DB_CONNECTION)hDb;
-    BOOLEAN bInLock = FALSE;
+    PLSA_DB_READER pReader = NULL;
     // do not free
     sqlite3_stmt *pstQuery = NULL;
     PLSA_SECURITY_OBJECT pObject = NULL;
 
-    ENTER_SQLITE_LOCK(&pConn->lock, bInLock);
+    pReader = LsaDbAcquireReader(pConn);
 
     switch (pGroupNameInfo->nameType)
     {
        case NameType_NT4:
-            pstQuery = pConn->pstFindObjectByNT4;
+            pstQuery = pReader->pstFindObjectByNT4;
             dwError = sqlite3_bind_text(
                     pstQuery,
                     1,
@@ -839,7 +1179,7 @@ LsaDbFindGroupByName(
                     -1, // let sqlite calculate the length
                     SQLITE_TRANSIENT //let sqlite make its own copy
                     );
-            BAIL_ON_SQLITE3_ERROR(dwError, sqlite3_errmsg(pConn->pDb));
+            BAIL_ON_SQLITE3_ERROR(dwError, sqlite3_errmsg(pReader->pDb));
 
             dwError = sqlite3_bind_text(
                     pstQuery,
@@ -848,10 +1188,10 @@ LsaDbFindGroupByName(
                     -1, // let sqlite calculate the length
                     SQLITE_TRANSIENT //let sqlite make its own copy
                     );
-            BAIL_ON_SQLITE3_ERROR(dwError, sqlite3_errmsg(pConn->pDb));
+            BAIL_ON_SQLITE3_ERROR(dwError, sqlite3_errmsg(pReader->pDb));
             break;
        case NameType_Alias:
-            pstQuery = pConn->pstFindGroupByAlias;
+            pstQuery = pReader->pstFindGroupByAlias;
             dwError = sqlite3_bind_text(
                     pstQuery,
                     1,
@@ -859,7 +1199,7 @@ LsaDbFindGroupByName(
                     -1, // let sqlite calculate the length
                     SQLITE_TRANSIENT //let sqlite make its own copy
                     );
-            BAIL_ON_SQLITE3_ERROR(dwError, sqlite3_errmsg(pConn->pDb));
+            BAIL_ON_SQLITE3_ERROR(dwError, sqlite3_errmsg(pReader->pDb));
             break;
        default:
             dwError = LW_ERROR_INTERNAL;
@@ -878,7 +1218,7 @@ LsaDbFindGroupByName(
     *ppObject = pObject;
 
 cleanup:
-    LEAVE_SQLITE_LOCK(&pConn->lock, bInLock);
+    LsaDbReleaseReader(pConn, &pReader);
 
     return dwError;
 
@@ -898,20 +1238,20 @@ LsaDbFindGroupById(
 {
     DWORD dwError = 0;
     PLSA_DB_CONNECTION pConn = (PLSA_DB_CONNECTION)hDb;
-    BOOLEAN bInLock = FALSE;
+    PLSA_DB_READER pReader = NULL;
     // do not free
     sqlite3_stmt *pstQuery = NULL;
     PLSA_SECURITY_OBJECT pObject = NULL;
 
-    ENTER_SQLITE_LOCK(&pConn->lock, bInLock);
+    pReader = LsaDbAcquireReader(pConn);
 
-    pstQuery = pConn->pstFindGroupById;
+    pstQuery = pReader->pstFindGroupById;
     dwError = sqlite3_bind_int64(
             pstQuery,
             1,
             (uint64_t)gid
             );
-    BAIL_ON_SQLITE3_ERROR(dwError, sqlite3_errmsg(pConn->pDb));
+    BAIL_ON_SQLITE3_ERROR(dwError, sqlite3_errmsg(pReader->pDb));
 
     dwError = LsaDbQueryObject(pstQuery, &pObject);
     BAIL_ON_LSA_ERROR(dwError);
@@ -925,7 +1265,7 @@ LsaDbFindGroupById(
     *ppObject = pObject;
 
 cleanup:
-    LEAVE_SQLITE_LOCK(&pConn->lock, bInLock);
+    LsaDbReleaseReader(pConn, &pReader);
 
     return dwError;
 
@@ -1450,6 +1790,13 @@ LsaDbUnpackGroupMembershipInfo(
         &pResult->bIsDomainPrimaryGroup);
     BAIL_ON_LSA_ERROR(dwError);
 
+    dwError = LsaSqliteReadBoolean(
+        pstQuery,
+        piColumnPos,
+        "IsInTokenGroups",
+        &pResult->bIsInTokenGroups);
+    BAIL_ON_LSA_ERROR(dwError);
+
     // Except for NULL entries, memberships must come from the PAC or LDAP.
     if (pResult->pszParentSid != NULL &&
         pResult->pszChildSid != NULL &&
@@ -1909,7 +2256,8 @@ LsaDbAddMembership(
     IN BOOLEAN bIsInPac,
     IN BOOLEAN bIsInPacOnly,
     IN BOOLEAN bIsInLdap,
-    IN BOOLEAN bIsDomainPrimaryGroup
+    IN BOOLEAN bIsDomainPrimaryGroup,
+    IN BOOLEAN bIsInTokenGroups
     )
 {
     DWORD dwError = LW_ERROR_SUCCESS;
@@ -1937,6 +2285,9 @@ LsaDbAddMembership(
     dwError = LsaSqliteBindBoolean(pstQuery, 7, bIsDomainPrimaryGroup);
     BAIL_ON_SQLITE3_ERROR_STMT(dwError, pstQuery);
 
+    dwError = LsaSqliteBindBoolean(pstQuery, 8, bIsInTokenGroups);
+    BAIL_ON_SQLITE3_ERROR_STMT(dwError, pstQuery);
+
     dwError = (DWORD)sqlite3_step(pstQuery);
     if (dwError == SQLITE_DONE)
     {
@@ -1984,7 +2335,9 @@ LsaDbStoreGroupMembershipCallback(
     // Start the transaction
     //
     // 1) Clear all group members for child SID.  However, keep
-    //    the PAC and primary group ones.
+    //    the PAC, primary group and tokenGroups ones.  The tokenGroups
+    //    rows hold the user's expanded (nested) memberships, which the
+    //    direct member list of this group does not describe.
     //
     // 2) Update any remaining PAC items to clear IsInLdap so that we
     //    can set it later in the transaction depending on what membership
@@ -1995,11 +2348,13 @@ LsaDbStoreGroupMembershipCallback(
         "    delete from " LSA_DB_TABLE_NAME_MEMBERSHIP " where\n"
         "        ParentSid = %Q AND\n"
         "        IsInPac = 0 AND\n"
-        "        IsDomainPrimaryGroup = 0;\n"
+        "        IsDomainPrimaryGroup = 0 AND\n"
+        "        IsInTokenGroups = 0;\n"
         // ISSUE-2008/11/03-dalmeida -- Do we want to set update time here?
         "    update OR IGNORE " LSA_DB_TABLE_NAME_MEMBERSHIP " set\n"
         "        IsInLdap = 0\n"
-        "        where ParentSid = %Q AND IsDomainPrimaryGroup = 0;\n"
+        "        where ParentSid = %Q AND IsDomainPrimaryGroup = 0 AND\n"
+        "            IsInTokenGroups = 0;\n"
         "",
         pszParentSid,
         pszParentSid);
@@ -2049,6 +2404,7 @@ LsaDbStoreGroupMembershipCallback(
                         FALSE,
                         FALSE,
                         TRUE,
+                        FALSE,
                         FALSE);
         BAIL_ON_LSA_ERROR(dwError);
     }
@@ -2166,8 +2522,8 @@ LsaDbStoreUserMembershipCallback(
     // 1) Clear all group members for child SID.  However, we keep the
     //    PAC ones unless we have authoritative PAC info.
     //
-    // 2) Update any remaining items to clear IsInLdap and
-    //    IsDomainPrimaryGroup so that we can set them later in the
+    // 2) Update any remaining items to clear IsInLdap,
+    //    IsDomainPrimaryGroup and IsInTokenGroups so that we can set them later in the
     //    transaction depending on what membership info got passed in. The
     //    update time is not changed in here for pac only items because it
     //    refers to the time the data was positively retreived, not when it was
@@ -2180,7 +2536,8 @@ LsaDbStoreUserMembershipCallback(
         "        %s;\n"
         "    update OR IGNORE " LSA_DB_TABLE_NAME_MEMBERSHIP " set\n"
         "        IsInLdap = 0,\n"
-        "        IsDomainPrimaryGroup = 0\n"
+        "        IsDomainPrimaryGroup = 0,\n"
+        "        IsInTokenGroups = 0\n"
         "        where ChildSid = %Q;\n"
         "",
         pszChildSid,
@@ -2234,6 +2591,16 @@ LsaDbStoreUserMembershipCallback(
             BAIL_ON_LSA_ERROR(dwError);
         }
 
+        if (!bIsPacAuthoritative && ppMembers[iMember]->bIsInTokenGroups)
+        {
+            dwError = LsaDbUpdateMembership(
+                            pArgs->pConn->pstSetTokenGroupsMembership,
+                            qwNewCacheId,
+                            ppMembers[iMember]->pszParentSid,
+                            pszChildSid);
+            BAIL_ON_LSA_ERROR(dwError);
+        }
+
         if (ppMembers[iMember]->bIsInPac && !ppMembers[iMember]->bIsInLdap)
         {
             bIsNewEntryInPacOnly = TRUE;
@@ -2248,7 +2615,8 @@ LsaDbStoreUserMembershipCallback(
                         ppMembers[iMember]->bIsInPac,
                         bIsNewEntryInPacOnly,
                         ppMembers[iMember]->bIsInLdap,
-                        ppMembers[iMember]->bIsDomainPrimaryGroup);
+                        ppMembers[iMember]->bIsDomainPrimaryGroup,
+                        ppMembers[iMember]->bIsInTokenGroups);
         BAIL_ON_LSA_ERROR(dwError);
     }
 
@@ -2374,7 +2742,7 @@ LsaDbGetMemberships(
 {
     DWORD dwError = LW_ERROR_SUCCESS;
     PLSA_DB_CONNECTION pConn = (PLSA_DB_CONNECTION)hDb;
-    BOOLEAN bInLock = FALSE;
+    PLSA_DB_READER pReader = NULL;
     // do not free
     sqlite3_stmt *pstQuery = NULL;
     size_t sResultCapacity = 0;
@@ -2385,15 +2753,15 @@ LsaDbGetMemberships(
     int nGotColumns = 0;
     PLSA_GROUP_MEMBERSHIP pMembership = NULL;
 
-    ENTER_SQLITE_LOCK(&pConn->lock, bInLock);
+    pReader = LsaDbAcquireReader(pConn);
 
     if (bIsGroupMembers)
     {
-        pstQuery = pConn->pstGetGroupMembers;
+        pstQuery = pReader->pstGetGroupMembers;
     }
     else
     {
-        pstQuery = pConn->pstGetGroupsForUser;
+        pstQuery = pReader->pstGetGroupsForUser;
     }
 
     dwError = LsaSqliteBindString(pstQuery, 1, pszSid);
@@ -2466,16 +2834,16 @@ LsaDbGetMemberships(
         // No more results found
         dwError = LW_ERROR_SUCCESS;
     }
-    BAIL_ON_SQLITE3_ERROR_DB(dwError, pConn->pDb);
+    BAIL_ON_SQLITE3_ERROR_DB(dwError, pReader->pDb);
 
     dwError = (DWORD)sqlite3_reset(pstQuery);
-    BAIL_ON_SQLITE3_ERROR_DB(dwError, pConn->pDb);
+    BAIL_ON_SQLITE3_ERROR_DB(dwError, pReader->pDb);
 
     *pppResults = ppResults;
     *psCount = sResultCount;
 
 cleanup:
-    LEAVE_SQLITE_LOCK(&pConn->lock, bInLock);
+    LsaDbReleaseReader(pConn, &pReader);
 
     return dwError;
 
@@ -2592,8 +2960,8 @@ LsaDbEnumUsersCache(
 {
     DWORD                 dwError = 0;
     PLSA_DB_CONNECTION    pConn = (PLSA_DB_CONNECTION)hDb;
-    BOOLEAN               bInLock = FALSE;
-    sqlite3_stmt *        pstQuery = pConn->pstEnumUsers;
+    PLSA_DB_READER        pReader = NULL;
+    sqlite3_stmt *        pstQuery = NULL;
     DWORD                 dwUserCount = 0;
     PLSA_SECURITY_OBJECT* ppObjectsLocal = NULL;
 
@@ -2602,7 +2970,8 @@ LsaDbEnumUsersCache(
                   (PVOID*)&ppObjectsLocal);
     BAIL_ON_LSA_ERROR(dwError);
 
-    ENTER_SQLITE_LOCK(&pConn->lock, bInLock);
+    pReader = LsaDbAcquireReader(pConn);
+    pstQuery = pReader->pstEnumUsers;
 
     dwError = sqlite3_bind_text(
                   pstQuery,
@@ -2611,14 +2980,14 @@ LsaDbEnumUsersCache(
                   -1, // let sqlite calculate the length
                   SQLITE_TRANSIENT //let sqlite make its own copy
                   );
-    BAIL_ON_SQLITE3_ERROR(dwError, sqlite3_errmsg(pConn->pDb));
+    BAIL_ON_SQLITE3_ERROR(dwError, sqlite3_errmsg(pReader->pDb));
 
     dwError = sqlite3_bind_int64(
                   pstQuery,
                   2,
                   (uint64_t)dwMaxNumUsers
                   );
-    BAIL_ON_SQLITE3_ERROR(dwError, sqlite3_errmsg(pConn->pDb));
+    BAIL_ON_SQLITE3_ERROR(dwError, sqlite3_errmsg(pReader->pDb));
 
     for ( dwUserCount = 0 ;
           dwUserCount < dwMaxNumUsers ;
@@ -2647,7 +3016,7 @@ LsaDbEnumUsersCache(
 
 cleanup:
 
-    LEAVE_SQLITE_LOCK(&pConn->lock, bInLock);
+    LsaDbReleaseReader(pConn, &pReader);
 
     return dwError;
 
@@ -2675,8 +3044,8 @@ LsaDbEnumGroupsCache(
 {
     DWORD                 dwError = 0;
     PLSA_DB_CONNECTION    pConn = (PLSA_DB_CONNECTION)hDb;
-    BOOLEAN               bInLock = FALSE;
-    sqlite3_stmt *        pstQuery = pConn->pstEnumGroups;
+    PLSA_DB_READER        pReader = NULL;
+    sqlite3_stmt *        pstQuery = NULL;
     DWORD                 dwGroupCount = 0;
     PLSA_SECURITY_OBJECT* ppObjectsLocal = NULL;
 
@@ -2685,7 +3054,8 @@ LsaDbEnumGroupsCache(
                   (PVOID*)&ppObjectsLocal);
     BAIL_ON_LSA_ERROR(dwError);
 
-    ENTER_SQLITE_LOCK(&pConn->lock, bInLock);
+    pReader = LsaDbAcquireReader(pConn);
+    pstQuery = pReader->pstEnumGroups;
 
     dwError = sqlite3_bind_text(
                   pstQuery,
@@ -2694,14 +3064,14 @@ LsaDbEnumGroupsCache(
                   -1, // let sqlite calculate the length
                   SQLITE_TRANSIENT //let sqlite make its own copy
                   );
-    BAIL_ON_SQLITE3_ERROR(dwError, sqlite3_errmsg(pConn->pDb));
+    BAIL_ON_SQLITE3_ERROR(dwError, sqlite3_errmsg(pReader->pDb));
 
     dwError = sqlite3_bind_int64(
                   pstQuery,
                   2,
                   (uint64_t)dwMaxNumGroups
                   );
-    BAIL_ON_SQLITE3_ERROR(dwError, sqlite3_errmsg(pConn->pDb));
+    BAIL_ON_SQLITE3_ERROR(dwError, sqlite3_errmsg(pReader->pDb));
 
     for ( dwGroupCount = 0 ;
           dwGroupCount < dwMaxNumGroups ;
@@ -2730,7 +3100,7 @@ LsaDbEnumGroupsCache(
 
 cleanup:
 
-    LEAVE_SQLITE_LOCK(&pConn->lock, bInLock);
+    LsaDbReleaseReader(pConn, &pReader);
 
     return dwError;
 
@@ -2921,13 +3291,13 @@ LsaDbFindObjectByDN(
 {
     DWORD dwError = 0;
     PLSA_DB_CONNECTION pConn = (PLSA_DB_CONNECTION)hDb;
-    BOOLEAN bInLock = FALSE;
+    PLSA_DB_READER pReader = NULL;
     // do not free
     sqlite3_stmt *pstQuery = NULL;
 
-    ENTER_SQLITE_LOCK(&pConn->lock, bInLock);
+    pReader = LsaDbAcquireReader(pConn);
 
-    pstQuery = pConn->pstFindObjectByDN;
+    pstQuery = pReader->pstFindObjectByDN;
     dwError = sqlite3_bind_text(
             pstQuery,
             1,
@@ -2935,13 +3305,13 @@ LsaDbFindObjectByDN(
             -1, // let sqlite calculate the length
             SQLITE_TRANSIENT //let sqlite make its own copy
             );
-    BAIL_ON_SQLITE3_ERROR(dwError, sqlite3_errmsg(pConn->pDb));
+    BAIL_ON_SQLITE3_ERROR(dwError, sqlite3_errmsg(pReader->pDb));
 
     dwError = LsaDbQueryObject(pstQuery, ppObject);
     BAIL_ON_LSA_ERROR(dwError);
 
 cleanup:
-    LEAVE_SQLITE_LOCK(&pConn->lock, bInLock);
+    LsaDbReleaseReader(pConn, &pReader);
 
     return dwError;
 
@@ -3000,13 +3370,13 @@ LsaDbFindObjectBySid(
 {
     DWORD dwError = 0;
     PLSA_DB_CONNECTION pConn = (PLSA_DB_CONNECTION)hDb;
-    BOOLEAN bInLock = FALSE;
+    PLSA_DB_READER pReader = NULL;
     // do not free
     sqlite3_stmt *pstQuery = NULL;
 
-    ENTER_SQLITE_LOCK(&pConn->lock, bInLock);
+    pReader = LsaDbAcquireReader(pConn);
 
-    pstQuery = pConn->pstFindObjectBySid;
+    pstQuery = pReader->pstFindObjectBySid;
     dwError = sqlite3_bind_text(
             pstQuery,
             1,
@@ -3014,13 +3384,13 @@ LsaDbFindObjectBySid(
             -1, // let sqlite calculate the length
             SQLITE_TRANSIENT //let sqlite make its own copy
             );
-    BAIL_ON_SQLITE3_ERROR(dwError, sqlite3_errmsg(pConn->pDb));
+    BAIL_ON_SQLITE3_ERROR(dwError, sqlite3_errmsg(pReader->pDb));
 
     dwError = LsaDbQueryObject(pstQuery, ppObject);
     BAIL_ON_LSA_ERROR(dwError);
 
 cleanup:
-    LEAVE_SQLITE_LOCK(&pConn->lock, bInLock);
+    LsaDbReleaseReader(pConn, &pReader);
 
     return dwError;
 
@@ -3081,7 +3451,7 @@ LsaDbGetPasswordVerifier(
 {
     DWORD dwError = 0;
     PLSA_DB_CONNECTION pConn = (PLSA_DB_CONNECTION)hDb;
-    BOOLEAN bInLock = FALSE;
+    PLSA_DB_READER pReader = NULL;
     // do not free
     sqlite3_stmt *pstQuery = NULL;
     const int nExpectedCols = 4;
@@ -3089,9 +3459,9 @@ LsaDbGetPasswordVerifier(
     int nGotColumns = 0;
     PLSA_PASSWORD_VERIFIER pResult = NULL;
 
-    ENTER_SQLITE_LOCK(&pConn->lock, bInLock);
+    pReader = LsaDbAcquireReader(pConn);
 
-    pstQuery = pConn->pstGetPasswordVerifier;
+    pstQuery = pReader->pstGetPasswordVerifier;
     dwError = sqlite3_bind_text(
             pstQuery,
             1,
@@ -3099,7 +3469,7 @@ LsaDbGetPasswordVerifier(
             -1, // let sqlite calculate the length
             SQLITE_TRANSIENT //let sqlite make its own copy
             );
-    BAIL_ON_SQLITE3_ERROR(dwError, sqlite3_errmsg(pConn->pDb));
+    BAIL_ON_SQLITE3_ERROR(dwError, sqlite3_errmsg(pReader->pDb));
 
     dwError = (DWORD)sqlite3_step(pstQuery);
     if (dwError == SQLITE_DONE)
@@ -3173,7 +3543,7 @@ LsaDbGetPasswordVerifier(
 
 cleanup:
 
-    LEAVE_SQLITE_LOCK(&pConn->lock, bInLock);
+    LsaDbReleaseReader(pConn, &pReader);
     return dwError;
 
 error:
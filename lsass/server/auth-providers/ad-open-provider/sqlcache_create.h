@@ -51,7 +51,7 @@
 #define LSA_DB_TABLE_NAME_USERS            "lwiusers6"
 #define LSA_DB_TABLE_NAME_VERIFIERS        "lwipasswordverifiers"
 #define LSA_DB_TABLE_NAME_GROUPS           "lwigroups2"
-#define LSA_DB_TABLE_NAME_MEMBERSHIP       "lwigroupmembership2"
+#define LSA_DB_TABLE_NAME_MEMBERSHIP       "lwigroupmembership3"
 
 #define _LSA_DB_SQL_DROP_TABLE(Table) \
     "DROP TABLE IF EXISTS " Table ";\n"
@@ -142,6 +142,10 @@
     _LSA_DB_SQL_DROP_INDEX("lwigroupmembership", "ParentSid") \
     _LSA_DB_SQL_DROP_INDEX("lwigroupmembership", "ChildSid") \
     _LSA_DB_SQL_DROP_TABLE("lwigroupmembership") \
+    _LSA_DB_SQL_DROP_INDEX("lwigroupmembership2", "CacheId") \
+    _LSA_DB_SQL_DROP_INDEX("lwigroupmembership2", "ParentSid") \
+    _LSA_DB_SQL_DROP_INDEX("lwigroupmembership2", "ChildSid") \
+    _LSA_DB_SQL_DROP_TABLE("lwigroupmembership2") \
     "\n" \
     _LSA_DB_SQL_CREATE_TABLE(LSA_DB_TABLE_NAME_MEMBERSHIP) "(\n" \
     "    CacheId integer,\n" \
@@ -151,6 +155,7 @@
     "    IsInPacOnly integer,\n" \
     "    IsInLdap integer,\n" \
     "    IsDomainPrimaryGroup integer,\n" \
+    "    IsInTokenGroups integer,\n" \
     "    UNIQUE (ParentSid, ChildSid)\n" \
     "    );\n" \
     _LSA_DB_SQL_CREATE_INDEX(LSA_DB_TABLE_NAME_MEMBERSHIP, "CacheId") \
@@ -46,17 +46,21 @@
 #ifndef __SQLCACHE_P_H__
 #define __SQLCACHE_P_H__
 
+// How long a connection waits for another connection's lock on the cache
+// database before giving up with SQLITE_BUSY
+#define LSA_DB_BUSY_TIMEOUT_MSECS (5 * 1000)
+
 #define LSA_DB_FREE_UNUSED_CACHEIDS   \
     "delete from " LSA_DB_TABLE_NAME_CACHE_TAGS " where CacheId NOT IN " \
         "( select CacheId from " LSA_DB_TABLE_NAME_MEMBERSHIP " ) AND " \
         "CacheId NOT IN ( select CacheId from " LSA_DB_TABLE_NAME_OBJECTS " ) AND " \
         "CacheId NOT IN ( select CacheId from " LSA_DB_TABLE_NAME_VERIFIERS " );\n"
 
-typedef struct _LSA_DB_CONNECTION
+// A connection that only runs lookups, together with the lookup statements
+// prepared on it.
+typedef struct _LSA_DB_READER
 {
     sqlite3 *pDb;
-    pthread_rwlock_t lock;
-    PLSA_AD_PROVIDER_STATE pProviderState;
 
     sqlite3_stmt *pstFindObjectByNT4;
     sqlite3_stmt *pstFindObjectByDN;
@@ -69,22 +73,45 @@ typedef struct _LSA_DB_CONNECTION
     sqlite3_stmt *pstFindGroupByAlias;
     sqlite3_stmt *pstFindGroupById;
 
-    sqlite3_stmt *pstRemoveObjectBySid;
-    sqlite3_stmt *pstRemoveUserBySid;
-    sqlite3_stmt *pstRemoveGroupBySid;
-
     sqlite3_stmt *pstEnumUsers;
     sqlite3_stmt *pstEnumGroups;
 
     sqlite3_stmt *pstGetGroupMembers;
     sqlite3_stmt *pstGetGroupsForUser;
- 
+
     sqlite3_stmt *pstGetPasswordVerifier;
 
+    struct _LSA_DB_READER *pNext;
+} LSA_DB_READER, *PLSA_DB_READER;
+
+typedef struct _LSA_DB_CONNECTION
+{
+    sqlite3 *pDb;
+    pthread_rwlock_t lock;
+    PLSA_AD_PROVIDER_STATE pProviderState;
+
+    // Lookups on pDb itself. These hold lock like the updates do, and are
+    // only used when no pooled read connection is available.
+    LSA_DB_READER reader;
+
+    // Pool of read-only connections to the same database file. Lookups
+    // check one out instead of taking lock.
+    pthread_mutex_t readerLock;
+    BOOLEAN bReaderLockCreated;
+    PLSA_DB_READER pFreeReaders;
+    DWORD dwReaderCount;
+    DWORD dwMaxReaders;
+    PSTR pszDbPath;
+
+    sqlite3_stmt *pstRemoveObjectBySid;
+    sqlite3_stmt *pstRemoveUserBySid;
+    sqlite3_stmt *pstRemoveGroupBySid;
+
     sqlite3_stmt *pstInsertCacheTag;
     sqlite3_stmt *pstGetLastInsertedRow;
     sqlite3_stmt *pstSetLdapMembership;
     sqlite3_stmt *pstSetPrimaryGroupMembership;
+    sqlite3_stmt *pstSetTokenGroupsMembership;
     sqlite3_stmt *pstAddMembership;
 } LSA_DB_CONNECTION, *PLSA_DB_CONNECTION;
 
@@ -180,7 +207,8 @@ LsaDbAddMembership(
     IN BOOLEAN bIsInPac,
     IN BOOLEAN bIsInPacOnly,
     IN BOOLEAN bIsInLdap,
-    IN BOOLEAN bIsDomainPrimaryGroup
+    IN BOOLEAN bIsDomainPrimaryGroup,
+    IN BOOLEAN bIsInTokenGroups
     );
 
 
@@ -93,6 +93,7 @@
 #include "lpmisc.h"
 #include "lpmarshal.h"
 #include "lpobject.h"
+#include "lpcache.h"
 #include "lpsecurity.h"
 
 #include "externs.h"
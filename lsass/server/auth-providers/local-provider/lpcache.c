@@ -0,0 +1,770 @@
+/* -*- mode: c; c-basic-offset: 4; indent-tabs-mode: nil; tab-width: 4 -*-
+ * ex: set softtabstop=4 tabstop=8 expandtab shiftwidth=4: *
+ * Editor Settings: expandtabs and use 4 spaces for indentation */
+
+/*
+ * Copyright © BeyondTrust Software 2004 - 2019
+ * All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * BEYONDTRUST MAKES THIS SOFTWARE AVAILABLE UNDER OTHER LICENSING TERMS AS
+ * WELL. IF YOU HAVE ENTERED INTO A SEPARATE LICENSE AGREEMENT WITH
+ * BEYONDTRUST, THEN YOU MAY ELECT TO USE THE SOFTWARE UNDER THE TERMS OF THAT
+ * SOFTWARE LICENSE AGREEMENT INSTEAD OF THE TERMS OF THE APACHE LICENSE,
+ * NOTWITHSTANDING THE ABOVE NOTICE.  IF YOU HAVE QUESTIONS, OR WISH TO REQUEST
+ * A COPY OF THE ALTERNATE LICENSING TERMS OFFERED BY BEYONDTRUST, PLEASE CONTACT
+ * BEYONDTRUST AT beyondtrust.com/contact
+ */
+
+/*
+ * Copyright (C) BeyondTrust Software. All rights reserved.
+ *
+ * Module Name:
+ *
+ *        lpcache.c
+ *
+ * Abstract:
+ *
+ *        BeyondTrust Security and Authentication Subsystem (LSASS)
+ *
+ *        Local Authentication Provider
+ *
+ *        In-memory object and membership cache
+ *
+ *        Users and groups are kept indexed by SID, NT4 name and uid/gid,
+ *        together with the direct group memberships of each SID, so that
+ *        repeated lookups do not go through the directory and sqlite.
+ *        Everything is tagged with the directory change count sampled
+ *        before it was read and thrown away as soon as the directory
+ *        reports a newer count, i.e. after any add, modify, delete,
+ *        password or membership change in the SAM database.
+ */
+
+#include "includes.h"
+
+static
+VOID
+LocalCacheFreeObjectEntry(
+    const LW_HASH_ENTRY* pEntry
+    )
+{
+    // The key is the object's own SID string
+    LsaUtilFreeSecurityObject((PLSA_SECURITY_OBJECT)pEntry->pValue);
+}
+
+static
+VOID
+LocalCacheFreeMembershipEntry(
+    const LW_HASH_ENTRY* pEntry
+    )
+{
+    PLOCAL_CACHE_MEMBERSHIP pMembership =
+        (PLOCAL_CACHE_MEMBERSHIP)pEntry->pValue;
+
+    LwFreeMemory(pEntry->pKey);
+
+    if (pMembership)
+    {
+        LwFreeStringArray(
+            pMembership->ppszGroupSids,
+            pMembership->dwGroupSidCount);
+        LwFreeMemory(pMembership);
+    }
+}
+
+static
+VOID
+LocalCacheFlush_inlock(
+    PLOCAL_OBJECT_CACHE pCache
+    )
+{
+    // The secondary indexes point into pObjectsBySid
+    LwHashSafeFree(&pCache->pObjectsByName);
+    LwHashSafeFree(&pCache->pUsersByUid);
+    LwHashSafeFree(&pCache->pGroupsByGid);
+    LwHashSafeFree(&pCache->pObjectsBySid);
+    LwHashSafeFree(&pCache->pMembershipsBySid);
+}
+
+/*
+ * Moves the cache forward to ullChangeCount, dropping everything read at
+ * an older count.  Returns FALSE if the caller sampled its count before
+ * the cache was last moved forward, in which case what it has read may
+ * already be stale and must neither be served nor stored.
+ */
+static
+BOOLEAN
+LocalCacheSyncChangeCount_inlock(
+    PLOCAL_OBJECT_CACHE pCache,
+    ULONG64 ullChangeCount
+    )
+{
+    if (ullChangeCount < pCache->ullChangeCount)
+    {
+        return FALSE;
+    }
+
+    if (ullChangeCount > pCache->ullChangeCount)
+    {
+        LocalCacheFlush_inlock(pCache);
+        pCache->ullChangeCount = ullChangeCount;
+    }
+
+    return TRUE;
+}
+
+static
+DWORD
+LocalCacheCreateObjectTables_inlock(
+    PLOCAL_OBJECT_CACHE pCache
+    )
+{
+    DWORD dwError = 0;
+
+    if (pCache->pObjectsBySid)
+    {
+        goto cleanup;
+    }
+
+    dwError = LwHashCreate(
+                    61,
+                    LwHashCaselessStringCompare,
+                    LwHashCaselessStringHash,
+                    LocalCacheFreeObjectEntry,
+                    NULL,
+                    &pCache->pObjectsBySid);
+    BAIL_ON_LSA_ERROR(dwError);
+
+    dwError = LwHashCreate(
+                    61,
+                    LwHashCaselessStringCompare,
+                    LwHashCaselessStringHash,
+                    LwHashFreeStringKey,
+                    NULL,
+                    &pCache->pObjectsByName);
+    BAIL_ON_LSA_ERROR(dwError);
+
+    dwError = LwHashCreate(
+                    61,
+                    LwHashPVoidCompare,
+                    LwHashPVoidHash,
+                    NULL,
+                    NULL,
+                    &pCache->pUsersByUid);
+    BAIL_ON_LSA_ERROR(dwError);
+
+    dwError = LwHashCreate(
+                    61,
+                    LwHashPVoidCompare,
+                    LwHashPVoidHash,
+                    NULL,
+                    NULL,
+                    &pCache->pGroupsByGid);
+    BAIL_ON_LSA_ERROR(dwError);
+
+cleanup:
+
+    return dwError;
+
+error:
+
+    LwHashSafeFree(&pCache->pObjectsByName);
+    LwHashSafeFree(&pCache->pUsersByUid);
+    LwHashSafeFree(&pCache->pGroupsByGid);
+    LwHashSafeFree(&pCache->pObjectsBySid);
+
+    goto cleanup;
+}
+
+static
+DWORD
+LocalCacheDuplicateObject(
+    PLSA_SECURITY_OBJECT pSrc,
+    PLSA_SECURITY_OBJECT* ppDest
+    )
+{
+    DWORD dwError = 0;
+    PLSA_SECURITY_OBJECT pDest = NULL;
+
+    dwError = LwAllocateMemory(
+                    sizeof(*pDest),
+                    OUT_PPVOID(&pDest));
+    BAIL_ON_LSA_ERROR(dwError);
+
+    pDest->version  = pSrc->version;
+    pDest->enabled  = pSrc->enabled;
+    pDest->bIsLocal = pSrc->bIsLocal;
+    pDest->type     = pSrc->type;
+
+    dwError = LwStrDupOrNull(pSrc->pszDN, &pDest->pszDN);
+    BAIL_ON_LSA_ERROR(dwError);
+
+    dwError = LwStrDupOrNull(pSrc->pszObjectSid, &pDest->pszObjectSid);
+    BAIL_ON_LSA_ERROR(dwError);
+
+    dwError = LwStrDupOrNull(
+                    pSrc->pszNetbiosDomainName,
+                    &pDest->pszNetbiosDomainName);
+    BAIL_ON_LSA_ERROR(dwError);
+
+    dwError = LwStrDupOrNull(
+                    pSrc->pszSamAccountName,
+                    &pDest->pszSamAccountName);
+    BAIL_ON_LSA_ERROR(dwError);
+
+    switch (pSrc->type)
+    {
+    case LSA_OBJECT_TYPE_USER:
+        pDest->userInfo.uid = pSrc->userInfo.uid;
+        pDest->userInfo.gid = pSrc->userInfo.gid;
+
+        pDest->userInfo.qwPwdLastSet     = pSrc->userInfo.qwPwdLastSet;
+        pDest->userInfo.qwMaxPwdAge      = pSrc->userInfo.qwMaxPwdAge;
+        pDest->userInfo.qwPwdExpires     = pSrc->userInfo.qwPwdExpires;
+        pDest->userInfo.qwAccountExpires = pSrc->userInfo.qwAccountExpires;
+
+        pDest->userInfo.bIsGeneratedUPN        = pSrc->userInfo.bIsGeneratedUPN;
+        pDest->userInfo.bIsAccountInfoKnown    = pSrc->userInfo.bIsAccountInfoKnown;
+        pDest->userInfo.bPasswordExpired       = pSrc->userInfo.bPasswordExpired;
+        pDest->userInfo.bPasswordNeverExpires  = pSrc->userInfo.bPasswordNeverExpires;
+        pDest->userInfo.bPromptPasswordChange  = pSrc->userInfo.bPromptPasswordChange;
+        pDest->userInfo.bUserCanChangePassword = pSrc->userInfo.bUserCanChangePassword;
+        pDest->userInfo.bAccountDisabled       = pSrc->userInfo.bAccountDisabled;
+        pDest->userInfo.bAccountExpired        = pSrc->userInfo.bAccountExpired;
+        pDest->userInfo.bAccountLocked         = pSrc->userInfo.bAccountLocked;
+
+        dwError = LwStrDupOrNull(
+                        pSrc->userInfo.pszPrimaryGroupSid,
+                        &pDest->userInfo.pszPrimaryGroupSid);
+        BAIL_ON_LSA_ERROR(dwError);
+
+        dwError = LwStrDupOrNull(
+                        pSrc->userInfo.pszUPN,
+                        &pDest->userInfo.pszUPN);
+        BAIL_ON_LSA_ERROR(dwError);
+
+        dwError = LwStrDupOrNull(
+                        pSrc->userInfo.pszAliasName,
+                        &pDest->userInfo.pszAliasName);
+        BAIL_ON_LSA_ERROR(dwError);
+
+        dwError = LwStrDupOrNull(
+                        pSrc->userInfo.pszUnixName,
+                        &pDest->userInfo.pszUnixName);
+        BAIL_ON_LSA_ERROR(dwError);
+
+        dwError = LwStrDupOrNull(
+                        pSrc->userInfo.pszPasswd,
+                        &pDest->userInfo.pszPasswd);
+        BAIL_ON_LSA_ERROR(dwError);
+
+        dwError = LwStrDupOrNull(
+                        pSrc->userInfo.pszGecos,
+                        &pDest->userInfo.pszGecos);
+        BAIL_ON_LSA_ERROR(dwError);
+
+        dwError = LwStrDupOrNull(
+                        pSrc->userInfo.pszShell,
+                        &pDest->userInfo.pszShell);
+        BAIL_ON_LSA_ERROR(dwError);
+
+        dwError = LwStrDupOrNull(
+                        pSrc->userInfo.pszHomedir,
+                        &pDest->userInfo.pszHomedir);
+        BAIL_ON_LSA_ERROR(dwError);
+
+        dwError = LwStrDupOrNull(
+                        pSrc->userInfo.pszDisplayName,
+                        &pDest->userInfo.pszDisplayName);
+        BAIL_ON_LSA_ERROR(dwError);
+
+        dwError = LwStrDupOrNull(
+                        pSrc->userInfo.pszWindowsHomeFolder,
+                        &pDest->userInfo.pszWindowsHomeFolder);
+        BAIL_ON_LSA_ERROR(dwError);
+
+        dwError = LwStrDupOrNull(
+                        pSrc->userInfo.pszLocalWindowsHomeFolder,
+                        &pDest->userInfo.pszLocalWindowsHomeFolder);
+        BAIL_ON_LSA_ERROR(dwError);
+
+        if (pSrc->userInfo.pLmHash)
+        {
+            dwError = LwAllocateMemory(
+                            pSrc->userInfo.dwLmHashLen,
+                            OUT_PPVOID(&pDest->userInfo.pLmHash));
+            BAIL_ON_LSA_ERROR(dwError);
+
+            memcpy(pDest->userInfo.pLmHash,
+                   pSrc->userInfo.pLmHash,
+                   pSrc->userInfo.dwLmHashLen);
+            pDest->userInfo.dwLmHashLen = pSrc->userInfo.dwLmHashLen;
+        }
+
+        if (pSrc->userInfo.pNtHash)
+        {
+            dwError = LwAllocateMemory(
+                            pSrc->userInfo.dwNtHashLen,
+                            OUT_PPVOID(&pDest->userInfo.pNtHash));
+            BAIL_ON_LSA_ERROR(dwError);
+
+            memcpy(pDest->userInfo.pNtHash,
+                   pSrc->userInfo.pNtHash,
+                   pSrc->userInfo.dwNtHashLen);
+            pDest->userInfo.dwNtHashLen = pSrc->userInfo.dwNtHashLen;
+        }
+        break;
+
+    case LSA_OBJECT_TYPE_GROUP:
+        pDest->groupInfo.gid = pSrc->groupInfo.gid;
+
+        dwError = LwStrDupOrNull(
+                        pSrc->groupInfo.pszAliasName,
+                        &pDest->groupInfo.pszAliasName);
+        BAIL_ON_LSA_ERROR(dwError);
+
+        dwError = LwStrDupOrNull(
+                        pSrc->groupInfo.pszUnixName,
+                        &pDest->groupInfo.pszUnixName);
+        BAIL_ON_LSA_ERROR(dwError);
+
+        dwError = LwStrDupOrNull(
+                        pSrc->groupInfo.pszPasswd,
+                        &pDest->groupInfo.pszPasswd);
+        BAIL_ON_LSA_ERROR(dwError);
+        break;
+    }
+
+    *ppDest = pDest;
+
+cleanup:
+
+    return dwError;
+
+error:
+
+    LsaUtilFreeSecurityObject(pDest);
+    *ppDest = NULL;
+
+    goto cleanup;
+}
+
+DWORD
+LocalCacheGetChangeCount(
+    IN HANDLE hDirectory,
+    OUT PULONG64 pullChangeCount
+    )
+{
+    return DirectoryGetChangeCount(hDirectory, pullChangeCount);
+}
+
+/*
+ * Name lookups use "NETBIOS\name" as the key, matching the
+ * NetBIOSName/SamAccountName filter used against the directory.
+ * Returns ERROR_NOT_FOUND on a miss.
+ */
+DWORD
+LocalCacheFindObject(
+    IN ULONG64 ullChangeCount,
+    IN LSA_OBJECT_TYPE ObjectType,
+    IN LSA_QUERY_TYPE QueryType,
+    IN LSA_QUERY_ITEM QueryItem,
+    OUT PLSA_SECURITY_OBJECT* ppObject
+    )
+{
+    DWORD dwError = 0;
+    PLOCAL_OBJECT_CACHE pCache = &gLPGlobals.cache;
+    BOOLEAN bInLock = FALSE;
+    PLSA_SECURITY_OBJECT pCached = NULL;
+    PLSA_SECURITY_OBJECT pObject = NULL;
+
+    LOCAL_LOCK_MUTEX(bInLock, &pCache->mutex);
+
+    if (!LocalCacheSyncChangeCount_inlock(pCache, ullChangeCount) ||
+        !pCache->pObjectsBySid)
+    {
+        dwError = ERROR_NOT_FOUND;
+        BAIL_ON_LSA_ERROR(dwError);
+    }
+
+    switch (QueryType)
+    {
+    case LSA_QUERY_TYPE_BY_SID:
+        dwError = LwHashGetValue(
+                        pCache->pObjectsBySid,
+                        QueryItem.pszString,
+                        OUT_PPVOID(&pCached));
+        break;
+    case LSA_QUERY_TYPE_BY_NT4:
+        dwError = LwHashGetValue(
+                        pCache->pObjectsByName,
+                        QueryItem.pszString,
+                        OUT_PPVOID(&pCached));
+        break;
+    case LSA_QUERY_TYPE_BY_UNIX_ID:
+        if (ObjectType == LSA_OBJECT_TYPE_USER)
+        {
+            dwError = LwHashGetValue(
+                            pCache->pUsersByUid,
+                            (PCVOID)(size_t)QueryItem.dwId,
+                            OUT_PPVOID(&pCached));
+        }
+        else if (ObjectType == LSA_OBJECT_TYPE_GROUP)
+        {
+            dwError = LwHashGetValue(
+                            pCache->pGroupsByGid,
+                            (PCVOID)(size_t)QueryItem.dwId,
+                            OUT_PPVOID(&pCached));
+        }
+        else
+        {
+            dwError = ERROR_NOT_FOUND;
+        }
+        break;
+    default:
+        dwError = ERROR_NOT_FOUND;
+        break;
+    }
+    BAIL_ON_LSA_ERROR(dwError);
+
+    if (ObjectType != LSA_OBJECT_TYPE_UNDEFINED &&
+        ObjectType != pCached->type)
+    {
+        dwError = ERROR_NOT_FOUND;
+        BAIL_ON_LSA_ERROR(dwError);
+    }
+
+    dwError = LocalCacheDuplicateObject(pCached, &pObject);
+    BAIL_ON_LSA_ERROR(dwError);
+
+    LOCAL_UNLOCK_MUTEX(bInLock, &pCache->mutex);
+
+    // Password and account expiry depend on the current time
+    dwError = LocalMarshalRefreshAccountInfo(pObject);
+    BAIL_ON_LSA_ERROR(dwError);
+
+    *ppObject = pObject;
+
+cleanup:
+
+    LOCAL_UNLOCK_MUTEX(bInLock, &pCache->mutex);
+
+    return dwError;
+
+error:
+
+    LsaUtilFreeSecurityObject(pObject);
+    *ppObject = NULL;
+
+    goto cleanup;
+}
+
+VOID
+LocalCacheAddObject(
+    IN ULONG64 ullChangeCount,
+    IN PLSA_SECURITY_OBJECT pObject
+    )
+{
+    DWORD dwError = 0;
+    PLOCAL_OBJECT_CACHE pCache = &gLPGlobals.cache;
+    BOOLEAN bInLock = FALSE;
+    PLSA_SECURITY_OBJECT pCached = NULL;
+    PLSA_SECURITY_OBJECT pIndexed = NULL;
+    PLSA_SECURITY_OBJECT pExisting = NULL;
+    PSTR pszName = NULL;
+
+    if (!pObject->pszObjectSid ||
+        !pObject->pszNetbiosDomainName ||
+        !pObject->pszSamAccountName)
+    {
+        goto cleanup;
+    }
+
+    dwError = LocalCacheDuplicateObject(pObject, &pCached);
+    BAIL_ON_LSA_ERROR(dwError);
+
+    dwError = LwAllocateStringPrintf(
+                    &pszName,
+                    "%s\\%s",
+                    pCached->pszNetbiosDomainName,
+                    pCached->pszSamAccountName);
+    BAIL_ON_LSA_ERROR(dwError);
+
+    LOCAL_LOCK_MUTEX(bInLock, &pCache->mutex);
+
+    if (!LocalCacheSyncChangeCount_inlock(pCache, ullChangeCount))
+    {
+        goto cleanup;
+    }
+
+    if (pCache->pObjectsBySid &&
+        LwHashGetKeyCount(pCache->pObjectsBySid) >= LOCAL_CACHE_MAX_OBJECTS)
+    {
+        LwHashSafeFree(&pCache->pObjectsByName);
+        LwHashSafeFree(&pCache->pUsersByUid);
+        LwHashSafeFree(&pCache->pGroupsByGid);
+        LwHashSafeFree(&pCache->pObjectsBySid);
+    }
+
+    dwError = LocalCacheCreateObjectTables_inlock(pCache);
+    BAIL_ON_LSA_ERROR(dwError);
+
+    if (LwHashExists(pCache->pObjectsBySid, pCached->pszObjectSid))
+    {
+        goto cleanup;
+    }
+
+    // Names are unique within a domain, but never let a second object
+    // shadow the first under the same key.
+    if (LwHashGetValue(
+            pCache->pObjectsByName,
+            pszName,
+            OUT_PPVOID(&pExisting)) == 0)
+    {
+        goto cleanup;
+    }
+
+    dwError = LwHashSetValue(
+                    pCache->pObjectsBySid,
+                    pCached->pszObjectSid,
+                    pCached);
+    BAIL_ON_LSA_ERROR(dwError);
+    pIndexed = pCached;
+    pCached = NULL;
+
+    dwError = LwHashSetValue(
+                    pCache->pObjectsByName,
+                    pszName,
+                    pIndexed);
+    BAIL_ON_LSA_ERROR(dwError);
+    pszName = NULL;
+
+    if (pIndexed->type == LSA_OBJECT_TYPE_USER)
+    {
+        dwError = LwHashSetValue(
+                        pCache->pUsersByUid,
+                        (PVOID)(size_t)pIndexed->userInfo.uid,
+                        pIndexed);
+        BAIL_ON_LSA_ERROR(dwError);
+    }
+    else if (pIndexed->type == LSA_OBJECT_TYPE_GROUP)
+    {
+        dwError = LwHashSetValue(
+                        pCache->pGroupsByGid,
+                        (PVOID)(size_t)pIndexed->groupInfo.gid,
+                        pIndexed);
+        BAIL_ON_LSA_ERROR(dwError);
+    }
+
+cleanup:
+
+    LOCAL_UNLOCK_MUTEX(bInLock, &pCache->mutex);
+
+    LsaUtilFreeSecurityObject(pCached);
+    LW_SAFE_FREE_STRING(pszName);
+
+    return;
+
+error:
+
+    // A partially indexed object would be found by some keys only
+    if (bInLock)
+    {
+        LocalCacheFlush_inlock(pCache);
+    }
+
+    goto cleanup;
+}
+
+/*
+ * Returns the direct parent group SIDs of pszSid, or ERROR_NOT_FOUND
+ * if they have not been cached at the current change count.
+ */
+DWORD
+LocalCacheFindMemberOf(
+    IN ULONG64 ullChangeCount,
+    IN PCSTR pszSid,
+    OUT PDWORD pdwGroupSidCount,
+    OUT PSTR** pppszGroupSids
+    )
+{
+    DWORD dwError = 0;
+    PLOCAL_OBJECT_CACHE pCache = &gLPGlobals.cache;
+    BOOLEAN bInLock = FALSE;
+    PLOCAL_CACHE_MEMBERSHIP pMembership = NULL;
+    PSTR* ppszGroupSids = NULL;
+    DWORD dwIndex = 0;
+
+    LOCAL_LOCK_MUTEX(bInLock, &pCache->mutex);
+
+    if (!LocalCacheSyncChangeCount_inlock(pCache, ullChangeCount) ||
+        !pCache->pMembershipsBySid)
+    {
+        dwError = ERROR_NOT_FOUND;
+        BAIL_ON_LSA_ERROR(dwError);
+    }
+
+    dwError = LwHashGetValue(
+                    pCache->pMembershipsBySid,
+                    pszSid,
+                    OUT_PPVOID(&pMembership));
+    BAIL_ON_LSA_ERROR(dwError);
+
+    if (pMembership->dwGroupSidCount)
+    {
+        dwError = LwAllocateMemory(
+                        sizeof(*ppszGroupSids) * pMembership->dwGroupSidCount,
+                        OUT_PPVOID(&ppszGroupSids));
+        BAIL_ON_LSA_ERROR(dwError);
+
+        for (dwIndex = 0; dwIndex < pMembership->dwGroupSidCount; dwIndex++)
+        {
+            dwError = LwAllocateString(
+                            pMembership->ppszGroupSids[dwIndex],
+                            &ppszGroupSids[dwIndex]);
+            BAIL_ON_LSA_ERROR(dwError);
+        }
+    }
+
+    *pdwGroupSidCount = pMembership->dwGroupSidCount;
+    *pppszGroupSids = ppszGroupSids;
+
+cleanup:
+
+    LOCAL_UNLOCK_MUTEX(bInLock, &pCache->mutex);
+
+    return dwError;
+
+error:
+
+    if (ppszGroupSids)
+    {
+        LwFreeStringArray(ppszGroupSids, pMembership->dwGroupSidCount);
+    }
+
+    *pdwGroupSidCount = 0;
+    *pppszGroupSids = NULL;
+
+    goto cleanup;
+}
+
+VOID
+LocalCacheAddMemberOf(
+    IN ULONG64 ullChangeCount,
+    IN PCSTR pszSid,
+    IN DWORD dwGroupSidCount,
+    IN PSTR* ppszGroupSids
+    )
+{
+    DWORD dwError = 0;
+    PLOCAL_OBJECT_CACHE pCache = &gLPGlobals.cache;
+    BOOLEAN bInLock = FALSE;
+    PLOCAL_CACHE_MEMBERSHIP pMembership = NULL;
+    PSTR pszKey = NULL;
+    DWORD dwIndex = 0;
+
+    dwError = LwAllocateMemory(
+                    sizeof(*pMembership),
+                    OUT_PPVOID(&pMembership));
+    BAIL_ON_LSA_ERROR(dwError);
+
+    if (dwGroupSidCount)
+    {
+        dwError = LwAllocateMemory(
+                        sizeof(*pMembership->ppszGroupSids) * dwGroupSidCount,
+                        OUT_PPVOID(&pMembership->ppszGroupSids));
+        BAIL_ON_LSA_ERROR(dwError);
+
+        pMembership->dwGroupSidCount = dwGroupSidCount;
+
+        for (dwIndex = 0; dwIndex < dwGroupSidCount; dwIndex++)
+        {
+            dwError = LwAllocateString(
+                            ppszGroupSids[dwIndex],
+                            &pMembership->ppszGroupSids[dwIndex]);
+            BAIL_ON_LSA_ERROR(dwError);
+        }
+    }
+
+    dwError = LwAllocateString(pszSid, &pszKey);
+    BAIL_ON_LSA_ERROR(dwError);
+
+    LOCAL_LOCK_MUTEX(bInLock, &pCache->mutex);
+
+    if (!LocalCacheSyncChangeCount_inlock(pCache, ullChangeCount))
+    {
+        goto cleanup;
+    }
+
+    if (pCache->pMembershipsBySid &&
+        LwHashGetKeyCount(pCache->pMembershipsBySid) >= LOCAL_CACHE_MAX_MEMBERSHIPS)
+    {
+        LwHashSafeFree(&pCache->pMembershipsBySid);
+    }
+
+    if (!pCache->pMembershipsBySid)
+    {
+        dwError = LwHashCreate(
+                        61,
+                        LwHashCaselessStringCompare,
+                        LwHashCaselessStringHash,
+                        LocalCacheFreeMembershipEntry,
+                        NULL,
+                        &pCache->pMembershipsBySid);
+        BAIL_ON_LSA_ERROR(dwError);
+    }
+
+    dwError = LwHashSetValue(
+                    pCache->pMembershipsBySid,
+                    pszKey,
+                    pMembership);
+    BAIL_ON_LSA_ERROR(dwError);
+    pszKey = NULL;
+    pMembership = NULL;
+
+cleanup:
+
+    LOCAL_UNLOCK_MUTEX(bInLock, &pCache->mutex);
+
+    LW_SAFE_FREE_STRING(pszKey);
+
+    if (pMembership)
+    {
+        LwFreeStringArray(
+            pMembership->ppszGroupSids,
+            pMembership->dwGroupSidCount);
+        LwFreeMemory(pMembership);
+    }
+
+    return;
+
+error:
+
+    goto cleanup;
+}
+
+VOID
+LocalCacheFlush(
+    VOID
+    )
+{
+    PLOCAL_OBJECT_CACHE pCache = &gLPGlobals.cache;
+    BOOLEAN bInLock = FALSE;
+
+    LOCAL_LOCK_MUTEX(bInLock, &pCache->mutex);
+
+    LocalCacheFlush_inlock(pCache);
+
+    LOCAL_UNLOCK_MUTEX(bInLock, &pCache->mutex);
+}
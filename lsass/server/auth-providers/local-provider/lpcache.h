@@ -0,0 +1,91 @@
+/* -*- mode: c; c-basic-offset: 4; indent-tabs-mode: nil; tab-width: 4 -*-
+ * ex: set softtabstop=4 tabstop=8 expandtab shiftwidth=4: *
+ * Editor Settings: expandtabs and use 4 spaces for indentation */
+
+/*
+ * Copyright © BeyondTrust Software 2004 - 2019
+ * All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * BEYONDTRUST MAKES THIS SOFTWARE AVAILABLE UNDER OTHER LICENSING TERMS AS
+ * WELL. IF YOU HAVE ENTERED INTO A SEPARATE LICENSE AGREEMENT WITH
+ * BEYONDTRUST, THEN YOU MAY ELECT TO USE THE SOFTWARE UNDER THE TERMS OF THAT
+ * SOFTWARE LICENSE AGREEMENT INSTEAD OF THE TERMS OF THE APACHE LICENSE,
+ * NOTWITHSTANDING THE ABOVE NOTICE.  IF YOU HAVE QUESTIONS, OR WISH TO REQUEST
+ * A COPY OF THE ALTERNATE LICENSING TERMS OFFERED BY BEYONDTRUST, PLEASE CONTACT
+ * BEYONDTRUST AT beyondtrust.com/contact
+ */
+
+/*
+ * Copyright (C) BeyondTrust Software. All rights reserved.
+ *
+ * Module Name:
+ *
+ *        lpcache.h
+ *
+ * Abstract:
+ *
+ *        BeyondTrust Security and Authentication Subsystem (LSASS)
+ *
+ *        Local Authentication Provider
+ *
+ *        In-memory object and membership cache
+ *
+ */
+#ifndef __LP_CACHE_H__
+#define __LP_CACHE_H__
+
+DWORD
+LocalCacheGetChangeCount(
+    IN HANDLE hDirectory,
+    OUT PULONG64 pullChangeCount
+    );
+
+DWORD
+LocalCacheFindObject(
+    IN ULONG64 ullChangeCount,
+    IN LSA_OBJECT_TYPE ObjectType,
+    IN LSA_QUERY_TYPE QueryType,
+    IN LSA_QUERY_ITEM QueryItem,
+    OUT PLSA_SECURITY_OBJECT* ppObject
+    );
+
+VOID
+LocalCacheAddObject(
+    IN ULONG64 ullChangeCount,
+    IN PLSA_SECURITY_OBJECT pObject
+    );
+
+DWORD
+LocalCacheFindMemberOf(
+    IN ULONG64 ullChangeCount,
+    IN PCSTR pszSid,
+    OUT PDWORD pdwGroupSidCount,
+    OUT PSTR** pppszGroupSids
+    );
+
+VOID
+LocalCacheAddMemberOf(
+    IN ULONG64 ullChangeCount,
+    IN PCSTR pszSid,
+    IN DWORD dwGroupSidCount,
+    IN PSTR* ppszGroupSids
+    );
+
+VOID
+LocalCacheFlush(
+    VOID
+    );
+
+#endif /* __LP_CACHE_H__ */
@@ -91,5 +91,6 @@ LSA_PROVIDER_FUNCTION_TABLE gLocalProviderAPITable =
 LOCAL_PROVIDER_GLOBALS gLPGlobals =
 {
     .pszBuiltinDomain = "BUILTIN",
-    .pSecCtx          = NULL
+    .pSecCtx          = NULL,
+    .cache            = { .mutex = PTHREAD_MUTEX_INITIALIZER }
 };
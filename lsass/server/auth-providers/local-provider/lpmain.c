@@ -1017,6 +1017,9 @@ LocalRefreshConfiguration(
 
     LOCAL_UNLOCK_MUTEX(bInLock, &gLPGlobals.cfgMutex);
 
+    // Cached objects were marshalled with the old settings
+    LocalCacheFlush();
+
     if (LsaSrvEventlogEnabled())
     {
         LocalEventLogConfigReload();
@@ -1313,6 +1316,8 @@ LocalShutdownProvider(
 
     LOCAL_WRLOCK_RWLOCK(bLocked, &gLPGlobals.rwlock);
 
+    LocalCacheFlush();
+
     LwMapSecurityFreeContext(&gLPGlobals.pSecCtx);
 
     LW_SAFE_FREE_STRING(gLPGlobals.pszLocalDomain);
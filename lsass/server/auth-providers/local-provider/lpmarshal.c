@@ -169,6 +169,45 @@ error:
     return dwError;
 }
 
+/*
+ * Recompute the time dependent account state of a user object that was
+ * marshalled earlier, e.g. one handed out from the object cache.
+ */
+DWORD
+LocalMarshalRefreshAccountInfo(
+    PLSA_SECURITY_OBJECT pObject
+    )
+{
+    DWORD dwError = 0;
+    DWORD dwAccountFlags = 0;
+
+    if (pObject->type != LSA_OBJECT_TYPE_USER)
+    {
+        return dwError;
+    }
+
+    if (pObject->userInfo.bPasswordNeverExpires)
+    {
+        dwAccountFlags |= LOCAL_ACB_PWNOEXP;
+    }
+
+    if (pObject->userInfo.bAccountDisabled)
+    {
+        dwAccountFlags |= LOCAL_ACB_DISABLED;
+    }
+
+    dwError = LocalMarshalAccountFlagsToSecurityObject(
+        pObject,
+        dwAccountFlags,
+        (LONG64)pObject->userInfo.qwPwdLastSet,
+        (LONG64)pObject->userInfo.qwAccountExpires);
+    BAIL_ON_LSA_ERROR(dwError);
+
+error:
+
+    return dwError;
+}
+
 DWORD
 LocalMarshalAttrToInteger(
     PDIRECTORY_ENTRY pEntry,
@@ -112,4 +112,9 @@ LocalMarshalEntryToSecurityObject(
     PLSA_SECURITY_OBJECT* ppObject
     );
 
+DWORD
+LocalMarshalRefreshAccountInfo(
+    PLSA_SECURITY_OBJECT pObject
+    );
+
 #endif /* __LP_MARSHAL_H__ */
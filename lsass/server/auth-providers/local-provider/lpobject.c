@@ -218,6 +218,89 @@ error:
     goto cleanup;
 }
 
+static
+DWORD
+LocalDirFindCachedObject(
+    IN ULONG64 ullChangeCount,
+    IN LSA_OBJECT_TYPE ObjectType,
+    IN LSA_QUERY_TYPE QueryType,
+    IN LSA_QUERY_LIST QueryList,
+    IN DWORD dwIndex,
+    OUT PLSA_SECURITY_OBJECT* ppObject
+    )
+{
+    DWORD dwError = 0;
+    LSA_QUERY_ITEM QueryItem = {0};
+    PLSA_LOGIN_NAME_INFO pLoginInfo = NULL;
+    PSTR pszName = NULL;
+    BOOLEAN bLocked = FALSE;
+
+    *ppObject = NULL;
+
+    switch (QueryType)
+    {
+    case LSA_QUERY_TYPE_BY_SID:
+        QueryItem.pszString = QueryList.ppszStrings[dwIndex];
+        break;
+
+    case LSA_QUERY_TYPE_BY_UNIX_ID:
+        QueryItem.dwId = QueryList.pdwIds[dwIndex];
+        break;
+
+    case LSA_QUERY_TYPE_BY_ALIAS:
+    case LSA_QUERY_TYPE_BY_NT4:
+        dwError = LsaSrvCrackDomainQualifiedName(
+            QueryList.ppszStrings[dwIndex],
+            &pLoginInfo);
+        BAIL_ON_LSA_ERROR(dwError);
+
+        LOCAL_RDLOCK_RWLOCK(bLocked, &gLPGlobals.rwlock);
+
+        dwError = LwAllocateStringPrintf(
+            &pszName,
+            "%s\\%s",
+            pLoginInfo->pszDomain ?
+                pLoginInfo->pszDomain : gLPGlobals.pszNetBIOSName,
+            pLoginInfo->pszName);
+        BAIL_ON_LSA_ERROR(dwError);
+
+        LOCAL_UNLOCK_RWLOCK(bLocked, &gLPGlobals.rwlock);
+
+        QueryItem.pszString = pszName;
+        QueryType = LSA_QUERY_TYPE_BY_NT4;
+        break;
+
+    default:
+        goto cleanup;
+    }
+
+    dwError = LocalCacheFindObject(
+        ullChangeCount,
+        ObjectType,
+        QueryType,
+        QueryItem,
+        ppObject);
+    if (dwError == ERROR_NOT_FOUND)
+    {
+        dwError = 0;
+    }
+    BAIL_ON_LSA_ERROR(dwError);
+
+cleanup:
+    LOCAL_UNLOCK_RWLOCK(bLocked, &gLPGlobals.rwlock);
+    LW_SAFE_FREE_STRING(pszName);
+
+    if (pLoginInfo)
+    {
+        LsaSrvFreeNameInfo(pLoginInfo);
+    }
+
+    return dwError;
+
+error:
+
+    goto cleanup;
+}
 
 static
 DWORD
@@ -293,6 +376,8 @@ LocalDirFindObjectsInternal(
     PLSA_LOGIN_NAME_INFO pLoginInfo = NULL;
     BOOLEAN bLocked = FALSE;
     BOOLEAN bFoundInvalidObject = FALSE;
+    ULONG64 ullChangeCount = 0;
+    BOOLEAN bUseCache = FALSE;
 
     /* FIXME: support generic queries */
     switch (ObjectType)
@@ -358,10 +443,33 @@ LocalDirFindObjectsInternal(
         BAIL_ON_LSA_ERROR(dwError);
     }
 
+    // Sampled before any search so that results read here are never
+    // cached under a newer change count than the data they came from.
+    bUseCache = (LocalCacheGetChangeCount(
+                     pContext->hDirectory,
+                     &ullChangeCount) == ERROR_SUCCESS);
+
     for (dwIndex = 0; dwIndex < dwCount; dwIndex++)
     {
         bFoundInvalidObject = FALSE;
 
+        if (bUseCache)
+        {
+            dwError = LocalDirFindCachedObject(
+                ullChangeCount,
+                ObjectType,
+                QueryType,
+                QueryList,
+                dwIndex,
+                &ppObjects[dwIndex]);
+            BAIL_ON_LSA_ERROR(dwError);
+
+            if (ppObjects[dwIndex])
+            {
+                continue;
+            }
+        }
+
         switch (QueryType)
         {
         case LSA_QUERY_TYPE_BY_ALIAS:
@@ -459,6 +567,11 @@ LocalDirFindObjectsInternal(
                     hProvider,
                     ppObjects[dwIndex]);
                 BAIL_ON_LSA_ERROR(dwError);
+
+                if (bUseCache)
+                {
+                    LocalCacheAddObject(ullChangeCount, ppObjects[dwIndex]);
+                }
             }
         }
 
@@ -1012,20 +1125,11 @@ error:
 
 static
 DWORD
-LocalDirQueryMemberOfInternal(
+LocalDirGetMemberOfDN(
     IN HANDLE hProvider,
-    IN LSA_FIND_FLAGS FindFlags,
-    IN PSTR pszSid,
-    IN OUT PLW_HASH_TABLE pGroupHash
-    );
-
-static
-DWORD
-LocalDirQueryMemberOfDN(
-    IN HANDLE hProvider,
-    IN LSA_FIND_FLAGS FindFlags,
     IN PWSTR pwszDN,
-    IN OUT PLW_HASH_TABLE pGroupHash
+    OUT PDWORD pdwGroupSidCount,
+    OUT PSTR** pppszGroupSids
     )
 {
     DWORD dwError = 0;
@@ -1038,11 +1142,8 @@ LocalDirQueryMemberOfDN(
     };
     PDIRECTORY_ENTRY pEntries = NULL;
     DWORD dwNumEntries = 0;
-    PSTR pszFilter = NULL;
-    PWSTR pwszFilter = NULL;
     DWORD dwIndex = 0;
-    PSTR pszGroupSid = NULL;
-    PSTR pszPreviousGroupSid = NULL;
+    PSTR* ppszGroupSids = NULL;
 
     dwError = DirectoryGetMemberships(
         pContext->hDirectory,
@@ -1051,48 +1152,29 @@ LocalDirQueryMemberOfDN(
         &pEntries,
         &dwNumEntries);
     BAIL_ON_LSA_ERROR(dwError);
-            
+
+    if (dwNumEntries)
+    {
+        dwError = LwAllocateMemory(
+            sizeof(*ppszGroupSids) * dwNumEntries,
+            OUT_PPVOID(&ppszGroupSids));
+        BAIL_ON_LSA_ERROR(dwError);
+    }
+
     for (dwIndex = 0; dwIndex < dwNumEntries; dwIndex++)
     {
         dwError = LocalMarshalAttrToANSIFromUnicodeString(
             &pEntries[dwIndex],
             wszAttrNameObjectSID,
-            &pszGroupSid);
+            &ppszGroupSids[dwIndex]);
         BAIL_ON_LSA_ERROR(dwError);
-        
-        dwError = LwHashGetValue(
-            pGroupHash,
-            pszGroupSid,
-            OUT_PPVOID(&pszPreviousGroupSid));
-        if (dwError == ERROR_NOT_FOUND)
-        {
-            dwError = LwHashSetValue(
-                pGroupHash,
-                pszGroupSid,
-                pszGroupSid);
-            BAIL_ON_LSA_ERROR(dwError);
-            
-            dwError = LocalDirQueryMemberOfInternal(
-                hProvider,
-                FindFlags,
-                pszGroupSid,
-                pGroupHash);
-            pszGroupSid = NULL;
-            BAIL_ON_LSA_ERROR(dwError);
-        }
-        else
-        {
-            BAIL_ON_LSA_ERROR(dwError);
-        }
-        
-        LW_SAFE_FREE_MEMORY(pszGroupSid);
     }
 
+    *pdwGroupSidCount = dwNumEntries;
+    *pppszGroupSids = ppszGroupSids;
+
 cleanup:
 
-    LW_SAFE_FREE_MEMORY(pwszFilter);
-    LW_SAFE_FREE_MEMORY(pszFilter);
-    
     if (pEntries)
     {
         DirectoryFreeEntries(pEntries, dwNumEntries);
@@ -1102,16 +1184,28 @@ cleanup:
 
 error:
 
+    *pdwGroupSidCount = 0;
+    *pppszGroupSids = NULL;
+
+    if (ppszGroupSids)
+    {
+        LwFreeStringArray(ppszGroupSids, dwNumEntries);
+    }
+
     goto cleanup;
 }
 
+/*
+ * Returns the groups pszSid is a direct member of.  An unknown SID
+ * simply has no memberships.
+ */
 static
 DWORD
-LocalDirQueryMemberOfInternal(
+LocalDirGetDirectMemberOf(
     IN HANDLE hProvider,
-    IN LSA_FIND_FLAGS FindFlags,
-    IN PSTR pszSid,
-    IN OUT PLW_HASH_TABLE pGroupHash
+    IN PCSTR pszSid,
+    OUT PDWORD pdwGroupSidCount,
+    OUT PSTR** pppszGroupSids
     )
 {
     DWORD dwError = 0;
@@ -1126,13 +1220,36 @@ LocalDirQueryMemberOfInternal(
     DWORD dwNumEntries = 0;
     PWSTR pwszFilter = NULL;
     PWSTR pwszDN = NULL;
+    ULONG64 ullChangeCount = 0;
+    BOOLEAN bUseCache = FALSE;
+    DWORD dwGroupSidCount = 0;
+    PSTR* ppszGroupSids = NULL;
+
+    bUseCache = (LocalCacheGetChangeCount(
+                     pContext->hDirectory,
+                     &ullChangeCount) == ERROR_SUCCESS);
+
+    if (bUseCache)
+    {
+        dwError = LocalCacheFindMemberOf(
+            ullChangeCount,
+            pszSid,
+            &dwGroupSidCount,
+            &ppszGroupSids);
+        if (dwError != ERROR_NOT_FOUND)
+        {
+            BAIL_ON_LSA_ERROR(dwError);
+            goto done;
+        }
+        dwError = 0;
+    }
 
     dwError = DirectoryAllocateWC16StringFilterPrintf(
         &pwszFilter,
         LOCAL_DB_DIR_ATTR_OBJECT_SID " = %Q",
         pszSid);
     BAIL_ON_LSA_ERROR(dwError);
-    
+
     dwError = DirectorySearch(
         pContext->hDirectory,
         NULL,
@@ -1143,7 +1260,7 @@ LocalDirQueryMemberOfInternal(
         &pEntries,
         &dwNumEntries);
     BAIL_ON_LSA_ERROR(dwError);
-    
+
     if (dwNumEntries > 1)
     {
         dwError = LW_ERROR_DATA_ERROR;
@@ -1156,25 +1273,108 @@ LocalDirQueryMemberOfInternal(
             wszAttrNameDN,
             &pwszDN);
         BAIL_ON_LSA_ERROR(dwError);
-        
-        dwError = LocalDirQueryMemberOfDN(
+
+        dwError = LocalDirGetMemberOfDN(
             hProvider,
-            FindFlags,
             pwszDN,
-            pGroupHash);
+            &dwGroupSidCount,
+            &ppszGroupSids);
         BAIL_ON_LSA_ERROR(dwError);
     }
-    
+
+    if (bUseCache)
+    {
+        LocalCacheAddMemberOf(
+            ullChangeCount,
+            pszSid,
+            dwGroupSidCount,
+            ppszGroupSids);
+    }
+
+done:
+
+    *pdwGroupSidCount = dwGroupSidCount;
+    *pppszGroupSids = ppszGroupSids;
+
 cleanup:
 
     LW_SAFE_FREE_MEMORY(pwszDN);
     LW_SAFE_FREE_MEMORY(pwszFilter);
-    
+
     if (pEntries)
     {
         DirectoryFreeEntries(pEntries, dwNumEntries);
     }
 
+    return dwError;
+
+error:
+
+    *pdwGroupSidCount = 0;
+    *pppszGroupSids = NULL;
+
+    if (ppszGroupSids)
+    {
+        LwFreeStringArray(ppszGroupSids, dwGroupSidCount);
+    }
+
+    goto cleanup;
+}
+
+static
+DWORD
+LocalDirQueryMemberOfInternal(
+    IN HANDLE hProvider,
+    IN LSA_FIND_FLAGS FindFlags,
+    IN PSTR pszSid,
+    IN OUT PLW_HASH_TABLE pGroupHash
+    )
+{
+    DWORD dwError = 0;
+    DWORD dwGroupSidCount = 0;
+    PSTR* ppszGroupSids = NULL;
+    DWORD dwIndex = 0;
+    PSTR pszGroupSid = NULL;
+
+    dwError = LocalDirGetDirectMemberOf(
+        hProvider,
+        pszSid,
+        &dwGroupSidCount,
+        &ppszGroupSids);
+    BAIL_ON_LSA_ERROR(dwError);
+
+    for (dwIndex = 0; dwIndex < dwGroupSidCount; dwIndex++)
+    {
+        if (LwHashExists(pGroupHash, ppszGroupSids[dwIndex]))
+        {
+            continue;
+        }
+
+        pszGroupSid = ppszGroupSids[dwIndex];
+
+        dwError = LwHashSetValue(
+            pGroupHash,
+            pszGroupSid,
+            pszGroupSid);
+        BAIL_ON_LSA_ERROR(dwError);
+
+        ppszGroupSids[dwIndex] = NULL;
+
+        dwError = LocalDirQueryMemberOfInternal(
+            hProvider,
+            FindFlags,
+            pszGroupSid,
+            pGroupHash);
+        BAIL_ON_LSA_ERROR(dwError);
+    }
+
+cleanup:
+
+    if (ppszGroupSids)
+    {
+        LwFreeStringArray(ppszGroupSids, dwGroupSidCount);
+    }
+
     if (dwError == LW_ERROR_NO_SUCH_USER ||
         dwError == LW_ERROR_NO_SUCH_GROUP ||
         dwError == LW_ERROR_NO_SUCH_OBJECT)
@@ -100,6 +100,31 @@ typedef struct __LOCAL_CONFIG
     BOOLEAN   EnableUnixIds;
 } LOCAL_CONFIG, *PLOCAL_CONFIG;
 
+typedef struct _LOCAL_CACHE_MEMBERSHIP
+{
+    DWORD dwGroupSidCount;
+    PSTR* ppszGroupSids;
+
+} LOCAL_CACHE_MEMBERSHIP, *PLOCAL_CACHE_MEMBERSHIP;
+
+typedef struct _LOCAL_OBJECT_CACHE
+{
+    pthread_mutex_t  mutex;
+
+    // Directory change count the contents were read at
+    ULONG64          ullChangeCount;
+
+    // Owns the objects; the other indexes point into it
+    PLW_HASH_TABLE   pObjectsBySid;
+    PLW_HASH_TABLE   pObjectsByName;
+    PLW_HASH_TABLE   pUsersByUid;
+    PLW_HASH_TABLE   pGroupsByGid;
+
+    // SID -> LOCAL_CACHE_MEMBERSHIP (direct parent groups)
+    PLW_HASH_TABLE   pMembershipsBySid;
+
+} LOCAL_OBJECT_CACHE, *PLOCAL_OBJECT_CACHE;
+
 typedef struct _LOCAL_PROVIDER_GLOBALS
 {
     pthread_rwlock_t  rwlock;
@@ -123,6 +148,8 @@ typedef struct _LOCAL_PROVIDER_GLOBALS
 
     LOCAL_CONFIG      cfg;
 
+    LOCAL_OBJECT_CACHE cache;
+
 } LOCAL_PROVIDER_GLOBALS, *PLOCAL_PROVIDER_GLOBALS;
 
 typedef struct _LOCAL_PROVIDER_GROUP_MEMBER
@@ -375,6 +375,17 @@ DirectoryGetGroupCount(
     PDWORD pdwNumGroups
     );
 
+/*
+ * Returns a counter that changes whenever any object, membership or
+ * password in the directory changes.  Providers that cannot track
+ * changes return ERROR_NOT_SUPPORTED.
+ */
+DWORD
+DirectoryGetChangeCount(
+    HANDLE   hBindHandle,
+    PULONG64 pullChangeCount
+    );
+
 DWORD
 DirectoryChangePassword(
     HANDLE hBindHandle,
@@ -82,3 +82,33 @@ error:
 
     return dwError;
 }
+
+DWORD
+DirectoryGetChangeCount(
+    HANDLE   hDirectory,
+    PULONG64 pullChangeCount
+    )
+{
+    DWORD dwError = 0;
+    PDIRECTORY_CONTEXT pContext = (PDIRECTORY_CONTEXT)hDirectory;
+
+    if (!pContext || !pContext->pProvider)
+    {
+        dwError = LW_ERROR_INVALID_PARAMETER;
+        BAIL_ON_DIRECTORY_ERROR(dwError);
+    }
+
+    if (!pContext->pProvider->pProviderFnTbl->pfnDirectoryGetChangeCount)
+    {
+        dwError = ERROR_NOT_SUPPORTED;
+        BAIL_ON_DIRECTORY_ERROR(dwError);
+    }
+
+    dwError = pContext->pProvider->pProviderFnTbl->pfnDirectoryGetChangeCount(
+                    pContext->hBindHandle,
+                    pullChangeCount);
+
+error:
+
+    return dwError;
+}
@@ -85,6 +85,11 @@ typedef DWORD (*PFNDIRECTORYGETGROUPCOUNT)(
                     PDWORD pdwNumGroups
                     );
 
+typedef DWORD (*PFNDIRECTORYGETCHANGECOUNT)(
+                    HANDLE   hDirectory,
+                    PULONG64 pullChangeCount
+                    );
+
 typedef DWORD (*PFNDIRECTORYDELETE)(
                     HANDLE hDirectory,
                     PWSTR  pwszObjectDN
@@ -111,6 +116,7 @@ typedef struct __LSA_DIRECTORY_PROVIDER_FUNCTION_TABLE
     PFNDIRECTORYSEARCH         pfnDirectorySearch;
     PFNDIRECTORYGETUSERCOUNT   pfnDirectoryGetUserCount;
     PFNDIRECTORYGETGROUPCOUNT  pfnDirectoryGetGroupCount;
+    PFNDIRECTORYGETCHANGECOUNT pfnDirectoryGetChangeCount;
     PFNDIRECTORYCLOSE          pfnDirectoryClose;
 
 } DIRECTORY_PROVIDER_FUNCTION_TABLE, *PDIRECTORY_PROVIDER_FUNCTION_TABLE;
@@ -209,6 +209,20 @@ SamDbFreeDbContext(
     PSAM_DB_CONTEXT pDbContext
     )
 {
+    DWORD iStmt = 0;
+
+    for (iStmt = 0; iStmt < SAM_DB_SEARCH_STMT_CACHE_SIZE; iStmt++)
+    {
+        PSAM_DB_SEARCH_STMT pSearchStmt = &pDbContext->searchStmts[iStmt];
+
+        if (pSearchStmt->pSqlStatement)
+        {
+            sqlite3_finalize(pSearchStmt->pSqlStatement);
+        }
+
+        DIRECTORY_FREE_STRING(pSearchStmt->pszQuery);
+    }
+
     if (pDbContext->pDelObjectStmt)
     {
         sqlite3_finalize(pDbContext->pDelObjectStmt);
@@ -55,6 +55,9 @@
 
 #define SAM_DB_CONTEXT_POOL_MAX_ENTRIES 10
 
+// Prepared search statements kept per database connection
+#define SAM_DB_SEARCH_STMT_CACHE_SIZE   16
+
 #define SAM_DB_DEFAULT_ADMINISTRATOR_SHELL   "/bin/sh"
 #define SAM_DB_DEFAULT_ADMINISTRATOR_HOMEDIR "/"
 
@@ -132,7 +132,9 @@ SAM_GLOBALS gSamGlobals =
 
         .pDbContextList            = NULL,
         .dwNumDbContexts           = 0,
-        .dwNumMaxDbContexts        = 0
+        .dwNumMaxDbContexts        = 0,
+
+        .ullChangeCount            = 0
     };
 
 
@@ -828,6 +828,8 @@ SamDbAddToGroup(
             dwError = LW_ERROR_SUCCESS;
         }
         BAIL_ON_SAMDB_SQLITE_ERROR_STMT(dwError, pSqlStatement);
+
+        SamDbIncrementChangeCount();
     }
 
 cleanup:
@@ -987,6 +989,8 @@ SamDbRemoveFromGroup(
             dwError = LW_ERROR_SUCCESS;
         }
         BAIL_ON_SAMDB_SQLITE_ERROR_STMT(dwError, pSqlStatement);
+
+        SamDbIncrementChangeCount();
     }
 
 cleanup:
@@ -166,6 +166,7 @@ DirectoryInitializeProvider(
                 .pfnDirectorySearch          = &SamDbSearchObject,
                 .pfnDirectoryGetUserCount    = &SamDbGetUserCount,
                 .pfnDirectoryGetGroupCount   = &SamDbGetGroupCount,
+                .pfnDirectoryGetChangeCount  = &SamDbGetChangeCount,
                 .pfnDirectoryClose           = &SamDbClose
         };
 
@@ -651,6 +651,8 @@ SamDbIncrementSequenceNumber_inlock(
     }
     BAIL_ON_SAMDB_SQLITE_ERROR_STMT(dwError, pSqlStatement);
 
+    SamDbIncrementChangeCount();
+
 cleanup:
     if (pSqlStatement)
     {
@@ -666,6 +668,46 @@ error:
 }
 
 
+/*
+ * Unlike the domain sequence number this counter lives in memory only
+ * and also moves on membership and password changes.  Writers bump it
+ * either while still holding the exclusive lock or after the change has
+ * been committed, so a reader that samples it before searching never
+ * pairs a current count with stale rows.
+ */
+VOID
+SamDbIncrementChangeCount(
+    VOID
+    )
+{
+    BOOLEAN bInLock = FALSE;
+
+    SAMDB_LOCK_MUTEX(bInLock, &gSamGlobals.mutex);
+
+    gSamGlobals.ullChangeCount++;
+
+    SAMDB_UNLOCK_MUTEX(bInLock, &gSamGlobals.mutex);
+}
+
+
+DWORD
+SamDbGetChangeCount(
+    HANDLE   hBindHandle,
+    PULONG64 pullChangeCount
+    )
+{
+    BOOLEAN bInLock = FALSE;
+
+    SAMDB_LOCK_MUTEX(bInLock, &gSamGlobals.mutex);
+
+    *pullChangeCount = gSamGlobals.ullChangeCount;
+
+    SAMDB_UNLOCK_MUTEX(bInLock, &gSamGlobals.mutex);
+
+    return ERROR_SUCCESS;
+}
+
+
 /*
 local variables:
 mode: c
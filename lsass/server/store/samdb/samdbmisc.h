@@ -146,6 +146,17 @@ SamDbIncrementSequenceNumber_inlock(
     PSAM_DIRECTORY_CONTEXT pDirectoryContext
     );
 
+VOID
+SamDbIncrementChangeCount(
+    VOID
+    );
+
+DWORD
+SamDbGetChangeCount(
+    HANDLE   hBindHandle,
+    PULONG64 pullChangeCount
+    );
+
 
 #endif /* __SAMDB_MISC_H__ */
 
@@ -49,27 +49,81 @@
 
 #include "includes.h"
 
+//
+// A literal taken out of a search filter, bound to the statement in
+// its place so that searches differing only in their values share one
+// prepared statement.
+//
+typedef struct _SAM_DB_SEARCH_BINDING
+{
+    BOOLEAN bIsText;
+    PSTR    pszValue;
+    LONG64  llValue;
+
+} SAM_DB_SEARCH_BINDING, *PSAM_DB_SEARCH_BINDING;
+
+typedef struct _SAM_DB_SEARCH_BINDINGS
+{
+    DWORD                  dwNumValues;
+    DWORD                  dwMaxValues;
+    PSAM_DB_SEARCH_BINDING pValues;
+
+} SAM_DB_SEARCH_BINDINGS, *PSAM_DB_SEARCH_BINDINGS;
+
 static
 DWORD
 SamDbBuildSqlQuery(
-    PSAM_DIRECTORY_CONTEXT pDirectoryContext,
-    PWSTR                  pwszFilter,
-    PWSTR                  wszAttributes[],
-    ULONG                  ulAttributesOnly,
-    PSTR*                  ppszQuery,
-    PBOOLEAN               pbMembersAttrExists,
-    PSAM_DB_COLUMN_VALUE*  ppColumnValueList
+    PSAM_DIRECTORY_CONTEXT   pDirectoryContext,
+    PWSTR                    pwszFilter,
+    PWSTR                    wszAttributes[],
+    ULONG                    ulAttributesOnly,
+    PSTR*                    ppszQuery,
+    PSAM_DB_SEARCH_BINDINGS* ppBindings,
+    PBOOLEAN                 pbMembersAttrExists,
+    PSAM_DB_COLUMN_VALUE*    ppColumnValueList
+    );
+
+static
+DWORD
+SamDbParameterizeFilter(
+    PCSTR                    pszFilter,
+    PSTR*                    ppszFilter,
+    PSAM_DB_SEARCH_BINDINGS* ppBindings
+    );
+
+static
+VOID
+SamDbFreeSearchBindings(
+    PSAM_DB_SEARCH_BINDINGS pBindings
+    );
+
+static
+DWORD
+SamDbSearchAcquireStatement(
+    PSAM_DB_CONTEXT      pDbContext,
+    PCSTR                pszQuery,
+    BOOLEAN              bCacheable,
+    sqlite3_stmt**       ppSqlStatement,
+    PSAM_DB_SEARCH_STMT* ppSearchStmt
+    );
+
+static
+VOID
+SamDbSearchReleaseStatement(
+    sqlite3_stmt*       pSqlStatement,
+    PSAM_DB_SEARCH_STMT pSearchStmt
     );
 
 static
 DWORD
 SamDbSearchExecute(
-    PSAM_DIRECTORY_CONTEXT pDirectoryContext,
-    PCSTR                  pszQuery,
-    PSAM_DB_COLUMN_VALUE   pColumnValueList,
-    ULONG                  ulAttributesOnly,
-    PDIRECTORY_ENTRY*      ppDirectoryEntries,
-    PDWORD                 pdwNumEntries
+    PSAM_DIRECTORY_CONTEXT  pDirectoryContext,
+    PCSTR                   pszQuery,
+    PSAM_DB_SEARCH_BINDINGS pBindings,
+    PSAM_DB_COLUMN_VALUE    pColumnValueList,
+    ULONG                   ulAttributesOnly,
+    PDIRECTORY_ENTRY*       ppDirectoryEntries,
+    PDWORD                  pdwNumEntries
     );
 
 static
@@ -86,12 +140,13 @@ SamDbSearchMarshallResultsAttributes(
 static
 DWORD
 SamDbSearchMarshallResultsAttributesValues(
-    PSAM_DIRECTORY_CONTEXT pDirectoryContext,
-    PCSTR                  pszQuery,
-    PSAM_DB_COLUMN_VALUE   pColumnValueList,
-    ULONG                  ulAttributesOnly,
-    PDIRECTORY_ENTRY*      ppDirectoryEntries,
-    PDWORD                 pdwNumEntries
+    PSAM_DIRECTORY_CONTEXT  pDirectoryContext,
+    PCSTR                   pszQuery,
+    PSAM_DB_SEARCH_BINDINGS pBindings,
+    PSAM_DB_COLUMN_VALUE    pColumnValueList,
+    ULONG                   ulAttributesOnly,
+    PDIRECTORY_ENTRY*       ppDirectoryEntries,
+    PDWORD                  pdwNumEntries
     );
 
 DWORD
@@ -141,6 +196,7 @@ SamDbSearchObject_inlock(
     DWORD dwError = 0;
     PSAM_DIRECTORY_CONTEXT pDirectoryContext = NULL;
     PSTR  pszQuery = NULL;
+    PSAM_DB_SEARCH_BINDINGS pBindings = NULL;
     BOOLEAN bMembersAttrExists = FALSE;
     PSAM_DB_COLUMN_VALUE pColumnValueList = NULL;
     PDIRECTORY_ENTRY pDirectoryEntries = NULL;
@@ -154,6 +210,7 @@ SamDbSearchObject_inlock(
                     wszAttributes,
                     ulAttributesOnly,
                     &pszQuery,
+                    &pBindings,
                     &bMembersAttrExists,
                     &pColumnValueList);
     BAIL_ON_SAMDB_ERROR(dwError);
@@ -161,6 +218,7 @@ SamDbSearchObject_inlock(
     dwError = SamDbSearchExecute(
                     pDirectoryContext,
                     pszQuery,
+                    pBindings,
                     pColumnValueList,
                     ulAttributesOnly,
                     &pDirectoryEntries,
@@ -179,6 +237,11 @@ cleanup:
 
     DIRECTORY_FREE_STRING(pszQuery);
 
+    if (pBindings)
+    {
+        SamDbFreeSearchBindings(pBindings);
+    }
+
     return(dwError);
 
 error:
@@ -200,13 +263,14 @@ error:
 static
 DWORD
 SamDbBuildSqlQuery(
-    PSAM_DIRECTORY_CONTEXT pDirectoryContext,
-    PWSTR                  pwszFilter,
-    PWSTR                  wszAttributes[],
-    ULONG                  ulAttributesOnly,
-    PSTR*                  ppszQuery,
-    PBOOLEAN               pbMembersAttrExists,
-    PSAM_DB_COLUMN_VALUE*  ppColumnValueList
+    PSAM_DIRECTORY_CONTEXT   pDirectoryContext,
+    PWSTR                    pwszFilter,
+    PWSTR                    wszAttributes[],
+    ULONG                    ulAttributesOnly,
+    PSTR*                    ppszQuery,
+    PSAM_DB_SEARCH_BINDINGS* ppBindings,
+    PBOOLEAN                 pbMembersAttrExists,
+    PSAM_DB_COLUMN_VALUE*    ppColumnValueList
     )
 {
     DWORD dwError = 0;
@@ -218,6 +282,8 @@ SamDbBuildSqlQuery(
     PSTR  pszQueryCursor = NULL;
     PSTR  pszCursor = NULL;
     PSTR  pszFilter = NULL;
+    PSTR  pszParamFilter = NULL;
+    PSAM_DB_SEARCH_BINDINGS pBindings = NULL;
     PSAM_DB_COLUMN_VALUE pColumnValueList = NULL;
     PSAM_DB_COLUMN_VALUE pIter = NULL;
 
@@ -229,6 +295,27 @@ SamDbBuildSqlQuery(
         BAIL_ON_SAMDB_ERROR(dwError);
 
         LwStripWhitespace(pszFilter, TRUE, TRUE);
+
+        dwError = SamDbParameterizeFilter(
+                        pszFilter,
+                        &pszParamFilter,
+                        &pBindings);
+        BAIL_ON_SAMDB_ERROR(dwError);
+
+        // Filters we cannot take literals out of are used as they are
+        if (pszParamFilter)
+        {
+            DIRECTORY_FREE_STRING(pszFilter);
+            pszFilter = pszParamFilter;
+            pszParamFilter = NULL;
+        }
+    }
+    else
+    {
+        dwError = DirectoryAllocateMemory(
+                        sizeof(*pBindings),
+                        (PVOID*)&pBindings);
+        BAIL_ON_SAMDB_ERROR(dwError);
     }
 
     while (wszAttributes[dwNumAttrs])
@@ -354,23 +441,31 @@ SamDbBuildSqlQuery(
     }
 
     *ppszQuery = pszQuery;
+    *ppBindings = pBindings;
     *pbMembersAttrExists = bMembersAttrExists;
     *ppColumnValueList = pColumnValueList;
 
 cleanup:
 
     DIRECTORY_FREE_STRING(pszFilter);
+    DIRECTORY_FREE_STRING(pszParamFilter);
 
     return dwError;
 
 error:
 
     *ppszQuery = NULL;
+    *ppBindings = NULL;
     *pbMembersAttrExists = FALSE;
     *ppColumnValueList = NULL;
 
     DIRECTORY_FREE_STRING(pszQuery);
 
+    if (pBindings)
+    {
+        SamDbFreeSearchBindings(pBindings);
+    }
+
     if (pColumnValueList)
     {
         SamDbFreeColumnValueList(pColumnValueList);
@@ -379,15 +474,363 @@ error:
     goto cleanup;
 }
 
+static
+BOOLEAN
+SamDbIsIdentifierChar(
+    CHAR c
+    )
+{
+    return isalnum((int)(UCHAR)c) || c == '_';
+}
+
+static
+DWORD
+SamDbAddSearchBinding(
+    PSAM_DB_SEARCH_BINDINGS pBindings,
+    PSAM_DB_SEARCH_BINDING* ppBinding
+    )
+{
+    DWORD dwError = 0;
+    DWORD dwNewMaxValues = 0;
+
+    if (pBindings->dwNumValues == pBindings->dwMaxValues)
+    {
+        dwNewMaxValues = pBindings->dwMaxValues + 4;
+
+        dwError = DirectoryReallocMemory(
+                        pBindings->pValues,
+                        (PVOID*)&pBindings->pValues,
+                        dwNewMaxValues * sizeof(pBindings->pValues[0]));
+        BAIL_ON_SAMDB_ERROR(dwError);
+
+        memset(&pBindings->pValues[pBindings->dwMaxValues],
+               0,
+               (dwNewMaxValues - pBindings->dwMaxValues) *
+                   sizeof(pBindings->pValues[0]));
+
+        pBindings->dwMaxValues = dwNewMaxValues;
+    }
+
+    *ppBinding = &pBindings->pValues[pBindings->dwNumValues++];
+
+error:
+
+    return dwError;
+}
+
+//
+// Replaces the string and integer literals of an SQL filter such as
+//
+//   SamAccountName = 'joe' AND ObjectClass = 5
+//
+// by parameters, returning the literals separately.  If the filter
+// contains anything this does not understand (blob literals, quoted
+// identifiers, comments, existing parameters), *ppszFilter is set to
+// NULL and the caller has to use the filter as it is.
+//
+static
+DWORD
+SamDbParameterizeFilter(
+    PCSTR                    pszFilter,
+    PSTR*                    ppszFilter,
+    PSAM_DB_SEARCH_BINDINGS* ppBindings
+    )
+{
+    DWORD dwError = 0;
+    PCSTR pszCursor = pszFilter;
+    PCSTR pszStart = NULL;
+    PSTR  pszOutput = NULL;
+    PSTR  pszOutputCursor = NULL;
+    PSTR  pszValueCursor = NULL;
+    PSAM_DB_SEARCH_BINDINGS pBindings = NULL;
+    PSAM_DB_SEARCH_BINDING  pBinding = NULL;
+    BOOLEAN bSupported = TRUE;
+
+    // Taking literals out never makes the filter longer
+    dwError = DirectoryAllocateMemory(
+                    strlen(pszFilter) + 1,
+                    (PVOID*)&pszOutput);
+    BAIL_ON_SAMDB_ERROR(dwError);
+
+    dwError = DirectoryAllocateMemory(
+                    sizeof(*pBindings),
+                    (PVOID*)&pBindings);
+    BAIL_ON_SAMDB_ERROR(dwError);
+
+    pszOutputCursor = pszOutput;
+
+    while (bSupported && *pszCursor)
+    {
+        CHAR c = *pszCursor;
+
+        if (c == '\'')
+        {
+            if (pszCursor > pszFilter && SamDbIsIdentifierChar(pszCursor[-1]))
+            {
+                // X'...' blob literal
+                bSupported = FALSE;
+                break;
+            }
+
+            dwError = SamDbAddSearchBinding(pBindings, &pBinding);
+            BAIL_ON_SAMDB_ERROR(dwError);
+
+            pBinding->bIsText = TRUE;
+
+            dwError = DirectoryAllocateMemory(
+                            strlen(pszCursor),
+                            (PVOID*)&pBinding->pszValue);
+            BAIL_ON_SAMDB_ERROR(dwError);
+
+            pszValueCursor = pBinding->pszValue;
+
+            for (pszCursor++; bSupported; pszCursor++)
+            {
+                if (!*pszCursor)
+                {
+                    bSupported = FALSE;
+                }
+                else if (*pszCursor != '\'')
+                {
+                    *pszValueCursor++ = *pszCursor;
+                }
+                else if (pszCursor[1] == '\'')
+                {
+                    *pszValueCursor++ = '\'';
+                    pszCursor++;
+                }
+                else
+                {
+                    pszCursor++;
+                    break;
+                }
+            }
+
+            *pszOutputCursor++ = '?';
+        }
+        else if (isdigit((int)(UCHAR)c) &&
+                 (pszCursor == pszFilter ||
+                  (!SamDbIsIdentifierChar(pszCursor[-1]) &&
+                   pszCursor[-1] != '.')))
+        {
+            pszStart = pszCursor;
+
+            while (isdigit((int)(UCHAR)*pszCursor))
+            {
+                pszCursor++;
+            }
+
+            // Hex, real and out of range numbers stay literals
+            if (SamDbIsIdentifierChar(*pszCursor) ||
+                *pszCursor == '.' ||
+                pszCursor - pszStart > 18)
+            {
+                bSupported = FALSE;
+                break;
+            }
+
+            dwError = SamDbAddSearchBinding(pBindings, &pBinding);
+            BAIL_ON_SAMDB_ERROR(dwError);
+
+            pBinding->llValue = strtoll(pszStart, NULL, 10);
+
+            *pszOutputCursor++ = '?';
+        }
+        else if (c == '?' || c == ':' || c == '@' || c == '$' ||
+                 c == '"' || c == '[' || c == '`' ||
+                 (c == '-' && pszCursor[1] == '-') ||
+                 (c == '/' && pszCursor[1] == '*'))
+        {
+            bSupported = FALSE;
+        }
+        else
+        {
+            *pszOutputCursor++ = *pszCursor++;
+        }
+    }
+
+    if (!bSupported)
+    {
+        DIRECTORY_FREE_STRING_AND_RESET(pszOutput);
+        SamDbFreeSearchBindings(pBindings);
+        pBindings = NULL;
+    }
+
+    *ppszFilter = pszOutput;
+    *ppBindings = pBindings;
+
+cleanup:
+
+    return dwError;
+
+error:
+
+    *ppszFilter = NULL;
+    *ppBindings = NULL;
+
+    DIRECTORY_FREE_STRING(pszOutput);
+
+    if (pBindings)
+    {
+        SamDbFreeSearchBindings(pBindings);
+    }
+
+    goto cleanup;
+}
+
+static
+VOID
+SamDbFreeSearchBindings(
+    PSAM_DB_SEARCH_BINDINGS pBindings
+    )
+{
+    DWORD iValue = 0;
+
+    for (iValue = 0; iValue < pBindings->dwNumValues; iValue++)
+    {
+        DIRECTORY_FREE_STRING(pBindings->pValues[iValue].pszValue);
+    }
+
+    if (pBindings->pValues)
+    {
+        DirectoryFreeMemory(pBindings->pValues);
+    }
+
+    DirectoryFreeMemory(pBindings);
+}
+
+//
+// Returns a prepared statement for pszQuery.  Cacheable queries are
+// kept on the database context, which is only ever used by one
+// directory context at a time, and are evicted least recently used
+// first.  *ppSearchStmt is NULL for a statement the caller owns.
+//
+static
+DWORD
+SamDbSearchAcquireStatement(
+    PSAM_DB_CONTEXT      pDbContext,
+    PCSTR                pszQuery,
+    BOOLEAN              bCacheable,
+    sqlite3_stmt**       ppSqlStatement,
+    PSAM_DB_SEARCH_STMT* ppSearchStmt
+    )
+{
+    DWORD dwError = 0;
+    DWORD iStmt = 0;
+    PSAM_DB_SEARCH_STMT pSearchStmt = NULL;
+    PSAM_DB_SEARCH_STMT pVictim = NULL;
+    sqlite3_stmt* pSqlStatement = NULL;
+    PSTR pszQueryCopy = NULL;
+
+    if (bCacheable)
+    {
+        for (iStmt = 0; iStmt < SAM_DB_SEARCH_STMT_CACHE_SIZE; iStmt++)
+        {
+            PSAM_DB_SEARCH_STMT pIter = &pDbContext->searchStmts[iStmt];
+
+            if (pIter->pszQuery && !strcmp(pIter->pszQuery, pszQuery))
+            {
+                pSearchStmt = pIter;
+                break;
+            }
+
+            if (!pVictim ||
+                (pVictim->pszQuery && (!pIter->pszQuery ||
+                    pIter->ulLastUsed < pVictim->ulLastUsed)))
+            {
+                pVictim = pIter;
+            }
+        }
+    }
+
+    if (pSearchStmt)
+    {
+        pSqlStatement = pSearchStmt->pSqlStatement;
+    }
+    else
+    {
+        dwError = sqlite3_prepare_v2(
+                        pDbContext->pDbHandle,
+                        pszQuery,
+                        -1,
+                        &pSqlStatement,
+                        NULL);
+        BAIL_ON_SAMDB_SQLITE_ERROR_DB(dwError, pDbContext->pDbHandle);
+
+        if (bCacheable)
+        {
+            dwError = DirectoryAllocateString(pszQuery, &pszQueryCopy);
+            BAIL_ON_SAMDB_ERROR(dwError);
+
+            if (pVictim->pSqlStatement)
+            {
+                sqlite3_finalize(pVictim->pSqlStatement);
+            }
+            DIRECTORY_FREE_STRING(pVictim->pszQuery);
+
+            pVictim->pszQuery = pszQueryCopy;
+            pVictim->pSqlStatement = pSqlStatement;
+            pszQueryCopy = NULL;
+
+            pSearchStmt = pVictim;
+        }
+    }
+
+    if (pSearchStmt)
+    {
+        pSearchStmt->ulLastUsed = ++pDbContext->ulSearchStmtClock;
+    }
+
+    *ppSqlStatement = pSqlStatement;
+    *ppSearchStmt = pSearchStmt;
+
+cleanup:
+
+    return dwError;
+
+error:
+
+    *ppSqlStatement = NULL;
+    *ppSearchStmt = NULL;
+
+    if (pSqlStatement)
+    {
+        sqlite3_finalize(pSqlStatement);
+    }
+
+    goto cleanup;
+}
+
+static
+VOID
+SamDbSearchReleaseStatement(
+    sqlite3_stmt*       pSqlStatement,
+    PSAM_DB_SEARCH_STMT pSearchStmt
+    )
+{
+    if (pSearchStmt)
+    {
+        // Resetting ends the read so the connection holds no lock
+        // while the statement sits in the cache.
+        sqlite3_reset(pSqlStatement);
+        sqlite3_clear_bindings(pSqlStatement);
+    }
+    else
+    {
+        sqlite3_finalize(pSqlStatement);
+    }
+}
+
 static
 DWORD
 SamDbSearchExecute(
-    PSAM_DIRECTORY_CONTEXT pDirectoryContext,
-    PCSTR                  pszQuery,
-    PSAM_DB_COLUMN_VALUE   pColumnValueList,
-    ULONG                  ulAttributesOnly,
-    PDIRECTORY_ENTRY*      ppDirectoryEntries,
-    PDWORD                 pdwNumEntries
+    PSAM_DIRECTORY_CONTEXT  pDirectoryContext,
+    PCSTR                   pszQuery,
+    PSAM_DB_SEARCH_BINDINGS pBindings,
+    PSAM_DB_COLUMN_VALUE    pColumnValueList,
+    ULONG                   ulAttributesOnly,
+    PDIRECTORY_ENTRY*       ppDirectoryEntries,
+    PDWORD                  pdwNumEntries
     )
 {
     DWORD dwError = 0;
@@ -407,6 +850,7 @@ SamDbSearchExecute(
         dwError = SamDbSearchMarshallResultsAttributesValues(
                         pDirectoryContext,
                         pszQuery,
+                        pBindings,
                         pColumnValueList,
                         ulAttributesOnly,
                         ppDirectoryEntries,
@@ -529,12 +973,13 @@ error:
 static
 DWORD
 SamDbSearchMarshallResultsAttributesValues(
-    PSAM_DIRECTORY_CONTEXT pDirectoryContext,
-    PCSTR                  pszQuery,
-    PSAM_DB_COLUMN_VALUE   pColumnValueList,
-    ULONG                  ulAttributesOnly,
-    PDIRECTORY_ENTRY*      ppDirectoryEntries,
-    PDWORD                 pdwNumEntries
+    PSAM_DIRECTORY_CONTEXT  pDirectoryContext,
+    PCSTR                   pszQuery,
+    PSAM_DB_SEARCH_BINDINGS pBindings,
+    PSAM_DB_COLUMN_VALUE    pColumnValueList,
+    ULONG                   ulAttributesOnly,
+    PDIRECTORY_ENTRY*       ppDirectoryEntries,
+    PDWORD                  pdwNumEntries
     )
 {
     DWORD                dwError = 0;
@@ -543,6 +988,8 @@ SamDbSearchMarshallResultsAttributesValues(
     DWORD                dwTotalEntries = 0;
     DWORD                dwEntriesAvailable = 0;
     sqlite3_stmt*        pSqlStatement = NULL;
+    PSAM_DB_SEARCH_STMT  pSearchStmt = NULL;
+    DWORD                iValue = 0;
     DWORD                dwNumCols = 0;
     PSAM_DB_COLUMN_VALUE pIter = NULL;
     PDIRECTORY_ATTRIBUTE pAttrs = NULL;
@@ -553,13 +1000,36 @@ SamDbSearchMarshallResultsAttributesValues(
         dwNumCols++;
     }
 
-    dwError = sqlite3_prepare_v2(
-                    pDirectoryContext->pDbContext->pDbHandle,
+    dwError = SamDbSearchAcquireStatement(
+                    pDirectoryContext->pDbContext,
                     pszQuery,
-                    -1,
+                    pBindings != NULL,
                     &pSqlStatement,
-                    NULL);
-    BAIL_ON_SAMDB_SQLITE_ERROR_DB(dwError, pDirectoryContext->pDbContext->pDbHandle);
+                    &pSearchStmt);
+    BAIL_ON_SAMDB_ERROR(dwError);
+
+    for (iValue = 0; pBindings && iValue < pBindings->dwNumValues; iValue++)
+    {
+        PSAM_DB_SEARCH_BINDING pBinding = &pBindings->pValues[iValue];
+
+        if (pBinding->bIsText)
+        {
+            dwError = sqlite3_bind_text(
+                            pSqlStatement,
+                            iValue + 1,
+                            pBinding->pszValue,
+                            -1,
+                            SQLITE_TRANSIENT);
+        }
+        else
+        {
+            dwError = sqlite3_bind_int64(
+                            pSqlStatement,
+                            iValue + 1,
+                            pBinding->llValue);
+        }
+        BAIL_ON_SAMDB_SQLITE_ERROR_STMT(dwError, pSqlStatement);
+    }
 
     while ((dwError = sqlite3_step(pSqlStatement)) == SQLITE_ROW)
     {
@@ -782,7 +1252,7 @@ cleanup:
 
     if (pSqlStatement)
     {
-        sqlite3_finalize(pSqlStatement);
+        SamDbSearchReleaseStatement(pSqlStatement, pSearchStmt);
     }
 
     return dwError;
@@ -58,6 +58,15 @@ typedef struct _SAMDB_OBJECTCLASS_TO_ATTR_MAP_INFO
 
 } SAMDB_OBJECTCLASS_TO_ATTR_MAP_INFO, *PSAMDB_OBJECTCLASS_TO_ATTR_MAP_INFO;
 
+typedef struct _SAM_DB_SEARCH_STMT
+{
+    // Query text with the filter's literals replaced by parameters
+    PSTR          pszQuery;
+    sqlite3_stmt* pSqlStatement;
+    ULONG         ulLastUsed;
+
+} SAM_DB_SEARCH_STMT, *PSAM_DB_SEARCH_STMT;
+
 typedef struct _SAM_DB_CONTEXT
 {
     sqlite3* pDbHandle;
@@ -66,6 +75,9 @@ typedef struct _SAM_DB_CONTEXT
     sqlite3_stmt* pQueryObjectCountStmt;
     sqlite3_stmt* pQueryObjectRecordInfoStmt;
 
+    SAM_DB_SEARCH_STMT searchStmts[SAM_DB_SEARCH_STMT_CACHE_SIZE];
+    ULONG              ulSearchStmtClock;
+
     struct _SAM_DB_CONTEXT* pNext;
 
 } SAM_DB_CONTEXT, *PSAM_DB_CONTEXT;
@@ -112,6 +124,11 @@ typedef struct _SAM_GLOBALS
     DWORD           dwNumDbContexts;
     DWORD           dwNumMaxDbContexts;
 
+    // Bumped (under mutex) after every committed change to objects or
+    // group memberships, so in-process callers can tell cached results
+    // apart from current ones.
+    ULONG64         ullChangeCount;
+
 } SAM_GLOBALS, *PSAM_GLOBALS;
 
 typedef struct _SAM_DB_DOMAIN_INFO
@@ -246,6 +246,8 @@ SamDbChangePassword(
                     pwszNewPassword);
     BAIL_ON_SAMDB_ERROR(dwError);
 
+    SamDbIncrementChangeCount();
+
 cleanup:
 
     SAMDB_UNLOCK_RWMUTEX(bInLock, &gSamGlobals.rwLock);
@@ -223,3 +223,139 @@ CleanupConnectLsass(
         LsaCloseServer(connection);
     }
 }
+
+/*
+ * Re-caches user0002 through user0500 in a loop: each user is removed from
+ * the AD cache and looked up again, so the cache database sees a steady
+ * stream of deletes and stores while the timed thread reads user0001.
+ */
+static
+PVOID
+MixedLoadWriter(
+    IN PVOID pvMixedState
+    )
+{
+    MIXED_LOAD_STATE *state = (MIXED_LOAD_STATE *)pvMixedState;
+    PLSA_USER_INFO_0 userInfo = NULL;
+    char name[256];
+    int i = 2;
+
+    while (!state->bStop)
+    {
+        snprintf(name, sizeof(name), "%s%04d", state->pszUserPrefix, i);
+
+        LsaAdRemoveUserByNameFromCache(state->WriterConnection, NULL, name);
+
+        if (!LsaFindUserByName(
+                state->WriterConnection,
+                name,
+                0,
+                (PVOID*)&userInfo))
+        {
+            LsaFreeUserInfo(0, userInfo);
+            userInfo = NULL;
+            state->dwWrites++;
+        }
+
+        i = (i == 500) ? 2 : i + 1;
+    }
+
+    return NULL;
+}
+
+BOOL
+SetupMixedLoad(
+    IN PVOID username,
+    OUT PVOID *ppvMixedState
+    )
+{
+    DWORD dwError = 0;
+    MIXED_LOAD_STATE *state = NULL;
+    FIND_STATE *find = NULL;
+    size_t len = 0;
+
+    dwError = LwAllocateMemory(sizeof(*state), (PVOID*)&state);
+    BAIL_ON_LSA_ERROR(dwError);
+
+    if (!SetupFindUserById(username, (PVOID*)&find))
+    {
+        dwError = LW_ERROR_INTERNAL;
+        BAIL_ON_LSA_ERROR(dwError);
+    }
+    state->Find = *find;
+    LW_SAFE_FREE_MEMORY(find);
+
+    // "<domain>\user0001" becomes the prefix "<domain>\user"
+    dwError = LwAllocateString((PSTR)username, &state->pszUserPrefix);
+    BAIL_ON_LSA_ERROR(dwError);
+
+    len = strlen(state->pszUserPrefix);
+    if (len < 4)
+    {
+        dwError = LW_ERROR_INVALID_PARAMETER;
+        BAIL_ON_LSA_ERROR(dwError);
+    }
+    state->pszUserPrefix[len - 4] = '\0';
+
+    dwError = LsaOpenServer(&state->WriterConnection);
+    BAIL_ON_LSA_ERROR(dwError);
+
+    dwError = LwMapErrnoToLwError(pthread_create(
+                &state->Writer,
+                NULL,
+                MixedLoadWriter,
+                state));
+    BAIL_ON_LSA_ERROR(dwError);
+    state->bWriterStarted = TRUE;
+
+    *(MIXED_LOAD_STATE **)ppvMixedState = state;
+
+cleanup:
+    return dwError == 0;
+
+error:
+    CleanupMixedLoad(state);
+    *(MIXED_LOAD_STATE **)ppvMixedState = NULL;
+    goto cleanup;
+}
+
+BOOL
+RunMixedLoad(
+    IN PVOID pvMixedState
+    )
+{
+    MIXED_LOAD_STATE *state = (MIXED_LOAD_STATE *)pvMixedState;
+
+    return RunFindUserById(&state->Find);
+}
+
+void
+CleanupMixedLoad(
+    IN PVOID pvMixedState
+    )
+{
+    MIXED_LOAD_STATE *state = (MIXED_LOAD_STATE *)pvMixedState;
+
+    if (state == NULL)
+    {
+        return;
+    }
+
+    if (state->bWriterStarted)
+    {
+        state->bStop = TRUE;
+        pthread_join(state->Writer, NULL);
+        printf("Writer re-cached %u users meanwhile\n", state->dwWrites);
+    }
+
+    if (state->WriterConnection != (HANDLE)NULL)
+    {
+        LsaCloseServer(state->WriterConnection);
+    }
+    if (state->Find.Connection != (HANDLE)NULL)
+    {
+        LsaCloseServer(state->Find.Connection);
+    }
+    LW_SAFE_FREE_STRING(state->pszUserPrefix);
+    LW_SAFE_FREE_MEMORY(state);
+}
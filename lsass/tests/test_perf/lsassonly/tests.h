@@ -52,11 +52,15 @@
 #if HAVE_SYS_TYPES_H
 #include <sys/types.h>
 #endif
+#include <stdio.h>
+#include <string.h>
 #include <lsa/lsa.h>
+#include <lsa/ad.h>
 #include "lwmem.h"
 #include "lwstr.h"
 #include "lwsecurityidentifier.h"
 #include <lsautils.h>
+#include <pthread.h>
 
 BOOL
 RunConnectDisconnect(
@@ -101,4 +105,31 @@ CleanupConnectLsass(
     IN PVOID handle
     );
 
+typedef struct _MIXED_LOAD_STATE
+{
+    FIND_STATE Find;
+    HANDLE WriterConnection;
+    PSTR pszUserPrefix;
+    pthread_t Writer;
+    BOOLEAN bWriterStarted;
+    volatile BOOLEAN bStop;
+    DWORD dwWrites;
+} MIXED_LOAD_STATE;
+
+BOOL
+SetupMixedLoad(
+    IN PVOID username,
+    OUT PVOID *ppvMixedState
+    );
+
+BOOL
+RunMixedLoad(
+    IN PVOID pvMixedState
+    );
+
+void
+CleanupMixedLoad(
+    IN PVOID pvMixedState
+    );
+
 #endif
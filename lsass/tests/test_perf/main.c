@@ -246,6 +246,18 @@ void RunLsassTests(
             dlsym(lsassTestLib, "CleanupFindUserById"),
             (PVOID)user0001
         },
+        {
+            // Compare with the previous result to see how much cache updates
+            // slow down lookups.  With the sqlite AD cache, run it once with
+            // CacheReadConnections set to 0 and once with the default; the
+            // pooled readers are only used if sqlite supports WAL.
+            "Cached LsaFindUserById's per second for user0001 while another thread re-caches user0002-user0500",
+            TEST_TYPE_RUNS_PER_SEC,
+            dlsym(lsassTestLib, "SetupMixedLoad"),
+            dlsym(lsassTestLib, "RunMixedLoad"),
+            dlsym(lsassTestLib, "CleanupMixedLoad"),
+            (PVOID)user0001
+        },
         {
             "LsaGetLogInfo's per second with shared connection (tests marshalling latency)",
             TEST_TYPE_RUNS_PER_SEC,
@@ -314,9 +326,9 @@ int main(int argc, const char *argv[])
         },
     };
 
-    if (argc != 2 || argv[1][0] == '-')
+    if (argc < 2 || argc > 3 || argv[1][0] == '-')
     {
-        printf("Usage: %s <domain>\n"
+        printf("Usage: %s <domain> [local user]\n"
                 "\n"
                 "This program runs a series of nsswitch performance tests against winbind or \n"
                 "lsassd.\n"
@@ -327,7 +339,10 @@ int main(int argc, const char *argv[])
                 "The following groups should be available from the domain:\n"
                 "<domain>\\groupsize1\n"
                 "<domain>\\groupsize1000\n"
-                "<domain>\\usergroup0001 through <domain>\\usergroup0500\n",
+                "<domain>\\usergroup0001 through <domain>\\usergroup0500\n"
+                "\n"
+                "If a local user is given (e.g. HOST\\user), getpwnam is also timed\n"
+                "for that local provider account.\n",
                 argv[0]);
         exit(1);
     }
@@ -342,6 +357,28 @@ int main(int argc, const char *argv[])
             testList,
             sizeof(testList)/sizeof(testList[0]));
 
+    if (argc == 3)
+    {
+        // After the first lookup the local provider answers from its
+        // in-memory cache, so this measures the cache hit path.  The SAM
+        // database is only searched again after it changes.
+        PerfTest localTestList[] =
+        {
+            {
+                "getpwnam's per second for a local provider user",
+                TEST_TYPE_RUNS_PER_SEC,
+                SetupGrabName,
+                RunGrabName,
+                NULL,
+                (PVOID)argv[2]
+            },
+        };
+
+        RunTests(
+                localTestList,
+                sizeof(localTestList)/sizeof(localTestList[0]));
+    }
+
     libperflsass = dlopen("./libperflsass.so", RTLD_NOW | RTLD_LOCAL);
 
     if (libperflsass != NULL)
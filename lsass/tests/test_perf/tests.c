@@ -100,6 +100,36 @@ SetupGrabUid(
     return TRUE;
 }
 
+BOOL
+RunGrabName(
+    IN PVOID username
+    )
+{
+    struct passwd *result = getpwnam((PSTR)username);
+
+    if (result == NULL)
+    {
+        perror(__FUNCTION__);
+        return FALSE;
+    }
+    return TRUE;
+}
+
+BOOL
+SetupGrabName(
+    IN PVOID username,
+    OUT PVOID *name
+    )
+{
+    if (!RunGrabName(username))
+    {
+        return FALSE;
+    }
+
+    *name = username;
+    return TRUE;
+}
+
 BOOL
 RunGrabGid(
     IN PVOID arg
@@ -58,6 +58,17 @@ SetupGrabUid(
     OUT PVOID *uid
     );
 
+BOOL
+RunGrabName(
+    IN PVOID username
+    );
+
+BOOL
+SetupGrabName(
+    IN PVOID username,
+    OUT PVOID *name
+    );
+
 BOOL
 RunGrabGid(
     IN PVOID arg
@@ -151,6 +151,36 @@ LwLdapDirectorySearchEx(
     LDAPMessage** ppMessage
     );
 
+/*
+ * Starts a search without waiting for the reply, so several searches
+ * can be outstanding on one connection.  Collect the result with
+ * LwLdapDirectorySearchWait, or drop it with LwLdapDirectorySearchAbandon.
+ * The caller must own hDirectory for the whole exchange; there is no
+ * dispatcher to hand results to other threads.
+ */
+DWORD
+LwLdapDirectorySearchAsync(
+    HANDLE hDirectory,
+    PCSTR  pszObjectDN,
+    int    scope,
+    PCSTR  pszQuery,
+    PSTR*  ppszAttributeList,
+    int*   pMessageId
+    );
+
+DWORD
+LwLdapDirectorySearchWait(
+    HANDLE hDirectory,
+    int    messageId,
+    LDAPMessage** ppMessage
+    );
+
+VOID
+LwLdapDirectorySearchAbandon(
+    HANDLE hDirectory,
+    int    messageId
+    );
+
 DWORD
 LwLdapEnablePageControlOption(
     HANDLE hDirectory
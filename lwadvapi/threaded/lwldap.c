@@ -824,6 +824,139 @@ error:
     goto cleanup;
 }
 
+DWORD
+LwLdapDirectorySearchAsync(
+    HANDLE hDirectory,
+    PCSTR  pszObjectDN,
+    int    scope,
+    PCSTR  pszQuery,
+    PSTR*  ppszAttributeList,
+    int*   pMessageId
+    )
+{
+    DWORD dwError = LW_ERROR_SUCCESS;
+    PLW_LDAP_DIRECTORY_CONTEXT pDirectory = (PLW_LDAP_DIRECTORY_CONTEXT)hDirectory;
+    int messageId = -1;
+
+    dwError = ldap_search_ext(pDirectory->ld,
+                              pszObjectDN,
+                              scope,
+                              pszQuery,
+                              ppszAttributeList,
+                              0,
+                              NULL,
+                              NULL,
+                              NULL,
+                              0,
+                              &messageId);
+    BAIL_ON_LDAP_ERROR(dwError);
+
+cleanup:
+
+    *pMessageId = messageId;
+
+    return(dwError);
+
+error:
+
+    messageId = -1;
+
+    goto cleanup;
+}
+
+DWORD
+LwLdapDirectorySearchWait(
+    HANDLE hDirectory,
+    int    messageId,
+    LDAPMessage** ppMessage
+    )
+{
+    DWORD dwError = LW_ERROR_SUCCESS;
+    PLW_LDAP_DIRECTORY_CONTEXT pDirectory = (PLW_LDAP_DIRECTORY_CONTEXT)hDirectory;
+    struct timeval timeout = {0};
+    LDAPMessage* pMessage = NULL;
+    int resultCode = LDAP_SUCCESS;
+    int ret = 0;
+
+    // Same per-search limit as LwLdapDirectorySearch
+    timeout.tv_sec = 15;
+    timeout.tv_usec = 0;
+
+    ret = ldap_result(pDirectory->ld,
+                      messageId,
+                      LDAP_MSG_ALL,
+                      &timeout,
+                      &pMessage);
+    if (ret == 0)
+    {
+        LwLdapDirectorySearchAbandon(hDirectory, messageId);
+        dwError = LDAP_TIMEOUT;
+        BAIL_ON_LDAP_ERROR(dwError);
+    }
+    else if (ret == -1)
+    {
+        ldap_get_option(pDirectory->ld, LDAP_OPT_RESULT_CODE, &resultCode);
+        dwError = resultCode ? resultCode : LDAP_OTHER;
+        BAIL_ON_LDAP_ERROR(dwError);
+    }
+
+    dwError = ldap_parse_result(pDirectory->ld,
+                                pMessage,
+                                &resultCode,
+                                NULL,
+                                NULL,
+                                NULL,
+                                NULL,
+                                0);
+    BAIL_ON_LDAP_ERROR(dwError);
+
+    dwError = resultCode;
+    if (dwError) {
+        if (dwError == LDAP_NO_SUCH_OBJECT) {
+            LW_RTL_LOG_VERBOSE("Caught LDAP_NO_SUCH_OBJECT Error on ldap search");
+            BAIL_ON_LDAP_ERROR(dwError);
+        }
+        if (dwError == LDAP_REFERRAL) {
+            // As in LwLdapDirectorySearch, the result is still returned
+            LW_RTL_LOG_VERBOSE("Caught LDAP_REFERRAL Error on ldap search");
+            LW_RTL_LOG_VERBOSE("LDAP Search Info: message id: [%d]", messageId);
+            dwError = LwMapLdapErrorToLwError(dwError);
+            goto cleanup;
+        }
+        BAIL_ON_LDAP_ERROR(dwError);
+    }
+
+cleanup:
+
+    *ppMessage = pMessage; // even referrals use this
+
+    return(dwError);
+
+error:
+
+    if (pMessage)
+    {
+        ldap_msgfree(pMessage);
+        pMessage = NULL;
+    }
+
+    goto cleanup;
+}
+
+VOID
+LwLdapDirectorySearchAbandon(
+    HANDLE hDirectory,
+    int    messageId
+    )
+{
+    PLW_LDAP_DIRECTORY_CONTEXT pDirectory = (PLW_LDAP_DIRECTORY_CONTEXT)hDirectory;
+
+    if (pDirectory && pDirectory->ld && messageId >= 0)
+    {
+        ldap_abandon_ext(pDirectory->ld, messageId, NULL, NULL);
+    }
+}
+
 DWORD
 LwLdapEnablePageControlOption(
     HANDLE hDirectory
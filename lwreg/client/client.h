@@ -63,3 +63,4 @@
 #include "regipc.h"
 
 #include "clientipc_p.h"
+#include "regcache_p.h"
@@ -188,6 +188,8 @@ NtRegCloseServerOnce(
 {
     if (!LwInterlockedDecrement(&glLibraryRefCount))
     {
+        RegCacheShutdown();
+
         if (gContext.pClient)
         {
             lwmsg_peer_delete(gContext.pClient);
@@ -358,6 +360,8 @@ RegTransactCreateKeyExW(
             *phkResult = (HKEY) pCreateKeyExResp->hkResult;
             pCreateKeyExResp->hkResult = NULL;
 
+            RegCacheTrackKey(hKey, pSubKey, AccessDesired, *phkResult);
+
             if(pdwDisposition)
             {
                 *pdwDisposition = pCreateKeyExResp->dwDisposition;
@@ -430,6 +434,8 @@ RegTransactOpenKeyExW(
             *phkResult = (HKEY) pOpenKeyExResp->hkResult;
             pOpenKeyExResp->hkResult = NULL;
 
+            RegCacheTrackKey(hKey, pwszSubKey, AccessDesired, *phkResult);
+
             break;
         case REG_R_ERROR:
             pStatus = (PREG_IPC_STATUS) out.data;
@@ -499,6 +505,7 @@ RegTransactCloseKey(
 cleanup:
 
     /* Release handle no matter what */
+    RegCacheUntrackKey(hKey);
     RegIpcReleaseHandle(hConnection, hKey);
 
     if (pCall)
@@ -764,6 +771,14 @@ RegTransactGetValueW(
     LWMsgParams in = LWMSG_PARAMS_INITIALIZER;
     LWMsgParams out = LWMSG_PARAMS_INITIALIZER;
     LWMsgCall* pCall = NULL;
+    REG_VALUE_CACHE_TOKEN cacheToken = {0};
+
+    if (pcbData &&
+        RegCacheLookupValue(hKey, pSubKey, pValue, Flags, pdwType, pvData, pcbData,
+                            &cacheToken))
+    {
+        goto cleanup;
+    }
 
     status = RegIpcAcquireCall(hConnection, &pCall);
     BAIL_ON_NT_STATUS(status);
@@ -800,6 +815,19 @@ RegTransactGetValueW(
                 *pcbData = pGetValueResp->cbData;
             }
 
+            if (pvData && pcbData)
+            {
+                RegCacheStoreValue(
+                    &cacheToken,
+                    hKey,
+                    pSubKey,
+                    pValue,
+                    Flags,
+                    pGetValueResp->dwType,
+                    pGetValueResp->pvData,
+                    pGetValueResp->cbData);
+            }
+
             break;
 
         case REG_R_ERROR:
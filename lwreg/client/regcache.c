@@ -0,0 +1,721 @@
+/* Editor Settings: expandtabs and use 4 spaces for indentation
+ * ex: set softtabstop=4 tabstop=8 expandtab shiftwidth=4: *
+ * -*- mode: c, c-basic-offset: 4 -*- */
+
+/*
+ * Copyright © BeyondTrust Software 2004 - 2019
+ * All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * BEYONDTRUST MAKES THIS SOFTWARE AVAILABLE UNDER OTHER LICENSING TERMS AS
+ * WELL. IF YOU HAVE ENTERED INTO A SEPARATE LICENSE AGREEMENT WITH
+ * BEYONDTRUST, THEN YOU MAY ELECT TO USE THE SOFTWARE UNDER THE TERMS OF THAT
+ * SOFTWARE LICENSE AGREEMENT INSTEAD OF THE TERMS OF THE APACHE LICENSE,
+ * NOTWITHSTANDING THE ABOVE NOTICE.  IF YOU HAVE QUESTIONS, OR WISH TO REQUEST
+ * A COPY OF THE ALTERNATE LICENSING TERMS OFFERED BY BEYONDTRUST, PLEASE CONTACT
+ * BEYONDTRUST AT beyondtrust.com/contact
+ */
+
+/*
+ * Copyright (C) BeyondTrust Software. All rights reserved.
+ *
+ * Module Name:
+ *
+ *        regcache.c
+ *
+ * Abstract:
+ *
+ *        Registry Subsystem
+ *
+ *        Client-side value cache
+ *
+ *        Successful value lookups are kept per process and keyed by the
+ *        full path of the key they were read through, sub key, value name
+ *        and type flags, so they outlive the handle (most consumers open,
+ *        read and close their configuration key on every pass).  Key
+ *        handles opened while the cache is enabled are mapped to their
+ *        path; values read through any other handle are not cached.
+ *
+ *        lwregd publishes a change generation in a small shared file;
+ *        whenever it differs from the generation the cache was filled at,
+ *        every cached value is discarded.  Since the generation is bumped
+ *        by the server on every modification (including key security),
+ *        a missed change cannot go unnoticed.
+ *
+ */
+#include "client.h"
+
+#include <sys/mman.h>
+
+typedef struct _REG_VALUE_CACHE_HANDLE
+{
+    HKEY hKey;
+    PWSTR pwszKeyPath;
+    /* Whether lwregd granted value reads on this handle */
+    BOOLEAN bQueryValue;
+} REG_VALUE_CACHE_HANDLE, *PREG_VALUE_CACHE_HANDLE;
+
+typedef struct _REG_VALUE_CACHE_ENTRY
+{
+    PWSTR pwszKeyPath;
+    PWSTR pwszSubKey;
+    PWSTR pwszValue;
+    REG_DATA_TYPE_FLAGS Flags;
+    DWORD dwType;
+    DWORD cbData;
+    BYTE Data[];
+} REG_VALUE_CACHE_ENTRY, *PREG_VALUE_CACHE_ENTRY;
+
+typedef struct _REG_VALUE_CACHE
+{
+    pthread_mutex_t Lock;
+    BOOLEAN bInitialized;
+    BOOLEAN bEnabled;
+    PREG_HASH_TABLE pTable;
+    PREG_HASH_TABLE pHandles;
+    PREG_IPC_CACHE_GENERATION pGeneration;
+    ino_t GenerationInode;
+    time_t LastRevalidated;
+    LONG lEpoch;
+    LONG lGeneration;
+    ULONG64 ullHits;
+    ULONG64 ullMisses;
+    ULONG64 ullInvalidations;
+} REG_VALUE_CACHE, *PREG_VALUE_CACHE;
+
+static REG_VALUE_CACHE gRegValueCache =
+{
+    .Lock = PTHREAD_MUTEX_INITIALIZER
+};
+
+static
+int
+RegCacheCompareOptionalString(
+    PCWSTR pwszString1,
+    PCWSTR pwszString2
+    )
+{
+    if (LW_IS_NULL_OR_EMPTY_STR(pwszString1) ||
+        LW_IS_NULL_OR_EMPTY_STR(pwszString2))
+    {
+        return !(LW_IS_NULL_OR_EMPTY_STR(pwszString1) &&
+                 LW_IS_NULL_OR_EMPTY_STR(pwszString2));
+    }
+
+    return RegHashCaselessWC16StringCompare(pwszString1, pwszString2);
+}
+
+static
+int
+RegCacheCompareEntry(
+    PCVOID pvEntry1,
+    PCVOID pvEntry2
+    )
+{
+    const REG_VALUE_CACHE_ENTRY* pEntry1 = pvEntry1;
+    const REG_VALUE_CACHE_ENTRY* pEntry2 = pvEntry2;
+
+    if (pEntry1->Flags != pEntry2->Flags)
+    {
+        return 1;
+    }
+
+    return RegHashCaselessWC16StringCompare(pEntry1->pwszKeyPath, pEntry2->pwszKeyPath) ||
+           RegCacheCompareOptionalString(pEntry1->pwszSubKey, pEntry2->pwszSubKey) ||
+           RegCacheCompareOptionalString(pEntry1->pwszValue, pEntry2->pwszValue);
+}
+
+static
+size_t
+RegCacheHashEntry(
+    PCVOID pvEntry
+    )
+{
+    const REG_VALUE_CACHE_ENTRY* pEntry = pvEntry;
+    size_t result = RegHashCaselessWc16String(pEntry->pwszKeyPath) ^ pEntry->Flags;
+
+    if (!LW_IS_NULL_OR_EMPTY_STR(pEntry->pwszSubKey))
+    {
+        result = result * 31 + RegHashCaselessWc16String(pEntry->pwszSubKey);
+    }
+
+    if (!LW_IS_NULL_OR_EMPTY_STR(pEntry->pwszValue))
+    {
+        result = result * 31 + RegHashCaselessWc16String(pEntry->pwszValue);
+    }
+
+    return result;
+}
+
+static
+VOID
+RegCacheFreeEntry(
+    const REG_HASH_ENTRY* pHashEntry
+    )
+{
+    PREG_VALUE_CACHE_ENTRY pEntry = pHashEntry->pValue;
+
+    if (pEntry)
+    {
+        LWREG_SAFE_FREE_MEMORY(pEntry->pwszKeyPath);
+        LWREG_SAFE_FREE_MEMORY(pEntry->pwszSubKey);
+        LWREG_SAFE_FREE_MEMORY(pEntry->pwszValue);
+        LwRtlMemoryFree(pEntry);
+    }
+}
+
+static
+VOID
+RegCacheFreeHandle(
+    const REG_HASH_ENTRY* pHashEntry
+    )
+{
+    PREG_VALUE_CACHE_HANDLE pHandle = pHashEntry->pValue;
+
+    if (pHandle)
+    {
+        LWREG_SAFE_FREE_MEMORY(pHandle->pwszKeyPath);
+        LwRtlMemoryFree(pHandle);
+    }
+}
+
+static
+PREG_VALUE_CACHE_HANDLE
+RegCacheFindHandle_inlock(
+    IN HKEY hKey
+    )
+{
+    PREG_VALUE_CACHE_HANDLE pHandle = NULL;
+
+    if (!hKey || !gRegValueCache.pHandles ||
+        RegHashGetValue(gRegValueCache.pHandles, hKey, (PVOID*) &pHandle) != STATUS_SUCCESS)
+    {
+        return NULL;
+    }
+
+    return pHandle;
+}
+
+static
+VOID
+RegCacheUnmapGeneration_inlock(
+    VOID
+    )
+{
+    if (gRegValueCache.pGeneration)
+    {
+        munmap(gRegValueCache.pGeneration, sizeof(*gRegValueCache.pGeneration));
+        gRegValueCache.pGeneration = NULL;
+    }
+}
+
+static
+VOID
+RegCacheMapGeneration_inlock(
+    VOID
+    )
+{
+    int fd = -1;
+    struct stat statbuf = {0};
+    PVOID pMap = MAP_FAILED;
+
+    RegCacheUnmapGeneration_inlock();
+
+    fd = open(CACHEDIR "/" REG_CACHE_GENERATION_FILENAME, O_RDONLY);
+    if (fd < 0 ||
+        fstat(fd, &statbuf) < 0 ||
+        statbuf.st_size < sizeof(*gRegValueCache.pGeneration))
+    {
+        goto cleanup;
+    }
+
+    pMap = mmap(NULL, sizeof(*gRegValueCache.pGeneration), PROT_READ, MAP_SHARED, fd, 0);
+    if (pMap == MAP_FAILED)
+    {
+        goto cleanup;
+    }
+
+    gRegValueCache.pGeneration = pMap;
+    gRegValueCache.GenerationInode = statbuf.st_ino;
+
+cleanup:
+
+    if (fd >= 0)
+    {
+        close(fd);
+    }
+}
+
+static
+VOID
+RegCacheFlush_inlock(
+    VOID
+    )
+{
+    if (gRegValueCache.pTable && gRegValueCache.pTable->sCount)
+    {
+        RegHashRemoveAll(gRegValueCache.pTable);
+        gRegValueCache.ullInvalidations++;
+    }
+}
+
+static
+VOID
+RegCacheInitialize_inlock(
+    VOID
+    )
+{
+    PCSTR pszEnable = NULL;
+
+    if (!gRegValueCache.bInitialized)
+    {
+        pszEnable = getenv(REG_VALUE_CACHE_ENV);
+        if (pszEnable && *pszEnable && strcmp(pszEnable, "0"))
+        {
+            gRegValueCache.bEnabled = TRUE;
+        }
+
+        gRegValueCache.bInitialized = TRUE;
+    }
+}
+
+/*
+ * Returns TRUE when cached entries can be trusted.  Flushes the cache
+ * if lwregd reported a change (or restarted) since it was filled.
+ */
+static
+BOOLEAN
+RegCacheValidate_inlock(
+    VOID
+    )
+{
+    PREG_IPC_CACHE_GENERATION pGeneration = NULL;
+    struct stat statbuf = {0};
+    time_t now = time(NULL);
+    LONG lEpoch = 0;
+    LONG lGeneration = 0;
+
+    if (!gRegValueCache.pGeneration ||
+        now - gRegValueCache.LastRevalidated >= REG_VALUE_CACHE_REVALIDATE_SECS)
+    {
+        gRegValueCache.LastRevalidated = now;
+
+        /*
+         * A restarted lwregd recreates the generation file, leaving our
+         * mapping pointing at the unlinked one.
+         */
+        if (!gRegValueCache.pGeneration ||
+            stat(CACHEDIR "/" REG_CACHE_GENERATION_FILENAME, &statbuf) < 0 ||
+            statbuf.st_ino != gRegValueCache.GenerationInode)
+        {
+            RegCacheMapGeneration_inlock();
+        }
+    }
+
+    pGeneration = gRegValueCache.pGeneration;
+
+    if (!pGeneration || pGeneration->ulMagic != REG_CACHE_GENERATION_MAGIC)
+    {
+        RegCacheFlush_inlock();
+        return FALSE;
+    }
+
+    lEpoch = pGeneration->lEpoch;
+    lGeneration = LwInterlockedRead(&pGeneration->lGeneration);
+
+    if (lEpoch != gRegValueCache.lEpoch ||
+        lGeneration != gRegValueCache.lGeneration)
+    {
+        RegCacheFlush_inlock();
+        gRegValueCache.lEpoch = lEpoch;
+        gRegValueCache.lGeneration = lGeneration;
+    }
+
+    return TRUE;
+}
+
+BOOLEAN
+RegCacheLookupValue(
+    IN HKEY hKey,
+    IN OPTIONAL PCWSTR pSubKey,
+    IN OPTIONAL PCWSTR pValue,
+    IN REG_DATA_TYPE_FLAGS Flags,
+    OUT OPTIONAL PDWORD pdwType,
+    OUT OPTIONAL PVOID pvData,
+    IN OUT PDWORD pcbData,
+    OUT PREG_VALUE_CACHE_TOKEN pToken
+    )
+{
+    BOOLEAN bHit = FALSE;
+    REG_VALUE_CACHE_ENTRY key = {0};
+    PREG_VALUE_CACHE_ENTRY pEntry = NULL;
+    PREG_VALUE_CACHE_HANDLE pHandle = NULL;
+
+    memset(pToken, 0, sizeof(*pToken));
+
+    pthread_mutex_lock(&gRegValueCache.Lock);
+
+    RegCacheInitialize_inlock();
+
+    if (!gRegValueCache.bEnabled)
+    {
+        goto cleanup;
+    }
+
+    /*
+     * Only serve handles lwregd already granted value reads on; for any
+     * other handle it has to produce the access check result itself.
+     */
+    pHandle = RegCacheFindHandle_inlock(hKey);
+    if (!pHandle || !pHandle->bQueryValue || !RegCacheValidate_inlock())
+    {
+        goto cleanup;
+    }
+
+    pToken->bValid = TRUE;
+    pToken->lEpoch = gRegValueCache.lEpoch;
+    pToken->lGeneration = gRegValueCache.lGeneration;
+
+    key.pwszKeyPath = pHandle->pwszKeyPath;
+    key.pwszSubKey = (PWSTR) pSubKey;
+    key.pwszValue = (PWSTR) pValue;
+    key.Flags = Flags;
+
+    if (gRegValueCache.pTable &&
+        RegHashGetValue(gRegValueCache.pTable, &key, (PVOID*) &pEntry) == STATUS_SUCCESS)
+    {
+        /* Let lwregd produce the exact error for short buffers */
+        if (!pvData || *pcbData >= pEntry->cbData)
+        {
+            if (pdwType)
+            {
+                *pdwType = pEntry->dwType;
+            }
+
+            if (pvData)
+            {
+                memcpy(pvData, pEntry->Data, pEntry->cbData);
+            }
+
+            *pcbData = pEntry->cbData;
+            bHit = TRUE;
+        }
+    }
+
+    if (bHit)
+    {
+        gRegValueCache.ullHits++;
+    }
+    else
+    {
+        gRegValueCache.ullMisses++;
+    }
+
+cleanup:
+
+    pthread_mutex_unlock(&gRegValueCache.Lock);
+
+    return bHit;
+}
+
+VOID
+RegCacheStoreValue(
+    IN PREG_VALUE_CACHE_TOKEN pToken,
+    IN HKEY hKey,
+    IN OPTIONAL PCWSTR pSubKey,
+    IN OPTIONAL PCWSTR pValue,
+    IN REG_DATA_TYPE_FLAGS Flags,
+    IN DWORD dwType,
+    IN PCVOID pvData,
+    IN DWORD cbData
+    )
+{
+    NTSTATUS status = 0;
+    PREG_VALUE_CACHE_ENTRY pEntry = NULL;
+    PREG_VALUE_CACHE_HANDLE pHandle = NULL;
+
+    if (!pToken->bValid || cbData > REG_VALUE_CACHE_MAX_DATA)
+    {
+        return;
+    }
+
+    pthread_mutex_lock(&gRegValueCache.Lock);
+
+    RegCacheInitialize_inlock();
+
+    /*
+     * The value may predate a change lwregd published while the request
+     * was in flight, so it is only kept if the generation is still the
+     * one the lookup missed at.
+     */
+    if (!gRegValueCache.bEnabled || !RegCacheValidate_inlock() ||
+        gRegValueCache.lEpoch != pToken->lEpoch ||
+        gRegValueCache.lGeneration != pToken->lGeneration)
+    {
+        goto cleanup;
+    }
+
+    pHandle = RegCacheFindHandle_inlock(hKey);
+    if (!pHandle || !pHandle->bQueryValue)
+    {
+        goto cleanup;
+    }
+
+    if (!gRegValueCache.pTable)
+    {
+        status = RegHashCreate(
+                        REG_VALUE_CACHE_MAX_ENTRIES / 4,
+                        RegCacheCompareEntry,
+                        RegCacheHashEntry,
+                        RegCacheFreeEntry,
+                        NULL,
+                        &gRegValueCache.pTable);
+        BAIL_ON_NT_STATUS(status);
+    }
+    else if (gRegValueCache.pTable->sCount >= REG_VALUE_CACHE_MAX_ENTRIES)
+    {
+        RegCacheFlush_inlock();
+    }
+
+    status = LW_RTL_ALLOCATE(&pEntry, REG_VALUE_CACHE_ENTRY, sizeof(*pEntry) + cbData);
+    BAIL_ON_NT_STATUS(status);
+
+    pEntry->Flags = Flags;
+    pEntry->dwType = dwType;
+    pEntry->cbData = cbData;
+
+    status = LwRtlWC16StringDuplicate(&pEntry->pwszKeyPath, pHandle->pwszKeyPath);
+    BAIL_ON_NT_STATUS(status);
+
+    if (pSubKey)
+    {
+        status = LwRtlWC16StringDuplicate(&pEntry->pwszSubKey, pSubKey);
+        BAIL_ON_NT_STATUS(status);
+    }
+
+    if (pValue)
+    {
+        status = LwRtlWC16StringDuplicate(&pEntry->pwszValue, pValue);
+        BAIL_ON_NT_STATUS(status);
+    }
+
+    if (cbData)
+    {
+        memcpy(pEntry->Data, pvData, cbData);
+    }
+
+    status = RegHashSetValue(gRegValueCache.pTable, pEntry, pEntry);
+    BAIL_ON_NT_STATUS(status);
+
+    pEntry = NULL;
+
+cleanup:
+
+    pthread_mutex_unlock(&gRegValueCache.Lock);
+
+    return;
+
+error:
+
+    if (pEntry)
+    {
+        REG_HASH_ENTRY hashEntry = { .pKey = pEntry, .pValue = pEntry };
+
+        RegCacheFreeEntry(&hashEntry);
+    }
+
+    goto cleanup;
+}
+
+VOID
+RegCacheTrackKey(
+    IN OPTIONAL HKEY hParentKey,
+    IN OPTIONAL PCWSTR pSubKey,
+    IN ACCESS_MASK AccessGranted,
+    IN HKEY hKey
+    )
+{
+    NTSTATUS status = 0;
+    PREG_VALUE_CACHE_HANDLE pParent = NULL;
+    PREG_VALUE_CACHE_HANDLE pHandle = NULL;
+
+    pthread_mutex_lock(&gRegValueCache.Lock);
+
+    RegCacheInitialize_inlock();
+
+    if (!gRegValueCache.bEnabled || !hKey)
+    {
+        goto cleanup;
+    }
+
+    /* Root keys are opened by name without a parent */
+    if (hParentKey)
+    {
+        pParent = RegCacheFindHandle_inlock(hParentKey);
+        if (!pParent)
+        {
+            goto cleanup;
+        }
+    }
+    else if (LW_IS_NULL_OR_EMPTY_STR(pSubKey))
+    {
+        goto cleanup;
+    }
+
+    if (!gRegValueCache.pHandles)
+    {
+        status = RegHashCreate(
+                        REG_VALUE_CACHE_MAX_ENTRIES / 4,
+                        RegHashPVoidCompare,
+                        RegHashPVoidHash,
+                        RegCacheFreeHandle,
+                        NULL,
+                        &gRegValueCache.pHandles);
+        BAIL_ON_NT_STATUS(status);
+    }
+
+    status = LW_RTL_ALLOCATE(&pHandle, REG_VALUE_CACHE_HANDLE, sizeof(*pHandle));
+    BAIL_ON_NT_STATUS(status);
+
+    pHandle->hKey = hKey;
+    pHandle->bQueryValue =
+        (AccessGranted & (KEY_QUERY_VALUE | GENERIC_READ | GENERIC_ALL)) ? TRUE : FALSE;
+
+    if (!pParent)
+    {
+        status = LwRtlWC16StringDuplicate(&pHandle->pwszKeyPath, pSubKey);
+    }
+    else if (LW_IS_NULL_OR_EMPTY_STR(pSubKey))
+    {
+        status = LwRtlWC16StringDuplicate(&pHandle->pwszKeyPath, pParent->pwszKeyPath);
+    }
+    else
+    {
+        status = LwRtlWC16StringAllocatePrintfW(
+                        &pHandle->pwszKeyPath,
+                        L"%ws\\%ws",
+                        pParent->pwszKeyPath,
+                        pSubKey);
+    }
+    BAIL_ON_NT_STATUS(status);
+
+    /* Replaces (and frees) any stale mapping of a reused handle value */
+    status = RegHashSetValue(gRegValueCache.pHandles, hKey, pHandle);
+    BAIL_ON_NT_STATUS(status);
+
+    pHandle = NULL;
+
+cleanup:
+
+    pthread_mutex_unlock(&gRegValueCache.Lock);
+
+    return;
+
+error:
+
+    if (pHandle)
+    {
+        REG_HASH_ENTRY hashEntry = { .pKey = hKey, .pValue = pHandle };
+
+        RegCacheFreeHandle(&hashEntry);
+    }
+
+    goto cleanup;
+}
+
+VOID
+RegCacheUntrackKey(
+    IN HKEY hKey
+    )
+{
+    pthread_mutex_lock(&gRegValueCache.Lock);
+
+    /* Cached values stay; they belong to the key path, not the handle */
+    if (gRegValueCache.pHandles)
+    {
+        RegHashRemoveKey(gRegValueCache.pHandles, hKey);
+    }
+
+    pthread_mutex_unlock(&gRegValueCache.Lock);
+}
+
+VOID
+RegCacheShutdown(
+    VOID
+    )
+{
+    pthread_mutex_lock(&gRegValueCache.Lock);
+
+    RegHashSafeFree(&gRegValueCache.pTable);
+    RegHashSafeFree(&gRegValueCache.pHandles);
+    RegCacheUnmapGeneration_inlock();
+
+    pthread_mutex_unlock(&gRegValueCache.Lock);
+}
+
+REG_API
+VOID
+RegEnableValueCache(
+    IN BOOLEAN bEnable
+    )
+{
+    pthread_mutex_lock(&gRegValueCache.Lock);
+
+    gRegValueCache.bInitialized = TRUE;
+    gRegValueCache.bEnabled = bEnable;
+
+    if (!bEnable)
+    {
+        RegCacheFlush_inlock();
+        RegHashSafeFree(&gRegValueCache.pHandles);
+    }
+
+    pthread_mutex_unlock(&gRegValueCache.Lock);
+}
+
+REG_API
+DWORD
+RegGetValueCacheStats(
+    OUT PLWREG_VALUE_CACHE_STATS pStats
+    )
+{
+    DWORD dwError = 0;
+
+    if (!pStats)
+    {
+        dwError = ERROR_INVALID_PARAMETER;
+        BAIL_ON_REG_ERROR(dwError);
+    }
+
+    memset(pStats, 0, sizeof(*pStats));
+
+    pthread_mutex_lock(&gRegValueCache.Lock);
+
+    RegCacheInitialize_inlock();
+
+    pStats->bEnabled = gRegValueCache.bEnabled;
+    pStats->bGenerationAvailable = RegCacheValidate_inlock();
+    pStats->dwEntries = gRegValueCache.pTable ? gRegValueCache.pTable->sCount : 0;
+    pStats->ullHits = gRegValueCache.ullHits;
+    pStats->ullMisses = gRegValueCache.ullMisses;
+    pStats->ullInvalidations = gRegValueCache.ullInvalidations;
+    pStats->lEpoch = gRegValueCache.lEpoch;
+    pStats->lGeneration = gRegValueCache.lGeneration;
+
+    pthread_mutex_unlock(&gRegValueCache.Lock);
+
+error:
+
+    return dwError;
+}
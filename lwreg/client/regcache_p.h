@@ -0,0 +1,111 @@
+/* Editor Settings: expandtabs and use 4 spaces for indentation
+ * ex: set softtabstop=4 tabstop=8 expandtab shiftwidth=4: *
+ * -*- mode: c, c-basic-offset: 4 -*- */
+
+/*
+ * Copyright © BeyondTrust Software 2004 - 2019
+ * All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * BEYONDTRUST MAKES THIS SOFTWARE AVAILABLE UNDER OTHER LICENSING TERMS AS
+ * WELL. IF YOU HAVE ENTERED INTO A SEPARATE LICENSE AGREEMENT WITH
+ * BEYONDTRUST, THEN YOU MAY ELECT TO USE THE SOFTWARE UNDER THE TERMS OF THAT
+ * SOFTWARE LICENSE AGREEMENT INSTEAD OF THE TERMS OF THE APACHE LICENSE,
+ * NOTWITHSTANDING THE ABOVE NOTICE.  IF YOU HAVE QUESTIONS, OR WISH TO REQUEST
+ * A COPY OF THE ALTERNATE LICENSING TERMS OFFERED BY BEYONDTRUST, PLEASE CONTACT
+ * BEYONDTRUST AT beyondtrust.com/contact
+ */
+
+/*
+ * Copyright (C) BeyondTrust Software. All rights reserved.
+ *
+ * Module Name:
+ *
+ *        regcache_p.h
+ *
+ * Abstract:
+ *
+ *        Registry Subsystem
+ *
+ *        Private Header (Library)
+ *
+ *        Client-side value cache
+ *
+ */
+#ifndef __REGCACHE_P_H__
+#define __REGCACHE_P_H__
+
+/* Values larger than this are always fetched from lwregd */
+#define REG_VALUE_CACHE_MAX_DATA       4096
+/* The cache is flushed rather than grown past this many values */
+#define REG_VALUE_CACHE_MAX_ENTRIES    1024
+/* How often to check whether lwregd was restarted behind our mapping */
+#define REG_VALUE_CACHE_REVALIDATE_SECS 1
+
+#define REG_VALUE_CACHE_ENV "LW_REG_VALUE_CACHE"
+
+/*
+ * The cache generation a lookup missed at.  A value fetched from lwregd
+ * is only stored if no change was published since this snapshot.
+ */
+typedef struct _REG_VALUE_CACHE_TOKEN
+{
+    BOOLEAN bValid;
+    LONG lEpoch;
+    LONG lGeneration;
+} REG_VALUE_CACHE_TOKEN, *PREG_VALUE_CACHE_TOKEN;
+
+BOOLEAN
+RegCacheLookupValue(
+    IN HKEY hKey,
+    IN OPTIONAL PCWSTR pSubKey,
+    IN OPTIONAL PCWSTR pValue,
+    IN REG_DATA_TYPE_FLAGS Flags,
+    OUT OPTIONAL PDWORD pdwType,
+    OUT OPTIONAL PVOID pvData,
+    IN OUT PDWORD pcbData,
+    OUT PREG_VALUE_CACHE_TOKEN pToken
+    );
+
+VOID
+RegCacheStoreValue(
+    IN PREG_VALUE_CACHE_TOKEN pToken,
+    IN HKEY hKey,
+    IN OPTIONAL PCWSTR pSubKey,
+    IN OPTIONAL PCWSTR pValue,
+    IN REG_DATA_TYPE_FLAGS Flags,
+    IN DWORD dwType,
+    IN PCVOID pvData,
+    IN DWORD cbData
+    );
+
+VOID
+RegCacheTrackKey(
+    IN OPTIONAL HKEY hParentKey,
+    IN OPTIONAL PCWSTR pSubKey,
+    IN ACCESS_MASK AccessGranted,
+    IN HKEY hKey
+    );
+
+VOID
+RegCacheUntrackKey(
+    IN HKEY hKey
+    );
+
+VOID
+RegCacheShutdown(
+    VOID
+    );
+
+#endif /* __REGCACHE_P_H__ */
@@ -586,6 +586,59 @@ LwRegProcessConfigUsingAttributeRanges(
     IN DWORD dwConfigEntries
     );
 
+/**
+ * Statistics for the per-process registry value cache
+ */
+typedef struct _LWREG_VALUE_CACHE_STATS
+{
+    /** TRUE if the cache is enabled in this process */
+    BOOLEAN bEnabled;
+    /** TRUE if lwregd publishes a change generation to validate against */
+    BOOLEAN bGenerationAvailable;
+    /** Number of values currently cached */
+    DWORD dwEntries;
+    /** Lookups answered from the cache */
+    ULONG64 ullHits;
+    /** Lookups that went to lwregd */
+    ULONG64 ullMisses;
+    /** Times the whole cache was discarded after a change */
+    ULONG64 ullInvalidations;
+    /** Server start epoch the cache is currently filled against */
+    LONG lEpoch;
+    /** Change generation the cache is currently filled against */
+    LONG lGeneration;
+} LWREG_VALUE_CACHE_STATS, *PLWREG_VALUE_CACHE_STATS;
+
+/**
+ * Enable or disable the per-process registry value cache
+ *
+ * When enabled, successful RegGetValue/RegQueryValueEx results are kept
+ * in memory and served without a round trip to lwregd until lwregd
+ * reports that the registry changed.  Values are kept per key path, so
+ * they survive closing and reopening the key, but only for keys opened
+ * (with KEY_QUERY_VALUE) after the cache was enabled.  The cache is off
+ * by default; it can also be enabled by setting LW_REG_VALUE_CACHE=1 in
+ * the environment.
+ *
+ * @param[in] bEnable TRUE to enable, FALSE to disable and flush
+ */
+VOID
+LwRegEnableValueCache(
+    IN BOOLEAN bEnable
+    );
+
+/**
+ * Retrieve statistics for the per-process registry value cache
+ *
+ * @param[out] pStats receives the current statistics
+ *
+ * @return LW_ERROR_SUCCESS or error
+ */
+DWORD
+LwRegGetValueCacheStats(
+    OUT PLWREG_VALUE_CACHE_STATS pStats
+    );
+
 #ifndef LW_STRICT_NAMESPACE
 #define RegOpenServer LwRegOpenServer
 #define RegCloseServer LwRegCloseServer
@@ -653,6 +706,8 @@ LwRegProcessConfigUsingAttributeRanges(
 #define RegUpdateConfigItemRange LwRegUpdateConfigItemRange
 #define RegProcessConfig LwRegProcessConfig
 #define RegProcessConfigUsingAttributeRanges LwRegProcessConfigUsingAttributeRanges
+#define RegEnableValueCache LwRegEnableValueCache
+#define RegGetValueCacheStats LwRegGetValueCacheStats
 
 #endif /* ! LW_STRICT_NAMESPACE */
 
@@ -51,6 +51,24 @@
 #define REG_CLIENT_PATH_FORMAT "/var/tmp/.regclient_%05ld"
 #define REG_SERVER_FILENAME    ".regsd"
 
+/*
+ * Change generation published by lwregd for client-side value caches.
+ *
+ * The server maps this file shared and bumps lGeneration after every
+ * successful modification.  Clients map it read-only and discard their
+ * cached values whenever the generation (or the epoch, which changes on
+ * every server start) differs from the one their entries were filled at.
+ */
+#define REG_CACHE_GENERATION_FILENAME ".regsd-gen"
+#define REG_CACHE_GENERATION_MAGIC    0x52474e31 /* "RGN1" */
+
+typedef struct __REG_IPC_CACHE_GENERATION
+{
+    ULONG ulMagic;
+    LONG lEpoch;
+    volatile LONG lGeneration;
+} REG_IPC_CACHE_GENERATION, *PREG_IPC_CACHE_GENERATION;
+
 typedef enum __REG_IPC_TAG
 {
     REG_R_ERROR,
@@ -0,0 +1,147 @@
+/* Editor Settings: expandtabs and use 4 spaces for indentation
+ * ex: set softtabstop=4 tabstop=8 expandtab shiftwidth=4: *
+ * -*- mode: c, c-basic-offset: 4 -*- */
+
+/*
+ * Copyright © BeyondTrust Software 2004 - 2019
+ * All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * BEYONDTRUST MAKES THIS SOFTWARE AVAILABLE UNDER OTHER LICENSING TERMS AS
+ * WELL. IF YOU HAVE ENTERED INTO A SEPARATE LICENSE AGREEMENT WITH
+ * BEYONDTRUST, THEN YOU MAY ELECT TO USE THE SOFTWARE UNDER THE TERMS OF THAT
+ * SOFTWARE LICENSE AGREEMENT INSTEAD OF THE TERMS OF THE APACHE LICENSE,
+ * NOTWITHSTANDING THE ABOVE NOTICE.  IF YOU HAVE QUESTIONS, OR WISH TO REQUEST
+ * A COPY OF THE ALTERNATE LICENSING TERMS OFFERED BY BEYONDTRUST, PLEASE CONTACT
+ * BEYONDTRUST AT beyondtrust.com/contact
+ */
+
+/*
+ * Copyright (C) BeyondTrust Software. All rights reserved.
+ *
+ * Module Name:
+ *
+ *        cachegen.c
+ *
+ * Abstract:
+ *
+ *        Registry
+ *
+ *        Change generation published to client-side value caches
+ *
+ */
+#include "api.h"
+
+#include <sys/mman.h>
+
+static PREG_IPC_CACHE_GENERATION gpRegCacheGeneration = NULL;
+
+DWORD
+RegSrvCacheGenerationInit(
+    VOID
+    )
+{
+    DWORD dwError = 0;
+    int fd = -1;
+    PVOID pMap = MAP_FAILED;
+    PREG_IPC_CACHE_GENERATION pGeneration = NULL;
+    PCSTR pszPath = CACHEDIR "/" REG_CACHE_GENERATION_FILENAME;
+
+    /*
+     * Always start from a fresh file so clients holding a mapping of a
+     * previous server instance notice the epoch change and do not trust
+     * anything cached against it.
+     */
+    if (unlink(pszPath) < 0 && errno != ENOENT)
+    {
+        dwError = RegMapErrnoToLwRegError(errno);
+        BAIL_ON_REG_ERROR(dwError);
+    }
+
+    fd = open(pszPath, O_RDWR | O_CREAT | O_EXCL, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+    if (fd < 0)
+    {
+        dwError = RegMapErrnoToLwRegError(errno);
+        BAIL_ON_REG_ERROR(dwError);
+    }
+
+    if (ftruncate(fd, sizeof(*pGeneration)) < 0)
+    {
+        dwError = RegMapErrnoToLwRegError(errno);
+        BAIL_ON_REG_ERROR(dwError);
+    }
+
+    pMap = mmap(NULL, sizeof(*pGeneration), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (pMap == MAP_FAILED)
+    {
+        dwError = RegMapErrnoToLwRegError(errno);
+        BAIL_ON_REG_ERROR(dwError);
+    }
+
+    pGeneration = pMap;
+    pGeneration->lEpoch = (LONG) time(NULL);
+    pGeneration->lGeneration = 0;
+    pGeneration->ulMagic = REG_CACHE_GENERATION_MAGIC;
+
+    gpRegCacheGeneration = pGeneration;
+
+cleanup:
+
+    if (fd >= 0)
+    {
+        close(fd);
+    }
+
+    return dwError;
+
+error:
+
+    /* Client caching is optional; lwregd runs fine without it */
+    REG_LOG_ERROR("Failed to publish registry change generation at %s (error %u)",
+                  pszPath, dwError);
+
+    if (pMap != MAP_FAILED)
+    {
+        munmap(pMap, sizeof(*pGeneration));
+    }
+
+    dwError = 0;
+
+    goto cleanup;
+}
+
+VOID
+RegSrvCacheGenerationShutdown(
+    VOID
+    )
+{
+    if (gpRegCacheGeneration)
+    {
+        /* Clients fall back to uncached lookups when the magic is gone */
+        gpRegCacheGeneration->ulMagic = 0;
+        munmap(gpRegCacheGeneration, sizeof(*gpRegCacheGeneration));
+        gpRegCacheGeneration = NULL;
+    }
+}
+
+VOID
+RegSrvCacheGenerationBump(
+    VOID
+    )
+{
+    if (gpRegCacheGeneration)
+    {
+        LwInterlockedIncrement(&gpRegCacheGeneration->lGeneration);
+    }
+}
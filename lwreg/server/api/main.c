@@ -103,6 +103,9 @@ RegSrvApiInit(
         BAIL_ON_REG_ERROR(dwError);
     }
 
+    dwError = RegSrvCacheGenerationInit();
+    BAIL_ON_REG_ERROR(dwError);
+
 cleanup:
 
     return dwError;
@@ -124,6 +127,8 @@ RegSrvApiShutdown(
     VOID
     )
 {
+    RegSrvCacheGenerationShutdown();
+
     RegSrvFreeProviders();
 
 #if defined(REG_USE_FILE)
@@ -173,9 +173,16 @@ RegSrvDeleteKey(
     PCWSTR pSubKey
     )
 {
-	return gpRegProvider->pfnRegSrvDeleteKey(Handle,
+    NTSTATUS status = gpRegProvider->pfnRegSrvDeleteKey(Handle,
 											 hKey,
 											 pSubKey);
+
+    if (!status)
+    {
+        RegSrvCacheGenerationBump();
+    }
+
+    return status;
 }
 
 NTSTATUS
@@ -186,10 +193,17 @@ RegSrvDeleteKeyValue(
     PCWSTR pValueName
     )
 {
-	return gpRegProvider->pfnRegSrvDeleteKeyValue(Handle,
+    NTSTATUS status = gpRegProvider->pfnRegSrvDeleteKeyValue(Handle,
 												  hKey,
 												  pSubKey,
 												  pValueName);
+
+    if (!status)
+    {
+        RegSrvCacheGenerationBump();
+    }
+
+    return status;
 }
 
 NTSTATUS
@@ -199,9 +213,16 @@ RegSrvDeleteValue(
     PCWSTR pValueName
     )
 {
-	return gpRegProvider->pfnRegSrvDeleteValue(Handle,
+    NTSTATUS status = gpRegProvider->pfnRegSrvDeleteValue(Handle,
                                                hKey,
                                                pValueName);
+
+    if (!status)
+    {
+        RegSrvCacheGenerationBump();
+    }
+
+    return status;
 }
 
 NTSTATUS
@@ -240,7 +261,7 @@ RegSrvSetValueExW(
     DWORD cbData
     )
 {
-   return gpRegProvider->pfnRegSrvSetValueExW(
+    NTSTATUS status = gpRegProvider->pfnRegSrvSetValueExW(
             Handle,
             hKey,
             pValueName,
@@ -248,6 +269,13 @@ RegSrvSetValueExW(
             dwType,
             pData,
             cbData);
+
+    if (!status)
+    {
+        RegSrvCacheGenerationBump();
+    }
+
+    return status;
 }
 
 NTSTATUS
@@ -338,10 +366,17 @@ RegSrvDeleteTree(
     PCWSTR pSubKey
     )
 {
-	return gpRegProvider->pfnRegSrvDeleteTree(
+    NTSTATUS status = gpRegProvider->pfnRegSrvDeleteTree(
             Handle,
             hKey,
             pSubKey);
+
+    if (!status)
+    {
+        RegSrvCacheGenerationBump();
+    }
+
+    return status;
 }
 
 NTSTATUS
@@ -373,12 +408,19 @@ RegSrvSetKeySecurity(
     IN ULONG ulSecDescLength
     )
 {
-    return gpRegProvider->pfnRegSrvSetKeySecurity(
+    NTSTATUS status = gpRegProvider->pfnRegSrvSetKeySecurity(
     		Handle,
     		hKey,
     		SecurityInformation,
     		pSecurityDescriptor,
     		ulSecDescLength);
+
+    if (!status)
+    {
+        RegSrvCacheGenerationBump();
+    }
+
+    return status;
 }
 
 NTSTATUS
@@ -410,12 +452,19 @@ RegSrvSetValueAttributesW(
     IN PLWREG_VALUE_ATTRIBUTES pValueAttributes
     )
 {
-   return gpRegProvider->pfnRegSrvSetValueAttributes(
+    NTSTATUS status = gpRegProvider->pfnRegSrvSetValueAttributes(
            hRegConnection,
             hKey,
             pSubKey,
             pValueName,
             pValueAttributes);
+
+    if (!status)
+    {
+        RegSrvCacheGenerationBump();
+    }
+
+    return status;
 }
 
 NTSTATUS
@@ -445,10 +494,17 @@ RegSrvDeleteValueAttributesW(
     IN PCWSTR pwszValueName
     )
 {
-    return gpRegProvider->pfnRegSrvDeleteValueAttributes(
+    NTSTATUS status = gpRegProvider->pfnRegSrvDeleteValueAttributes(
             hRegConnection,
              hKey,
              pwszSubKey,
              pwszValueName);
+
+    if (!status)
+    {
+        RegSrvCacheGenerationBump();
+    }
+
+    return status;
 }
 
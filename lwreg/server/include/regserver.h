@@ -142,6 +142,21 @@ RegSrvApiShutdown(
     VOID
     );
 
+DWORD
+RegSrvCacheGenerationInit(
+    VOID
+    );
+
+VOID
+RegSrvCacheGenerationShutdown(
+    VOID
+    );
+
+VOID
+RegSrvCacheGenerationBump(
+    VOID
+    );
+
 LWMsgDispatchSpec*
 RegSrvGetDispatchSpec(
     void
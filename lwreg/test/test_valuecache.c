@@ -0,0 +1,263 @@
+/*
+ * Copyright © BeyondTrust Software 2004 - 2019
+ * All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * BEYONDTRUST MAKES THIS SOFTWARE AVAILABLE UNDER OTHER LICENSING TERMS AS
+ * WELL. IF YOU HAVE ENTERED INTO A SEPARATE LICENSE AGREEMENT WITH
+ * BEYONDTRUST, THEN YOU MAY ELECT TO USE THE SOFTWARE UNDER THE TERMS OF THAT
+ * SOFTWARE LICENSE AGREEMENT INSTEAD OF THE TERMS OF THE APACHE LICENSE,
+ * NOTWITHSTANDING THE ABOVE NOTICE.  IF YOU HAVE QUESTIONS, OR WISH TO REQUEST
+ * A COPY OF THE ALTERNATE LICENSING TERMS OFFERED BY BEYONDTRUST, PLEASE CONTACT
+ * BEYONDTRUST AT beyondtrust.com/contact
+ */
+
+/*
+ * Copyright (C) BeyondTrust Software. All rights reserved.
+ *
+ * Module Name:
+ *
+ *        test_valuecache.c
+ *
+ * Abstract:
+ *
+ *        Client-side registry value cache tests
+ *
+ *        Reads a value the way RegProcessConfig does (open the root key,
+ *        read, close) and checks that repeated passes are answered from
+ *        the cache and that a change made through lwregd is seen by the
+ *        next pass.
+ *
+ */
+#include "includes.h"
+
+#define TEST_VALUECACHE_KEY "Services\\test_valuecache"
+#define TEST_VALUECACHE_VALUE "Value"
+
+static
+DWORD
+TestReadValue(
+    HANDLE hReg,
+    PDWORD pdwValue
+    )
+{
+    DWORD dwError = 0;
+    HKEY hRootKey = NULL;
+    DWORD dwValue = 0;
+    DWORD cbData = sizeof(dwValue);
+
+    dwError = RegOpenKeyExA(
+                hReg,
+                NULL,
+                HKEY_THIS_MACHINE,
+                0,
+                KEY_READ,
+                &hRootKey);
+    BAIL_ON_REG_ERROR(dwError);
+
+    dwError = RegGetValueA(
+                hReg,
+                hRootKey,
+                TEST_VALUECACHE_KEY,
+                TEST_VALUECACHE_VALUE,
+                RRF_RT_REG_DWORD,
+                NULL,
+                &dwValue,
+                &cbData);
+    BAIL_ON_REG_ERROR(dwError);
+
+    *pdwValue = dwValue;
+
+cleanup:
+
+    if (hRootKey)
+    {
+        RegCloseKey(hReg, hRootKey);
+    }
+
+    return dwError;
+
+error:
+
+    goto cleanup;
+}
+
+static
+DWORD
+TestWriteValue(
+    HANDLE hReg,
+    DWORD dwValue
+    )
+{
+    DWORD dwError = 0;
+    HKEY hRootKey = NULL;
+    HKEY hKey = NULL;
+
+    dwError = RegOpenKeyExA(
+                hReg,
+                NULL,
+                HKEY_THIS_MACHINE,
+                0,
+                KEY_ALL_ACCESS,
+                &hRootKey);
+    BAIL_ON_REG_ERROR(dwError);
+
+    dwError = RegCreateKeyExA(
+                hReg,
+                hRootKey,
+                TEST_VALUECACHE_KEY,
+                0,
+                NULL,
+                0,
+                KEY_ALL_ACCESS,
+                NULL,
+                &hKey,
+                NULL);
+    BAIL_ON_REG_ERROR(dwError);
+
+    dwError = RegSetValueExA(
+                hReg,
+                hKey,
+                TEST_VALUECACHE_VALUE,
+                0,
+                REG_DWORD,
+                (const BYTE*) &dwValue,
+                sizeof(dwValue));
+    BAIL_ON_REG_ERROR(dwError);
+
+cleanup:
+
+    if (hKey)
+    {
+        RegCloseKey(hReg, hKey);
+    }
+
+    if (hRootKey)
+    {
+        RegCloseKey(hReg, hRootKey);
+    }
+
+    return dwError;
+
+error:
+
+    goto cleanup;
+}
+
+static
+VOID
+TestDeleteKey(
+    HANDLE hReg
+    )
+{
+    HKEY hRootKey = NULL;
+
+    if (!RegOpenKeyExA(
+            hReg,
+            NULL,
+            HKEY_THIS_MACHINE,
+            0,
+            KEY_ALL_ACCESS,
+            &hRootKey))
+    {
+        RegDeleteTreeA(hReg, hRootKey, TEST_VALUECACHE_KEY);
+        RegCloseKey(hReg, hRootKey);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    DWORD dwError = 0;
+    HANDLE hReg = NULL;
+    DWORD dwValue = 0;
+    LWREG_VALUE_CACHE_STATS before = {0};
+    LWREG_VALUE_CACHE_STATS after = {0};
+    int failures = 0;
+
+    RegEnableValueCache(TRUE);
+
+    dwError = RegOpenServer(&hReg);
+    printf("RegOpenServer()=%d\n", dwError);
+    BAIL_ON_REG_ERROR(dwError);
+
+    dwError = TestWriteValue(hReg, 1);
+    printf("TestWriteValue(1)=%d\n", dwError);
+    BAIL_ON_REG_ERROR(dwError);
+
+    /* First pass fills the cache */
+    dwError = TestReadValue(hReg, &dwValue);
+    BAIL_ON_REG_ERROR(dwError);
+
+    dwError = RegGetValueCacheStats(&before);
+    BAIL_ON_REG_ERROR(dwError);
+
+    /* Second pass goes through a new root key handle */
+    dwError = TestReadValue(hReg, &dwValue);
+    BAIL_ON_REG_ERROR(dwError);
+
+    dwError = RegGetValueCacheStats(&after);
+    BAIL_ON_REG_ERROR(dwError);
+
+    if (dwValue != 1)
+    {
+        printf("FAIL: read %u, expected 1\n", dwValue);
+        failures++;
+    }
+
+    if (!after.bGenerationAvailable)
+    {
+        printf("SKIP: lwregd does not publish a change generation\n");
+    }
+    else if (after.ullHits <= before.ullHits)
+    {
+        printf("FAIL: value was not served from the cache after reopening the key\n");
+        failures++;
+    }
+    else
+    {
+        printf("PASS: value served from the cache after reopening the key\n");
+    }
+
+    dwError = TestWriteValue(hReg, 2);
+    printf("TestWriteValue(2)=%d\n", dwError);
+    BAIL_ON_REG_ERROR(dwError);
+
+    dwError = TestReadValue(hReg, &dwValue);
+    BAIL_ON_REG_ERROR(dwError);
+
+    if (dwValue != 2)
+    {
+        printf("FAIL: read %u after change, expected 2\n", dwValue);
+        failures++;
+    }
+    else
+    {
+        printf("PASS: change seen by the next read\n");
+    }
+
+cleanup:
+
+    if (hReg)
+    {
+        TestDeleteKey(hReg);
+        RegCloseServer(hReg);
+    }
+
+    return (dwError || failures) ? 1 : 0;
+
+error:
+
+    printf("ERROR %d\n", dwError);
+    goto cleanup;
+}
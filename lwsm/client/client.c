@@ -452,6 +452,72 @@ error:
     goto cleanup;
 }
 
+DWORD
+LwSmQueryServiceReadiness(
+    LW_SERVICE_HANDLE hHandle,
+    PLW_SERVICE_READINESS pReadiness
+    )
+{
+    DWORD dwError = 0;
+    LWMsgStatus status = LWMSG_STATUS_SUCCESS;
+    LWMsgCall* pCall = NULL;
+    LWMsgParams in = LWMSG_PARAMS_INITIALIZER;
+    LWMsgParams out = LWMSG_PARAMS_INITIALIZER;
+
+    in.tag = SM_IPC_QUERY_SERVICE_READINESS_REQ;
+    in.data = hHandle;
+
+    dwError = LwSmIpcAcquireCall(&pCall);
+    BAIL_ON_ERROR(dwError);
+
+    status = lwmsg_call_dispatch(pCall, &in, &out, NULL, NULL);
+    switch (status)
+    {
+    case LWMSG_STATUS_MALFORMED:
+    case LWMSG_STATUS_UNSUPPORTED:
+    case LWMSG_STATUS_PEER_ABORT:
+    case LWMSG_STATUS_PEER_RESET:
+    case LWMSG_STATUS_PEER_CLOSE:
+        /* A service manager that predates this call does not know its
+           message tag and rejects it or drops the connection */
+        dwError = LW_ERROR_NOT_SUPPORTED;
+        break;
+    default:
+        dwError = MAP_LWMSG_STATUS(status);
+        break;
+    }
+    BAIL_ON_ERROR(dwError);
+
+    switch (out.tag)
+    {
+    case SM_IPC_QUERY_SERVICE_READINESS_RES:
+        *pReadiness = *(PLW_SERVICE_READINESS) out.data;
+        break;
+    case SM_IPC_ERROR:
+        dwError = *(PDWORD) out.data;
+        BAIL_ON_ERROR(dwError);
+        break;
+    default:
+        dwError = LW_ERROR_INTERNAL;
+        BAIL_ON_ERROR(dwError);
+        break;
+    }
+
+cleanup:
+
+    if (pCall)
+    {
+        lwmsg_call_destroy_params(pCall, &out);
+        lwmsg_call_release(pCall);
+    }
+
+    return dwError;
+
+error:
+
+    goto cleanup;
+}
+
 /**
  * Refresh service
  */
@@ -984,6 +984,7 @@ LwSmInfo(
     PWSTR pwszServiceName = NULL;
     LW_SERVICE_HANDLE hHandle = NULL;
     PLW_SERVICE_INFO pInfo = NULL;
+    LW_SERVICE_READINESS readiness = {0};
     PSTR pszTemp = NULL;
     size_t i = 0;
 
@@ -1088,6 +1089,31 @@ LwSmInfo(
         printf("Shutdown timeout (sec): inherit\n");
     }
 
+    dwError = LwSmQueryServiceReadiness(hHandle, &readiness);
+    if (dwError == LW_ERROR_NOT_SUPPORTED)
+    {
+        /* Older service managers do not track readiness */
+        printf("Time to ready (ms): unknown\n");
+        dwError = 0;
+    }
+    else
+    {
+        BAIL_ON_ERROR(dwError);
+
+        if (readiness.bReady)
+        {
+            printf("Time to ready (ms): %lu\n", (unsigned long) readiness.dwTimeToReady);
+        }
+        else if (readiness.llStartTime)
+        {
+            printf("Time to ready (ms): not ready\n");
+        }
+        else
+        {
+            printf("Time to ready (ms): not started\n");
+        }
+    }
+
 cleanup:
 
     LW_SAFE_FREE_MEMORY(pwszServiceName);
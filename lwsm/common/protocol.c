@@ -209,6 +209,16 @@ static LWMsgTypeSpec gServiceStatusSpec[] =
     LWMSG_TYPE_END
 };
 
+static LWMsgTypeSpec gServiceReadinessSpec[] =
+{
+    LWMSG_STRUCT_BEGIN(LW_SERVICE_READINESS),
+    LWMSG_MEMBER_TYPESPEC(LW_SERVICE_READINESS, bReady, gBooleanSpec),
+    LWMSG_MEMBER_INT64(LW_SERVICE_READINESS, llStartTime),
+    LWMSG_MEMBER_UINT32(LW_SERVICE_READINESS, dwTimeToReady),
+    LWMSG_STRUCT_END,
+    LWMSG_TYPE_END
+};
+
 static LWMsgTypeSpec gResetLogDefaultsSpec[] = 
 {
     LWMSG_STRUCT_BEGIN(SM_RESET_LOG_DEFAULTS_REQ),
@@ -354,6 +364,8 @@ static LWMsgProtocolSpec gIpcSpec[] =
     LWMSG_MESSAGE(SM_IPC_SET_GLOBAL_RES, NULL),
     LWMSG_MESSAGE(SM_IPC_GET_GLOBAL_REQ, gGetGlobalReqSpec),
     LWMSG_MESSAGE(SM_IPC_GET_GLOBAL_RES, gGlobalValueSpec),
+    LWMSG_MESSAGE(SM_IPC_QUERY_SERVICE_READINESS_REQ, gExistingHandleSpec),
+    LWMSG_MESSAGE(SM_IPC_QUERY_SERVICE_READINESS_RES, gServiceReadinessSpec),
     LWMSG_PROTOCOL_END,
 };
 
@@ -141,7 +141,9 @@ typedef enum _SM_IPC_TAG
     SM_IPC_SET_GLOBAL_REQ,
     SM_IPC_SET_GLOBAL_RES,
     SM_IPC_GET_GLOBAL_REQ,
-    SM_IPC_GET_GLOBAL_RES
+    SM_IPC_GET_GLOBAL_RES,
+    SM_IPC_QUERY_SERVICE_READINESS_REQ,
+    SM_IPC_QUERY_SERVICE_READINESS_RES
 } SM_IPC_TAG;
 
 typedef struct _SM_IPC_WAIT_STATE_CHANGE_REQ
@@ -388,6 +388,23 @@ typedef struct _LW_SERVICE_STATUS
     pid_t pid;
 } LW_SERVICE_STATUS, *PLW_SERVICE_STATUS;
 
+/**
+ * @brief Service readiness
+ *
+ * Describes how long the most recent start of a service took
+ * to complete, as measured from the start request to the service
+ * reporting that it is ready to accept requests.
+ */
+typedef struct _LW_SERVICE_READINESS
+{
+    /** @brief Has the service become ready since it was last started? */
+    LW_BOOLEAN bReady;
+    /** @brief Time of the last start (seconds since the epoch, 0 if never started) */
+    LW_LONG64 llStartTime;
+    /** @brief Milliseconds between the last start and readiness */
+    LW_DWORD dwTimeToReady;
+} LW_SERVICE_READINESS, *PLW_SERVICE_READINESS;
+
 typedef enum _LW_SM_GLOBAL_SETTING
 {
     /**
@@ -563,6 +580,27 @@ LwSmQueryServiceStatus(
     PLW_SERVICE_STATUS pStatus
     );
 
+/**
+ * @brief Get service readiness
+ *
+ * Gets the time taken by the most recent start of the service
+ * represented by the given service handle.  A service is ready once
+ * it has signalled the service manager that it can accept requests;
+ * standalone executables do this through the descriptor named by the
+ * LIKEWISE_SM_NOTIFY environment variable, and modules do so when their
+ * start routine completes.
+ *
+ * @param[in] hHandle the service handle
+ * @param[out] pReadiness the readiness of the service
+ * @retval LW_ERROR_SUCCESS success
+ * @retval LW_ERROR_NOT_SUPPORTED the service manager is too old to track readiness
+ */
+DWORD
+LwSmQueryServiceReadiness(
+    LW_SERVICE_HANDLE hHandle,
+    PLW_SERVICE_READINESS pReadiness
+    );
+
 /**
  * @brief Wait for service state change
  *
@@ -90,6 +90,11 @@ typedef struct _SM_TABLE_ENTRY
     DWORD StartAttempts;
     /* When did we begin the last restart period? */
     time_t LastRestartPeriod;
+    /* When was the service last started, and when did it
+     * report that it was ready (ms since the epoch, 0 if not yet)?
+     */
+    LONG64 StartTime;
+    LONG64 ReadyTime;
     /* Lock controlling access to entry */
     pthread_mutex_t lock;
     pthread_mutex_t* pLock;
@@ -174,6 +179,9 @@ typedef struct _SM_LOGGER
         );
 } SM_LOGGER, *PSM_LOGGER;
 
+/* Default number of services autostart brings up concurrently */
+#define SM_AUTOSTART_DEFAULT_PARALLELISM 8
+
 typedef struct _SM_GLOBAL_STATE
 {
     LWMsgContext* pIpcContext;
@@ -189,6 +197,7 @@ typedef struct _SM_GLOBAL_STATE
     PCSTR pszLogFilePath;
     BOOLEAN bSyslog;
     BOOLEAN bDisableAutostart;
+    DWORD dwAutostartParallelism;
     BOOLEAN bContainer;
     PWSTR pGroup;
     PCSTR pName;
@@ -218,6 +227,12 @@ LwSmSrvGetServiceStatus(
     PLW_SERVICE_STATUS pStatus
     );
 
+DWORD
+LwSmSrvGetServiceReadiness(
+    LW_SERVICE_HANDLE hHandle,
+    PLW_SERVICE_READINESS pReadiness
+    );
+
 DWORD
 LwSmSrvStartService(
     LW_SERVICE_HANDLE hHandle
@@ -324,6 +339,12 @@ LwSmTableGetEntryStatus(
     PLW_SERVICE_STATUS pStatus
     );
 
+DWORD
+LwSmTableGetEntryReadiness(
+    PSM_TABLE_ENTRY pEntry,
+    PLW_SERVICE_READINESS pReadiness
+    );
+
 DWORD
 LwSmTableSetEntryLogInfo(
     PSM_TABLE_ENTRY pEntry,
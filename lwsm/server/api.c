@@ -118,6 +118,15 @@ LwSmSrvGetServiceStatus(
     return LwSmTableGetEntryStatus(hHandle->pEntry, pStatus);
 }
 
+DWORD
+LwSmSrvGetServiceReadiness(
+    LW_SERVICE_HANDLE hHandle,
+    PLW_SERVICE_READINESS pReadiness
+    )
+{
+    return LwSmTableGetEntryReadiness(hHandle->pEntry, pReadiness);
+}
+
 DWORD
 LwSmSrvRefreshService(
     LW_SERVICE_HANDLE hHandle
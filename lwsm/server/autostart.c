@@ -26,7 +26,7 @@
 /*
  * Module Name:
  *
- *        bootstrap.c
+ *        autostart.c
  *
  * Abstract:
  *
@@ -34,11 +34,508 @@
  *
  */
 
+
 #include "includes.h"
 
+/*
+ * Autostart runs as a dependency-driven scheduler: every service that
+ * must come up (autostart services and everything they depend on) is a
+ * node, and a small set of starter threads picks up any node whose
+ * dependencies are all running.  Independent chains therefore come up
+ * concurrently rather than one after another.
+ */
+
+typedef enum _SM_AUTOSTART_STATE
+{
+    SM_AUTOSTART_PENDING,
+    SM_AUTOSTART_READY,
+    SM_AUTOSTART_STARTING,
+    SM_AUTOSTART_RUNNING,
+    SM_AUTOSTART_FAILED
+} SM_AUTOSTART_STATE;
+
+typedef struct _SM_AUTOSTART_NODE
+{
+    PSM_TABLE_ENTRY pEntry;
+    PSTR pszName;
+    SM_AUTOSTART_STATE state;
+    /* Dependencies not yet running */
+    size_t Waiting;
+    /* Indices of nodes that depend directly on this one */
+    size_t* pDependents;
+    size_t DependentCount;
+    /* Milliseconds since autostart began, for boot tracing */
+    ULONG ulReadyTime;
+    ULONG ulStartTime;
+    ULONG ulDoneTime;
+    /* Set if the node could not be added to the graph */
+    DWORD dwGraphError;
+} SM_AUTOSTART_NODE, *PSM_AUTOSTART_NODE;
+
+typedef struct _SM_AUTOSTART
+{
+    pthread_mutex_t lock;
+    pthread_cond_t event;
+    PSM_AUTOSTART_NODE pNodes;
+    size_t NodeCount;
+    /* FIFO of ready node indices */
+    size_t* pQueue;
+    size_t QueueHead;
+    size_t QueueTail;
+    /* Nodes currently being started */
+    size_t Starting;
+    /* Nodes neither running nor failed yet */
+    size_t Outstanding;
+    struct timeval begin;
+} SM_AUTOSTART, *PSM_AUTOSTART;
+
+static
+ULONG
+LwSmAutostartElapsed(
+    PSM_AUTOSTART pAutostart
+    )
+{
+    struct timeval now = {0};
+
+    gettimeofday(&now, NULL);
+
+    return (ULONG) ((now.tv_sec - pAutostart->begin.tv_sec) * 1000 +
+                    (now.tv_usec - pAutostart->begin.tv_usec) / 1000);
+}
+
+static
+DWORD
+LwSmAutostartFindNode(
+    PWSTR* ppwszNames,
+    PCWSTR pwszName,
+    size_t* pIndex
+    )
+{
+    size_t i = 0;
+
+    for (i = 0; ppwszNames[i]; i++)
+    {
+        if (LwRtlWC16StringIsEqual(ppwszNames[i], pwszName, FALSE))
+        {
+            *pIndex = i;
+            return 0;
+        }
+    }
+
+    return LW_ERROR_NO_SUCH_SERVICE;
+}
+
+static
+DWORD
+LwSmAutostartAddName(
+    PWSTR** pppwszNames,
+    PWSTR pwszName
+    )
+{
+    DWORD dwError = 0;
+    PWSTR pwszCopy = NULL;
+
+    if (!LwSmStringListContains(*pppwszNames, pwszName))
+    {
+        dwError = LwAllocateWc16String(&pwszCopy, pwszName);
+        BAIL_ON_ERROR(dwError);
+
+        dwError = LwSmStringListAppend(pppwszNames, pwszCopy);
+        BAIL_ON_ERROR(dwError);
+
+        pwszCopy = NULL;
+    }
+
+error:
+
+    LW_SAFE_FREE_MEMORY(pwszCopy);
+
+    return dwError;
+}
+
+/*
+ * Collect every autostart service together with its dependency closure
+ */
+static
+DWORD
+LwSmAutostartCollectNames(
+    PWSTR** pppwszNames
+    )
+{
+    DWORD dwError = 0;
+    PWSTR* ppwszAllServices = NULL;
+    PWSTR* ppwszDeps = NULL;
+    PWSTR* ppwszNames = NULL;
+    PSM_TABLE_ENTRY pEntry = NULL;
+    size_t i = 0;
+    size_t j = 0;
+
+    dwError = LwAllocateMemory(sizeof(*ppwszNames) * 1, OUT_PPVOID(&ppwszNames));
+    BAIL_ON_ERROR(dwError);
+
+    dwError = LwSmTableEnumerateEntries(&ppwszAllServices);
+    BAIL_ON_ERROR(dwError);
+
+    for (i = 0; ppwszAllServices[i]; i++)
+    {
+        dwError = LwSmTableGetEntry(ppwszAllServices[i], &pEntry);
+        BAIL_ON_ERROR(dwError);
+
+        if (pEntry->pInfo->bAutostart)
+        {
+            dwError = LwSmTableGetEntryDependencyClosure(pEntry, &ppwszDeps);
+            if (dwError)
+            {
+                SM_LOG_ERROR("Could not resolve dependencies for autostart: %s",
+                             LwWin32ExtErrorToName(dwError));
+                dwError = 0;
+            }
+            else
+            {
+                for (j = 0; ppwszDeps[j]; j++)
+                {
+                    dwError = LwSmAutostartAddName(&ppwszNames, ppwszDeps[j]);
+                    BAIL_ON_ERROR(dwError);
+                }
+
+                dwError = LwSmAutostartAddName(&ppwszNames, ppwszAllServices[i]);
+                BAIL_ON_ERROR(dwError);
+
+                LwSmFreeStringList(ppwszDeps);
+                ppwszDeps = NULL;
+            }
+        }
+
+        LwSmTableReleaseEntry(pEntry);
+        pEntry = NULL;
+    }
+
+    *pppwszNames = ppwszNames;
+
+cleanup:
+
+    if (pEntry)
+    {
+        LwSmTableReleaseEntry(pEntry);
+    }
+
+    if (ppwszDeps)
+    {
+        LwSmFreeStringList(ppwszDeps);
+    }
+
+    if (ppwszAllServices)
+    {
+        LwSmFreeStringList(ppwszAllServices);
+    }
+
+    return dwError;
+
+error:
+
+    *pppwszNames = NULL;
+
+    if (ppwszNames)
+    {
+        LwSmFreeStringList(ppwszNames);
+    }
+
+    goto cleanup;
+}
+
+static
+VOID
+LwSmAutostartFree(
+    PSM_AUTOSTART pAutostart
+    )
+{
+    size_t i = 0;
+
+    if (pAutostart->pNodes)
+    {
+        for (i = 0; i < pAutostart->NodeCount; i++)
+        {
+            if (pAutostart->pNodes[i].pEntry)
+            {
+                LwSmTableReleaseEntry(pAutostart->pNodes[i].pEntry);
+            }
+
+            LW_SAFE_FREE_MEMORY(pAutostart->pNodes[i].pszName);
+            LW_SAFE_FREE_MEMORY(pAutostart->pNodes[i].pDependents);
+        }
+
+        LW_SAFE_FREE_MEMORY(pAutostart->pNodes);
+    }
+
+    LW_SAFE_FREE_MEMORY(pAutostart->pQueue);
+
+    pthread_mutex_destroy(&pAutostart->lock);
+    pthread_cond_destroy(&pAutostart->event);
+}
+
+static
+VOID
+LwSmAutostartEnqueue_inlock(
+    PSM_AUTOSTART pAutostart,
+    size_t index
+    )
+{
+    PSM_AUTOSTART_NODE pNode = &pAutostart->pNodes[index];
+
+    pNode->state = SM_AUTOSTART_READY;
+    pNode->ulReadyTime = LwSmAutostartElapsed(pAutostart);
+    pAutostart->pQueue[pAutostart->QueueTail++] = index;
+
+    pthread_cond_broadcast(&pAutostart->event);
+}
+
+/*
+ * Build the dependency graph.  Each node counts the direct dependencies
+ * it waits for and records which nodes wait for it.
+ */
 static
 DWORD
-StartService(
+LwSmAutostartBuildGraph(
+    PSM_AUTOSTART pAutostart
+    )
+{
+    DWORD dwError = 0;
+    PWSTR* ppwszNames = NULL;
+    PLW_SERVICE_INFO pInfo = NULL;
+    PSM_AUTOSTART_NODE pNode = NULL;
+    PSM_AUTOSTART_NODE pDep = NULL;
+    BOOLEAN bLocked = FALSE;
+    size_t depIndex = 0;
+    size_t i = 0;
+    size_t j = 0;
+
+    dwError = LwSmAutostartCollectNames(&ppwszNames);
+    BAIL_ON_ERROR(dwError);
+
+    pAutostart->NodeCount = LwSmStringListLength(ppwszNames);
+
+    if (!pAutostart->NodeCount)
+    {
+        goto cleanup;
+    }
+
+    dwError = LwAllocateMemory(
+        sizeof(*pAutostart->pNodes) * pAutostart->NodeCount,
+        OUT_PPVOID(&pAutostart->pNodes));
+    BAIL_ON_ERROR(dwError);
+
+    dwError = LwAllocateMemory(
+        sizeof(*pAutostart->pQueue) * pAutostart->NodeCount,
+        OUT_PPVOID(&pAutostart->pQueue));
+    BAIL_ON_ERROR(dwError);
+
+    for (i = 0; i < pAutostart->NodeCount; i++)
+    {
+        pNode = &pAutostart->pNodes[i];
+
+        dwError = LwWc16sToMbs(ppwszNames[i], &pNode->pszName);
+        BAIL_ON_ERROR(dwError);
+
+        /* A service that cannot be looked up fails on its own, along
+           with whatever depends on it, without stopping the rest */
+        pNode->dwGraphError = LwSmTableGetEntry(ppwszNames[i], &pNode->pEntry);
+    }
+
+    for (i = 0; i < pAutostart->NodeCount; i++)
+    {
+        pNode = &pAutostart->pNodes[i];
+
+        if (pNode->dwGraphError)
+        {
+            continue;
+        }
+
+        LOCK(bLocked, pNode->pEntry->pLock);
+        dwError = LwSmCopyServiceInfo(pNode->pEntry->pInfo, &pInfo);
+        UNLOCK(bLocked, pNode->pEntry->pLock);
+        BAIL_ON_ERROR(dwError);
+
+        for (j = 0; pInfo->ppwszDependencies[j]; j++)
+        {
+            pNode->dwGraphError = LwSmAutostartFindNode(
+                ppwszNames,
+                pInfo->ppwszDependencies[j],
+                &depIndex);
+            if (pNode->dwGraphError)
+            {
+                break;
+            }
+
+            pDep = &pAutostart->pNodes[depIndex];
+
+            dwError = LwReallocMemory(
+                pDep->pDependents,
+                OUT_PPVOID(&pDep->pDependents),
+                sizeof(*pDep->pDependents) * (pDep->DependentCount + 1));
+            BAIL_ON_ERROR(dwError);
+
+            pDep->pDependents[pDep->DependentCount++] = i;
+            pNode->Waiting++;
+        }
+
+        LwSmCommonFreeServiceInfo(pInfo);
+        pInfo = NULL;
+    }
+
+    pAutostart->Outstanding = pAutostart->NodeCount;
+
+cleanup:
+
+    if (pInfo)
+    {
+        LwSmCommonFreeServiceInfo(pInfo);
+    }
+
+    if (ppwszNames)
+    {
+        LwSmFreeStringList(ppwszNames);
+    }
+
+    return dwError;
+
+error:
+
+    goto cleanup;
+}
+
+static
+VOID
+LwSmAutostartFail_inlock(
+    PSM_AUTOSTART pAutostart,
+    size_t index,
+    PCSTR pszReason
+    )
+{
+    PSM_AUTOSTART_NODE pNode = &pAutostart->pNodes[index];
+    size_t i = 0;
+
+    if (pNode->state == SM_AUTOSTART_FAILED)
+    {
+        return;
+    }
+
+    if (pszReason)
+    {
+        SM_LOG_ERROR("Could not autostart service: %s (dependency %s failed)",
+                     pNode->pszName,
+                     pszReason);
+    }
+
+    pNode->state = SM_AUTOSTART_FAILED;
+    pNode->ulDoneTime = LwSmAutostartElapsed(pAutostart);
+    pAutostart->Outstanding--;
+
+    /* Anything that depends on a failed service cannot be started */
+    for (i = 0; i < pNode->DependentCount; i++)
+    {
+        LwSmAutostartFail_inlock(pAutostart, pNode->pDependents[i], pNode->pszName);
+    }
+}
+
+static
+VOID
+LwSmAutostartFinish_inlock(
+    PSM_AUTOSTART pAutostart,
+    size_t index,
+    DWORD dwError
+    )
+{
+    PSM_AUTOSTART_NODE pNode = &pAutostart->pNodes[index];
+    PSM_AUTOSTART_NODE pDependent = NULL;
+    size_t i = 0;
+
+    pAutostart->Starting--;
+
+    if (dwError)
+    {
+        SM_LOG_ERROR("Could not autostart service: %s (%s)",
+                     pNode->pszName,
+                     LwWin32ExtErrorToName(dwError));
+
+        LwSmAutostartFail_inlock(pAutostart, index, NULL);
+    }
+    else
+    {
+        pNode->state = SM_AUTOSTART_RUNNING;
+        pNode->ulDoneTime = LwSmAutostartElapsed(pAutostart);
+        pAutostart->Outstanding--;
+
+        SM_LOG_INFO("Autostart: %s running at +%lu ms "
+                    "(waited %lu ms for dependencies, %lu ms queued, %lu ms to start)",
+                    pNode->pszName,
+                    (unsigned long) pNode->ulDoneTime,
+                    (unsigned long) pNode->ulReadyTime,
+                    (unsigned long) (pNode->ulStartTime - pNode->ulReadyTime),
+                    (unsigned long) (pNode->ulDoneTime - pNode->ulStartTime));
+
+        for (i = 0; i < pNode->DependentCount; i++)
+        {
+            pDependent = &pAutostart->pNodes[pNode->pDependents[i]];
+
+            if (pDependent->state == SM_AUTOSTART_PENDING &&
+                --pDependent->Waiting == 0)
+            {
+                LwSmAutostartEnqueue_inlock(pAutostart, pNode->pDependents[i]);
+            }
+        }
+    }
+
+    pthread_cond_broadcast(&pAutostart->event);
+}
+
+/*
+ * Fail the nodes that could not be added to the graph, along with their
+ * dependents, and queue every node that waits for nothing
+ */
+static
+VOID
+LwSmAutostartSeed(
+    PSM_AUTOSTART pAutostart
+    )
+{
+    PSM_AUTOSTART_NODE pNode = NULL;
+    size_t i = 0;
+
+    pthread_mutex_lock(&pAutostart->lock);
+
+    for (i = 0; i < pAutostart->NodeCount; i++)
+    {
+        pNode = &pAutostart->pNodes[i];
+
+        if (pNode->dwGraphError)
+        {
+            SM_LOG_ERROR("Could not autostart service: %s (%s)",
+                         pNode->pszName,
+                         LwWin32ExtErrorToName(pNode->dwGraphError));
+            LwSmAutostartFail_inlock(pAutostart, i, NULL);
+        }
+    }
+
+    for (i = 0; i < pAutostart->NodeCount; i++)
+    {
+        pNode = &pAutostart->pNodes[i];
+
+        if (pNode->state == SM_AUTOSTART_PENDING && pNode->Waiting == 0)
+        {
+            LwSmAutostartEnqueue_inlock(pAutostart, i);
+        }
+    }
+
+    pthread_mutex_unlock(&pAutostart->lock);
+}
+
+/*
+ * Start each autostart service after its dependency closure, one at a
+ * time.  Only used if the dependency graph cannot be built at all.
+ */
+static
+DWORD
+LwSmAutostartStartSequential(
     PSM_TABLE_ENTRY pEntry
     )
 {
@@ -56,15 +553,8 @@ StartService(
         BAIL_ON_ERROR(dwError);
 
         dwError = LwSmTableStartEntry(pDep);
-        if (dwError)
-        {
-            SM_LOG_ERROR("Could not autostart fixme: %s",
-                         /* fixme : service name */
-                         LwWin32ExtErrorToName(dwError));
-        }
         BAIL_ON_ERROR(dwError);
 
-
         LwSmTableReleaseEntry(pDep);
         pDep = NULL;
     }
@@ -77,13 +567,11 @@ cleanup:
     if (pDep)
     {
         LwSmTableReleaseEntry(pDep);
-        pDep = NULL;
     }
 
     if (ppwszDeps)
     {
         LwSmFreeStringList(ppwszDeps);
-        ppwszDeps = NULL;
     }
 
     return dwError;
@@ -93,17 +581,20 @@ error:
     goto cleanup;
 }
 
+static
 DWORD
-LwSmAutostartServices(
+LwSmAutostartServicesSequential(
     VOID
     )
 {
     DWORD dwError = 0;
     PWSTR *ppwszAllServices = NULL;
     PSM_TABLE_ENTRY pEntry = NULL;
+    PSTR pszName = NULL;
     size_t i = 0;
 
     dwError = LwSmTableEnumerateEntries(&ppwszAllServices);
+    BAIL_ON_ERROR(dwError);
 
     for (i = 0; ppwszAllServices[i]; i++)
     {
@@ -112,7 +603,19 @@ LwSmAutostartServices(
 
         if (pEntry->pInfo->bAutostart)
         {
-            StartService(pEntry);
+            /* One service failing does not stop the others */
+            dwError = LwSmAutostartStartSequential(pEntry);
+            if (dwError)
+            {
+                if (!LwWc16sToMbs(ppwszAllServices[i], &pszName))
+                {
+                    SM_LOG_ERROR("Could not autostart service: %s (%s)",
+                                 pszName,
+                                 LwWin32ExtErrorToName(dwError));
+                    LW_SAFE_FREE_MEMORY(pszName);
+                }
+                dwError = 0;
+            }
         }
 
         LwSmTableReleaseEntry(pEntry);
@@ -124,13 +627,11 @@ cleanup:
     if (pEntry)
     {
         LwSmTableReleaseEntry(pEntry);
-        pEntry = NULL;
     }
 
     if (ppwszAllServices)
     {
         LwSmFreeStringList(ppwszAllServices);
-        ppwszAllServices = NULL;
     }
 
     return dwError;
@@ -139,3 +640,170 @@ error:
 
     goto cleanup;
 }
+
+static
+PVOID
+LwSmAutostartThread(
+    PVOID pData
+    )
+{
+    PSM_AUTOSTART pAutostart = pData;
+    PSM_AUTOSTART_NODE pNode = NULL;
+    DWORD dwError = 0;
+    size_t index = 0;
+    size_t i = 0;
+
+    pthread_mutex_lock(&pAutostart->lock);
+
+    while (pAutostart->Outstanding)
+    {
+        if (pAutostart->QueueHead == pAutostart->QueueTail)
+        {
+            if (!pAutostart->Starting)
+            {
+                /* Nothing is ready or in flight, yet services remain:
+                   the remaining nodes wait on each other */
+                for (i = 0; i < pAutostart->NodeCount; i++)
+                {
+                    if (pAutostart->pNodes[i].state == SM_AUTOSTART_PENDING)
+                    {
+                        SM_LOG_ERROR("Could not autostart service: %s (%s)",
+                                     pAutostart->pNodes[i].pszName,
+                                     LwWin32ExtErrorToName(ERROR_CIRCULAR_DEPENDENCY));
+                        LwSmAutostartFail_inlock(pAutostart, i, NULL);
+                    }
+                }
+
+                pthread_cond_broadcast(&pAutostart->event);
+                continue;
+            }
+
+            pthread_cond_wait(&pAutostart->event, &pAutostart->lock);
+            continue;
+        }
+
+        index = pAutostart->pQueue[pAutostart->QueueHead++];
+        pNode = &pAutostart->pNodes[index];
+
+        if (pNode->state != SM_AUTOSTART_READY)
+        {
+            continue;
+        }
+
+        pNode->state = SM_AUTOSTART_STARTING;
+        pNode->ulStartTime = LwSmAutostartElapsed(pAutostart);
+        pAutostart->Starting++;
+
+        pthread_mutex_unlock(&pAutostart->lock);
+        dwError = LwSmTableStartEntry(pNode->pEntry);
+        pthread_mutex_lock(&pAutostart->lock);
+
+        LwSmAutostartFinish_inlock(pAutostart, index, dwError);
+    }
+
+    pthread_mutex_unlock(&pAutostart->lock);
+
+    return NULL;
+}
+
+DWORD
+LwSmAutostartServices(
+    VOID
+    )
+{
+    DWORD dwError = 0;
+    SM_AUTOSTART autostart =
+    {
+        .lock = PTHREAD_MUTEX_INITIALIZER,
+        .event = PTHREAD_COND_INITIALIZER
+    };
+    pthread_t* pThreads = NULL;
+    size_t threadCount = 0;
+    size_t started = 0;
+    size_t failed = 0;
+    size_t i = 0;
+
+    gettimeofday(&autostart.begin, NULL);
+
+    dwError = LwSmAutostartBuildGraph(&autostart);
+    if (dwError)
+    {
+        SM_LOG_WARNING("Could not build autostart dependency graph (%s); "
+                       "starting services sequentially",
+                       LwWin32ExtErrorToName(dwError));
+
+        dwError = LwSmAutostartServicesSequential();
+        goto cleanup;
+    }
+
+    LwSmAutostartSeed(&autostart);
+
+    threadCount = gState.dwAutostartParallelism;
+    if (threadCount < 1)
+    {
+        threadCount = 1;
+    }
+    if (threadCount > autostart.NodeCount)
+    {
+        threadCount = autostart.NodeCount;
+    }
+
+    if (threadCount)
+    {
+        dwError = LwAllocateMemory(sizeof(*pThreads) * threadCount, OUT_PPVOID(&pThreads));
+        BAIL_ON_ERROR(dwError);
+    }
+
+    SM_LOG_VERBOSE("Autostarting %lu services with up to %lu in parallel",
+                   (unsigned long) autostart.NodeCount,
+                   (unsigned long) threadCount);
+
+    /* The first starter runs on this thread */
+    for (i = 1; i < threadCount; i++)
+    {
+        dwError = LwErrnoToWin32Error(
+            pthread_create(&pThreads[started], NULL, LwSmAutostartThread, &autostart));
+        if (dwError)
+        {
+            /* Fewer starters only means less parallelism */
+            SM_LOG_WARNING("Could not create autostart thread: %s",
+                           LwWin32ExtErrorToName(dwError));
+            dwError = 0;
+            break;
+        }
+
+        started++;
+    }
+
+    LwSmAutostartThread(&autostart);
+
+    for (i = 0; i < started; i++)
+    {
+        pthread_join(pThreads[i], NULL);
+    }
+
+    for (i = 0; i < autostart.NodeCount; i++)
+    {
+        if (autostart.pNodes[i].state == SM_AUTOSTART_FAILED)
+        {
+            failed++;
+        }
+    }
+
+    SM_LOG_INFO("Autostart completed in %lu ms (%lu services, %lu failed)",
+                (unsigned long) LwSmAutostartElapsed(&autostart),
+                (unsigned long) autostart.NodeCount,
+                (unsigned long) failed);
+
+cleanup:
+
+    LW_SAFE_FREE_MEMORY(pThreads);
+
+    LwSmAutostartFree(&autostart);
+
+    return dwError;
+
+error:
+
+    goto cleanup;
+}
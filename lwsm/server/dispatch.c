@@ -352,6 +352,50 @@ error:
     goto cleanup;
 }
 
+static
+LWMsgStatus
+LwSmDispatchGetServiceReadiness(
+    LWMsgCall* pCall,
+    LWMsgParams* pIn,
+    LWMsgParams* pOut,
+    PVOID pData
+    )
+{
+    DWORD dwError = 0;
+    LW_SERVICE_HANDLE hHandle = NULL;
+    PLW_SERVICE_READINESS pReadiness = NULL;
+
+    dwError = LwSmGetHandle(pCall, (LWMsgHandle*) pIn->data, &hHandle);
+    BAIL_ON_ERROR(dwError);
+
+    dwError = LwAllocateMemory(sizeof(*pReadiness), OUT_PPVOID(&pReadiness));
+    BAIL_ON_ERROR(dwError);
+
+    dwError = LwSmSrvGetServiceReadiness(hHandle, pReadiness);
+
+    if (dwError == 0)
+    {
+        pOut->tag = SM_IPC_QUERY_SERVICE_READINESS_RES;
+        pOut->data = pReadiness;
+        pReadiness = NULL;
+    }
+    else
+    {
+        dwError = LwSmSetError(pOut, dwError);
+        BAIL_ON_ERROR(dwError);
+    }
+
+cleanup:
+
+    LW_SAFE_FREE_MEMORY(pReadiness);
+
+    return LwSmMapLwError(dwError);
+
+error:
+
+    goto cleanup;
+}
+
 static
 LWMsgStatus
 LwSmDispatchStartService(
@@ -1328,6 +1372,7 @@ LWMsgDispatchSpec gDispatchSpec[] =
     LWMSG_DISPATCH_BLOCK(SM_IPC_STOP_SERVICE_REQ, LwSmDispatchStopService),
     LWMSG_DISPATCH_BLOCK(SM_IPC_REFRESH_SERVICE_REQ, LwSmDispatchRefreshService),
     LWMSG_DISPATCH_BLOCK(SM_IPC_QUERY_SERVICE_STATUS_REQ, LwSmDispatchGetServiceStatus),
+    LWMSG_DISPATCH_BLOCK(SM_IPC_QUERY_SERVICE_READINESS_REQ, LwSmDispatchGetServiceReadiness),
     LWMSG_DISPATCH_BLOCK(SM_IPC_QUERY_SERVICE_INFO_REQ, LwSmDispatchGetServiceInfo),
     LWMSG_DISPATCH_NONBLOCK(SM_IPC_WAIT_SERVICE_REQ, LwSmDispatchWaitService),
     LWMSG_DISPATCH_BLOCK(SM_IPC_RESET_LOG_DEFAULTS_REQ, LwSmDispatchResetLogDefaults),
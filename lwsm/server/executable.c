@@ -46,6 +46,10 @@ extern char **environ;
 #define ENVIRON environ
 #endif
 
+/* Legacy executables have no way to report readiness, so they are
+   considered running once they survive this long after being forked */
+#define SM_LEGACY_READY_DELAY_NS (1000000000ll)
+
 typedef struct _SM_PROCESS_TABLE
 {
     pthread_mutex_t lock;
@@ -104,7 +108,6 @@ LwSmForkProcess(
 {
     DWORD dwError = 0;
     pid_t pid = -1;
-    struct timespec ts = {1, 0};
     int notifyPipe[2] = {-1, -1};
 
     if (pExec->type == LW_SERVICE_TYPE_EXECUTABLE)
@@ -149,14 +152,9 @@ LwSmForkProcess(
         }
         else
         {
+            /* The task tracking the process will move it to the
+               running state after SM_LEGACY_READY_DELAY_NS */
             pExec->notifyFd = -1;
-
-            /* Wait for process to start up */
-            if (nanosleep(&ts, NULL) != 0)
-            {
-                dwError = LwMapErrnoToLwError(errno);
-                BAIL_ON_ERROR(dwError);
-            }
         }
     }
 
@@ -589,6 +587,11 @@ LwSmExecutableTask(
 
             *pWaitMask |= LW_TASK_EVENT_FD_READABLE;
         }
+        else
+        {
+            *pllTime = SM_LEGACY_READY_DELAY_NS;
+            *pWaitMask |= LW_TASK_EVENT_TIME;
+        }
     }
     else if (WakeMask & LW_TASK_EVENT_CANCEL)
     {
@@ -646,6 +649,15 @@ LwSmExecutableTask(
         }
     }
 
+    if ((WakeMask & LW_TASK_EVENT_TIME) &&
+        pExec->state == LW_SERVICE_STATE_STARTING)
+    {
+        pExec->state = LW_SERVICE_STATE_RUNNING;
+        LwSmNotifyServiceObjectStateChange(pExec->pObject, pExec->state);
+
+        *pWaitMask &= ~LW_TASK_EVENT_TIME;
+    }
+
 cleanup:
 
     UNLOCK(bLocked, &gProcTable.lock);
@@ -54,6 +54,7 @@ SM_GLOBAL_STATE gState =
     .pszLogFilePath = NULL,
     .bSyslog = FALSE,
     .bDisableAutostart = FALSE,
+    .dwAutostartParallelism = SM_AUTOSTART_DEFAULT_PARALLELISM,
     .bWatchdog = TRUE,
     .ControlLock = -1
 };
@@ -268,7 +269,10 @@ Usage(
            "    --loglevel <level>     Set log level to <level>\n"
            "                           (error, warning, info, verbose, debug, trace)\n"
            "    --container <group>    Start as a container for service group <group>\n"
-           "    --help                 Show usage information\n");
+           "    --autostart-parallelism <n>\n"
+           "                           Start up to <n> independent services at once (default %d)\n"
+           "    --help                 Show usage information\n",
+           SM_AUTOSTART_DEFAULT_PARALLELISM);
 
     return dwError;
 }
@@ -334,6 +338,16 @@ LwSmParseArguments(
             {
                 gState.bDisableAutostart = TRUE;
             }
+            else if (!strcmp(ppszArgv[i], "--autostart-parallelism"))
+            {
+                if (++i >= argc || atoi(ppszArgv[i]) < 1)
+                {
+                    dwError = LW_ERROR_INVALID_PARAMETER;
+                    BAIL_ON_ERROR(dwError);
+                }
+
+                gState.dwAutostartParallelism = (DWORD) atoi(ppszArgv[i]);
+            }
             else if (!strcmp(ppszArgv[i], "--container"))
             {
                 if (++i >= argc)
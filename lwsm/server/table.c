@@ -54,6 +54,12 @@ LwSmTableFreeEntry(
     PSM_TABLE_ENTRY pEntry
     );
 
+static
+LONG64
+LwSmTableNow(
+    VOID
+    );
+
 static SM_TABLE gServiceTable =
 {
     .lock = PTHREAD_MUTEX_INITIALIZER,
@@ -455,6 +461,9 @@ LwSmTableStartEntry(
                     BAIL_ON_ERROR(dwError);
                 }
 
+                pEntry->StartTime = LwSmTableNow();
+                pEntry->ReadyTime = 0;
+
                 UNLOCK(bLocked, pEntry->pLock);
                 dwError = pEntry->pVtbl->pfnStart(&pEntry->object);
                 LOCK(bLocked, pEntry->pLock);
@@ -642,6 +651,40 @@ error:
     return dwError;
 }
 
+DWORD
+LwSmTableGetEntryReadiness(
+    PSM_TABLE_ENTRY pEntry,
+    PLW_SERVICE_READINESS pReadiness
+    )
+{
+    DWORD dwError = 0;
+    BOOLEAN bLocked = FALSE;
+
+    LOCK(bLocked, pEntry->pLock);
+
+    if (!pEntry->bValid)
+    {
+        dwError = LW_ERROR_INVALID_HANDLE;
+        BAIL_ON_ERROR(dwError);
+    }
+
+    memset(pReadiness, 0, sizeof(*pReadiness));
+
+    pReadiness->llStartTime = pEntry->StartTime / 1000;
+
+    if (pEntry->StartTime && pEntry->ReadyTime)
+    {
+        pReadiness->bReady = TRUE;
+        pReadiness->dwTimeToReady = (DWORD) (pEntry->ReadyTime - pEntry->StartTime);
+    }
+
+error:
+
+    UNLOCK(bLocked, pEntry->pLock);
+
+    return dwError;
+}
+
 DWORD
 LwSmTableSetEntryLogInfo(
     PSM_TABLE_ENTRY pEntry,
@@ -931,6 +974,20 @@ LwSmTableNotifyEntryStateChanged(
 
     pthread_cond_broadcast(pEntry->pEvent);
 
+    if (state == LW_SERVICE_STATE_RUNNING &&
+        pEntry->StartTime && !pEntry->ReadyTime)
+    {
+        pEntry->ReadyTime = LwSmTableNow();
+
+        error = LwWc16sToMbs(pEntry->pInfo->pwszName, &pServiceName);
+        BAIL_ON_ERROR(error);
+
+        SM_LOG_VERBOSE(
+            "Service ready: %s (%lu ms after start)",
+            pServiceName,
+            (unsigned long) (pEntry->ReadyTime - pEntry->StartTime));
+    }
+
     if (state == LW_SERVICE_STATE_DEAD && gState.bWatchdog)
     {
         now = time(NULL);
@@ -992,6 +1049,19 @@ error:
     LW_SAFE_FREE_MEMORY(pServiceName);
 }
 
+static
+LONG64
+LwSmTableNow(
+    VOID
+    )
+{
+    struct timeval now = {0};
+
+    (void) gettimeofday(&now, NULL);
+
+    return (LONG64) now.tv_sec * 1000 + now.tv_usec / 1000;
+}
+
 DWORD
 LwSmTableWaitEntryChanged(
     PSM_TABLE_ENTRY pEntry
@@ -199,6 +199,72 @@ error:
     return dwError;
 }
 
+static
+BOOLEAN
+LWNetIsSessionDropped(
+    LWMsgStatus status
+    )
+{
+    switch (status)
+    {
+    case LWMSG_STATUS_PEER_CLOSE:
+    case LWMSG_STATUS_PEER_RESET:
+    case LWMSG_STATUS_PEER_ABORT:
+        return TRUE;
+    default:
+        return FALSE;
+    }
+}
+
+/*
+ * The connection to netlogond is shared by the whole process and is
+ * only torn down when the library unloads.  If netlogond restarted
+ * since the last call, the first dispatch on the old session fails;
+ * lwmsg reconnects when the next call is acquired, so retry once
+ * rather than failing the caller.
+ */
+static
+DWORD
+LWNetDispatchCall(
+    HANDLE hConnection,
+    LWMsgParams* pIn,
+    LWMsgParams* pOut,
+    LWMsgCall** ppCall
+    )
+{
+    DWORD dwError = 0;
+    LWMsgStatus status = LWMSG_STATUS_SUCCESS;
+    LWMsgCall* pCall = NULL;
+    DWORD dwAttempt = 0;
+
+    for (dwAttempt = 0; dwAttempt < 2; dwAttempt++)
+    {
+        if (pCall)
+        {
+            lwmsg_call_destroy_params(pCall, pOut);
+            lwmsg_call_release(pCall);
+            pCall = NULL;
+        }
+
+        dwError = LWNetAcquireCall(hConnection, &pCall);
+        BAIL_ON_LWNET_ERROR(dwError);
+
+        status = lwmsg_call_dispatch(pCall, pIn, pOut, NULL, NULL);
+        if (!LWNetIsSessionDropped(status))
+        {
+            break;
+        }
+    }
+
+    dwError = MAP_LWMSG_ERROR(status);
+
+error:
+
+    *ppCall = pCall;
+
+    return dwError;
+}
+
 DWORD
 LWNetTransactGetDCName(
     HANDLE hConnection,
@@ -220,9 +286,6 @@ LWNetTransactGetDCName(
     LWMsgParams out = LWMSG_PARAMS_INITIALIZER;
     LWMsgCall* pCall = NULL;
 
-    dwError = LWNetAcquireCall(hConnection, &pCall);
-    BAIL_ON_LWNET_ERROR(dwError);
-
     dcReq.pszServerFQDN = pszServerFQDN;
     dcReq.pszDomainFQDN = pszDomainFQDN;
     dcReq.pszSiteName = pszSiteName;
@@ -234,7 +297,7 @@ LWNetTransactGetDCName(
     in.tag = LWNET_Q_GET_DC_NAME;
     in.data = &dcReq;
 
-    dwError = MAP_LWMSG_ERROR(lwmsg_call_dispatch(pCall, &in, &out, NULL, NULL));
+    dwError = LWNetDispatchCall(hConnection, &in, &out, &pCall);
     BAIL_ON_LWNET_ERROR(dwError);
     
     switch (out.tag)
@@ -291,9 +354,6 @@ LWNetTransactGetDCList(
     LWMsgParams out = LWMSG_PARAMS_INITIALIZER;
     LWMsgCall* pCall = NULL;
 
-    dwError = LWNetAcquireCall(hConnection, &pCall);
-    BAIL_ON_LWNET_ERROR(dwError);
-
     dcReq.pszDomainFQDN = pszDomainFQDN;
     dcReq.pszSiteName = pszSiteName;
     dcReq.dwFlags = dwFlags;
@@ -301,7 +361,7 @@ LWNetTransactGetDCList(
     in.tag = LWNET_Q_GET_DC_LIST;
     in.data = &dcReq;
 
-    dwError = MAP_LWMSG_ERROR(lwmsg_call_dispatch(pCall, &in, &out, NULL, NULL));
+    dwError = LWNetDispatchCall(hConnection, &in, &out, &pCall);
     BAIL_ON_LWNET_ERROR(dwError);
     
     switch (out.tag)
@@ -357,14 +417,11 @@ LWNetTransactGetDCTime(
     LWMsgParams out = LWMSG_PARAMS_INITIALIZER;
     LWMsgCall* pCall = NULL;
 
-    dwError = LWNetAcquireCall(hConnection, &pCall);
-    BAIL_ON_LWNET_ERROR(dwError);
-
     dcTimeReq.pszString = pszDomainFQDN;
     in.tag = LWNET_Q_GET_DC_TIME;
     in.data = &dcTimeReq;
 
-    dwError = MAP_LWMSG_ERROR(lwmsg_call_dispatch(pCall, &in, &out, NULL, NULL));
+    dwError = LWNetDispatchCall(hConnection, &in, &out, &pCall);
     BAIL_ON_LWNET_ERROR(dwError);
     
     switch (out.tag)
@@ -412,14 +469,11 @@ LWNetTransactGetDomainController(
     LWMsgParams out = LWMSG_PARAMS_INITIALIZER;
     LWMsgCall* pCall = NULL;
 
-    dwError = LWNetAcquireCall(hConnection, &pCall);
-    BAIL_ON_LWNET_ERROR(dwError);
-
     dcReq.pszString = pszDomainFQDN;
     in.tag = LWNET_Q_GET_DOMAIN_CONTROLLER;
     in.data = &dcReq;
 
-    dwError = MAP_LWMSG_ERROR(lwmsg_call_dispatch(pCall, &in, &out, NULL, NULL));
+    dwError = LWNetDispatchCall(hConnection, &in, &out, &pCall);
     BAIL_ON_LWNET_ERROR(dwError);
     
     switch (out.tag)
@@ -474,15 +528,12 @@ LWNetTransactResolveName(
     LWMsgCall* pCall = NULL;
 
     
-    dwError = LWNetAcquireCall(hConnection, &pCall);
-    BAIL_ON_LWNET_ERROR(dwError);
-
     inHostName.pwszHostName = (PWSTR) pcwszHostName;
 
     in.tag = LWNET_Q_RESOLVE_NAME;
     in.data = &inHostName;
 
-    dwError = MAP_LWMSG_ERROR(lwmsg_call_dispatch(pCall, &in, &out, NULL, NULL));
+    dwError = LWNetDispatchCall(hConnection, &in, &out, &pCall);
     BAIL_ON_LWNET_ERROR(dwError);
 
     switch (out.tag)
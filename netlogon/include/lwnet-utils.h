@@ -214,6 +214,12 @@ LWNetDnsSrvQuery(
     OUT PDWORD pdwServerCount
     );
 
+// Drop all SRV and address answers cached by LWNetDnsSrvQuery.
+VOID
+LWNetDnsCacheFlush(
+    VOID
+    );
+
 DWORD
 LWNetReadNextLine(
     FILE* fp,
@@ -286,6 +292,12 @@ LWNetSleepInMs(
     IN LWNET_UNIX_MS_TIME_T Time
     );
 
+VOID
+LWNetGetRandomBytes(
+    OUT PVOID pBuffer,
+    IN DWORD dwSize
+    );
+
 DWORD
 LWNetCrackLdapTime(
     IN PCSTR pszStrTime,
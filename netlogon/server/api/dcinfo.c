@@ -90,6 +90,8 @@ LWNetSrvGetDCName(
     BOOLEAN bFailedFindWritable = FALSE;
     BOOLEAN bUpdateCache = FALSE;
     BOOLEAN bUpdateKrb5Affinity = FALSE;
+    BOOLEAN bProbeReachable = FALSE;
+    LWNET_UNIX_TIME_T lastProbed = 0;
 
     #define MAX_NUM_BLACKLIST_DC 50
     PSTR ppszTempAddressBlackList[MAX_NUM_BLACKLIST_DC] = {0};
@@ -186,8 +188,68 @@ LWNetSrvGetDCName(
                 LWNET_SAFE_FREE_DC_INFO(pDcInfo);
                 pDcInfo = NULL;
             }
+            else if ((now - lastPinged) > LWNetConfigGetPingAgainTimeoutSeconds() &&
+                     LWNetSrvGetDcProbeResult(
+                            pszDnsDomainName,
+                            pDcInfo->pszDomainControllerAddress,
+                            now,
+                            LWNetConfigGetPingAgainTimeoutSeconds(),
+                            &bProbeReachable,
+                            &lastProbed))
+            {
+                // The background prober (lwnet-prober.c) pinged this DC
+                // recently enough, so answer from its result instead of
+                // pinging while the caller waits.
+                if (bProbeReachable)
+                {
+                    bUpdateCache = TRUE;
+                    lastPinged = lastProbed;
+
+                    if ((dwDsFlags & DS_WRITABLE_REQUIRED) && isBackoffToWritableDc)
+                    {
+                        lastBackoffToWritableDc = now;
+                    }
+                }
+                else
+                {
+                    LWNET_SAFE_FREE_DC_INFO(pDcInfo);
+
+                    // Switch to a DC that answered the prober, if any;
+                    // otherwise fall through to discovery.
+                    dwError = LWNetSrvGetDcProbeCandidate(
+                                    pszDnsDomainName,
+                                    pszSiteName,
+                                    dwDsFlags,
+                                    now,
+                                    LWNetConfigGetPingAgainTimeoutSeconds(),
+                                    dwTempBlackListCount,
+                                    ppszTempAddressBlackList,
+                                    &pDcInfo);
+                    if (dwError == ERROR_NOT_FOUND)
+                    {
+                        dwError = 0;
+                    }
+                    BAIL_ON_LWNET_ERROR(dwError);
+
+                    if (pDcInfo && LWNetSrvIsAffinitizableRequestFlags(dwDsFlags))
+                    {
+                        bUpdateCache = TRUE;
+                        lastDiscovered = now;
+                        lastPinged = now;
+                        isBackoffToWritableDc = FALSE;
+                        lastBackoffToWritableDc = 0;
+
+                        bUpdateKrb5Affinity = LWNetIsUpdateKrb5AffinityEnabled(
+                                                  dwDsFlags,
+                                                  pszSiteName,
+                                                  pDcInfo);
+                    }
+                }
+            }
             else if ((now - lastPinged) > LWNetConfigGetPingAgainTimeoutSeconds())
             {
+                // Only reached when background probing is disabled or has
+                // no recent result for this DC.
                 DNS_SERVER_INFO serverInfo;
 
                 serverInfo.pszName = pDcInfo->pszDomainControllerName;
@@ -324,6 +386,23 @@ LWNetSrvGetDCName(
 
     if (bUpdateKrb5Affinity)
     {
+        if (!pServerArray)
+        {
+            // Switched to a probed DC without discovery; the other DCs
+            // are still listed as fallbacks for krb5.
+            dwError = LWNetDnsSrvQuery(
+                            pszDnsDomainName,
+                            pszSiteName,
+                            dwDsFlags,
+                            &pServerArray,
+                            &dwServerCount);
+            if (dwError)
+            {
+                dwServerCount = 0;
+                dwError = 0;
+            }
+        }
+
         dwError = LWNetKrb5UpdateAffinity(
                         pszDnsDomainName,
                         pDcInfo,
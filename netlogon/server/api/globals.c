@@ -56,6 +56,9 @@ LWNetSrvApiInit(
     
     LWNetSrvInitEventlogInterface();
 
+    /* lwregd invalidates cached values whenever the registry changes */
+    RegEnableValueCache(TRUE);
+
     dwError = LWNetSrvReadRegistry();
     BAIL_ON_LWNET_ERROR(dwError);
 
@@ -68,6 +71,9 @@ LWNetSrvApiInit(
     dwError = LWNetSrvStartNetBios();
     BAIL_ON_LWNET_ERROR(dwError);
 
+    dwError = LWNetSrvStartDcProber();
+    BAIL_ON_LWNET_ERROR(dwError);
+
 error:
     return dwError;
 }
@@ -77,6 +83,8 @@ LWNetSrvApiShutdown(
     VOID
     )
 {
+    LWNetSrvStopDcProber();
+
     LWNetStopNetBios();
 
     LWNetCleanupPlugin();
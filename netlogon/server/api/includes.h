@@ -78,5 +78,7 @@
 #include "lwnet-cachedb.h"
 #include "lwnet-krb5_p.h"
 #include "lwnet-server-cfg_p.h"
+#include "lwnet-prober_p.h"
+#include "lwnet-cldap_p.h"
 #include "state_p.h"
 
@@ -59,11 +59,29 @@ struct _LWNET_CACHE_DB_HANDLE_DATA {
     // (which might happen with database debugging or maintenance tools).
     pthread_rwlock_t Lock;
     pthread_rwlock_t* pLock;
+    // Changes are written to the registry in the background by the flush
+    // thread, at most once every LWNET_CACHE_DB_FLUSH_DELAY_SECONDS, so
+    // that lookups and updates never wait on registry IPC.
+    pthread_mutex_t FlushLock;
+    pthread_mutex_t* pFlushLock;
+    pthread_cond_t FlushEvent;
+    pthread_cond_t* pFlushEvent;
+    pthread_t FlushThread;
+    pthread_t* pFlushThread;
+    BOOLEAN bDirty;
+    BOOLEAN bShutdown;
+    // The entries as they were last written to the registry.  Only the
+    // flush path touches these.  When bSavedValid is not set (a write
+    // failed part way), the next flush rewrites the whole cache key.
+    PLWNET_CACHE_DB_ENTRY pSavedEntries;
+    DWORD dwSavedCount;
+    BOOLEAN bSavedValid;
 };
 
 static LWNET_CACHE_DB_HANDLE gDbHandle;
 #define LWNET_NETLOGON_REGISTRY_KEY "Services\\netlogon"
 #define LWNET_CACHE_REGISTRY_KEY "cachedb"
+#define LWNET_CACHE_DB_FLUSH_DELAY_SECONDS 5
 
 LWMsgTypeSpec gLWNetCacheEntrySpec[] =
 {
@@ -99,10 +117,10 @@ LWMsgTypeSpec gLWNetCacheEntrySpec[] =
     LWMSG_TYPE_END
 };
 
-// ISSUE-2008/07/01-dalmeida -- For now, use exlusive locking as we need to
-// verify actual thread safety wrt things like error strings and such.
+// Lookups only copy out of the in-memory list, so they can share the lock
+// with each other and with the flush thread's snapshot.
 #define RW_LOCK_ACQUIRE_READ(Lock) \
-    pthread_rwlock_wrlock(Lock)
+    pthread_rwlock_rdlock(Lock)
 
 #define RW_LOCK_RELEASE_READ(Lock) \
     pthread_rwlock_unlock(Lock)
@@ -134,7 +152,41 @@ LWNetCacheDbReadFromRegistry(
 static
 DWORD
 LWNetCacheDbWriteToRegistry(
-    PLW_DLINKED_LIST pCacheList
+    IN LWNET_CACHE_DB_HANDLE DbHandle,
+    IN PLWNET_CACHE_DB_ENTRY pEntries,
+    IN DWORD dwCount
+    );
+
+static
+DWORD
+LWNetCacheDbFlush(
+    IN LWNET_CACHE_DB_HANDLE DbHandle
+    );
+
+static
+PVOID
+LWNetCacheDbFlushThread(
+    IN PVOID pContext
+    );
+
+static
+VOID
+LWNetCacheDbMarkDirty(
+    IN LWNET_CACHE_DB_HANDLE DbHandle
+    );
+
+static
+BOOLEAN
+LWNetCacheDbIsSameKey(
+    IN PLWNET_CACHE_DB_ENTRY pEntry1,
+    IN PLWNET_CACHE_DB_ENTRY pEntry2
+    );
+
+static
+BOOLEAN
+LWNetCacheDbIsSameData(
+    IN PLWNET_CACHE_DB_ENTRY pEntry1,
+    IN PLWNET_CACHE_DB_ENTRY pEntry2
     );
 
 static
@@ -267,9 +319,44 @@ LWNetCacheDbOpen(
 
     dbHandle->pLock = &dbHandle->Lock;
 
+    lError = pthread_mutex_init(&dbHandle->FlushLock, NULL);
+    dwError = LwMapErrnoToLwError(lError);
+    BAIL_ON_LWNET_ERROR(dwError);
+
+    dbHandle->pFlushLock = &dbHandle->FlushLock;
+
+    lError = pthread_cond_init(&dbHandle->FlushEvent, NULL);
+    dwError = LwMapErrnoToLwError(lError);
+    BAIL_ON_LWNET_ERROR(dwError);
+
+    dbHandle->pFlushEvent = &dbHandle->FlushEvent;
+
     dwError = LWNetCacheDbReadFromRegistry(dbHandle);
     BAIL_ON_LWNET_ERROR(dwError);
 
+    // What was just read is already in the registry.
+    dbHandle->bDirty = FALSE;
+
+    dwError = LWNetCacheDbExport(
+                  dbHandle,
+                  &dbHandle->pSavedEntries,
+                  &dbHandle->dwSavedCount);
+    BAIL_ON_LWNET_ERROR(dwError);
+
+    dbHandle->bSavedValid = TRUE;
+
+    if (bIsWrite)
+    {
+        lError = pthread_create(&dbHandle->FlushThread,
+                                NULL,
+                                LWNetCacheDbFlushThread,
+                                dbHandle);
+        dwError = LwMapErrnoToLwError(lError);
+        BAIL_ON_LWNET_ERROR(dwError);
+
+        dbHandle->pFlushThread = &dbHandle->FlushThread;
+    }
+
 error:
     if (dwError)
     {
@@ -288,19 +375,43 @@ LWNetCacheDbClose(
 
     if (dbHandle)
     {
+        if (dbHandle->pFlushThread)
+        {
+            pthread_mutex_lock(dbHandle->pFlushLock);
+            dbHandle->bShutdown = TRUE;
+            pthread_cond_signal(dbHandle->pFlushEvent);
+            pthread_mutex_unlock(dbHandle->pFlushLock);
+
+            pthread_join(*dbHandle->pFlushThread, NULL);
+            dbHandle->pFlushThread = NULL;
+
+            // Write out whatever changed since the last flush.
+            if (dbHandle->bDirty)
+            {
+                LWNetCacheDbFlush(dbHandle);
+            }
+        }
         if (dbHandle->pCacheList)
         {
-            LWNetCacheDbWriteToRegistry(dbHandle->pCacheList);
             LwDLinkedListForEach(
                 dbHandle->pCacheList,
                 LWNetCacheDbForEachEntryDestroy,
                 NULL);
             LwDLinkedListFree(dbHandle->pCacheList);
         }
+        LWNetCacheDbFreeEntries(dbHandle->pSavedEntries, dbHandle->dwSavedCount);
         if (dbHandle->pLock)
         {
             pthread_rwlock_destroy(dbHandle->pLock);
         }
+        if (dbHandle->pFlushEvent)
+        {
+            pthread_cond_destroy(dbHandle->pFlushEvent);
+        }
+        if (dbHandle->pFlushLock)
+        {
+            pthread_mutex_destroy(dbHandle->pFlushLock);
+        }
 
         LWNET_SAFE_FREE_MEMORY(dbHandle);
 
@@ -342,6 +453,85 @@ LWNetCacheDbEntryFree(
     }
 }
 
+static
+BOOLEAN
+LWNetCacheDbIsSameString(
+    IN OPTIONAL PCSTR pszString1,
+    IN OPTIONAL PCSTR pszString2
+    )
+{
+    // NULL is written to the registry as ""
+    return !strcmp(pszString1 ? pszString1 : "",
+                   pszString2 ? pszString2 : "");
+}
+
+// Whether both entries are stored under the same registry key
+static
+BOOLEAN
+LWNetCacheDbIsSameKey(
+    IN PLWNET_CACHE_DB_ENTRY pEntry1,
+    IN PLWNET_CACHE_DB_ENTRY pEntry2
+    )
+{
+    if (pEntry1->QueryType != pEntry2->QueryType ||
+        !LWNetCacheDbIsSameString(pEntry1->pszDnsDomainName,
+                                  pEntry2->pszDnsDomainName))
+    {
+        return FALSE;
+    }
+
+    if (!pEntry1->pszSiteName || !pEntry2->pszSiteName)
+    {
+        return !pEntry1->pszSiteName && !pEntry2->pszSiteName;
+    }
+
+    return !strcmp(pEntry1->pszSiteName, pEntry2->pszSiteName);
+}
+
+// Whether the registry copy of pEntry1 is still good for pEntry2.
+// LastPinged and the ping time change on every successful ping of the
+// same DC, so they do not count as a change by themselves.  They are
+// saved with the next real change to the entry; an entry reloaded with
+// an old LastPinged is simply pinged again on first use.
+static
+BOOLEAN
+LWNetCacheDbIsSameData(
+    IN PLWNET_CACHE_DB_ENTRY pEntry1,
+    IN PLWNET_CACHE_DB_ENTRY pEntry2
+    )
+{
+    PLWNET_DC_INFO pDcInfo1 = &pEntry1->DcInfo;
+    PLWNET_DC_INFO pDcInfo2 = &pEntry2->DcInfo;
+
+    return (pEntry1->LastDiscovered == pEntry2->LastDiscovered &&
+            pEntry1->IsBackoffToWritableDc == pEntry2->IsBackoffToWritableDc &&
+            pEntry1->LastBackoffToWritableDc == pEntry2->LastBackoffToWritableDc &&
+            pDcInfo1->dwDomainControllerAddressType == pDcInfo2->dwDomainControllerAddressType &&
+            pDcInfo1->dwFlags == pDcInfo2->dwFlags &&
+            pDcInfo1->dwVersion == pDcInfo2->dwVersion &&
+            pDcInfo1->wLMToken == pDcInfo2->wLMToken &&
+            pDcInfo1->wNTToken == pDcInfo2->wNTToken &&
+            !memcmp(pDcInfo1->pucDomainGUID, pDcInfo2->pucDomainGUID, LWNET_GUID_SIZE) &&
+            LWNetCacheDbIsSameString(pDcInfo1->pszDomainControllerName,
+                                     pDcInfo2->pszDomainControllerName) &&
+            LWNetCacheDbIsSameString(pDcInfo1->pszDomainControllerAddress,
+                                     pDcInfo2->pszDomainControllerAddress) &&
+            LWNetCacheDbIsSameString(pDcInfo1->pszNetBIOSDomainName,
+                                     pDcInfo2->pszNetBIOSDomainName) &&
+            LWNetCacheDbIsSameString(pDcInfo1->pszFullyQualifiedDomainName,
+                                     pDcInfo2->pszFullyQualifiedDomainName) &&
+            LWNetCacheDbIsSameString(pDcInfo1->pszDnsForestName,
+                                     pDcInfo2->pszDnsForestName) &&
+            LWNetCacheDbIsSameString(pDcInfo1->pszDCSiteName,
+                                     pDcInfo2->pszDCSiteName) &&
+            LWNetCacheDbIsSameString(pDcInfo1->pszClientSiteName,
+                                     pDcInfo2->pszClientSiteName) &&
+            LWNetCacheDbIsSameString(pDcInfo1->pszNetBIOSHostName,
+                                     pDcInfo2->pszNetBIOSHostName) &&
+            LWNetCacheDbIsSameString(pDcInfo1->pszUserName,
+                                     pDcInfo2->pszUserName));
+}
+
 
 DWORD
 LWNetCacheDbRegistryReadString(
@@ -687,8 +877,8 @@ LWNetCacheDbReadFromRegistry(
                   HKEY_THIS_MACHINE,
                   LWNET_NETLOGON_REGISTRY_KEY "\\" LWNET_CACHE_REGISTRY_KEY);
 
-    /* cachedb entry does not exist until netlogond is stopped, so this
-     * is not an error when this entry is not found.
+    /* cachedb entry does not exist until the cache has been flushed once,
+     * so this is not an error when this entry is not found.
      */
     if (dwError)
     {
@@ -775,7 +965,7 @@ error:
 DWORD
 LWNetCacheDbRegistryWriteValue(
     HANDLE hReg,
-    PSTR pszSubKey,
+    HKEY hKey,
     PSTR pszValueName,
     DWORD dwType,
     PVOID pValue,
@@ -791,17 +981,12 @@ LWNetCacheDbRegistryWriteValue(
     {
         case REG_SZ:
             pszValue = *((PSTR *) pValue);
-            if (pszValue)
-            {
-                dwDataLen = strlen(pszValue);
-                pData = pszValue;
-            }
-            else
+            if (!pszValue)
             {
                 pszValue = "";
-                dwDataLen = 0;
-                pData = (PVOID) pszValue;
             }
+            dwDataLen = strlen(pszValue) + 1;
+            pData = (PVOID) pszValue;
             break;
 
         case REG_DWORD:
@@ -824,12 +1009,11 @@ LWNetCacheDbRegistryWriteValue(
             break;
     }
 
-    dwError = RegUtilSetValue(
+    dwError = RegSetValueExA(
                   hReg,
-                  HKEY_THIS_MACHINE,
-                  LWNET_NETLOGON_REGISTRY_KEY "\\" LWNET_CACHE_REGISTRY_KEY,
-                  pszSubKey,
+                  hKey,
                   pszValueName,
+                  0,
                   dwType,
                   pData,
                   dwDataLen);
@@ -846,7 +1030,7 @@ error:
 DWORD
 LWNetCacheDbRegistryWriteValues(
     HANDLE hReg,
-    PSTR pszSubKey,
+    HKEY hKey,
     PLWNET_CACHE_DB_ENTRY pEntry)
 {
 
@@ -865,7 +1049,7 @@ LWNetCacheDbRegistryWriteValues(
     {
         dwError = LWNetCacheDbRegistryWriteValue(
                       hReg,
-                      pszSubKey,
+                      hKey,
                       valueArray[index].pszValueName,
                       valueArray[index].dwType,
                       valueArray[index].pValue,
@@ -882,29 +1066,81 @@ error:
 }
 
 
+static
+DWORD
+LWNetCacheDbGetRegistryKeyName(
+    IN PLWNET_CACHE_DB_ENTRY pEntry,
+    OUT PSTR* ppszKeyName
+    )
+{
+    return LwAllocateStringPrintf(
+               ppszKeyName,
+               "%s%s%s-%d",
+               pEntry->pszDnsDomainName ? pEntry->pszDnsDomainName : "",
+               pEntry->pszSiteName ? "-" : "",
+               pEntry->pszSiteName ? pEntry->pszSiteName : "",
+               (int) pEntry->QueryType);
+}
+
+static
+PLWNET_CACHE_DB_ENTRY
+LWNetCacheDbFindEntry(
+    IN PLWNET_CACHE_DB_ENTRY pEntries,
+    IN DWORD dwCount,
+    IN PLWNET_CACHE_DB_ENTRY pEntry
+    )
+{
+    DWORD i = 0;
+
+    for (i = 0; i < dwCount; i++)
+    {
+        if (LWNetCacheDbIsSameKey(&pEntries[i], pEntry))
+        {
+            return &pEntries[i];
+        }
+    }
+
+    return NULL;
+}
+
+/*
+ * Bring the registry copy of the cache in line with pEntries.  Only the
+ * entries that differ from the last saved snapshot are written, and only
+ * the keys of entries that have gone away are deleted, so that a flush
+ * does not rewrite (and invalidate registry caches for) the whole tree.
+ */
 static
 DWORD
 LWNetCacheDbWriteToRegistry(
-    PLW_DLINKED_LIST pCacheList
+    IN LWNET_CACHE_DB_HANDLE DbHandle,
+    IN PLWNET_CACHE_DB_ENTRY pEntries,
+    IN DWORD dwCount
     )
 {
     HANDLE hReg = NULL;
-    HKEY pRootKey = NULL;
+    HKEY pCacheKey = NULL;
+    HKEY pEntryKey = NULL;
     DWORD dwError = 0;
     PSTR pszNewCacheKey = NULL;
-    PVOID pData = NULL;
     PLWNET_CACHE_DB_ENTRY pCacheDbEntry = NULL;
+    PLWNET_CACHE_DB_ENTRY pSavedEntry = NULL;
+    DWORD dwWritten = 0;
+    DWORD dwDeleted = 0;
+    DWORD i = 0;
 
     /* Open connection to registry */
     dwError = RegOpenServer(&hReg);
     BAIL_ON_LWNET_ERROR(dwError);
 
-    /* Don't care if this fails, just remove the old cache if it exists */
-    RegUtilDeleteTree(hReg,
-                      HKEY_THIS_MACHINE,
-                      LWNET_NETLOGON_REGISTRY_KEY,
-                      LWNET_CACHE_REGISTRY_KEY);
-                      
+    if (!DbHandle->bSavedValid)
+    {
+        /* Don't care if this fails, just remove the old cache if it exists */
+        RegUtilDeleteTree(hReg,
+                          HKEY_THIS_MACHINE,
+                          LWNET_NETLOGON_REGISTRY_KEY,
+                          LWNET_CACHE_REGISTRY_KEY);
+    }
+
     dwError = RegUtilAddKey(
                   hReg,
                   HKEY_THIS_MACHINE,
@@ -913,50 +1149,115 @@ LWNetCacheDbWriteToRegistry(
     BAIL_ON_LWNET_ERROR(dwError);
 
     /*
-     * Create new keys for every cached entry, and fill in the values under
-     * each key
+     * Keep the cache key open for the whole write and set the values
+     * through the open entry keys, rather than resolving the full path
+     * for every value.
+     */
+    dwError = RegOpenKeyExA(
+                  hReg,
+                  NULL,
+                  HKEY_THIS_MACHINE "\\" LWNET_NETLOGON_REGISTRY_KEY "\\" LWNET_CACHE_REGISTRY_KEY,
+                  0,
+                  KEY_ALL_ACCESS,
+                  &pCacheKey);
+    BAIL_ON_LWNET_ERROR(dwError);
+
+    /*
+     * Create or update the keys of new and changed entries, and fill in
+     * the values under each key
      */
-    while (pCacheList)
+    for (i = 0; i < dwCount; i++)
     {
-        /* Create new registry subkey for each cached entry */
-        pCacheDbEntry = (PLWNET_CACHE_DB_ENTRY) pCacheList->pItem;
-
-        dwError = LwAllocateStringPrintf(
-                       &pszNewCacheKey, 
-                      "%s%s%s-%d",
-                       pCacheDbEntry->pszDnsDomainName ?
-                           pCacheDbEntry->pszDnsDomainName : "",
-                       pCacheDbEntry->pszSiteName ? "-" : "",
-                       pCacheDbEntry->pszSiteName ?
-                           pCacheDbEntry->pszSiteName : "",
-                       (int) pCacheDbEntry->QueryType);
+        pCacheDbEntry = &pEntries[i];
+
+        if (DbHandle->bSavedValid)
+        {
+            pSavedEntry = LWNetCacheDbFindEntry(
+                              DbHandle->pSavedEntries,
+                              DbHandle->dwSavedCount,
+                              pCacheDbEntry);
+            if (pSavedEntry &&
+                LWNetCacheDbIsSameData(pSavedEntry, pCacheDbEntry))
+            {
+                continue;
+            }
+        }
+
+        dwError = LWNetCacheDbGetRegistryKeyName(
+                      pCacheDbEntry,
+                      &pszNewCacheKey);
         BAIL_ON_LWNET_ERROR(dwError);
         
-        dwError = RegUtilAddKey(
+        dwError = RegCreateKeyExA(
                       hReg,
-                      HKEY_THIS_MACHINE,
-                      LWNET_NETLOGON_REGISTRY_KEY "\\" LWNET_CACHE_REGISTRY_KEY,
-                      pszNewCacheKey);
+                      pCacheKey,
+                      pszNewCacheKey,
+                      0,
+                      NULL,
+                      0,
+                      KEY_ALL_ACCESS,
+                      NULL,
+                      &pEntryKey,
+                      NULL);
         BAIL_ON_LWNET_ERROR(dwError);
 
         /* Add to registry the current entries */
         dwError = LWNetCacheDbRegistryWriteValues(
                       hReg,
-                      pszNewCacheKey,
+                      pEntryKey,
                       pCacheDbEntry);
         BAIL_ON_LWNET_ERROR(dwError);
+
+        RegCloseKey(hReg, pEntryKey);
+        pEntryKey = NULL;
         LWNET_SAFE_FREE_MEMORY(pszNewCacheKey);
+        dwWritten++;
+    }
+
+    /* Remove the keys of entries that were scavenged or replaced */
+    for (i = 0; DbHandle->bSavedValid && i < DbHandle->dwSavedCount; i++)
+    {
+        pSavedEntry = &DbHandle->pSavedEntries[i];
+
+        if (LWNetCacheDbFindEntry(pEntries, dwCount, pSavedEntry))
+        {
+            continue;
+        }
+
+        dwError = LWNetCacheDbGetRegistryKeyName(
+                      pSavedEntry,
+                      &pszNewCacheKey);
+        BAIL_ON_LWNET_ERROR(dwError);
 
-        pCacheList = pCacheList->pNext;
+        dwError = RegUtilDeleteTree(
+                      hReg,
+                      HKEY_THIS_MACHINE,
+                      LWNET_NETLOGON_REGISTRY_KEY "\\" LWNET_CACHE_REGISTRY_KEY,
+                      pszNewCacheKey);
+        if (dwError == LWREG_ERROR_NO_SUCH_KEY_OR_VALUE)
+        {
+            dwError = 0;
+        }
+        BAIL_ON_LWNET_ERROR(dwError);
+
+        LWNET_SAFE_FREE_MEMORY(pszNewCacheKey);
+        dwDeleted++;
     }
 
+    LWNET_LOG_VERBOSE("Saved DC cache to the registry (%u entries written, "
+                      "%u removed, %u total)",
+                      dwWritten, dwDeleted, dwCount);
+
 cleanup:
-    if (pRootKey)
+    if (pEntryKey)
     {
-        RegCloseKey(hReg, pRootKey);
+        RegCloseKey(hReg, pEntryKey);
+    }
+    if (pCacheKey)
+    {
+        RegCloseKey(hReg, pCacheKey);
     }
     RegCloseServer(hReg);
-    LWNET_SAFE_FREE_MEMORY(pData);
     LWNET_SAFE_FREE_MEMORY(pszNewCacheKey);
 
     return dwError;
@@ -969,6 +1270,116 @@ error:
     goto cleanup;
 }
 
+static
+DWORD
+LWNetCacheDbFlush(
+    IN LWNET_CACHE_DB_HANDLE DbHandle
+    )
+{
+    DWORD dwError = 0;
+    PLWNET_CACHE_DB_ENTRY pEntries = NULL;
+    DWORD dwCount = 0;
+
+    // Take a snapshot so the registry is written without holding the
+    // cache lock.
+    dwError = LWNetCacheDbExport(DbHandle, &pEntries, &dwCount);
+    BAIL_ON_LWNET_ERROR(dwError);
+
+    dwError = LWNetCacheDbWriteToRegistry(DbHandle, pEntries, dwCount);
+    if (dwError)
+    {
+        // Some keys may have been written and some not, so the saved
+        // snapshot no longer describes the registry.
+        DbHandle->bSavedValid = FALSE;
+    }
+    BAIL_ON_LWNET_ERROR(dwError);
+
+    LWNetCacheDbFreeEntries(DbHandle->pSavedEntries, DbHandle->dwSavedCount);
+    DbHandle->pSavedEntries = pEntries;
+    DbHandle->dwSavedCount = dwCount;
+    DbHandle->bSavedValid = TRUE;
+
+    pEntries = NULL;
+    dwCount = 0;
+
+error:
+    LWNetCacheDbFreeEntries(pEntries, dwCount);
+
+    return dwError;
+}
+
+static
+PVOID
+LWNetCacheDbFlushThread(
+    IN PVOID pContext
+    )
+{
+    LWNET_CACHE_DB_HANDLE DbHandle = (LWNET_CACHE_DB_HANDLE) pContext;
+    struct timespec deadline = { 0 };
+    DWORD dwError = 0;
+
+    pthread_mutex_lock(DbHandle->pFlushLock);
+
+    while (!DbHandle->bShutdown)
+    {
+        if (!DbHandle->bDirty)
+        {
+            pthread_cond_wait(DbHandle->pFlushEvent, DbHandle->pFlushLock);
+            continue;
+        }
+
+        // Let further changes accumulate so that a burst of updates
+        // results in a single write.
+        deadline.tv_sec = time(NULL) + LWNET_CACHE_DB_FLUSH_DELAY_SECONDS;
+        deadline.tv_nsec = 0;
+
+        while (!DbHandle->bShutdown &&
+               pthread_cond_timedwait(DbHandle->pFlushEvent,
+                                      DbHandle->pFlushLock,
+                                      &deadline) != ETIMEDOUT)
+        {
+        }
+
+        if (DbHandle->bShutdown)
+        {
+            // LWNetCacheDbClose writes out the remaining changes.
+            break;
+        }
+
+        DbHandle->bDirty = FALSE;
+        pthread_mutex_unlock(DbHandle->pFlushLock);
+
+        dwError = LWNetCacheDbFlush(DbHandle);
+
+        pthread_mutex_lock(DbHandle->pFlushLock);
+
+        if (dwError)
+        {
+            // Try again with the next round.
+            DbHandle->bDirty = TRUE;
+        }
+    }
+
+    pthread_mutex_unlock(DbHandle->pFlushLock);
+
+    return NULL;
+}
+
+static
+VOID
+LWNetCacheDbMarkDirty(
+    IN LWNET_CACHE_DB_HANDLE DbHandle
+    )
+{
+    pthread_mutex_lock(DbHandle->pFlushLock);
+    if (!DbHandle->bDirty)
+    {
+        DbHandle->bDirty = TRUE;
+        pthread_cond_signal(DbHandle->pFlushEvent);
+    }
+    pthread_mutex_unlock(DbHandle->pFlushLock);
+}
+
 
 static
 LWNET_CACHE_DB_QUERY_TYPE
@@ -1190,6 +1601,7 @@ LWNetCacheDbUpdate(
     PLWNET_CACHE_DB_ENTRY pOldEntry = NULL;
     PLW_DLINKED_LIST pOldListEntry = NULL;
     BOOLEAN isAcquired = FALSE;
+    BOOLEAN bChanged = TRUE;
 
     dwError = LWNetAllocateMemory(sizeof(*pNewEntry), (PVOID *)&pNewEntry);
     BAIL_ON_LWNET_ERROR(dwError);
@@ -1299,6 +1711,10 @@ LWNetCacheDbUpdate(
 
     if (pOldListEntry)
     {
+        // A ping that finds the same DC only moves LastPinged, which
+        // does not need to go to the registry on its own.
+        bChanged = !LWNetCacheDbIsSameData(pOldEntry, pNewEntry);
+
         LwDLinkedListDelete(
             &DbHandle->pCacheList,
             pOldEntry);
@@ -1321,6 +1737,11 @@ error:
         RW_LOCK_RELEASE_WRITE(DbHandle->pLock);
     }
 
+    if (!dwError && bChanged)
+    {
+        LWNetCacheDbMarkDirty(DbHandle);
+    }
+
     LWNetCacheDbEntryFree(pNewEntry);
 
     return dwError;
@@ -1340,6 +1761,7 @@ LWNetCacheDbScavenge(
     PLW_DLINKED_LIST pListEntry = NULL;
     PLW_DLINKED_LIST pNextListEntry = NULL;
     BOOLEAN isAcquired = FALSE;
+    BOOLEAN bRemoved = FALSE;
 
     dwError = LWNetGetSystemTime(&now);
     positiveTimeLimit = now + PositiveCacheAge;
@@ -1360,6 +1782,7 @@ LWNetCacheDbScavenge(
                 pEntry);
 
             LWNetCacheDbEntryFree(pEntry);
+            bRemoved = TRUE;
         }
 
         pListEntry = pNextListEntry;
@@ -1370,6 +1793,11 @@ LWNetCacheDbScavenge(
         RW_LOCK_RELEASE_WRITE(DbHandle->pLock);
     }
 
+    if (bRemoved)
+    {
+        LWNetCacheDbMarkDirty(DbHandle);
+    }
+
     return dwError;
 }
 
@@ -1380,9 +1808,6 @@ LWNetCacheDbExport(
     OUT PDWORD pdwCount
     )
 {
-#if 1
-    return ERROR_CALL_NOT_IMPLEMENTED;
-#else
     DWORD dwError = 0;
     PLWNET_CACHE_DB_ENTRY pEntries = NULL;
     DWORD dwCount = 0;
@@ -1390,7 +1815,7 @@ LWNetCacheDbExport(
     DWORD i = 0;
 
     RW_LOCK_ACQUIRE_READ(DbHandle->pLock);
-    
+
     for (pListEntry = DbHandle->pCacheList;
          pListEntry;
          pListEntry = pListEntry->pNext)
@@ -1499,11 +1924,38 @@ cleanup:
     return dwError;
 
 error:
-    // TODO: Add free function.
+    LWNetCacheDbFreeEntries(pEntries, dwCount);
     pEntries = NULL;
     dwCount = 0;
     goto cleanup;
-#endif
+}
+
+VOID
+LWNetCacheDbFreeEntries(
+    IN OUT PLWNET_CACHE_DB_ENTRY pEntries,
+    IN DWORD dwCount
+    )
+{
+    DWORD i = 0;
+
+    if (pEntries)
+    {
+        for (i = 0; i < dwCount; i++)
+        {
+            LWNET_SAFE_FREE_STRING(pEntries[i].pszDnsDomainName);
+            LWNET_SAFE_FREE_STRING(pEntries[i].pszSiteName);
+            LWNET_SAFE_FREE_STRING(pEntries[i].DcInfo.pszDomainControllerName);
+            LWNET_SAFE_FREE_STRING(pEntries[i].DcInfo.pszDomainControllerAddress);
+            LWNET_SAFE_FREE_STRING(pEntries[i].DcInfo.pszNetBIOSDomainName);
+            LWNET_SAFE_FREE_STRING(pEntries[i].DcInfo.pszFullyQualifiedDomainName);
+            LWNET_SAFE_FREE_STRING(pEntries[i].DcInfo.pszDnsForestName);
+            LWNET_SAFE_FREE_STRING(pEntries[i].DcInfo.pszDCSiteName);
+            LWNET_SAFE_FREE_STRING(pEntries[i].DcInfo.pszClientSiteName);
+            LWNET_SAFE_FREE_STRING(pEntries[i].DcInfo.pszNetBIOSHostName);
+            LWNET_SAFE_FREE_STRING(pEntries[i].DcInfo.pszUserName);
+        }
+        LWNET_SAFE_FREE_MEMORY(pEntries);
+    }
 }
 
 DWORD
@@ -1595,6 +2047,15 @@ error:
     return dwError;
 }
 
+DWORD
+LWNetCacheExport(
+    OUT PLWNET_CACHE_DB_ENTRY* ppEntries,
+    OUT PDWORD pdwCount
+    )
+{
+    return LWNetCacheDbExport(gDbHandle, ppEntries, pdwCount);
+}
+
 DWORD
 LWNetCacheScavenge(
     IN LWNET_UNIX_TIME_T PositiveCacheAge,
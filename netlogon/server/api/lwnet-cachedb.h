@@ -143,6 +143,12 @@ LWNetCacheDbExport(
     OUT PDWORD pdwCount
     );
 
+VOID
+LWNetCacheDbFreeEntries(
+    IN OUT PLWNET_CACHE_DB_ENTRY pEntries,
+    IN DWORD dwCount
+    );
+
 //
 // High-level API for server
 //
@@ -178,6 +184,12 @@ LWNetCacheUpdate(
     IN PLWNET_DC_INFO pDcInfo
     );
 
+DWORD
+LWNetCacheExport(
+    OUT PLWNET_CACHE_DB_ENTRY* ppEntries,
+    OUT PDWORD pdwCount
+    );
+
 DWORD
 LWNetCacheScavenge(
     IN LWNET_UNIX_TIME_T PositiveCacheAge,
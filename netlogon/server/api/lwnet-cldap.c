@@ -0,0 +1,829 @@
+/* Editor Settings: expandtabs and use 4 spaces for indentation
+ * ex: set softtabstop=4 tabstop=8 expandtab shiftwidth=4: *
+ * -*- mode: c, c-basic-offset: 4 -*- */
+
+/*
+ * Copyright © BeyondTrust Software 2004 - 2019
+ * All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * BEYONDTRUST MAKES THIS SOFTWARE AVAILABLE UNDER OTHER LICENSING TERMS AS
+ * WELL. IF YOU HAVE ENTERED INTO A SEPARATE LICENSE AGREEMENT WITH
+ * BEYONDTRUST, THEN YOU MAY ELECT TO USE THE SOFTWARE UNDER THE TERMS OF THAT
+ * SOFTWARE LICENSE AGREEMENT INSTEAD OF THE TERMS OF THE APACHE LICENSE,
+ * NOTWITHSTANDING THE ABOVE NOTICE.  IF YOU HAVE QUESTIONS, OR WISH TO REQUEST
+ * A COPY OF THE ALTERNATE LICENSING TERMS OFFERED BY BEYONDTRUST, PLEASE CONTACT
+ * BEYONDTRUST AT beyondtrust.com/contact
+ */
+
+/*
+ * Copyright (C) BeyondTrust Software. All rights reserved.
+ *
+ * Module Name:
+ *
+ *        lwnet-cldap.c
+ *
+ * Abstract:
+ *
+ *        BeyondTrust Site Manager
+ *
+ *        Connectionless LDAP (CLDAP) Ping Engine
+ *
+ *        All pings of one discovery go out over a single UDP socket per
+ *        address family.  Each ping carries its own LDAP message id, so
+ *        replies are matched back to the server they came from by id and
+ *        source address.  Pings are started in batches (limited by
+ *        CLdapMaximumConnections outstanding at a time) and the first
+ *        suitable reply ends the search, so discovery takes about as long
+ *        as the fastest suitable DC needs to answer.
+ *
+ */
+#include "includes.h"
+
+// Largest reply we accept.  A Netlogon ping response is a few hundred
+// bytes; anything bigger than this is not a CLDAP ping reply.
+#define LWNET_CLDAP_MAX_DATAGRAM_SIZE 4096
+
+#define LWNET_CLDAP_SOCKET_IPV4 0
+#define LWNET_CLDAP_SOCKET_IPV6 1
+#define LWNET_CLDAP_SOCKET_COUNT 2
+
+typedef struct _LWNET_CLDAP_PING
+{
+    PDNS_SERVER_INFO pServerInfo;
+    struct sockaddr_storage Address;
+    socklen_t AddressLength;
+    DWORD dwSocketIndex;
+    LWNET_UNIX_MS_TIME_T StartTime;
+    BOOLEAN bOutstanding;
+} LWNET_CLDAP_PING, *PLWNET_CLDAP_PING;
+
+typedef struct _LWNET_CLDAP_ENGINE
+{
+    PCSTR pszDnsDomainName;
+    DWORD dwDsFlags;
+    WORD wPort;
+    // Message id of the ping at index 0; ping i uses base + i.
+    ber_int_t MessageIdBase;
+    struct pollfd Sockets[LWNET_CLDAP_SOCKET_COUNT];
+    PLWNET_CLDAP_PING pPings;
+    DWORD dwPingCount;
+    DWORD dwNextPing;
+    DWORD dwOldestPing;
+    DWORD dwOutstanding;
+    BOOLEAN bFailedFindWritable;
+} LWNET_CLDAP_ENGINE, *PLWNET_CLDAP_ENGINE;
+
+static
+DWORD
+LWNetCLdapOpenSocket(
+    IN int Family,
+    OUT int* pFd
+    )
+{
+    DWORD dwError = 0;
+    int fd = -1;
+    int flags = 0;
+
+    fd = socket(Family, SOCK_DGRAM, 0);
+    if (fd < 0)
+    {
+        dwError = LwMapErrnoToLwError(errno);
+        BAIL_ON_LWNET_ERROR(dwError);
+    }
+
+    flags = fcntl(fd, F_GETFL, 0);
+    if (flags < 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0)
+    {
+        dwError = LwMapErrnoToLwError(errno);
+        BAIL_ON_LWNET_ERROR(dwError);
+    }
+
+    if (fcntl(fd, F_SETFD, FD_CLOEXEC) < 0)
+    {
+        dwError = LwMapErrnoToLwError(errno);
+        BAIL_ON_LWNET_ERROR(dwError);
+    }
+
+    *pFd = fd;
+
+cleanup:
+
+    return dwError;
+
+error:
+
+    if (fd >= 0)
+    {
+        close(fd);
+    }
+
+    *pFd = -1;
+
+    goto cleanup;
+}
+
+static
+DWORD
+LWNetCLdapEncodePing(
+    IN PCSTR pszDnsDomainName,
+    IN ber_int_t MessageId,
+    OUT BerElement** ppBer
+    )
+{
+    DWORD dwError = 0;
+    BerElement* pBer = NULL;
+    // NETLOGON_NT_VERSION_5 | NETLOGON_NT_VERSION_5EX | NETLOGON_NT_VERSION_IP
+    static const char NtVer[] = { 0x06, 0x00, 0x00, 0x80 };
+
+    pBer = ber_alloc_t(LBER_USE_DER);
+    if (!pBer)
+    {
+        dwError = ERROR_NOT_ENOUGH_MEMORY;
+        BAIL_ON_LWNET_ERROR(dwError);
+    }
+
+    // SearchRequest for the root DSE with the filter
+    // (&(DnsDomain=<domain>)(NtVer=\06\00\00\80)), asking only for the
+    // Netlogon attribute -- the same query the LDAP library used to send.
+    if (ber_printf(pBer, "{it{seeiib",
+                   MessageId,
+                   (ber_tag_t) LDAP_REQ_SEARCH,
+                   "",
+                   (ber_int_t) LDAP_SCOPE_BASE,
+                   (ber_int_t) LDAP_DEREF_NEVER,
+                   (ber_int_t) 0,
+                   (ber_int_t) 0,
+                   (ber_int_t) 0) < 0 ||
+        ber_printf(pBer, "t{t{ss}t{so}}",
+                   (ber_tag_t) LDAP_FILTER_AND,
+                   (ber_tag_t) LDAP_FILTER_EQUALITY,
+                   "DnsDomain",
+                   pszDnsDomainName,
+                   (ber_tag_t) LDAP_FILTER_EQUALITY,
+                   "NtVer",
+                   NtVer,
+                   (ber_len_t) sizeof(NtVer)) < 0 ||
+        ber_printf(pBer, "{s}}}", NETLOGON_LDAP_ATTRIBUTE_NAME) < 0)
+    {
+        dwError = ERROR_NOT_ENOUGH_MEMORY;
+        BAIL_ON_LWNET_ERROR(dwError);
+    }
+
+    *ppBer = pBer;
+
+cleanup:
+
+    return dwError;
+
+error:
+
+    if (pBer)
+    {
+        ber_free(pBer, 1);
+    }
+
+    *ppBer = NULL;
+
+    goto cleanup;
+}
+
+static
+DWORD
+LWNetCLdapResolvePing(
+    IN OUT PLWNET_CLDAP_PING pPing,
+    IN WORD wPort
+    )
+{
+    DWORD dwError = 0;
+    struct addrinfo hints = { 0 };
+    struct addrinfo* pAddrInfo = NULL;
+    char szPort[8] = { 0 };
+    int aiError = 0;
+
+    snprintf(szPort, sizeof(szPort), "%u", (unsigned) wPort);
+
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_DGRAM;
+    hints.ai_flags = AI_NUMERICHOST;
+
+    aiError = getaddrinfo(pPing->pServerInfo->pszAddress, szPort, &hints, &pAddrInfo);
+    if (aiError ||
+        (pAddrInfo->ai_family != AF_INET && pAddrInfo->ai_family != AF_INET6) ||
+        pAddrInfo->ai_addrlen > sizeof(pPing->Address))
+    {
+        dwError = ERROR_BAD_NET_NAME;
+        BAIL_ON_LWNET_ERROR(dwError);
+    }
+
+    memcpy(&pPing->Address, pAddrInfo->ai_addr, pAddrInfo->ai_addrlen);
+    pPing->AddressLength = pAddrInfo->ai_addrlen;
+    pPing->dwSocketIndex = (pAddrInfo->ai_family == AF_INET6 ?
+                            LWNET_CLDAP_SOCKET_IPV6 :
+                            LWNET_CLDAP_SOCKET_IPV4);
+
+error:
+
+    if (pAddrInfo)
+    {
+        freeaddrinfo(pAddrInfo);
+    }
+
+    return dwError;
+}
+
+static
+DWORD
+LWNetCLdapSendPing(
+    IN OUT PLWNET_CLDAP_ENGINE pEngine,
+    IN DWORD dwIndex
+    )
+{
+    DWORD dwError = 0;
+    PLWNET_CLDAP_PING pPing = &pEngine->pPings[dwIndex];
+    struct pollfd* pSocket = NULL;
+    BerElement* pBer = NULL;
+    struct berval request = { 0 };
+    ssize_t sent = 0;
+
+    dwError = LWNetCLdapResolvePing(pPing, pEngine->wPort);
+    BAIL_ON_LWNET_ERROR(dwError);
+
+    pSocket = &pEngine->Sockets[pPing->dwSocketIndex];
+    if (pSocket->fd < 0)
+    {
+        dwError = LWNetCLdapOpenSocket(pPing->Address.ss_family, &pSocket->fd);
+        BAIL_ON_LWNET_ERROR(dwError);
+    }
+
+    dwError = LWNetCLdapEncodePing(
+                    pEngine->pszDnsDomainName,
+                    pEngine->MessageIdBase + (ber_int_t) dwIndex,
+                    &pBer);
+    BAIL_ON_LWNET_ERROR(dwError);
+
+    if (ber_flatten2(pBer, &request, 0) < 0)
+    {
+        dwError = ERROR_NOT_ENOUGH_MEMORY;
+        BAIL_ON_LWNET_ERROR(dwError);
+    }
+
+    dwError = LWNetGetSystemTimeInMs(&pPing->StartTime);
+    BAIL_ON_LWNET_ERROR(dwError);
+
+    do
+    {
+        sent = sendto(pSocket->fd,
+                      request.bv_val,
+                      request.bv_len,
+                      0,
+                      (struct sockaddr*) &pPing->Address,
+                      pPing->AddressLength);
+    } while (sent < 0 && errno == EINTR);
+
+    if (sent < 0)
+    {
+        dwError = LwMapErrnoToLwError(errno);
+        BAIL_ON_LWNET_ERROR(dwError);
+    }
+
+    pPing->bOutstanding = TRUE;
+    pEngine->dwOutstanding++;
+
+error:
+
+    if (pBer)
+    {
+        ber_free(pBer, 1);
+    }
+
+    return dwError;
+}
+
+static
+VOID
+LWNetCLdapEndPing(
+    IN OUT PLWNET_CLDAP_ENGINE pEngine,
+    IN PLWNET_CLDAP_PING pPing
+    )
+{
+    if (pPing->bOutstanding)
+    {
+        pPing->bOutstanding = FALSE;
+        pEngine->dwOutstanding--;
+    }
+
+    while (pEngine->dwOldestPing < pEngine->dwNextPing &&
+           !pEngine->pPings[pEngine->dwOldestPing].bOutstanding)
+    {
+        pEngine->dwOldestPing++;
+    }
+}
+
+static
+BOOLEAN
+LWNetCLdapIsSameAddress(
+    IN const struct sockaddr_storage* pExpected,
+    IN const struct sockaddr_storage* pActual
+    )
+{
+    if (pExpected->ss_family != pActual->ss_family)
+    {
+        return FALSE;
+    }
+
+    switch (pExpected->ss_family)
+    {
+        case AF_INET:
+        {
+            const struct sockaddr_in* pA = (const struct sockaddr_in*) pExpected;
+            const struct sockaddr_in* pB = (const struct sockaddr_in*) pActual;
+
+            return (pA->sin_port == pB->sin_port &&
+                    !memcmp(&pA->sin_addr, &pB->sin_addr, sizeof(pA->sin_addr)));
+        }
+        case AF_INET6:
+        {
+            const struct sockaddr_in6* pA = (const struct sockaddr_in6*) pExpected;
+            const struct sockaddr_in6* pB = (const struct sockaddr_in6*) pActual;
+
+            return (pA->sin6_port == pB->sin6_port &&
+                    !memcmp(&pA->sin6_addr, &pB->sin6_addr, sizeof(pA->sin6_addr)));
+        }
+        default:
+            return FALSE;
+    }
+}
+
+// Pulls the message id and the Netlogon attribute value out of a
+// SearchResultEntry.  The value points into pBer.
+static
+DWORD
+LWNetCLdapDecodeReply(
+    IN BerElement* pBer,
+    OUT ber_int_t* pMessageId,
+    OUT struct berval* pNetlogon
+    )
+{
+    DWORD dwError = 0;
+    ber_int_t messageId = 0;
+    ber_tag_t tag = 0;
+    ber_len_t len = 0;
+    char* pszCookie = NULL;
+    struct berval type = { 0 };
+    struct berval value = { 0 };
+    BOOLEAN bFound = FALSE;
+
+    if (ber_scanf(pBer, "{i", &messageId) == LBER_ERROR)
+    {
+        dwError = DNS_ERROR_BAD_PACKET;
+        BAIL_ON_LWNET_ERROR(dwError);
+    }
+
+    *pMessageId = messageId;
+
+    // A DC that does not serve the requested domain answers with
+    // just a SearchResultDone.
+    if (ber_peek_tag(pBer, &len) != LDAP_RES_SEARCH_ENTRY)
+    {
+        dwError = LW_ERROR_NO_SUCH_OBJECT;
+        BAIL_ON_LWNET_ERROR(dwError);
+    }
+
+    if (ber_scanf(pBer, "{x") == LBER_ERROR)
+    {
+        dwError = DNS_ERROR_BAD_PACKET;
+        BAIL_ON_LWNET_ERROR(dwError);
+    }
+
+    for (tag = ber_first_element(pBer, &len, &pszCookie);
+         tag != LBER_DEFAULT && !bFound;
+         tag = ber_next_element(pBer, &len, pszCookie))
+    {
+        if (ber_scanf(pBer, "{m", &type) == LBER_ERROR)
+        {
+            dwError = DNS_ERROR_BAD_PACKET;
+            BAIL_ON_LWNET_ERROR(dwError);
+        }
+
+        if (type.bv_len == sizeof(NETLOGON_LDAP_ATTRIBUTE_NAME) - 1 &&
+            !strncasecmp(type.bv_val,
+                         NETLOGON_LDAP_ATTRIBUTE_NAME,
+                         type.bv_len))
+        {
+            if (ber_scanf(pBer, "[m", &value) == LBER_ERROR)
+            {
+                dwError = DNS_ERROR_BAD_PACKET;
+                BAIL_ON_LWNET_ERROR(dwError);
+            }
+            bFound = TRUE;
+        }
+        else if (ber_scanf(pBer, "x") == LBER_ERROR)
+        {
+            // Skip the values of an attribute we did not ask for.
+            dwError = DNS_ERROR_BAD_PACKET;
+            BAIL_ON_LWNET_ERROR(dwError);
+        }
+    }
+
+    if (!bFound)
+    {
+        dwError = LW_ERROR_NO_SUCH_OBJECT;
+        BAIL_ON_LWNET_ERROR(dwError);
+    }
+
+    *pNetlogon = value;
+
+cleanup:
+
+    return dwError;
+
+error:
+
+    pNetlogon->bv_val = NULL;
+    pNetlogon->bv_len = 0;
+
+    goto cleanup;
+}
+
+static
+VOID
+LWNetCLdapProcessReply(
+    IN OUT PLWNET_CLDAP_ENGINE pEngine,
+    IN PBYTE pBuffer,
+    IN DWORD dwLength,
+    IN const struct sockaddr_storage* pFrom,
+    IN LWNET_UNIX_MS_TIME_T CurrentTime,
+    OUT PLWNET_DC_INFO* ppDcInfo
+    )
+{
+    DWORD dwError = 0;
+    struct berval reply = { 0 };
+    struct berval netlogon = { 0 };
+    BerElement* pBer = NULL;
+    ber_int_t messageId = 0;
+    DWORD dwIndex = 0;
+    PLWNET_CLDAP_PING pPing = NULL;
+    PLWNET_DC_INFO pDcInfo = NULL;
+
+    reply.bv_val = (char*) pBuffer;
+    reply.bv_len = dwLength;
+
+    pBer = ber_init(&reply);
+    if (!pBer)
+    {
+        dwError = ERROR_NOT_ENOUGH_MEMORY;
+        BAIL_ON_LWNET_ERROR(dwError);
+    }
+
+    dwError = LWNetCLdapDecodeReply(pBer, &messageId, &netlogon);
+    if (messageId >= pEngine->MessageIdBase &&
+        messageId - pEngine->MessageIdBase < (ber_int_t) pEngine->dwNextPing)
+    {
+        dwIndex = (DWORD) (messageId - pEngine->MessageIdBase);
+        if (pEngine->pPings[dwIndex].bOutstanding &&
+            LWNetCLdapIsSameAddress(&pEngine->pPings[dwIndex].Address, pFrom))
+        {
+            pPing = &pEngine->pPings[dwIndex];
+        }
+    }
+    if (!pPing)
+    {
+        // Late, duplicate or unsolicited datagram.
+        dwError = 0;
+        goto cleanup;
+    }
+    BAIL_ON_LWNET_ERROR(dwError);
+
+    dwError = LWNetBuildDCInfo((PBYTE) netlogon.bv_val,
+                               (DWORD) netlogon.bv_len,
+                               &pDcInfo);
+    BAIL_ON_LWNET_ERROR(dwError);
+
+    dwError = LWNetAllocateString(pPing->pServerInfo->pszAddress,
+                                  &pDcInfo->pszDomainControllerAddress);
+    BAIL_ON_LWNET_ERROR(dwError);
+
+    pDcInfo->dwPingTime = (DWORD)(CurrentTime - pPing->StartTime);
+    if (CurrentTime < pPing->StartTime)
+    {
+        LWNET_LOG_ERROR("Stop time is earlier than start time");
+    }
+
+    if (!LWNetSrvIsMatchingDcInfo(pDcInfo, pEngine->dwDsFlags))
+    {
+        dwError = LW_ERROR_NO_SUCH_OBJECT;
+
+        if (LWNetSrvIsMatchingDcInfo(pDcInfo, pEngine->dwDsFlags & ~DS_WRITABLE_REQUIRED))
+        {
+            // We found something, but it failed only because it did
+            // not satisfy writability.
+            pEngine->bFailedFindWritable = TRUE;
+        }
+        BAIL_ON_LWNET_ERROR(dwError);
+    }
+
+cleanup:
+
+    if (pPing)
+    {
+        LWNetCLdapEndPing(pEngine, pPing);
+    }
+
+    if (pBer)
+    {
+        ber_free(pBer, 1);
+    }
+
+    *ppDcInfo = pDcInfo;
+
+    return;
+
+error:
+
+    if (pPing)
+    {
+        LWNET_LOG_VERBOSE("CLDAP error: %u, %s", dwError, pPing->pServerInfo->pszName);
+    }
+
+    LWNET_SAFE_FREE_DC_INFO(pDcInfo);
+
+    goto cleanup;
+}
+
+static
+DWORD
+LWNetCLdapReceive(
+    IN OUT PLWNET_CLDAP_ENGINE pEngine,
+    IN int fd,
+    OUT PLWNET_DC_INFO* ppDcInfo
+    )
+{
+    DWORD dwError = 0;
+    BYTE buffer[LWNET_CLDAP_MAX_DATAGRAM_SIZE];
+    struct sockaddr_storage from;
+    socklen_t fromLength = 0;
+    ssize_t received = 0;
+    LWNET_UNIX_MS_TIME_T CurrentTime = 0;
+    PLWNET_DC_INFO pDcInfo = NULL;
+
+    dwError = LWNetGetSystemTimeInMs(&CurrentTime);
+    BAIL_ON_LWNET_ERROR(dwError);
+
+    // Drain everything that has arrived; several DCs usually answer
+    // within the same poll interval.
+    while (!pDcInfo)
+    {
+        fromLength = sizeof(from);
+        received = recvfrom(fd,
+                            buffer,
+                            sizeof(buffer),
+                            0,
+                            (struct sockaddr*) &from,
+                            &fromLength);
+        if (received < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            if (errno != EAGAIN && errno != EWOULDBLOCK)
+            {
+                // e.g. ICMP port unreachable reported on the socket;
+                // the ping it belongs to simply times out.
+                LWNET_LOG_VERBOSE("CLDAP receive error: %d", errno);
+            }
+            break;
+        }
+
+        LWNetCLdapProcessReply(
+            pEngine,
+            buffer,
+            (DWORD) received,
+            &from,
+            CurrentTime,
+            &pDcInfo);
+    }
+
+    *ppDcInfo = pDcInfo;
+
+error:
+
+    return dwError;
+}
+
+static
+VOID
+LWNetCLdapExpirePings(
+    IN OUT PLWNET_CLDAP_ENGINE pEngine,
+    IN LWNET_UNIX_MS_TIME_T CurrentTime,
+    IN DWORD dwSingleTimeoutMilliseconds
+    )
+{
+    PLWNET_CLDAP_PING pPing = NULL;
+
+    // Pings are sent in index order, so the oldest outstanding one is
+    // always at dwOldestPing.
+    while (pEngine->dwOldestPing < pEngine->dwNextPing)
+    {
+        pPing = &pEngine->pPings[pEngine->dwOldestPing];
+
+        if (pPing->StartTime + dwSingleTimeoutMilliseconds > CurrentTime)
+        {
+            break;
+        }
+
+        LWNET_LOG_VERBOSE("CLDAP timed out: %s", pPing->pServerInfo->pszName);
+
+        LWNetCLdapEndPing(pEngine, pPing);
+    }
+}
+
+DWORD
+LWNetCLdapPingServers(
+    IN PCSTR pszDnsDomainName,
+    IN DWORD dwDsFlags,
+    IN PDNS_SERVER_INFO pServerArray,
+    IN DWORD dwServerCount,
+    IN WORD wPort,
+    IN DWORD dwMaxOutstanding,
+    IN DWORD dwIncrementalCount,
+    IN DWORD dwSingleTimeoutMilliseconds,
+    IN DWORD dwTimeoutMilliseconds,
+    OUT PLWNET_DC_INFO* ppDcInfo,
+    OUT PBOOLEAN pbFailedFindWritable
+    )
+{
+    DWORD dwError = 0;
+    LWNET_CLDAP_ENGINE engine = { 0 };
+    LWNET_UNIX_MS_TIME_T StopTime = 0;
+    LWNET_UNIX_MS_TIME_T CurrentTime = 0;
+    LWNET_UNIX_MS_TIME_T WakeTime = 0;
+    PLWNET_DC_INFO pDcInfo = NULL;
+    DWORD dwStarted = 0;
+    DWORD dwIndex = 0;
+    DWORD dwIdBase = 0;
+    int sret = 0;
+
+    engine.pszDnsDomainName = pszDnsDomainName;
+    engine.dwDsFlags = dwDsFlags;
+    engine.wPort = wPort;
+    for (dwIndex = 0; dwIndex < LWNET_CLDAP_SOCKET_COUNT; dwIndex++)
+    {
+        engine.Sockets[dwIndex].fd = -1;
+        engine.Sockets[dwIndex].events = POLLIN;
+    }
+
+    if (!dwServerCount)
+    {
+        dwError = NERR_DCNotFound;
+        BAIL_ON_LWNET_ERROR(dwError);
+    }
+
+    dwError = LWNetAllocateMemory(
+                  dwServerCount * sizeof(*engine.pPings),
+                  OUT_PPVOID(&engine.pPings));
+    BAIL_ON_LWNET_ERROR(dwError);
+
+    engine.dwPingCount = dwServerCount;
+    for (dwIndex = 0; dwIndex < dwServerCount; dwIndex++)
+    {
+        engine.pPings[dwIndex].pServerInfo = &pServerArray[dwIndex];
+    }
+
+    dwError = LWNetGetSystemTimeInMs(&CurrentTime);
+    BAIL_ON_LWNET_ERROR(dwError);
+
+    StopTime = CurrentTime + dwTimeoutMilliseconds;
+
+    // Start each search at an unpredictable message id so replies to an
+    // earlier search (or forged ones) are not mistaken for ours.
+    LWNetGetRandomBytes(&dwIdBase, sizeof(dwIdBase));
+    engine.MessageIdBase = (ber_int_t) (dwIdBase & 0x3fffffff) + 1;
+
+    for (;;)
+    {
+        // Start the next batch if there is room.
+        dwStarted = 0;
+        while (dwStarted < dwIncrementalCount &&
+               engine.dwOutstanding < dwMaxOutstanding &&
+               engine.dwNextPing < engine.dwPingCount)
+        {
+            dwIndex = engine.dwNextPing++;
+
+            dwError = LWNetCLdapSendPing(&engine, dwIndex);
+            if (dwError)
+            {
+                LWNET_LOG_VERBOSE("CLDAP send error: %u, %s",
+                                  dwError,
+                                  engine.pPings[dwIndex].pServerInfo->pszName);
+                LWNetCLdapEndPing(&engine, &engine.pPings[dwIndex]);
+                dwError = 0;
+            }
+            else
+            {
+                dwStarted++;
+            }
+        }
+
+        if (engine.dwOutstanding == 0 &&
+            engine.dwNextPing >= engine.dwPingCount)
+        {
+            dwError = NERR_DCNotFound;
+            BAIL_ON_LWNET_ERROR(dwError);
+        }
+
+        dwError = LWNetGetSystemTimeInMs(&CurrentTime);
+        BAIL_ON_LWNET_ERROR(dwError);
+
+        if (CurrentTime >= StopTime)
+        {
+            dwError = NERR_DCNotFound;
+            BAIL_ON_LWNET_ERROR(dwError);
+        }
+
+        // Wake for the next batch, the oldest ping's deadline or the
+        // overall deadline, whichever comes first.
+        WakeTime = StopTime;
+        if (engine.dwOutstanding < dwMaxOutstanding &&
+            engine.dwNextPing < engine.dwPingCount)
+        {
+            WakeTime = CT_MIN(WakeTime, CurrentTime + LWNET_CLDAP_SHORT_POLL_TIMEOUT_MILLISECONDS);
+        }
+        if (engine.dwOutstanding)
+        {
+            WakeTime = CT_MIN(WakeTime,
+                              engine.pPings[engine.dwOldestPing].StartTime +
+                              dwSingleTimeoutMilliseconds);
+        }
+
+        do
+        {
+            sret = poll(engine.Sockets,
+                        LWNET_CLDAP_SOCKET_COUNT,
+                        WakeTime > CurrentTime ? (int) (WakeTime - CurrentTime) : 0);
+        } while (sret < 0 && errno == EINTR);
+
+        if (sret < 0)
+        {
+            dwError = LwMapErrnoToLwError(errno);
+            BAIL_ON_LWNET_ERROR(dwError);
+        }
+
+        for (dwIndex = 0; sret > 0 && !pDcInfo && dwIndex < LWNET_CLDAP_SOCKET_COUNT; dwIndex++)
+        {
+            if (engine.Sockets[dwIndex].fd >= 0 &&
+                engine.Sockets[dwIndex].revents)
+            {
+                dwError = LWNetCLdapReceive(
+                              &engine,
+                              engine.Sockets[dwIndex].fd,
+                              &pDcInfo);
+                BAIL_ON_LWNET_ERROR(dwError);
+            }
+        }
+
+        if (pDcInfo)
+        {
+            break;
+        }
+
+        dwError = LWNetGetSystemTimeInMs(&CurrentTime);
+        BAIL_ON_LWNET_ERROR(dwError);
+
+        LWNetCLdapExpirePings(&engine, CurrentTime, dwSingleTimeoutMilliseconds);
+    }
+
+cleanup:
+
+    for (dwIndex = 0; dwIndex < LWNET_CLDAP_SOCKET_COUNT; dwIndex++)
+    {
+        if (engine.Sockets[dwIndex].fd >= 0)
+        {
+            close(engine.Sockets[dwIndex].fd);
+        }
+    }
+    LW_SAFE_FREE_MEMORY(engine.pPings);
+
+    *ppDcInfo = pDcInfo;
+    *pbFailedFindWritable = pDcInfo ? FALSE : engine.bFailedFindWritable;
+
+    return dwError;
+
+error:
+
+    LWNET_SAFE_FREE_DC_INFO(pDcInfo);
+
+    goto cleanup;
+}
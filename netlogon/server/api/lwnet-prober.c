@@ -0,0 +1,1044 @@
+/* Editor Settings: expandtabs and use 4 spaces for indentation
+ * ex: set softtabstop=4 tabstop=8 expandtab shiftwidth=4: *
+ * -*- mode: c, c-basic-offset: 4 -*- */
+
+/*
+ * Copyright © BeyondTrust Software 2004 - 2019
+ * All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * BEYONDTRUST MAKES THIS SOFTWARE AVAILABLE UNDER OTHER LICENSING TERMS AS
+ * WELL. IF YOU HAVE ENTERED INTO A SEPARATE LICENSE AGREEMENT WITH
+ * BEYONDTRUST, THEN YOU MAY ELECT TO USE THE SOFTWARE UNDER THE TERMS OF THAT
+ * SOFTWARE LICENSE AGREEMENT INSTEAD OF THE TERMS OF THE APACHE LICENSE,
+ * NOTWITHSTANDING THE ABOVE NOTICE.  IF YOU HAVE QUESTIONS, OR WISH TO REQUEST
+ * A COPY OF THE ALTERNATE LICENSING TERMS OFFERED BY BEYONDTRUST, PLEASE CONTACT
+ * BEYONDTRUST AT beyondtrust.com/contact
+ */
+
+/*
+ * Copyright (C) BeyondTrust Software. All rights reserved.
+ *
+ * Module Name:
+ *
+ *        lwnet-prober.c
+ *
+ * Abstract:
+ *
+ *        BeyondTrust Site Manager
+ *
+ *        Background Domain Controller Prober
+ *
+ *        Every DcProbeInterval seconds, for each entry in the DC cache, the
+ *        prober CLDAP-pings the affinitized DC (unless a caller pinged it
+ *        within the interval) and the candidate DCs DNS lists for the same
+ *        domain, site and query type.  Each reply is kept with per-DC round
+ *        trip time and failure statistics.
+ *
+ *        When the affinitized DC stops answering, the entry is switched to
+ *        the fastest candidate that answered recently; only if there is none
+ *        is discovery run.  LWNetSrvGetDCName uses the same results rather
+ *        than pinging inline while its caller waits.  Statistics for DCs
+ *        that are no longer probed expire after a few intervals.
+ *
+ */
+#include "includes.h"
+
+// Maximum number of recently failed DCs skipped when re-discovering
+#define LWNET_DC_PROBE_MAX_SKIPPED 16
+// How often the configuration is checked again while probing is disabled
+#define LWNET_DC_PROBE_DISABLED_RECHECK_SECONDS 60
+// Candidate DCs pinged per cache entry and round
+#define LWNET_DC_PROBE_MAX_CANDIDATES 8
+// Candidates are pinged one at a time, so do not wait long for each
+#define LWNET_DC_PROBE_CANDIDATE_TIMEOUT_SECONDS 3
+// Statistics not refreshed for this many intervals are dropped
+#define LWNET_DC_PROBE_STATS_EXPIRY_INTERVALS 3
+
+typedef struct _LWNET_DC_PROBE_STATS
+{
+    PSTR pszDnsDomainName;
+    PSTR pszAddress;
+    DWORD dwLastRttMs;
+    // Smoothed as in TCP: avg += (sample - avg) / 8
+    DWORD dwAverageRttMs;
+    DWORD dwProbeCount;
+    DWORD dwFailureCount;
+    DWORD dwConsecutiveFailures;
+    LWNET_UNIX_TIME_T LastProbed;
+    LWNET_UNIX_TIME_T LastFailure;
+    // Reply to the last successful ping
+    PLWNET_DC_INFO pDcInfo;
+} LWNET_DC_PROBE_STATS, *PLWNET_DC_PROBE_STATS;
+
+typedef struct _LWNET_DC_PROBER
+{
+    pthread_mutex_t Mutex;
+    pthread_cond_t Wakeup;
+    pthread_t Thread;
+    BOOLEAN bStarted;
+    BOOLEAN bShutdown;
+    // Protected by Mutex.  Entries are only freed by the prober thread
+    // (or after it stopped), so it may keep using their strings unlocked.
+    PLW_DLINKED_LIST pStatsList;
+} LWNET_DC_PROBER, *PLWNET_DC_PROBER;
+
+static LWNET_DC_PROBER gLWNetDcProber =
+{
+    .Mutex = PTHREAD_MUTEX_INITIALIZER,
+    .Wakeup = PTHREAD_COND_INITIALIZER
+};
+
+static
+DWORD
+LWNetProberCopyString(
+    IN OPTIONAL PCSTR pszString,
+    OUT PSTR* ppszCopy
+    )
+{
+    if (!pszString)
+    {
+        *ppszCopy = NULL;
+        return 0;
+    }
+
+    return LWNetAllocateString(pszString, ppszCopy);
+}
+
+static
+DWORD
+LWNetProberCopyDcInfo(
+    IN PLWNET_DC_INFO pDcInfo,
+    OUT PLWNET_DC_INFO* ppCopy
+    )
+{
+    DWORD dwError = 0;
+    PLWNET_DC_INFO pCopy = NULL;
+
+    dwError = LWNetAllocateMemory(sizeof(*pCopy), (PVOID*)&pCopy);
+    BAIL_ON_LWNET_ERROR(dwError);
+
+    pCopy->dwPingTime = pDcInfo->dwPingTime;
+    pCopy->dwDomainControllerAddressType = pDcInfo->dwDomainControllerAddressType;
+    pCopy->dwFlags = pDcInfo->dwFlags;
+    pCopy->dwVersion = pDcInfo->dwVersion;
+    pCopy->wLMToken = pDcInfo->wLMToken;
+    pCopy->wNTToken = pDcInfo->wNTToken;
+    memcpy(pCopy->pucDomainGUID, pDcInfo->pucDomainGUID, LWNET_GUID_SIZE);
+
+    dwError = LWNetProberCopyString(pDcInfo->pszDomainControllerName,
+                                    &pCopy->pszDomainControllerName);
+    BAIL_ON_LWNET_ERROR(dwError);
+
+    dwError = LWNetProberCopyString(pDcInfo->pszDomainControllerAddress,
+                                    &pCopy->pszDomainControllerAddress);
+    BAIL_ON_LWNET_ERROR(dwError);
+
+    dwError = LWNetProberCopyString(pDcInfo->pszNetBIOSDomainName,
+                                    &pCopy->pszNetBIOSDomainName);
+    BAIL_ON_LWNET_ERROR(dwError);
+
+    dwError = LWNetProberCopyString(pDcInfo->pszFullyQualifiedDomainName,
+                                    &pCopy->pszFullyQualifiedDomainName);
+    BAIL_ON_LWNET_ERROR(dwError);
+
+    dwError = LWNetProberCopyString(pDcInfo->pszDnsForestName,
+                                    &pCopy->pszDnsForestName);
+    BAIL_ON_LWNET_ERROR(dwError);
+
+    dwError = LWNetProberCopyString(pDcInfo->pszDCSiteName,
+                                    &pCopy->pszDCSiteName);
+    BAIL_ON_LWNET_ERROR(dwError);
+
+    dwError = LWNetProberCopyString(pDcInfo->pszClientSiteName,
+                                    &pCopy->pszClientSiteName);
+    BAIL_ON_LWNET_ERROR(dwError);
+
+    dwError = LWNetProberCopyString(pDcInfo->pszNetBIOSHostName,
+                                    &pCopy->pszNetBIOSHostName);
+    BAIL_ON_LWNET_ERROR(dwError);
+
+    dwError = LWNetProberCopyString(pDcInfo->pszUserName,
+                                    &pCopy->pszUserName);
+    BAIL_ON_LWNET_ERROR(dwError);
+
+error:
+    if (dwError)
+    {
+        LWNET_SAFE_FREE_DC_INFO(pCopy);
+    }
+
+    *ppCopy = pCopy;
+
+    return dwError;
+}
+
+static
+PLWNET_DC_PROBE_STATS
+LWNetProberFindStats_inlock(
+    IN PCSTR pszDnsDomainName,
+    IN PCSTR pszAddress
+    )
+{
+    PLW_DLINKED_LIST pListEntry = NULL;
+    PLWNET_DC_PROBE_STATS pStats = NULL;
+
+    for (pListEntry = gLWNetDcProber.pStatsList;
+         pListEntry;
+         pListEntry = pListEntry->pNext)
+    {
+        pStats = (PLWNET_DC_PROBE_STATS)pListEntry->pItem;
+        if (!strcmp(pStats->pszAddress, pszAddress) &&
+            !strcasecmp(pStats->pszDnsDomainName, pszDnsDomainName))
+        {
+            return pStats;
+        }
+    }
+
+    return NULL;
+}
+
+static
+VOID
+LWNetProberFreeStats(
+    IN PVOID pData,
+    IN PVOID pContext
+    )
+{
+    PLWNET_DC_PROBE_STATS pStats = (PLWNET_DC_PROBE_STATS)pData;
+
+    LWNET_SAFE_FREE_STRING(pStats->pszDnsDomainName);
+    LWNET_SAFE_FREE_STRING(pStats->pszAddress);
+    LWNET_SAFE_FREE_DC_INFO(pStats->pDcInfo);
+    LWNET_SAFE_FREE_MEMORY(pStats);
+}
+
+static
+DWORD
+LWNetProberGetStats_inlock(
+    IN PCSTR pszDnsDomainName,
+    IN PCSTR pszAddress,
+    OUT PLWNET_DC_PROBE_STATS* ppStats
+    )
+{
+    DWORD dwError = 0;
+    PLWNET_DC_PROBE_STATS pStats = NULL;
+
+    pStats = LWNetProberFindStats_inlock(pszDnsDomainName, pszAddress);
+    if (!pStats)
+    {
+        dwError = LWNetAllocateMemory(sizeof(*pStats), (PVOID*)&pStats);
+        BAIL_ON_LWNET_ERROR(dwError);
+
+        dwError = LWNetAllocateString(pszDnsDomainName, &pStats->pszDnsDomainName);
+        BAIL_ON_LWNET_ERROR(dwError);
+
+        dwError = LWNetAllocateString(pszAddress, &pStats->pszAddress);
+        BAIL_ON_LWNET_ERROR(dwError);
+
+        dwError = LwDLinkedListAppend(&gLWNetDcProber.pStatsList, pStats);
+        BAIL_ON_LWNET_ERROR(dwError);
+    }
+
+    *ppStats = pStats;
+
+cleanup:
+    return dwError;
+
+error:
+    if (pStats)
+    {
+        LWNetProberFreeStats(pStats, NULL);
+    }
+    *ppStats = NULL;
+    goto cleanup;
+}
+
+static
+VOID
+LWNetProberRecordResult(
+    IN PCSTR pszDnsDomainName,
+    IN PCSTR pszAddress,
+    IN OPTIONAL PLWNET_DC_INFO pDcInfo,
+    IN LWNET_UNIX_TIME_T Now
+    )
+{
+    DWORD dwError = 0;
+    PLWNET_DC_PROBE_STATS pStats = NULL;
+    PLWNET_DC_INFO pCopy = NULL;
+
+    if (pDcInfo)
+    {
+        dwError = LWNetProberCopyDcInfo(pDcInfo, &pCopy);
+        BAIL_ON_LWNET_ERROR(dwError);
+    }
+
+    pthread_mutex_lock(&gLWNetDcProber.Mutex);
+
+    dwError = LWNetProberGetStats_inlock(pszDnsDomainName, pszAddress, &pStats);
+    if (dwError)
+    {
+        pthread_mutex_unlock(&gLWNetDcProber.Mutex);
+        BAIL_ON_LWNET_ERROR(dwError);
+    }
+
+    pStats->dwProbeCount++;
+    pStats->LastProbed = Now;
+
+    if (pCopy)
+    {
+        if (pStats->dwProbeCount - pStats->dwFailureCount == 1)
+        {
+            pStats->dwAverageRttMs = pCopy->dwPingTime;
+        }
+        else
+        {
+            pStats->dwAverageRttMs =
+                (DWORD)((LONG64)pStats->dwAverageRttMs +
+                        ((LONG64)pCopy->dwPingTime - (LONG64)pStats->dwAverageRttMs) / 8);
+        }
+        pStats->dwLastRttMs = pCopy->dwPingTime;
+        pStats->dwConsecutiveFailures = 0;
+
+        LWNET_SAFE_FREE_DC_INFO(pStats->pDcInfo);
+        pStats->pDcInfo = pCopy;
+        pCopy = NULL;
+    }
+    else
+    {
+        pStats->dwFailureCount++;
+        pStats->dwConsecutiveFailures++;
+        pStats->LastFailure = Now;
+    }
+
+    LWNET_LOG_VERBOSE("DC %s (%s): %s, rtt %u ms (avg %u ms), %u of %u probes failed",
+            pszAddress,
+            pszDnsDomainName,
+            pStats->dwConsecutiveFailures ? "unreachable" : "reachable",
+            pStats->dwLastRttMs,
+            pStats->dwAverageRttMs,
+            pStats->dwFailureCount,
+            pStats->dwProbeCount);
+
+    pthread_mutex_unlock(&gLWNetDcProber.Mutex);
+
+error:
+    LWNET_SAFE_FREE_DC_INFO(pCopy);
+}
+
+static
+VOID
+LWNetProberExpireStats(
+    IN LWNET_UNIX_TIME_T Now,
+    IN DWORD dwIntervalSeconds
+    )
+{
+    PLW_DLINKED_LIST pListEntry = NULL;
+    PLW_DLINKED_LIST pNextEntry = NULL;
+    PLWNET_DC_PROBE_STATS pStats = NULL;
+    LWNET_UNIX_TIME_T maxAge = (LWNET_UNIX_TIME_T)dwIntervalSeconds *
+                                   LWNET_DC_PROBE_STATS_EXPIRY_INTERVALS;
+
+    pthread_mutex_lock(&gLWNetDcProber.Mutex);
+
+    for (pListEntry = gLWNetDcProber.pStatsList;
+         pListEntry;
+         pListEntry = pNextEntry)
+    {
+        pNextEntry = pListEntry->pNext;
+        pStats = (PLWNET_DC_PROBE_STATS)pListEntry->pItem;
+
+        // No longer affinitized or listed as a candidate
+        if ((Now - pStats->LastProbed) > maxAge)
+        {
+            LwDLinkedListDelete(&gLWNetDcProber.pStatsList, pStats);
+            LWNetProberFreeStats(pStats, NULL);
+        }
+    }
+
+    pthread_mutex_unlock(&gLWNetDcProber.Mutex);
+}
+
+static
+BOOLEAN
+LWNetProberIsInList(
+    IN PCSTR pszAddress,
+    IN DWORD dwCount,
+    IN PSTR* ppszList
+    )
+{
+    DWORD i = 0;
+
+    for (i = 0; i < dwCount; i++)
+    {
+        if (ppszList[i] && !strcmp(ppszList[i], pszAddress))
+        {
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+/*
+ * Picks the DC with the lowest smoothed round trip time among those whose
+ * last ping, no older than dwMaxAgeSeconds, succeeded and satisfied
+ * dwDsFlags (and pszSiteName, if given).
+ */
+static
+DWORD
+LWNetProberFindCandidate_inlock(
+    IN PCSTR pszDnsDomainName,
+    IN OPTIONAL PCSTR pszSiteName,
+    IN DWORD dwDsFlags,
+    IN LWNET_UNIX_TIME_T Now,
+    IN DWORD dwMaxAgeSeconds,
+    IN DWORD dwSkipCount,
+    IN PSTR* ppszSkipList,
+    OUT PLWNET_DC_INFO* ppDcInfo
+    )
+{
+    DWORD dwError = 0;
+    PLW_DLINKED_LIST pListEntry = NULL;
+    PLWNET_DC_PROBE_STATS pStats = NULL;
+    PLWNET_DC_PROBE_STATS pBest = NULL;
+    PLWNET_DC_INFO pDcInfo = NULL;
+
+    for (pListEntry = gLWNetDcProber.pStatsList;
+         pListEntry;
+         pListEntry = pListEntry->pNext)
+    {
+        pStats = (PLWNET_DC_PROBE_STATS)pListEntry->pItem;
+
+        if (!pStats->pDcInfo ||
+            pStats->dwConsecutiveFailures ||
+            (Now - pStats->LastProbed) > dwMaxAgeSeconds ||
+            strcasecmp(pStats->pszDnsDomainName, pszDnsDomainName) ||
+            !LWNetSrvIsMatchingDcInfo(pStats->pDcInfo, dwDsFlags) ||
+            LWNetProberIsInList(pStats->pszAddress, dwSkipCount, ppszSkipList))
+        {
+            continue;
+        }
+
+        if (!LW_IS_NULL_OR_EMPTY_STR(pszSiteName) &&
+            (!pStats->pDcInfo->pszDCSiteName ||
+             strcasecmp(pStats->pDcInfo->pszDCSiteName, pszSiteName)))
+        {
+            continue;
+        }
+
+        if (!pBest || pStats->dwAverageRttMs < pBest->dwAverageRttMs)
+        {
+            pBest = pStats;
+        }
+    }
+
+    if (!pBest)
+    {
+        dwError = ERROR_NOT_FOUND;
+        BAIL_ON_LWNET_ERROR(dwError);
+    }
+
+    dwError = LWNetProberCopyDcInfo(pBest->pDcInfo, &pDcInfo);
+    BAIL_ON_LWNET_ERROR(dwError);
+
+    pDcInfo->dwPingTime = pBest->dwLastRttMs;
+
+error:
+    *ppDcInfo = pDcInfo;
+
+    return dwError;
+}
+
+static
+DWORD
+LWNetProberQueryTypeToFlags(
+    IN PLWNET_CACHE_DB_ENTRY pEntry
+    )
+{
+    DWORD dwDsFlags = 0;
+
+    switch (pEntry->QueryType)
+    {
+        case LWNET_CACHE_DB_QUERY_TYPE_GC:
+            dwDsFlags = DS_GC_SERVER_REQUIRED;
+            break;
+        case LWNET_CACHE_DB_QUERY_TYPE_PDC:
+            dwDsFlags = DS_PDC_REQUIRED;
+            break;
+    }
+
+    if (pEntry->IsBackoffToWritableDc)
+    {
+        dwDsFlags |= DS_WRITABLE_REQUIRED;
+    }
+
+    return dwDsFlags;
+}
+
+static
+PCSTR
+LWNetProberSkipBackslashes(
+    IN PCSTR pszName
+    )
+{
+    while (pszName && pszName[0] == '\\')
+    {
+        pszName++;
+    }
+    return pszName;
+}
+
+/*
+ * Pings one DC and records the outcome.  No flags are required of the
+ * reply, so a live DC is never counted as failed for lacking a role;
+ * whether it can serve a given request is checked when it is picked.
+ */
+static
+DWORD
+LWNetProberPing(
+    IN PCSTR pszDnsDomainName,
+    IN PDNS_SERVER_INFO pServerInfo,
+    IN DWORD dwTimeoutSeconds,
+    OUT OPTIONAL PLWNET_DC_INFO* ppDcInfo
+    )
+{
+    DWORD dwError = 0;
+    DNS_SERVER_INFO serverInfo = { 0 };
+    PLWNET_DC_INFO pDcInfo = NULL;
+    BOOLEAN bFailedFindWritable = FALSE;
+    LWNET_UNIX_TIME_T now = 0;
+
+    serverInfo.pszName = (PSTR)LWNetProberSkipBackslashes(pServerInfo->pszName);
+    serverInfo.pszAddress = (PSTR)LWNetProberSkipBackslashes(pServerInfo->pszAddress);
+
+    dwError = LWNetSrvPingCLdapArray(
+                    pszDnsDomainName,
+                    0,
+                    &serverInfo, 1,
+                    dwTimeoutSeconds,
+                    &pDcInfo,
+                    &bFailedFindWritable);
+
+    // Only fails if the clock cannot be read
+    LWNetGetSystemTime(&now);
+
+    LWNetProberRecordResult(
+        pszDnsDomainName,
+        serverInfo.pszAddress,
+        dwError ? NULL : pDcInfo,
+        now);
+
+    if (ppDcInfo)
+    {
+        *ppDcInfo = pDcInfo;
+        pDcInfo = NULL;
+    }
+
+    LWNET_SAFE_FREE_DC_INFO(pDcInfo);
+
+    return dwError;
+}
+
+static
+VOID
+LWNetProberProbeCandidates(
+    IN PLWNET_CACHE_DB_ENTRY pEntry,
+    IN PDNS_SERVER_INFO pServerArray,
+    IN DWORD dwServerCount,
+    IN DWORD dwIntervalSeconds
+    )
+{
+    DWORD i = 0;
+    DWORD dwProbed = 0;
+    PCSTR pszAffinitized = LWNetProberSkipBackslashes(
+                                pEntry->DcInfo.pszDomainControllerAddress);
+    PLWNET_DC_PROBE_STATS pStats = NULL;
+    BOOLEAN bRecent = FALSE;
+    BOOLEAN bShutdown = FALSE;
+    LWNET_UNIX_TIME_T now = 0;
+
+    for (i = 0;
+         i < dwServerCount && dwProbed < LWNET_DC_PROBE_MAX_CANDIDATES;
+         i++)
+    {
+        if (LW_IS_NULL_OR_EMPTY_STR(pServerArray[i].pszAddress) ||
+            (pszAffinitized && !strcmp(pServerArray[i].pszAddress, pszAffinitized)))
+        {
+            continue;
+        }
+
+        LWNetGetSystemTime(&now);
+
+        // Already pinged this round on behalf of another cache entry
+        pthread_mutex_lock(&gLWNetDcProber.Mutex);
+        pStats = LWNetProberFindStats_inlock(pEntry->pszDnsDomainName,
+                                             pServerArray[i].pszAddress);
+        bRecent = pStats && (now - pStats->LastProbed) < dwIntervalSeconds;
+        bShutdown = gLWNetDcProber.bShutdown;
+        pthread_mutex_unlock(&gLWNetDcProber.Mutex);
+
+        if (bShutdown)
+        {
+            break;
+        }
+        else if (bRecent)
+        {
+            continue;
+        }
+
+        LWNetProberPing(
+            pEntry->pszDnsDomainName,
+            &pServerArray[i],
+            LWNET_DC_PROBE_CANDIDATE_TIMEOUT_SECONDS,
+            NULL);
+        dwProbed++;
+    }
+}
+
+/*
+ * Switches a cache entry whose DC stopped answering to another DC and
+ * updates the cache (and krb5) the same way LWNetSrvGetDCName does after
+ * discovery.  A candidate that answered the prober recently is used if
+ * there is one; otherwise discovery is run, skipping recently failed DCs.
+ */
+static
+DWORD
+LWNetProberReaffinitize(
+    IN PLWNET_CACHE_DB_ENTRY pEntry,
+    IN DWORD dwDsFlags,
+    IN PDNS_SERVER_INFO pServerArray,
+    IN DWORD dwServerCount,
+    IN LWNET_UNIX_TIME_T Now
+    )
+{
+    DWORD dwError = 0;
+    PSTR ppszSkipList[LWNET_DC_PROBE_MAX_SKIPPED] = { 0 };
+    DWORD dwSkipCount = 0;
+    PLW_DLINKED_LIST pListEntry = NULL;
+    PLWNET_DC_PROBE_STATS pStats = NULL;
+    PLWNET_DC_INFO pDcInfo = NULL;
+    PDNS_SERVER_INFO pDiscoveredServerArray = NULL;
+    DWORD dwDiscoveredServerCount = 0;
+    BOOLEAN bFailedFindWritable = FALSE;
+    PCSTR pszSiteName = NULL;
+
+    pszSiteName = LW_IS_NULL_OR_EMPTY_STR(pEntry->pszSiteName) ?
+                        NULL : pEntry->pszSiteName;
+
+    pthread_mutex_lock(&gLWNetDcProber.Mutex);
+
+    dwError = LWNetProberFindCandidate_inlock(
+                    pEntry->pszDnsDomainName,
+                    pszSiteName,
+                    dwDsFlags,
+                    Now,
+                    LWNetConfigGetPingAgainTimeoutSeconds(),
+                    0,
+                    NULL,
+                    &pDcInfo);
+    if (dwError == ERROR_NOT_FOUND)
+    {
+        // Skip DCs whose last probe failed within the ping again window
+        for (pListEntry = gLWNetDcProber.pStatsList;
+             pListEntry && dwSkipCount < LWNET_DC_PROBE_MAX_SKIPPED;
+             pListEntry = pListEntry->pNext)
+        {
+            pStats = (PLWNET_DC_PROBE_STATS)pListEntry->pItem;
+            if (pStats->dwConsecutiveFailures &&
+                (Now - pStats->LastFailure) <= LWNetConfigGetPingAgainTimeoutSeconds())
+            {
+                ppszSkipList[dwSkipCount++] = pStats->pszAddress;
+            }
+        }
+    }
+
+    pthread_mutex_unlock(&gLWNetDcProber.Mutex);
+
+    if (dwError == ERROR_NOT_FOUND)
+    {
+        dwError = LWNetSrvGetDCNameDiscover(
+                        pEntry->pszDnsDomainName,
+                        pszSiteName,
+                        NULL,
+                        dwDsFlags,
+                        dwSkipCount,
+                        ppszSkipList,
+                        &pDcInfo,
+                        &pDiscoveredServerArray,
+                        &dwDiscoveredServerCount,
+                        &bFailedFindWritable);
+        BAIL_ON_LWNET_ERROR(dwError);
+
+        pServerArray = pDiscoveredServerArray;
+        dwServerCount = dwDiscoveredServerCount;
+
+        LWNetProberRecordResult(
+            pEntry->pszDnsDomainName,
+            pDcInfo->pszDomainControllerAddress,
+            pDcInfo,
+            Now);
+    }
+    BAIL_ON_LWNET_ERROR(dwError);
+
+    LWNET_LOG_INFO("Re-affinitized domain '%s', site '%s' from DC %s to %s",
+            pEntry->pszDnsDomainName,
+            LWNET_SAFE_LOG_STRING(pszSiteName),
+            pEntry->DcInfo.pszDomainControllerAddress,
+            pDcInfo->pszDomainControllerAddress);
+
+    dwError = LWNetCacheUpdate(
+                    pEntry->pszDnsDomainName,
+                    pEntry->pszSiteName,
+                    dwDsFlags,
+                    Now,
+                    Now,
+                    bFailedFindWritable,
+                    bFailedFindWritable ? Now : 0,
+                    pDcInfo);
+    BAIL_ON_LWNET_ERROR(dwError);
+
+    if (LWNetIsUpdateKrb5AffinityEnabled(dwDsFlags, pszSiteName, pDcInfo))
+    {
+        dwError = LWNetKrb5UpdateAffinity(
+                        pEntry->pszDnsDomainName,
+                        pDcInfo,
+                        pServerArray,
+                        dwServerCount);
+        BAIL_ON_LWNET_ERROR(dwError);
+    }
+
+error:
+    LWNET_SAFE_FREE_DC_INFO(pDcInfo);
+    LWNET_SAFE_FREE_MEMORY(pDiscoveredServerArray);
+
+    return dwError;
+}
+
+static
+DWORD
+LWNetProberProbeEntry(
+    IN PLWNET_CACHE_DB_ENTRY pEntry,
+    IN DWORD dwIntervalSeconds
+    )
+{
+    DWORD dwError = 0;
+    DWORD dwDsFlags = LWNetProberQueryTypeToFlags(pEntry);
+    PCSTR pszSiteName = NULL;
+    DNS_SERVER_INFO serverInfo = { 0 };
+    PDNS_SERVER_INFO pServerArray = NULL;
+    DWORD dwServerCount = 0;
+    PLWNET_DC_INFO pNewDcInfo = NULL;
+    LWNET_UNIX_TIME_T now = 0;
+
+    pszSiteName = LW_IS_NULL_OR_EMPTY_STR(pEntry->pszSiteName) ?
+                        NULL : pEntry->pszSiteName;
+
+    // The candidates are the DCs discovery would consider for this entry
+    dwError = LWNetDnsSrvQuery(
+                    pEntry->pszDnsDomainName,
+                    pszSiteName,
+                    dwDsFlags,
+                    &pServerArray,
+                    &dwServerCount);
+    if (dwError)
+    {
+        LWNET_LOG_VERBOSE("Could not list candidate DCs for domain '%s' (error %u)",
+                pEntry->pszDnsDomainName,
+                dwError);
+        dwError = 0;
+    }
+
+    LWNetProberProbeCandidates(pEntry, pServerArray, dwServerCount, dwIntervalSeconds);
+
+    dwError = LWNetGetSystemTime(&now);
+    BAIL_ON_LWNET_ERROR(dwError);
+
+    // Recently pinged by a caller or by the entry for the DC's own site
+    if ((now - pEntry->LastPinged) < dwIntervalSeconds)
+    {
+        goto error;
+    }
+
+    serverInfo.pszName = pEntry->DcInfo.pszDomainControllerName;
+    serverInfo.pszAddress = pEntry->DcInfo.pszDomainControllerAddress;
+
+    dwError = LWNetProberPing(pEntry->pszDnsDomainName, &serverInfo, 0, &pNewDcInfo);
+
+    LWNetGetSystemTime(&now);
+
+    if (!dwError && !LWNetSrvIsMatchingDcInfo(pNewDcInfo, dwDsFlags))
+    {
+        // Still answering, but no longer in the role this entry needs
+        dwError = LW_ERROR_NO_SUCH_OBJECT;
+    }
+
+    if (dwError)
+    {
+        LWNET_LOG_WARNING("DC %s for domain '%s' did not answer a background "
+                "ping as required (error %u); switching to another DC",
+                pEntry->DcInfo.pszDomainControllerAddress,
+                pEntry->pszDnsDomainName,
+                dwError);
+
+        dwError = LWNetProberReaffinitize(
+                        pEntry,
+                        dwDsFlags,
+                        pServerArray,
+                        dwServerCount,
+                        now);
+        BAIL_ON_LWNET_ERROR(dwError);
+    }
+    else
+    {
+        // Keep the discovery and writable backoff times so the usual
+        // rediscovery rules still apply
+        dwError = LWNetCacheUpdate(
+                        pEntry->pszDnsDomainName,
+                        pEntry->pszSiteName,
+                        dwDsFlags,
+                        pEntry->LastDiscovered,
+                        now,
+                        pEntry->IsBackoffToWritableDc,
+                        pEntry->LastBackoffToWritableDc,
+                        pNewDcInfo);
+        BAIL_ON_LWNET_ERROR(dwError);
+    }
+
+error:
+    LWNET_SAFE_FREE_DC_INFO(pNewDcInfo);
+    LWNET_SAFE_FREE_MEMORY(pServerArray);
+
+    return dwError;
+}
+
+static
+VOID
+LWNetProberRunOnce(
+    IN DWORD dwIntervalSeconds
+    )
+{
+    DWORD dwError = 0;
+    PLWNET_CACHE_DB_ENTRY pEntries = NULL;
+    DWORD dwCount = 0;
+    DWORD i = 0;
+    LWNET_UNIX_TIME_T now = 0;
+
+    dwError = LWNetCacheExport(&pEntries, &dwCount);
+    BAIL_ON_LWNET_ERROR(dwError);
+
+    for (i = 0; i < dwCount; i++)
+    {
+        if (LW_IS_NULL_OR_EMPTY_STR(pEntries[i].DcInfo.pszDomainControllerAddress))
+        {
+            continue;
+        }
+
+        dwError = LWNetProberProbeEntry(&pEntries[i], dwIntervalSeconds);
+        if (dwError)
+        {
+            LWNET_LOG_ERROR("Background probe for domain '%s' failed (error %u); "
+                    "the next request will rediscover",
+                    pEntries[i].pszDnsDomainName,
+                    dwError);
+            dwError = 0;
+        }
+
+        pthread_mutex_lock(&gLWNetDcProber.Mutex);
+        if (gLWNetDcProber.bShutdown)
+        {
+            i = dwCount;
+        }
+        pthread_mutex_unlock(&gLWNetDcProber.Mutex);
+    }
+
+    dwError = LWNetGetSystemTime(&now);
+    BAIL_ON_LWNET_ERROR(dwError);
+
+    LWNetProberExpireStats(now, dwIntervalSeconds);
+
+error:
+    LWNetCacheDbFreeEntries(pEntries, dwCount);
+}
+
+static
+PVOID
+LWNetProberThreadRoutine(
+    IN PVOID pUnused
+    )
+{
+    DWORD dwIntervalSeconds = 0;
+    struct timespec wakeTime = { 0 };
+
+    LWNET_LOG_INFO("DC prober thread started");
+
+    pthread_mutex_lock(&gLWNetDcProber.Mutex);
+
+    while (!gLWNetDcProber.bShutdown)
+    {
+        // Re-read on each pass so configuration refreshes take effect.
+        // Entries must be refreshed well before LWNetSrvGetDCName would
+        // consider them stale and ping inline.
+        dwIntervalSeconds = LW_MIN(
+                                LWNetConfigGetDcProbeIntervalSeconds(),
+                                LWNetConfigGetPingAgainTimeoutSeconds() / 2);
+
+        wakeTime.tv_sec = time(NULL) +
+            (dwIntervalSeconds ? dwIntervalSeconds : LWNET_DC_PROBE_DISABLED_RECHECK_SECONDS);
+        wakeTime.tv_nsec = 0;
+
+        while (!gLWNetDcProber.bShutdown &&
+               pthread_cond_timedwait(
+                    &gLWNetDcProber.Wakeup,
+                    &gLWNetDcProber.Mutex,
+                    &wakeTime) != ETIMEDOUT)
+        {
+        }
+
+        if (gLWNetDcProber.bShutdown || !dwIntervalSeconds)
+        {
+            continue;
+        }
+
+        pthread_mutex_unlock(&gLWNetDcProber.Mutex);
+
+        LWNetProberRunOnce(dwIntervalSeconds);
+
+        pthread_mutex_lock(&gLWNetDcProber.Mutex);
+    }
+
+    pthread_mutex_unlock(&gLWNetDcProber.Mutex);
+
+    LWNET_LOG_INFO("DC prober thread stopped");
+
+    return NULL;
+}
+
+DWORD
+LWNetSrvStartDcProber(
+    VOID
+    )
+{
+    DWORD dwError = 0;
+
+    dwError = LwErrnoToWin32Error(pthread_create(
+                    &gLWNetDcProber.Thread,
+                    NULL,
+                    LWNetProberThreadRoutine,
+                    NULL));
+    BAIL_ON_LWNET_ERROR(dwError);
+
+    gLWNetDcProber.bStarted = TRUE;
+
+error:
+    return dwError;
+}
+
+VOID
+LWNetSrvStopDcProber(
+    VOID
+    )
+{
+    if (!gLWNetDcProber.bStarted)
+    {
+        return;
+    }
+
+    pthread_mutex_lock(&gLWNetDcProber.Mutex);
+    gLWNetDcProber.bShutdown = TRUE;
+    pthread_cond_signal(&gLWNetDcProber.Wakeup);
+    pthread_mutex_unlock(&gLWNetDcProber.Mutex);
+
+    pthread_join(gLWNetDcProber.Thread, NULL);
+    gLWNetDcProber.bStarted = FALSE;
+
+    pthread_mutex_lock(&gLWNetDcProber.Mutex);
+    gLWNetDcProber.bShutdown = FALSE;
+    LwDLinkedListForEach(
+        gLWNetDcProber.pStatsList,
+        LWNetProberFreeStats,
+        NULL);
+    LwDLinkedListFree(gLWNetDcProber.pStatsList);
+    gLWNetDcProber.pStatsList = NULL;
+    pthread_mutex_unlock(&gLWNetDcProber.Mutex);
+}
+
+BOOLEAN
+LWNetSrvGetDcProbeResult(
+    IN PCSTR pszDnsDomainName,
+    IN PCSTR pszAddress,
+    IN LWNET_UNIX_TIME_T Now,
+    IN DWORD dwMaxAgeSeconds,
+    OUT PBOOLEAN pbReachable,
+    OUT PLWNET_UNIX_TIME_T pLastProbed
+    )
+{
+    PLWNET_DC_PROBE_STATS pStats = NULL;
+    BOOLEAN bFound = FALSE;
+
+    *pbReachable = FALSE;
+    *pLastProbed = 0;
+
+    if (!LWNetConfigGetDcProbeIntervalSeconds())
+    {
+        return FALSE;
+    }
+
+    pthread_mutex_lock(&gLWNetDcProber.Mutex);
+
+    pStats = LWNetProberFindStats_inlock(
+                    pszDnsDomainName,
+                    LWNetProberSkipBackslashes(pszAddress));
+    if (pStats && (Now - pStats->LastProbed) <= dwMaxAgeSeconds)
+    {
+        bFound = TRUE;
+        *pbReachable = pStats->dwConsecutiveFailures ? FALSE : TRUE;
+        *pLastProbed = pStats->LastProbed;
+    }
+
+    pthread_mutex_unlock(&gLWNetDcProber.Mutex);
+
+    return bFound;
+}
+
+DWORD
+LWNetSrvGetDcProbeCandidate(
+    IN PCSTR pszDnsDomainName,
+    IN OPTIONAL PCSTR pszSiteName,
+    IN DWORD dwDsFlags,
+    IN LWNET_UNIX_TIME_T Now,
+    IN DWORD dwMaxAgeSeconds,
+    IN DWORD dwSkipCount,
+    IN PSTR* ppszSkipList,
+    OUT PLWNET_DC_INFO* ppDcInfo
+    )
+{
+    DWORD dwError = 0;
+
+    pthread_mutex_lock(&gLWNetDcProber.Mutex);
+
+    dwError = LWNetProberFindCandidate_inlock(
+                    pszDnsDomainName,
+                    pszSiteName,
+                    dwDsFlags,
+                    Now,
+                    dwMaxAgeSeconds,
+                    dwSkipCount,
+                    ppszSkipList,
+                    ppDcInfo);
+
+    pthread_mutex_unlock(&gLWNetDcProber.Mutex);
+
+    return dwError;
+}
@@ -0,0 +1,83 @@
+/* Editor Settings: expandtabs and use 4 spaces for indentation
+ * ex: set softtabstop=4 tabstop=8 expandtab shiftwidth=4: *
+ * -*- mode: c, c-basic-offset: 4 -*- */
+
+/*
+ * Copyright © BeyondTrust Software 2004 - 2019
+ * All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * BEYONDTRUST MAKES THIS SOFTWARE AVAILABLE UNDER OTHER LICENSING TERMS AS
+ * WELL. IF YOU HAVE ENTERED INTO A SEPARATE LICENSE AGREEMENT WITH
+ * BEYONDTRUST, THEN YOU MAY ELECT TO USE THE SOFTWARE UNDER THE TERMS OF THAT
+ * SOFTWARE LICENSE AGREEMENT INSTEAD OF THE TERMS OF THE APACHE LICENSE,
+ * NOTWITHSTANDING THE ABOVE NOTICE.  IF YOU HAVE QUESTIONS, OR WISH TO REQUEST
+ * A COPY OF THE ALTERNATE LICENSING TERMS OFFERED BY BEYONDTRUST, PLEASE CONTACT
+ * BEYONDTRUST AT beyondtrust.com/contact
+ */
+
+/*
+ * Copyright (C) BeyondTrust Software. All rights reserved.
+ *
+ * Module Name:
+ *
+ *        lwnet-prober_p.h
+ *
+ * Abstract:
+ *
+ *        BeyondTrust Site Manager
+ *
+ *        Background Domain Controller Prober
+ *
+ */
+#ifndef __LWNET_PROBER_P_H__
+#define __LWNET_PROBER_P_H__
+
+DWORD
+LWNetSrvStartDcProber(
+    VOID
+    );
+
+VOID
+LWNetSrvStopDcProber(
+    VOID
+    );
+
+// Returns TRUE if the prober pinged the DC within dwMaxAgeSeconds, with
+// the outcome in *pbReachable.
+BOOLEAN
+LWNetSrvGetDcProbeResult(
+    IN PCSTR pszDnsDomainName,
+    IN PCSTR pszAddress,
+    IN LWNET_UNIX_TIME_T Now,
+    IN DWORD dwMaxAgeSeconds,
+    OUT PBOOLEAN pbReachable,
+    OUT PLWNET_UNIX_TIME_T pLastProbed
+    );
+
+// Returns the fastest DC that answered the prober within dwMaxAgeSeconds
+// and satisfies dwDsFlags and pszSiteName, or ERROR_NOT_FOUND.
+DWORD
+LWNetSrvGetDcProbeCandidate(
+    IN PCSTR pszDnsDomainName,
+    IN OPTIONAL PCSTR pszSiteName,
+    IN DWORD dwDsFlags,
+    IN LWNET_UNIX_TIME_T Now,
+    IN DWORD dwMaxAgeSeconds,
+    IN DWORD dwSkipCount,
+    IN PSTR* ppszSkipList,
+    OUT PLWNET_DC_INFO* ppDcInfo
+    );
+
+#endif /* __LWNET_PROBER_P_H__ */
@@ -61,6 +61,7 @@ typedef struct _LWNET_SERVER_CONFIG {
     DWORD dwCLdapSearchTimeoutSeconds;
     DWORD dwCLdapSingleConnectionTimeoutSeconds;
     DWORD dwNetBiosUdpTimeout;
+    DWORD dwDcProbeIntervalSeconds;
     PSTR pszWinsPrimaryServer;
     PSTR pszWinsSecondaryServer;
     PSTR pszResolveNameOrder;
@@ -73,6 +74,8 @@ typedef struct _LWNET_SERVER_CONFIG {
 #define LWNET_WRITABLE_REDISCOVERY_TIMEOUT_SECONDS (30 * 60)
 #define LWNET_WRITABLE_TIMESTAMP_MINIMUM_CHANGE_SECONDS (0 * 60)
 
+#define LWNET_DC_PROBE_INTERVAL_SECONDS (1 * 60)
+
 LWNET_SERVER_CONFIG gLWNetServerConfig = {
     .pszPluginPath = NULL,
     .dwPingAgainTimeoutSeconds = LWNET_PING_AGAIN_TIMEOUT_SECONDS,
@@ -83,6 +86,7 @@ LWNET_SERVER_CONFIG gLWNetServerConfig = {
     .dwCLdapSearchTimeoutSeconds = LWNET_CLDAP_DEFAULT_TIMEOUT_SECONDS,
     .dwCLdapSingleConnectionTimeoutSeconds = LWNET_CLDAP_DEFAULT_TIMEOUT_SECONDS,
     .dwNetBiosUdpTimeout = 2,
+    .dwDcProbeIntervalSeconds = LWNET_DC_PROBE_INTERVAL_SECONDS,
     .pszBlacklistDCList = NULL
 };
 
@@ -195,6 +199,16 @@ LWNetSrvReadRegistry()
             &StagingConfig.dwNetBiosUdpTimeout,
             NULL
         },
+        {
+            "DcProbeInterval",
+            TRUE,
+            LwRegTypeDword,
+            0,
+            3600,
+            NULL,
+            &StagingConfig.dwDcProbeIntervalSeconds,
+            NULL
+        },
         {
             "NetBiosWinsPrimary",
             TRUE,
@@ -271,6 +285,7 @@ LWNetSrvReadRegistry()
     gLWNetServerConfig.dwCLdapSearchTimeoutSeconds = StagingConfig.dwCLdapSearchTimeoutSeconds;
     gLWNetServerConfig.dwCLdapSingleConnectionTimeoutSeconds = StagingConfig.dwCLdapSingleConnectionTimeoutSeconds;
     gLWNetServerConfig.dwNetBiosUdpTimeout = StagingConfig.dwNetBiosUdpTimeout;
+    gLWNetServerConfig.dwDcProbeIntervalSeconds = StagingConfig.dwDcProbeIntervalSeconds;
 
     dwError = LWNetAllocateString(StagingConfig.pszWinsPrimaryServer, &gLWNetServerConfig.pszWinsPrimaryServer);
     BAIL_ON_LWNET_ERROR(dwError);
@@ -464,6 +479,14 @@ LWNetConfigIsNetBiosUdpTimeout(
     return gLWNetServerConfig.dwNetBiosUdpTimeout;
 }
 
+DWORD
+LWNetConfigGetDcProbeIntervalSeconds(
+    VOID
+    )
+{
+    return gLWNetServerConfig.dwDcProbeIntervalSeconds;
+}
+
 
 VOID
 LwNetConfigGetWinsServers(
@@ -590,6 +613,7 @@ LWNetSrvApiInitConfig(PLWNET_SERVER_CONFIG pConfig)
     pConfig->dwCLdapSearchTimeoutSeconds = LWNET_CLDAP_DEFAULT_TIMEOUT_SECONDS,
     pConfig->dwCLdapSingleConnectionTimeoutSeconds = LWNET_CLDAP_DEFAULT_TIMEOUT_SECONDS,
     pConfig->dwNetBiosUdpTimeout = 2,
+    pConfig->dwDcProbeIntervalSeconds = LWNET_DC_PROBE_INTERVAL_SECONDS,
 
     pConfig->pszBlacklistDCList = NULL;
     pConfig->pszPluginPath = NULL;
@@ -637,6 +661,9 @@ LWNetSrvRefreshConfiguration(HANDLE hServer)
     dwError = LWNetSrvReadRegistry();
     BAIL_ON_LWNET_ERROR(dwError);
 
+    // A refresh is the administrator's way to pick up DNS changes
+    // before cached answers expire.
+    LWNetDnsCacheFlush();
 
 cleanup:
 
@@ -103,6 +103,11 @@ LWNetConfigIsNetBiosUdpTimeout(
     VOID
     );
 
+DWORD
+LWNetConfigGetDcProbeIntervalSeconds(
+    VOID
+    );
+
 VOID
 LwNetConfigGetWinsServers(
     PSTR *primaryServer,
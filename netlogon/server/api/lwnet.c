@@ -64,208 +64,6 @@ LWNetServerIsInDomain(
     IN PCSTR pszDomainName
     );
 
-static
-DWORD
-LWNetSrvPingCLdapEnd(
-    IN PLWNET_CLDAP_CONNECTION_CONTEXT pContext
-    );
-
-static
-DWORD
-LWNetSrvPingCLdapBegin(
-    IN PLWNET_CLDAP_CONNECTION_CONTEXT pContext,
-    IN PDNS_SERVER_INFO pServerInfo,
-    IN PCSTR pszDnsDomainName,
-    IN DWORD dwTimeout
-    )
-{
-    DWORD dwError = 0;
-    PSTR pszQuery = NULL;
-    PSTR szAttributeList[] = { NETLOGON_LDAP_ATTRIBUTE_NAME, NULL };
-    struct timeval timeout = {0};
-    LDAP *ld = NULL;
-
-    pContext->hDirectory = NULL;
-    pContext->pServerInfo = pServerInfo;
-
-    dwError = LwAllocateStringPrintf(&pszQuery,
-                                        "(&(DnsDomain=%s)(NtVer=\\06\\00\\00\\80))",
-                                        pszDnsDomainName);
-    BAIL_ON_LWNET_ERROR(dwError);
-
-    dwError = LwCLdapOpenDirectory(pServerInfo->pszAddress, &pContext->hDirectory);
-    BAIL_ON_LWNET_ERROR(dwError);
-
-    dwError = LwLdapBindDirectoryAnonymous(pContext->hDirectory);
-    BAIL_ON_LWNET_ERROR(dwError);
-
-    timeout.tv_sec = 0;
-    timeout.tv_usec = dwTimeout;
-
-    dwError = LWNetGetSystemTimeInMs(&pContext->StartTime);
-    BAIL_ON_LWNET_ERROR(dwError);
-
-    ld = LwLdapGetSession(pContext->hDirectory);
-
-    dwError = ldap_search_ext(
-                  ld,
-                  "",
-                  LDAP_SCOPE_BASE,
-                  pszQuery,
-                  szAttributeList,
-                  0,
-                  NULL,
-                  NULL,
-                  &timeout,
-                  0,
-                  &pContext->msgid);
-    dwError = LwMapLdapErrorToLwError(dwError);
-    BAIL_ON_LWNET_ERROR(dwError);
-
-    dwError = ldap_get_option(
-                  ld,
-                  LDAP_OPT_DESC,
-                  &pContext->fd);
-    dwError = LwMapLdapErrorToLwError(dwError);
-    BAIL_ON_LWNET_ERROR(dwError);
-
-error:
-    if (dwError)
-    {
-        if (pContext->hDirectory)
-        {
-            LWNetSrvPingCLdapEnd(pContext);
-        }
-    }
-
-    LWNET_SAFE_FREE_STRING(pszQuery);
-
-    return dwError;
-}
-
-static
-DWORD
-LWNetSrvPingCLdapProcess(
-    IN PLWNET_CLDAP_CONNECTION_CONTEXT pContext,
-    IN DWORD dwDsFlags,
-    IN LWNET_UNIX_MS_TIME_T StopTime,
-    OUT PLWNET_DC_INFO* ppDcInfo,
-    OUT PBOOLEAN pbFailedFindWritable
-    )
-{
-    DWORD dwError = 0;
-    DWORD dwResultType = 0;
-    LDAPMessage* pMessage = NULL;
-    PBYTE pNetlogonAttributeValue = NULL;
-    DWORD dwNetlogonAttributeSize = 0;
-    PLWNET_DC_INFO pDcInfo = NULL;
-    BOOLEAN bFailedFindWritable = FALSE;
-    struct timeval timeout = {0};
-    LDAP *ld = NULL;
-
-    ld = LwLdapGetSession(pContext->hDirectory);
-
-    dwResultType =  ldap_result(
-                        ld,
-                        pContext->msgid,
-                        0,
-                        &timeout,
-                        &pMessage);
-    if (dwResultType == 0)
-    {
-        // timed out
-        goto error;
-    }
-    else if (dwResultType == -1)
-    {
-        // -1 = problem
-        dwError = LDAP_NO_SUCH_OBJECT;
-        LWNET_LOG_VERBOSE("Caught LDAP_NO_SUCH_OBJECT Error on ldap search");
-    }
-    else
-    {
-        // returns result type
-        if (dwResultType != LDAP_RES_SEARCH_ENTRY)
-        {
-            dwError = LDAP_NO_SUCH_OBJECT;
-            LWNET_LOG_DEBUG("Caught incorrect result type on ldap search: %d", dwError);
-        }
-    }
-    dwError = LwMapLdapErrorToLwError(dwError);
-    BAIL_ON_LWNET_ERROR(dwError);
-
-    dwError = LwLdapGetBytes(
-                    pContext->hDirectory,
-                    pMessage,
-                    NETLOGON_LDAP_ATTRIBUTE_NAME,
-                    &pNetlogonAttributeValue,
-                    &dwNetlogonAttributeSize);
-    BAIL_ON_LWNET_ERROR(dwError);
-
-    dwError = LWNetBuildDCInfo(pNetlogonAttributeValue,
-                               dwNetlogonAttributeSize,
-                               &pDcInfo);
-    BAIL_ON_LWNET_ERROR(dwError);
-
-    dwError = LWNetAllocateString(pContext->pServerInfo->pszAddress, &pDcInfo->pszDomainControllerAddress);
-    BAIL_ON_LWNET_ERROR(dwError);
-
-    pDcInfo->dwPingTime = (DWORD)(StopTime - pContext->StartTime);
-    if (StopTime < pContext->StartTime)
-    {
-        LWNET_LOG_ERROR("Stop time is earlier than start time");
-    }
-
-    if (!LWNetSrvIsMatchingDcInfo(pDcInfo, dwDsFlags))
-    {
-        dwError = LW_ERROR_NO_SUCH_OBJECT;
-
-        if (LWNetSrvIsMatchingDcInfo(pDcInfo, dwDsFlags & ~DS_WRITABLE_REQUIRED))
-        {
-            // We found something, but it failed only because it did
-            // not satisfy writability.
-            bFailedFindWritable = TRUE;
-        }
-    }
-
-error:
-    if (pMessage)
-    {
-        ldap_msgfree(pMessage);
-    }
-
-    LWNET_SAFE_FREE_MEMORY(pNetlogonAttributeValue);
-
-    if (dwError)
-    {
-        LWNET_SAFE_FREE_DC_INFO(pDcInfo);
-
-        LWNetSrvPingCLdapEnd(pContext);
-    }
-
-    *ppDcInfo = pDcInfo;
-    *pbFailedFindWritable = bFailedFindWritable;
-
-    return dwError;
-}
-
-static
-DWORD
-LWNetSrvPingCLdapEnd(
-    IN PLWNET_CLDAP_CONNECTION_CONTEXT pContext
-    )
-{
-    DWORD dwError = 0;
-
-    if (pContext->hDirectory)
-    {
-        LwLdapCloseDirectory(pContext->hDirectory);
-        pContext->hDirectory = NULL;
-    }
-
-    return dwError;
-}
-
 BOOLEAN
 LWNetSrvIsMatchingDcInfo(
     IN PLWNET_DC_INFO pDcInfo,
@@ -341,187 +139,6 @@ LWNetSrvIsInSameSite(
     return isInSameSite;
 }
 
-static
-VOID
-LWNetSrvPingCLdapNewConnections(
-    IN PCSTR pszDnsDomainName,
-    IN DWORD dwSingleConnTimeoutMilliseconds,
-    IN DWORD dwMaxConnCount,
-    IN DWORD dwServerCount,
-    IN DWORD dwIncrementalConnCount,
-    IN PDNS_SERVER_INFO pServerArray,
-    IN OUT PLWNET_CLDAP_CONNECTION_CONTEXT pConnections,
-    IN OUT struct pollfd *Readfds,
-    IN OUT DWORD* pdwActualConnCount,
-    IN OUT DWORD* pdwUsedServers
-    )
-{
-    DWORD dwError = 0;
-    DWORD dwNewConn = 0;
-    DWORD dwActualConnCount = *pdwActualConnCount;
-    DWORD dwUsedServers = *pdwUsedServers;
-
-    while (dwNewConn < dwIncrementalConnCount &&
-           dwActualConnCount < dwMaxConnCount &&
-           dwUsedServers < dwServerCount)
-    {
-
-        dwError = LWNetSrvPingCLdapBegin(
-                      &pConnections[dwActualConnCount],
-                      &pServerArray[dwUsedServers],
-                      pszDnsDomainName,
-                      dwSingleConnTimeoutMilliseconds);
-        if (dwError)
-        {
-            dwError = 0;
-        }
-        else
-        {
-            Readfds[dwActualConnCount].fd = pConnections[dwActualConnCount].fd;
-            Readfds[dwActualConnCount].events = POLLIN | POLLERR;
-            pConnections[dwActualConnCount++].pServerInfo = &pServerArray[dwUsedServers];
-            dwNewConn++;
-        }
-        dwUsedServers++;
-    }
-
-    *pdwActualConnCount = dwActualConnCount;
-    *pdwUsedServers = dwUsedServers;
-}
-
-static
-DWORD
-LWNetSrvPingCLdapPoll(
-    IN DWORD dwTimeoutMilliseconds,
-    IN DWORD dwFdCount,
-    IN struct pollfd *Readfds
-    )
-{
-    DWORD dwError = 0;
-    int sret = 0;
-    LWNET_UNIX_MS_TIME_T CurrentTime = 0;
-    LWNET_UNIX_MS_TIME_T StopTime = 0;
-    DWORD dwRemainder = 0;
-
-    dwError = LWNetGetSystemTimeInMs(&StopTime);
-    BAIL_ON_LWNET_ERROR(dwError);
-
-    StopTime += dwTimeoutMilliseconds;
-
-    do
-    {
-        dwError = LWNetGetSystemTimeInMs(&CurrentTime);
-        BAIL_ON_LWNET_ERROR(dwError);
-
-        if (CurrentTime < StopTime)
-        {
-            dwRemainder = StopTime - CurrentTime;
-            sret = poll(Readfds, dwFdCount, dwRemainder);
-        }
-        else
-        {
-            sret = 0;
-        }
-    } while (sret < 0 && errno == EINTR);
-
-    if (sret < 0)
-    {
-        dwError = LwMapErrnoToLwError(errno);
-    }
-    BAIL_ON_LWNET_ERROR(dwError);
-
-error:
-
-    return dwError;
-}
-
-static
-VOID
-LWNetSrvPingCLdapProcessConnections(
-    IN DWORD dwDsFlags,
-    IN LWNET_UNIX_MS_TIME_T CurrentTime,
-    IN DWORD dwSingleConnTimeoutMilliseconds,
-    IN DWORD dwActualConnCount,
-    IN struct pollfd *Readfds,
-    IN OUT PLWNET_CLDAP_CONNECTION_CONTEXT pConnections,
-    OUT PLWNET_DC_INFO* ppDcInfo,
-    OUT PBOOLEAN pbFailedFindWritable
-    )
-{
-    DWORD dwError = 0;
-    DWORD dwIndexConn = dwActualConnCount;
-    BOOLEAN bFailedFindWritable = FALSE;
-    BOOLEAN bFailed = FALSE;
-    PLWNET_DC_INFO pDcInfo = NULL;
-
-    while (dwIndexConn > 0)
-    {
-        dwIndexConn--;
-
-        if (Readfds[dwIndexConn].revents)
-        {
-            dwError = LWNetSrvPingCLdapProcess(
-                          &pConnections[dwIndexConn],
-                          dwDsFlags,
-                          CurrentTime,
-                          &pDcInfo,
-                          &bFailed);
-            bFailedFindWritable = bFailed ? TRUE : bFailedFindWritable;
-            if (dwError)
-            {
-                LWNET_LOG_VERBOSE("CLDAP error: %d, %s", dwError, pConnections[dwIndexConn].pServerInfo->pszName);
-                dwError = 0;
-            }
-            else if (pDcInfo)
-            {
-                break;
-            }
-        } else if (pConnections[dwIndexConn].StartTime + dwSingleConnTimeoutMilliseconds < CurrentTime)
-        {
-            LWNET_LOG_VERBOSE("CLDAP timed out: %s", pConnections[dwIndexConn].pServerInfo->pszName);
-
-            LWNetSrvPingCLdapEnd(&pConnections[dwIndexConn]);
-        }
-    }
-
-    *ppDcInfo = pDcInfo;
-}
-
-static
-DWORD
-LWNetSrvPingCLdapPackArrays(
-    IN DWORD dwConnectionCount,
-    IN PLWNET_CLDAP_CONNECTION_CONTEXT pConnections,
-    IN struct pollfd *Readfds
-    )
-{
-    DWORD dwSourceConn = 0;
-    DWORD dwTargetConn = 0;
-
-    // Eliminate the invalid connections while preserving
-    // the order so that the newest connections remain at
-    // the end of the list.
-    for (dwTargetConn = 0, dwSourceConn = 0 ; 
-         dwSourceConn < dwConnectionCount ;
-         dwSourceConn++)
-    {
-        if (pConnections[dwTargetConn].hDirectory == NULL &&
-            pConnections[dwSourceConn].hDirectory != NULL)
-        {
-            Readfds[dwTargetConn] = Readfds[dwSourceConn];
-            pConnections[dwTargetConn] = pConnections[dwSourceConn];
-            pConnections[dwSourceConn].hDirectory = NULL;
-        }
-
-        if (pConnections[dwTargetConn].hDirectory != NULL)
-        {
-            dwTargetConn++;
-        }
-    }
-
-    return dwTargetConn;
-}
-
 DWORD
 LWNetSrvPingCLdapArray(
     IN PCSTR pszDnsDomainName,
@@ -533,45 +150,15 @@ LWNetSrvPingCLdapArray(
     OUT PBOOLEAN pbFailedFindWritable
     )
 {
-    DWORD dwError = 0;
     DWORD dwMaxConnCount = 0;
     DWORD dwIncrementalConnCount = 0;
     DWORD dwActualTimeoutSeconds = 0;
     DWORD dwSingleConnTimeoutSeconds = 0;
-    DWORD dwSingleConnTimeoutMilliseconds = 0;
-    DWORD dwTimeoutMilliseconds = 0;
-    LWNET_UNIX_MS_TIME_T StopTime = 0;
-    LWNET_UNIX_MS_TIME_T CurrentTime = 0;
-    PLWNET_DC_INFO pDcInfo = NULL;
-    BOOLEAN bFailedFindWritable = FALSE;
-    PLWNET_CLDAP_CONNECTION_CONTEXT pConnections = NULL;
-    DWORD dwActualConnCount = 0;
-    DWORD dwUsedServers = 0;
-    DWORD dwIndexConn = 0;
-    struct pollfd *Readfds = NULL;
-
-    // The basic scheme is a big loop over:
-    //
-    //     1. starting some CLDAP searches
-    //     2. polling for responses
-    //     3. processing responses
-    //
-    // When starting CLDAP searches, a portion of the 
-    // available connections will be started followed
-    // by a short poll until the maximum number of
-    // connections has been used.  Once the maximum
-    // number of connections are in use, the polling
-    // timeout will be the single search timeout for
-    // the oldest connection.  This will start the
-    // maximum number of connections reasonably fast
-    // yet prevent excess network traffic if a server
-    // responds quickly.
-    //
-    // Active connections will be tracked in a list
-    // that is ordered by start time.  If several
-    // servers respond at the same time, the one
-    // nearest the end of the list will be the one
-    // that responded the fastest.
+
+    // A portion of the servers is pinged at a time, with a short
+    // pause between batches, until the maximum number of pings are
+    // outstanding.  This starts the pings reasonably fast yet avoids
+    // pinging every server when one responds quickly.
 
     dwMaxConnCount = CT_MIN(LWNetConfigGetCLdapMaximumConnections(), dwServerCount);
     dwIncrementalConnCount = CT_MAX(dwMaxConnCount / 5, LWNET_CLDAP_MINIMUM_INCREMENTAL_CONNECTIONS);
@@ -586,126 +173,19 @@ LWNetSrvPingCLdapArray(
     }
 
     dwSingleConnTimeoutSeconds = CT_MIN(LWNetConfigGetCLdapSingleConnectionTimeoutSeconds(), dwActualTimeoutSeconds);
-    dwSingleConnTimeoutMilliseconds = dwSingleConnTimeoutSeconds * 1000;
-
-    dwError = LWNetAllocateMemory(
-                  dwMaxConnCount * sizeof(*pConnections),
-                  OUT_PPVOID(&pConnections));
-    BAIL_ON_LWNET_ERROR(dwError);
-
-    dwError = LWNetAllocateMemory(
-                  dwMaxConnCount * sizeof(*Readfds),
-                  OUT_PPVOID(&Readfds));
-    BAIL_ON_LWNET_ERROR(dwError);
-
-    dwError = LWNetGetSystemTimeInMs(&CurrentTime);
-    BAIL_ON_LWNET_ERROR(dwError);
-
-    StopTime = CurrentTime + (dwActualTimeoutSeconds * 1000);
-
-    for (;;)
-    {
-        LWNetSrvPingCLdapNewConnections(
-            pszDnsDomainName,
-            dwSingleConnTimeoutMilliseconds,
-            dwMaxConnCount,
-            dwServerCount,
-            dwIncrementalConnCount,
-            pServerArray,
-            pConnections,
-            Readfds,
-            &dwActualConnCount,
-            &dwUsedServers);
-
-        if (dwActualConnCount == 0)
-        {
-            dwError = NERR_DCNotFound;
-            BAIL_ON_LWNET_ERROR(dwError);
-        }
-
-        dwError = LWNetGetSystemTimeInMs(&CurrentTime);
-        BAIL_ON_LWNET_ERROR(dwError);
-
-        if (CurrentTime > StopTime)
-        {
-            dwError = NERR_DCNotFound;
-            BAIL_ON_LWNET_ERROR(dwError);
-        }
-
-        if (dwActualConnCount < dwMaxConnCount &&
-            dwUsedServers < dwServerCount)
-        {
-            // If there are more connections available,
-            // use a short timeout
-            dwTimeoutMilliseconds = LWNET_CLDAP_SHORT_POLL_TIMEOUT_MILLISECONDS;
-        }
-        else
-        {
-            if (pConnections[0].StartTime +
-                dwSingleConnTimeoutMilliseconds > CurrentTime)
-            {
-                // Use the remaining time for the oldest connection
-                dwTimeoutMilliseconds = pConnections[0].StartTime + 
-                                        dwSingleConnTimeoutMilliseconds -
-                                        CurrentTime;
-                dwTimeoutMilliseconds = CT_MIN(dwSingleConnTimeoutMilliseconds, StopTime - CurrentTime);
-            }
-            else
-            {
-                // The oldest connection has exceeded its limit so
-                // use the shortest possible timeout to check which
-                // connections have responded now.
-                dwTimeoutMilliseconds = 1;
-            }
-        }
-
-        dwError = LWNetSrvPingCLdapPoll(
-                      dwTimeoutMilliseconds,
-                      dwActualConnCount,
-                      Readfds);
-        BAIL_ON_LWNET_ERROR(dwError);
-
-        dwError = LWNetGetSystemTimeInMs(&CurrentTime);
-        BAIL_ON_LWNET_ERROR(dwError);
-
-        LWNetSrvPingCLdapProcessConnections(
-            dwDsFlags,
-            CurrentTime,
-            dwSingleConnTimeoutMilliseconds,
-            dwActualConnCount,
-            Readfds,
-            pConnections,
-            &pDcInfo,
-            &bFailedFindWritable);
-
-        if (pDcInfo)
-        {
-            break;
-        }
-
-        dwActualConnCount = LWNetSrvPingCLdapPackArrays(
-                                dwActualConnCount,
-                                pConnections,
-                                Readfds);
-    }
 
-error:
-    if (pConnections)
-    {
-        for (dwIndexConn = 0 ; dwIndexConn < dwActualConnCount ; dwIndexConn++)
-        {
-            LWNetSrvPingCLdapEnd(&pConnections[dwIndexConn]);
-        }
-        LW_SAFE_FREE_MEMORY(pConnections);
-    }
-    LW_SAFE_FREE_MEMORY(Readfds);
-    if (dwError)
-    {
-        LWNET_SAFE_FREE_DC_INFO(pDcInfo);
-    }
-    *ppDcInfo = pDcInfo;
-    *pbFailedFindWritable = pDcInfo ? FALSE : bFailedFindWritable;
-    return dwError;
+    return LWNetCLdapPingServers(
+                pszDnsDomainName,
+                dwDsFlags,
+                pServerArray,
+                dwServerCount,
+                LWNET_CLDAP_PORT,
+                dwMaxConnCount,
+                dwIncrementalConnCount,
+                dwSingleConnTimeoutSeconds * 1000,
+                dwActualTimeoutSeconds * 1000,
+                ppDcInfo,
+                pbFailedFindWritable);
 }
 
 VOID
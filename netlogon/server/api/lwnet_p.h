@@ -59,33 +59,25 @@ typedef struct _PACKED_ARRAY
 
 #define NETLOGON_LDAP_ATTRIBUTE_NAME "Netlogon"
 
-// CLDAP searches of individual domain controllers are
+// CLDAP pings of individual domain controllers are
 // started in batches of 1/5 the maximum number of
-// connections or the minimum number set here.  The
-// short poll timeout controls how long to wait between
-// batches.  This prevents the entire set of connections
-// from being started in cases where there is a fast
-// response.
+// outstanding pings or the minimum number set here.
+// The short poll timeout controls how long to wait
+// between batches.  This prevents the entire set of
+// servers from being pinged in cases where there is
+// a fast response.
 #define LWNET_CLDAP_SHORT_POLL_TIMEOUT_MILLISECONDS 100
 #define LWNET_CLDAP_MINIMUM_INCREMENTAL_CONNECTIONS 20
 
 // These settings can be overridden by configuration.
 // This timeout is the default for both the entire
-// search and individual domain controller searches.
+// search and individual domain controller pings.
 // The maximum number of connections controls how
-// many domain controllers can be searched 
+// many domain controllers can be pinged
 // simultaneously.
 #define LWNET_CLDAP_DEFAULT_TIMEOUT_SECONDS 15
 #define LWNET_CLDAP_DEFAULT_MAXIMUM_CONNECTIONS 100
 
-typedef struct _LWNET_CLDAP_CONNECTION_CONTEXT {
-    HANDLE hDirectory;
-    int fd;
-    int msgid;
-    LWNET_UNIX_MS_TIME_T StartTime;
-    PDNS_SERVER_INFO pServerInfo;
-} LWNET_CLDAP_CONNECTION_CONTEXT, *PLWNET_CLDAP_CONNECTION_CONTEXT;
-
 BOOLEAN
 LWNetSrvIsMatchingDcInfo(
     IN PLWNET_DC_INFO pDcInfo,
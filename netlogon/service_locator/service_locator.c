@@ -49,16 +49,66 @@
 #include "lwnet-utils.h"
 #include "lwnet.h"
 #include <lwerror.h>
+#include <lwmem.h>
+#include <lwstr.h>
+#include <reg/lwreg.h>
 #include <krb5/krb5.h>
 #include <krb5/locate_plugin.h>
 #include <lwkrb5.h>
 
+/*
+ * libkrb5 asks the locator for a KDC on every ticket request, so
+ * remember the last answer per realm for a short while.  Successful
+ * lookups are kept for LocatorCacheTimeout seconds (never longer than
+ * netlogond's own PingAgainTimeout) and "no such domain" answers for
+ * NegativeCacheTimeout, the same window netlogond itself uses.
+ */
+#define LOCATOR_CACHE_SIZE 16
+#define LOCATOR_CACHE_TIMEOUT_SECONDS 30
+#define LOCATOR_NEGATIVE_CACHE_TIMEOUT_SECONDS 60
+#define LOCATOR_PING_AGAIN_TIMEOUT_SECONDS (15 * 60)
+
+typedef struct _LOCATOR_CACHE_ENTRY
+{
+    PSTR pszRealm;
+    PSTR pszAddress;
+    DWORD dwError;
+    time_t Expires;
+} LOCATOR_CACHE_ENTRY, *PLOCATOR_CACHE_ENTRY;
+
+typedef struct _LOCATOR_CACHE
+{
+    pthread_mutex_t Mutex;
+    BOOLEAN bConfigRead;
+    DWORD dwCacheTimeoutSeconds;
+    DWORD dwNegativeCacheTimeoutSeconds;
+    LOCATOR_CACHE_ENTRY Entries[LOCATOR_CACHE_SIZE];
+} LOCATOR_CACHE, *PLOCATOR_CACHE;
+
+static LOCATOR_CACHE gLocatorCache =
+{
+    .Mutex = PTHREAD_MUTEX_INITIALIZER
+};
+
 static
 DWORD
 LocatorEaiToLwError(
     int eai
     );
 
+static
+VOID
+LocatorReadConfig(
+    VOID
+    );
+
+static
+DWORD
+LocatorGetKdcAddress(
+    PCSTR pszRealm,
+    PSTR* ppszAddress
+    );
+
 static
 krb5_error_code
 LocatorInit(
@@ -116,6 +166,224 @@ LocatorEaiToLwError(
     }
 }
 
+static
+VOID
+LocatorReadConfig(
+    VOID
+    )
+{
+    DWORD dwCacheTimeout = LOCATOR_CACHE_TIMEOUT_SECONDS;
+    DWORD dwNegativeCacheTimeout = LOCATOR_NEGATIVE_CACHE_TIMEOUT_SECONDS;
+    DWORD dwPingAgainTimeout = LOCATOR_PING_AGAIN_TIMEOUT_SECONDS;
+    LWREG_CONFIG_ITEM Config[] =
+    {
+        {
+            "LocatorCacheTimeout",
+            TRUE,
+            LwRegTypeDword,
+            0,
+            3600,
+            NULL,
+            &dwCacheTimeout,
+            NULL
+        },
+        {
+            "NegativeCacheTimeout",
+            TRUE,
+            LwRegTypeDword,
+            0,
+            -1,
+            NULL,
+            &dwNegativeCacheTimeout,
+            NULL
+        },
+        {
+            "PingAgainTimeout",
+            TRUE,
+            LwRegTypeDword,
+            0,
+            -1,
+            NULL,
+            &dwPingAgainTimeout,
+            NULL
+        },
+    };
+
+    // Keep the defaults if the registry cannot be reached.
+    RegProcessConfig(
+        "Services\\netlogon\\Parameters",
+        "Policy\\Services\\netlogon\\Parameters",
+        Config,
+        sizeof(Config)/sizeof(Config[0]));
+
+    gLocatorCache.dwCacheTimeoutSeconds =
+        LW_MIN(dwCacheTimeout, dwPingAgainTimeout);
+    gLocatorCache.dwNegativeCacheTimeoutSeconds = dwNegativeCacheTimeout;
+    gLocatorCache.bConfigRead = TRUE;
+}
+
+static
+DWORD
+LocatorGetKdcAddress(
+    PCSTR pszRealm,
+    PSTR* ppszAddress
+    )
+{
+    DWORD dwError = 0;
+    PLWNET_DC_INFO pDCInfo = NULL;
+    PSTR pszAddress = NULL;
+    PSTR pszCachedRealm = NULL;
+    PSTR pszCachedAddress = NULL;
+    PLOCATOR_CACHE_ENTRY pEntry = NULL;
+    DWORD dwLookupError = 0;
+    DWORD dwTimeout = 0;
+    time_t now = time(NULL);
+    BOOLEAN bLocked = FALSE;
+    DWORD i = 0;
+
+    pthread_mutex_lock(&gLocatorCache.Mutex);
+    bLocked = TRUE;
+
+    if (!gLocatorCache.bConfigRead)
+    {
+        LocatorReadConfig();
+    }
+
+    for (i = 0; i < LOCATOR_CACHE_SIZE; i++)
+    {
+        pEntry = &gLocatorCache.Entries[i];
+
+        if (pEntry->pszRealm &&
+            pEntry->Expires > now &&
+            !strcasecmp(pEntry->pszRealm, pszRealm))
+        {
+            dwError = pEntry->dwError;
+            BAIL_ON_LWNET_ERROR(dwError);
+
+            dwError = LwAllocateString(pEntry->pszAddress, &pszAddress);
+            BAIL_ON_LWNET_ERROR(dwError);
+
+            goto cleanup;
+        }
+    }
+
+    pthread_mutex_unlock(&gLocatorCache.Mutex);
+    bLocked = FALSE;
+
+    dwLookupError = LWNetGetDCName(
+                        NULL,
+                        pszRealm,
+                        NULL,
+                        DS_KDC_REQUIRED,
+                        &pDCInfo);
+    switch (dwLookupError)
+    {
+        case 0:
+            dwError = LwAllocateString(
+                            pDCInfo->pszDomainControllerAddress,
+                            &pszAddress);
+            BAIL_ON_LWNET_ERROR(dwError);
+
+            dwError = LwAllocateString(
+                            pDCInfo->pszDomainControllerAddress,
+                            &pszCachedAddress);
+            BAIL_ON_LWNET_ERROR(dwError);
+
+            dwTimeout = gLocatorCache.dwCacheTimeoutSeconds;
+            break;
+        case ERROR_NO_SUCH_DOMAIN:
+        case DNS_ERROR_BAD_PACKET:
+            // netlogond answered; anything else (e.g. netlogond not
+            // running) should be retried on the next lookup.
+            dwTimeout = gLocatorCache.dwNegativeCacheTimeoutSeconds;
+            break;
+        default:
+            dwError = dwLookupError;
+            BAIL_ON_LWNET_ERROR(dwError);
+    }
+
+    if (dwTimeout)
+    {
+        dwError = LwAllocateString(pszRealm, &pszCachedRealm);
+        BAIL_ON_LWNET_ERROR(dwError);
+
+        pthread_mutex_lock(&gLocatorCache.Mutex);
+        bLocked = TRUE;
+
+        // Reuse the slot for this realm, else an empty or the
+        // soonest-expiring one.
+        pEntry = &gLocatorCache.Entries[0];
+        for (i = 0; i < LOCATOR_CACHE_SIZE; i++)
+        {
+            PLOCATOR_CACHE_ENTRY pCandidate = &gLocatorCache.Entries[i];
+
+            if (!pCandidate->pszRealm ||
+                !strcasecmp(pCandidate->pszRealm, pszRealm))
+            {
+                pEntry = pCandidate;
+                break;
+            }
+            if (pCandidate->Expires < pEntry->Expires)
+            {
+                pEntry = pCandidate;
+            }
+        }
+
+        LW_SAFE_FREE_STRING(pEntry->pszRealm);
+        LW_SAFE_FREE_STRING(pEntry->pszAddress);
+
+        pEntry->pszRealm = pszCachedRealm;
+        pEntry->pszAddress = pszCachedAddress;
+        pEntry->dwError = dwLookupError;
+        pEntry->Expires = now + dwTimeout;
+        pszCachedRealm = NULL;
+        pszCachedAddress = NULL;
+    }
+
+    dwError = dwLookupError;
+    BAIL_ON_LWNET_ERROR(dwError);
+
+cleanup:
+
+    if (bLocked)
+    {
+        pthread_mutex_unlock(&gLocatorCache.Mutex);
+    }
+
+    if (pDCInfo)
+    {
+        LWNetFreeDCInfo(pDCInfo);
+    }
+    LW_SAFE_FREE_STRING(pszCachedRealm);
+    LW_SAFE_FREE_STRING(pszCachedAddress);
+
+    *ppszAddress = pszAddress;
+
+    return dwError;
+
+error:
+
+    LW_SAFE_FREE_STRING(pszAddress);
+
+    goto cleanup;
+}
+
+static
+__attribute__((destructor))
+VOID
+LocatorFreeCache(
+    VOID
+    )
+{
+    DWORD i = 0;
+
+    for (i = 0; i < LOCATOR_CACHE_SIZE; i++)
+    {
+        LW_SAFE_FREE_STRING(gLocatorCache.Entries[i].pszRealm);
+        LW_SAFE_FREE_STRING(gLocatorCache.Entries[i].pszAddress);
+    }
+}
+
 static
 krb5_error_code
 LocatorInit(
@@ -147,12 +415,11 @@ LocatorLookup(
     PVOID pvAddCallbackData
     )
 {
-    PLWNET_DC_INFO pDCInfo = NULL;
+    PSTR pszAddress = NULL;
     DWORD dwError = 0;
     struct addrinfo hints = { 0 };
     struct addrinfo* pAddrInfo = NULL;
     krb5_error_code kError = 0;
-    DWORD dwFlags = DS_KDC_REQUIRED;
 
     if (svc != locate_service_master_kdc && svc != locate_service_kdc)
     {
@@ -160,13 +427,7 @@ LocatorLookup(
         BAIL_ON_LWNET_ERROR(dwError); 
     }
 
-    dwError = LWNetGetDCName(
-                NULL,
-                pszRealm,
-                NULL,
-                dwFlags,
-                &pDCInfo
-                );
+    dwError = LocatorGetKdcAddress(pszRealm, &pszAddress);
     BAIL_ON_LWNET_ERROR(dwError); 
 
     hints.ai_family = iFamily;
@@ -175,7 +436,7 @@ LocatorLookup(
     hints.ai_flags = AI_NUMERICHOST;
 
     dwError = LocatorEaiToLwError(getaddrinfo(
-                pDCInfo->pszDomainControllerAddress,
+                pszAddress,
                 "88",
                 &hints,
                 &pAddrInfo));
@@ -201,10 +462,7 @@ cleanup:
     {
         freeaddrinfo(pAddrInfo);
     }
-    if (pDCInfo)
-    {
-        LWNetFreeDCInfo(pDCInfo);
-    }
+    LW_SAFE_FREE_STRING(pszAddress);
     switch(dwError)
     {
         case 0:
@@ -0,0 +1,347 @@
+/*
+ * Discovery latency of the CLDAP ping engine against a simulated DC set.
+ *
+ * Starts one responder thread per simulated domain controller, each
+ * bound to its own loopback address (127.0.1.x) on a high port.  Every
+ * responder answers a ping with a Netlogon SAM logon response after its
+ * own delay; some never answer and some do not advertise a KDC, so the
+ * engine has to skip them.  Each iteration runs LWNetCLdapPingServers
+ * for a KDC and prints how long discovery took next to the fastest
+ * suitable responder's delay.
+ *
+ * Usage: cldapbench [dc count] [iterations] [port]
+ */
+#include "includes.h"
+
+#define BENCH_DOMAIN "bench.example.com"
+#define BENCH_DEFAULT_DC_COUNT 200
+#define BENCH_DEFAULT_ITERATIONS 10
+#define BENCH_DEFAULT_PORT 38900
+#define BENCH_MAX_DC_COUNT 250
+
+typedef struct _BENCH_DC
+{
+    int fd;
+    DWORD dwIndex;
+    DWORD dwDelayMs;
+    BOOLEAN bSilent;
+    BOOLEAN bKdc;
+    char szAddress[32];
+    char szName[64];
+    pthread_t Thread;
+} BENCH_DC, *PBENCH_DC;
+
+static
+size_t
+BenchPutName(
+    unsigned char* pOut,
+    const char* pszName
+    )
+{
+    size_t len = 0;
+    const char* pszLabel = pszName;
+    const char* pszDot = NULL;
+    size_t labelLen = 0;
+
+    while (*pszLabel)
+    {
+        pszDot = strchr(pszLabel, '.');
+        labelLen = pszDot ? (size_t) (pszDot - pszLabel) : strlen(pszLabel);
+
+        pOut[len++] = (unsigned char) labelLen;
+        memcpy(pOut + len, pszLabel, labelLen);
+        len += labelLen;
+        pszLabel += labelLen + (pszDot ? 1 : 0);
+    }
+    pOut[len++] = 0;
+
+    return len;
+}
+
+static
+size_t
+BenchPutDword(
+    unsigned char* pOut,
+    DWORD dwValue
+    )
+{
+    pOut[0] = dwValue & 0xff;
+    pOut[1] = (dwValue >> 8) & 0xff;
+    pOut[2] = (dwValue >> 16) & 0xff;
+    pOut[3] = (dwValue >> 24) & 0xff;
+
+    return 4;
+}
+
+// NETLOGON_SAM_LOGON_RESPONSE_EX as parsed by LWNetBuildDCInfo.
+static
+size_t
+BenchBuildNetlogon(
+    PBENCH_DC pDc,
+    unsigned char* pOut
+    )
+{
+    size_t len = 0;
+    DWORD dwFlags = DS_DS_FLAG | DS_LDAP_FLAG | DS_WRITABLE_FLAG;
+
+    if (pDc->bKdc)
+    {
+        dwFlags |= DS_KDC_FLAG;
+    }
+
+    len += BenchPutDword(pOut + len, 23);
+    len += BenchPutDword(pOut + len, dwFlags);
+    memset(pOut + len, 0x11, LWNET_GUID_SIZE);
+    len += LWNET_GUID_SIZE;
+    len += BenchPutName(pOut + len, BENCH_DOMAIN);
+    len += BenchPutName(pOut + len, BENCH_DOMAIN);
+    len += BenchPutName(pOut + len, pDc->szName);
+    len += BenchPutName(pOut + len, "BENCH");
+    len += BenchPutName(pOut + len, "DC");
+    len += BenchPutName(pOut + len, "");
+    len += BenchPutName(pOut + len, "Default-First-Site-Name");
+    len += BenchPutName(pOut + len, "Default-First-Site-Name");
+    len += BenchPutDword(pOut + len, 5);
+    pOut[len++] = 0xff;
+    pOut[len++] = 0xff;
+    pOut[len++] = 0xff;
+    pOut[len++] = 0xff;
+
+    return len;
+}
+
+static
+PVOID
+BenchDcThread(
+    PVOID pData
+    )
+{
+    PBENCH_DC pDc = pData;
+    unsigned char request[2048];
+    unsigned char netlogon[512];
+    struct sockaddr_storage from;
+    socklen_t fromLength = 0;
+    ssize_t received = 0;
+    BerElement* pRequest = NULL;
+    BerElement* pReply = NULL;
+    struct berval bv = { 0 };
+    struct berval value = { 0 };
+    ber_int_t messageId = 0;
+    size_t netlogonLength = 0;
+
+    for (;;)
+    {
+        fromLength = sizeof(from);
+        received = recvfrom(pDc->fd, request, sizeof(request), 0,
+                            (struct sockaddr*) &from, &fromLength);
+        if (received <= 0)
+        {
+            break;
+        }
+
+        if (pDc->bSilent)
+        {
+            continue;
+        }
+
+        bv.bv_val = (char*) request;
+        bv.bv_len = received;
+        pRequest = ber_init(&bv);
+        if (!pRequest || ber_scanf(pRequest, "{i", &messageId) == LBER_ERROR)
+        {
+            if (pRequest)
+            {
+                ber_free(pRequest, 1);
+            }
+            continue;
+        }
+        ber_free(pRequest, 1);
+
+        if (pDc->dwDelayMs)
+        {
+            usleep(pDc->dwDelayMs * 1000);
+        }
+
+        netlogonLength = BenchBuildNetlogon(pDc, netlogon);
+        value.bv_val = (char*) netlogon;
+        value.bv_len = netlogonLength;
+
+        // SearchResultEntry followed by SearchResultDone in one
+        // datagram, like a Windows DC sends.
+        pReply = ber_alloc_t(LBER_USE_DER);
+        ber_printf(pReply, "{it{s{{s[O]}}}}",
+                   messageId,
+                   (ber_tag_t) LDAP_RES_SEARCH_ENTRY,
+                   "",
+                   NETLOGON_LDAP_ATTRIBUTE_NAME,
+                   &value);
+        ber_printf(pReply, "{it{ess}}",
+                   messageId,
+                   (ber_tag_t) LDAP_RES_SEARCH_RESULT,
+                   (ber_int_t) LDAP_SUCCESS,
+                   "",
+                   "");
+        if (ber_flatten2(pReply, &bv, 0) == 0)
+        {
+            sendto(pDc->fd, bv.bv_val, bv.bv_len, 0,
+                   (struct sockaddr*) &from, fromLength);
+        }
+        ber_free(pReply, 1);
+    }
+
+    return NULL;
+}
+
+static
+double
+BenchNow(
+    VOID
+    )
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec * 1000.0 + tv.tv_usec / 1000.0;
+}
+
+int
+main(
+    int argc,
+    char* argv[]
+    )
+{
+    DWORD dwError = 0;
+    DWORD dwDcCount = BENCH_DEFAULT_DC_COUNT;
+    DWORD dwIterations = BENCH_DEFAULT_ITERATIONS;
+    WORD wPort = BENCH_DEFAULT_PORT;
+    PBENCH_DC pDcs = NULL;
+    PDNS_SERVER_INFO pServers = NULL;
+    struct sockaddr_in address;
+    PLWNET_DC_INFO pDcInfo = NULL;
+    BOOLEAN bFailedFindWritable = FALSE;
+    DWORD dwFastest = (DWORD) -1;
+    DWORD i = 0;
+    double start = 0;
+    double elapsed = 0;
+    double total = 0;
+
+    if (argc > 1)
+    {
+        dwDcCount = CT_MIN(strtoul(argv[1], NULL, 0), BENCH_MAX_DC_COUNT);
+    }
+    if (argc > 2)
+    {
+        dwIterations = strtoul(argv[2], NULL, 0);
+    }
+    if (argc > 3)
+    {
+        wPort = (WORD) strtoul(argv[3], NULL, 0);
+    }
+    if (!dwDcCount)
+    {
+        printf("usage: %s [dc count] [iterations] [port]\n", argv[0]);
+        return 1;
+    }
+
+    pDcs = calloc(dwDcCount, sizeof(*pDcs));
+    pServers = calloc(dwDcCount, sizeof(*pServers));
+    if (!pDcs || !pServers)
+    {
+        fprintf(stderr, "Out of memory\n");
+        return 1;
+    }
+
+    srand(1);
+
+    for (i = 0; i < dwDcCount; i++)
+    {
+        PBENCH_DC pDc = &pDcs[i];
+
+        pDc->dwIndex = i;
+        // 10% never answer, 20% are not KDCs, the rest answer after
+        // 20-500ms.
+        pDc->bSilent = (i % 10) == 3;
+        pDc->bKdc = (i % 5) != 1;
+        pDc->dwDelayMs = 20 + rand() % 480;
+        snprintf(pDc->szAddress, sizeof(pDc->szAddress), "127.0.1.%u", i + 1);
+        snprintf(pDc->szName, sizeof(pDc->szName), "dc%u." BENCH_DOMAIN, i);
+
+        if (!pDc->bSilent && pDc->bKdc)
+        {
+            dwFastest = CT_MIN(dwFastest, pDc->dwDelayMs);
+        }
+
+        pDc->fd = socket(AF_INET, SOCK_DGRAM, 0);
+        if (pDc->fd < 0)
+        {
+            perror("socket");
+            return 1;
+        }
+
+        memset(&address, 0, sizeof(address));
+        address.sin_family = AF_INET;
+        address.sin_port = htons(wPort);
+        inet_pton(AF_INET, pDc->szAddress, &address.sin_addr);
+        if (bind(pDc->fd, (struct sockaddr*) &address, sizeof(address)) < 0)
+        {
+            perror(pDc->szAddress);
+            return 1;
+        }
+
+        if (pthread_create(&pDc->Thread, NULL, BenchDcThread, pDc))
+        {
+            fprintf(stderr, "Could not start responder %u\n", i);
+            return 1;
+        }
+
+        pServers[i].pszName = pDc->szName;
+        pServers[i].pszAddress = pDc->szAddress;
+    }
+
+    printf("%u simulated DCs, fastest suitable answers after %u ms\n",
+           dwDcCount, dwFastest);
+
+    for (i = 0; i < dwIterations; i++)
+    {
+        start = BenchNow();
+
+        dwError = LWNetCLdapPingServers(
+                        BENCH_DOMAIN,
+                        DS_KDC_REQUIRED,
+                        pServers,
+                        dwDcCount,
+                        wPort,
+                        CT_MIN(LWNET_CLDAP_DEFAULT_MAXIMUM_CONNECTIONS, dwDcCount),
+                        CT_MAX(CT_MIN(LWNET_CLDAP_DEFAULT_MAXIMUM_CONNECTIONS, dwDcCount) / 5,
+                               LWNET_CLDAP_MINIMUM_INCREMENTAL_CONNECTIONS),
+                        LWNET_CLDAP_DEFAULT_TIMEOUT_SECONDS * 1000,
+                        LWNET_CLDAP_DEFAULT_TIMEOUT_SECONDS * 1000,
+                        &pDcInfo,
+                        &bFailedFindWritable);
+
+        elapsed = BenchNow() - start;
+        total += elapsed;
+
+        if (dwError)
+        {
+            printf("iteration %u: error %u after %.1f ms\n", i, dwError, elapsed);
+            continue;
+        }
+
+        printf("iteration %u: %s (%s) in %.1f ms, ping time %u ms\n",
+               i,
+               pDcInfo->pszDomainControllerName,
+               pDcInfo->pszDomainControllerAddress,
+               elapsed,
+               pDcInfo->dwPingTime);
+
+        LWNET_SAFE_FREE_DC_INFO(pDcInfo);
+    }
+
+    if (dwIterations)
+    {
+        printf("average discovery time: %.1f ms\n", total / dwIterations);
+    }
+
+    return dwError ? 1 : 0;
+}
@@ -836,57 +836,221 @@ LWNetDnsFreeRecord(
 }
 
 DWORD
-LWNetDnsBuildSRVRecordList(
+LWNetDnsBuildSRVTargetList(
     IN PDNS_RESPONSE_HEADER pHeader,
     IN PLW_DLINKED_LIST pAnswersList,
-    IN PLW_DLINKED_LIST pAdditionalsList,
-    OUT PLW_DLINKED_LIST* ppSRVRecordList
+    OUT PLW_DLINKED_LIST* ppSRVTargetList,
+    OUT PDWORD pdwTtl
     )
+// Returns the SRV answers as DNS_SRV_INFO_RECORDs without addresses,
+// along with the smallest TTL among them.
 {
     DWORD dwError = 0;
-    WORD priority = 0;
-    WORD weight = 0;
-    WORD port = 0;
-    PSTR pszTarget = NULL;
     PDNS_SRV_INFO_RECORD pSrvInfoRecord = NULL;
     PLW_DLINKED_LIST pListMember = NULL;
-    PLW_DLINKED_LIST pSRVRecordList = NULL;
-    PLW_DLINKED_LIST pAddressList = NULL;
-    PLW_DLINKED_LIST pAddressListMember = NULL;
+    PLW_DLINKED_LIST pSRVTargetList = NULL;
+    DWORD dwTtl = (DWORD) -1;
 
     for (pListMember = pAnswersList;
          pListMember;
          pListMember = pListMember->pNext)
     {
-        LWNET_SAFE_FREE_STRING(pszTarget);
+        PDNS_RECORD pRecord = (PDNS_RECORD)pListMember->pItem;
+
+        if (pRecord->wType != ns_t_srv)
+        {
+            continue;
+        }
+
+        dwError = LWNetAllocateMemory(sizeof(*pSrvInfoRecord),
+                                      OUT_PPVOID(&pSrvInfoRecord));
+        BAIL_ON_LWNET_ERROR(dwError);
+
         dwError = LWNetDnsParseSrvRecord(pHeader,
-                                        (PDNS_RECORD)pListMember->pItem,
-                                        &priority,
-                                        &weight,
-                                        &port,
-                                        &pszTarget);
+                                        pRecord,
+                                        &pSrvInfoRecord->wPriority,
+                                        &pSrvInfoRecord->wWeight,
+                                        &pSrvInfoRecord->wPort,
+                                        &pSrvInfoRecord->pszTarget);
         BAIL_ON_LWNET_ERROR(dwError);
 
-        LWNET_SAFE_FREE_PSTR_LINKED_LIST(pAddressList);
-        dwError = LWNetDnsParseOrGetAddressesForServer(
-                        pAdditionalsList,
-                        pszTarget,
-                        &pAddressList);
+        dwError = LwDLinkedListAppend(&pSRVTargetList, pSrvInfoRecord);
+        BAIL_ON_LWNET_ERROR(dwError);
+        pSrvInfoRecord = NULL;
+
+        dwTtl = CT_MIN(dwTtl, pRecord->dwTTL);
+    }
+
+error:
+    if (dwError)
+    {
+        LWNET_SAFE_FREE_SRV_INFO_LINKED_LIST(pSRVTargetList);
+    }
+
+    if (pSrvInfoRecord)
+    {
+        LWNetDnsFreeSRVInfoRecord(pSrvInfoRecord);
+    }
+
+    *ppSRVTargetList = pSRVTargetList;
+    *pdwTtl = pSRVTargetList ? dwTtl : 0;
+
+    return dwError;
+}
+
+DWORD
+LWNetDnsBuildSRVRecordList(
+    IN PLW_DLINKED_LIST pSRVTargetList,
+    IN OPTIONAL PLW_DLINKED_LIST pAdditionalsList,
+    OUT PLW_DLINKED_LIST* ppSRVRecordList
+    )
+// Produces one record per target and address, in answer order.  Addresses
+// come from the additional section, then the cache, and the remaining
+// targets are looked up all at once rather than one after the other.
+{
+    DWORD dwError = 0;
+    PDNS_SRV_INFO_RECORD pSrvInfoRecord = NULL;
+    PLW_DLINKED_LIST pListMember = NULL;
+    PLW_DLINKED_LIST pSRVRecordList = NULL;
+    PLW_DLINKED_LIST pAddressListMember = NULL;
+    PLWNET_DNS_HOST_QUERY pHosts = NULL;
+    PLWNET_DNS_HOST_QUERY pHost = NULL;
+    DWORD dwHostCount = 0;
+    DWORD dwPendingCount = 0;
+    DWORD dwTtl = 0;
+    BOOLEAN bFound = FALSE;
+    DWORD i = 0;
+
+    for (pListMember = pSRVTargetList;
+         pListMember;
+         pListMember = pListMember->pNext)
+    {
+        dwHostCount++;
+    }
+
+    if (!dwHostCount)
+    {
+        goto error;
+    }
+
+    dwError = LWNetAllocateMemory(dwHostCount * sizeof(*pHosts),
+                                  OUT_PPVOID(&pHosts));
+    BAIL_ON_LWNET_ERROR(dwError);
+
+    for (pListMember = pSRVTargetList, i = 0;
+         pListMember;
+         pListMember = pListMember->pNext, i++)
+    {
+        pHost = &pHosts[i];
+        pHost->pszHostname = ((PDNS_SRV_INFO_RECORD)pListMember->pItem)->pszTarget;
+        pHost->dwTtl = (DWORD) -1;
+        pHost->dwNegativeTtl = (DWORD) -1;
+
+        if (pAdditionalsList)
+        {
+            dwError = LWNetDnsParseAddressesForServer(
+                            pAdditionalsList,
+                            pHost->pszHostname,
+                            &pHost->pAddressList,
+                            &dwTtl);
+            BAIL_ON_LWNET_ERROR(dwError);
+
+            if (pHost->pAddressList)
+            {
+                LWNetDnsCacheAddAddresses(pHost->pszHostname,
+                                          pHost->pAddressList,
+                                          0,
+                                          dwTtl);
+                pHost->bResolved = TRUE;
+                continue;
+            }
+        }
+
+        pHost->dwError = LWNetDnsCacheLookupAddresses(
+                                pHost->pszHostname,
+                                &pHost->pAddressList,
+                                &bFound);
+        if (bFound)
+        {
+            pHost->bResolved = TRUE;
+            continue;
+        }
+        pHost->dwError = 0;
+
+        dwPendingCount++;
+    }
+
+    if (dwPendingCount)
+    {
+        dwError = LWNetDnsQueryHostsInParallel(pHosts, dwHostCount);
         if (dwError)
+        {
+            LWNET_LOG_VERBOSE("Parallel address lookup unavailable (error = %u)",
+                              dwError);
+            dwError = 0;
+        }
+    }
+
+    for (i = 0; i < dwHostCount; i++)
+    {
+        pHost = &pHosts[i];
+
+        if (pHost->bResolved)
+        {
+            continue;
+        }
+
+        if (pHost->pAddressList)
+        {
+            // Only a complete answer may stand in for later lookups.
+            if (pHost->bAnswered[LWNET_DNS_QUERY_TYPE_A] &&
+                pHost->bAnswered[LWNET_DNS_QUERY_TYPE_AAAA])
+            {
+                LWNetDnsCacheAddAddresses(pHost->pszHostname,
+                                          pHost->pAddressList,
+                                          0,
+                                          pHost->dwTtl);
+            }
+            continue;
+        }
+
+        // DNS had no answer for us in time, or said the name has no
+        // addresses; the host may still be known to other name services.
+        pHost->dwError = LWNetDnsGetAddressesForServer(
+                                pHost->pszHostname,
+                                &pHost->pAddressList);
+        if (pHost->dwError == ERROR_NOT_FOUND &&
+            !pHost->bFailed &&
+            pHost->bAnswered[LWNET_DNS_QUERY_TYPE_A] &&
+            pHost->bAnswered[LWNET_DNS_QUERY_TYPE_AAAA])
+        {
+            LWNetDnsCacheAddAddresses(pHost->pszHostname,
+                                      NULL,
+                                      pHost->dwError,
+                                      pHost->dwNegativeTtl);
+        }
+    }
+
+    for (pListMember = pSRVTargetList, i = 0;
+         pListMember;
+         pListMember = pListMember->pNext, i++)
+    {
+        PDNS_SRV_INFO_RECORD pTarget = (PDNS_SRV_INFO_RECORD)pListMember->pItem;
+
+        pHost = &pHosts[i];
+
+        if (pHost->dwError)
         {
             // Already logged on ERROR_NOT_FOUND
-            if (dwError != ERROR_NOT_FOUND)
+            if (pHost->dwError != ERROR_NOT_FOUND)
             {
                 LWNET_LOG_ERROR("Failed to build SRV record information");
             }
             // Skip
-            dwError = 0;
             continue;
         }
 
-        LW_ASSERT(pAddressList);
-
-        for (pAddressListMember = pAddressList;
+        for (pAddressListMember = pHost->pAddressList;
              pAddressListMember;
              pAddressListMember = pAddressListMember->pNext)
         {
@@ -896,11 +1060,11 @@ LWNetDnsBuildSRVRecordList(
                                           OUT_PPVOID(&pSrvInfoRecord));
             BAIL_ON_LWNET_ERROR(dwError);
 
-            pSrvInfoRecord->wPriority = priority;
-            pSrvInfoRecord->wWeight = weight;
-            pSrvInfoRecord->wPort = port;
+            pSrvInfoRecord->wPriority = pTarget->wPriority;
+            pSrvInfoRecord->wWeight = pTarget->wWeight;
+            pSrvInfoRecord->wPort = pTarget->wPort;
 
-            dwError = LwAllocateString(pszTarget, &pSrvInfoRecord->pszTarget);
+            dwError = LwAllocateString(pTarget->pszTarget, &pSrvInfoRecord->pszTarget);
             BAIL_ON_LWNET_ERROR(dwError);
 
             dwError = LwAllocateString(pszAddress, &pSrvInfoRecord->pszAddress);
@@ -911,7 +1075,7 @@ LWNetDnsBuildSRVRecordList(
             pSrvInfoRecord = NULL;
         }
     }
-    
+
 error:
     if (dwError)
     {
@@ -922,8 +1086,15 @@ error:
     {
         LWNetDnsFreeSRVInfoRecord(pSrvInfoRecord);
     }
-    LWNET_SAFE_FREE_STRING(pszTarget);
-    LWNET_SAFE_FREE_PSTR_LINKED_LIST(pAddressList);
+
+    if (pHosts)
+    {
+        for (i = 0; i < dwHostCount; i++)
+        {
+            LWNET_SAFE_FREE_PSTR_LINKED_LIST(pHosts[i].pAddressList);
+        }
+        LWNetFreeMemory(pHosts);
+    }
 
     *ppSRVRecordList = pSRVRecordList;
 
@@ -989,81 +1160,602 @@ error:
 }
 
 DWORD
-LWNetDnsParseOrGetAddressesForServer(
-    IN PLW_DLINKED_LIST pAdditionalsList,
-    IN PCSTR pszHostname,
-    OUT PLW_DLINKED_LIST* ppAddressList
+LWNetDnsFormatAddressRecord(
+    IN PDNS_RECORD pRecord,
+    OUT PSTR* ppszAddress
+    )
+{
+    DWORD dwError = 0;
+    PSTR pszAddress = NULL;
+
+    if (pRecord->wType == ns_t_a && pRecord->wDataLen == 4)
+    {
+        dwError = LwAllocateStringPrintf(&pszAddress, "%d.%d.%d.%d",
+                                            pRecord->pData[0],
+                                            pRecord->pData[1],
+                                            pRecord->pData[2],
+                                            pRecord->pData[3]);
+        BAIL_ON_LWNET_ERROR(dwError);
+    }
+    else if (pRecord->wType == ns_t_aaaa && pRecord->wDataLen == 16)
+    {
+        dwError = LwAllocateStringPrintf(
+                    &pszAddress,
+                    "%x:%x:%x:%x:%x:%x:%x:%x",
+                    LWNetDnsReadWORD(&pRecord->pData[0]),
+                    LWNetDnsReadWORD(&pRecord->pData[2]),
+                    LWNetDnsReadWORD(&pRecord->pData[4]),
+                    LWNetDnsReadWORD(&pRecord->pData[6]),
+                    LWNetDnsReadWORD(&pRecord->pData[8]),
+                    LWNetDnsReadWORD(&pRecord->pData[10]),
+                    LWNetDnsReadWORD(&pRecord->pData[12]),
+                    LWNetDnsReadWORD(&pRecord->pData[14]));
+        BAIL_ON_LWNET_ERROR(dwError);
+    }
+    else
+    {
+        dwError = DNS_ERROR_BAD_PACKET;
+        BAIL_ON_LWNET_ERROR(dwError);
+    }
+
+error:
+    if (dwError)
+    {
+        LWNET_SAFE_FREE_STRING(pszAddress);
+    }
+
+    *ppszAddress = pszAddress;
+
+    return dwError;
+}
+
+DWORD
+LWNetDnsParseAddressesForServer(
+    IN PLW_DLINKED_LIST pRecordList,
+    IN OPTIONAL PCSTR pszHostname,
+    OUT PLW_DLINKED_LIST* ppAddressList,
+    OUT PDWORD pdwTtl
     )
+// Collects the A and AAAA records for pszHostname (or all of them, for the
+// answer to an address query, which may go through a CNAME) and returns
+// the smallest TTL among them.  Returns no list rather than an error when
+// there are none.
 {
     DWORD dwError = 0;
     PSTR  pszAddress = NULL;
     PLW_DLINKED_LIST pListMember = NULL;
     PLW_DLINKED_LIST pAddressList = NULL;
-    
-    pListMember = pAdditionalsList;
-    while (pListMember)
+    DWORD dwTtl = (DWORD) -1;
+
+    for (pListMember = pRecordList;
+         pListMember;
+         pListMember = pListMember->pNext)
     {
         PDNS_RECORD pRecord = (PDNS_RECORD)pListMember->pItem;
-        
-        if ( (pRecord->wType == ns_t_a ) &&
-             !strcasecmp( pRecord->pszName, pszHostname ) )
+
+        if ((pRecord->wType != ns_t_a && pRecord->wType != ns_t_aaaa) ||
+            (pszHostname && strcasecmp(pRecord->pszName, pszHostname)))
         {
-            dwError = LwAllocateStringPrintf(&pszAddress, "%d.%d.%d.%d",
-                                                pRecord->pData[0],
-                                                pRecord->pData[1],
-                                                pRecord->pData[2],
-                                                pRecord->pData[3]);
-            BAIL_ON_LWNET_ERROR(dwError);
+            continue;
+        }
 
-            dwError = LwDLinkedListAppend(&pAddressList, pszAddress);
-            BAIL_ON_LWNET_ERROR(dwError);
+        dwError = LWNetDnsFormatAddressRecord(pRecord, &pszAddress);
+        if (dwError == DNS_ERROR_BAD_PACKET)
+        {
+            dwError = 0;
+            continue;
+        }
+        BAIL_ON_LWNET_ERROR(dwError);
+
+        dwError = LwDLinkedListAppend(&pAddressList, pszAddress);
+        BAIL_ON_LWNET_ERROR(dwError);
+
+        pszAddress = NULL;
+
+        dwTtl = CT_MIN(dwTtl, pRecord->dwTTL);
+    }
+
+error:
+    if (dwError)
+    {
+        LWNET_SAFE_FREE_PSTR_LINKED_LIST(pAddressList);
+    }
+
+    LWNET_SAFE_FREE_STRING(pszAddress);
+
+    *ppAddressList = pAddressList;
+    *pdwTtl = pAddressList ? dwTtl : 0;
+
+    return dwError;
+}
+
+static
+DWORD
+LWNetDnsGetNegativeTtl(
+    IN PLW_DLINKED_LIST pAuthsList
+    )
+// RFC 2308: a negative answer may be kept for the smaller of the SOA
+// record's TTL and its MINIMUM field, and not at all without an SOA.
+{
+    PLW_DLINKED_LIST pListMember = NULL;
+
+    for (pListMember = pAuthsList;
+         pListMember;
+         pListMember = pListMember->pNext)
+    {
+        PDNS_RECORD pRecord = (PDNS_RECORD)pListMember->pItem;
+
+        // MINIMUM is the last of the five 32-bit fields that end the RDATA.
+        if (pRecord->wType == ns_t_soa &&
+            pRecord->wDataLen >= 5 * sizeof(DWORD))
+        {
+            return CT_MIN(pRecord->dwTTL,
+                          LWNetDnsReadDWORD(pRecord->pData +
+                                            pRecord->wDataLen -
+                                            sizeof(DWORD)));
+        }
+    }
+
+    return 0;
+}
+
+static
+VOID
+LWNetDnsProcessHostResponse(
+    IN OUT PLWNET_DNS_HOST_QUERY pHost,
+    IN DWORD dwType,
+    IN PDNS_RESPONSE_HEADER pHeader
+    )
+{
+    DWORD dwError = 0;
+    PLW_DLINKED_LIST pAnswersList = NULL;
+    PLW_DLINKED_LIST pAuthsList = NULL;
+    PLW_DLINKED_LIST pAddressList = NULL;
+    PLW_DLINKED_LIST pListMember = NULL;
+    DWORD dwTtl = 0;
+
+    pHost->bAnswered[dwType] = TRUE;
+
+    if (LWNetDnsIsTruncatedResponse(pHeader) ||
+        (pHeader->flags.B.reply_code != ns_r_noerror &&
+         pHeader->flags.B.reply_code != ns_r_nxdomain))
+    {
+        LWNET_LOG_VERBOSE("DNS address lookup for '%s' failed (rcode = %d, truncated = %d)",
+                          pHost->pszHostname,
+                          pHeader->flags.B.reply_code,
+                          pHeader->flags.B.truncated);
+        pHost->bFailed = TRUE;
+        goto cleanup;
+    }
+
+    dwError = LWNetDnsParseQueryResponse(pHeader,
+                                         &pAnswersList,
+                                         &pAuthsList,
+                                         NULL);
+    BAIL_ON_LWNET_ERROR(dwError);
+
+    if (pHeader->flags.B.reply_code == ns_r_noerror)
+    {
+        dwError = LWNetDnsParseAddressesForServer(pAnswersList,
+                                                  NULL,
+                                                  &pAddressList,
+                                                  &dwTtl);
+        BAIL_ON_LWNET_ERROR(dwError);
+    }
+
+    if (!pAddressList)
+    {
+        pHost->dwNegativeTtl = CT_MIN(pHost->dwNegativeTtl,
+                                      LWNetDnsGetNegativeTtl(pAuthsList));
+        goto cleanup;
+    }
+
+    for (pListMember = pAddressList;
+         pListMember;
+         pListMember = pListMember->pNext)
+    {
+        dwError = LwDLinkedListAppend(&pHost->pAddressList,
+                                      pListMember->pItem);
+        BAIL_ON_LWNET_ERROR(dwError);
+
+        pListMember->pItem = NULL;
+    }
+
+    pHost->dwTtl = CT_MIN(pHost->dwTtl, dwTtl);
+
+cleanup:
+    LWNET_SAFE_FREE_DNS_RECORD_LINKED_LIST(pAnswersList);
+    LWNET_SAFE_FREE_DNS_RECORD_LINKED_LIST(pAuthsList);
+    LWNET_SAFE_FREE_PSTR_LINKED_LIST(pAddressList);
+
+    return;
 
-            pszAddress = NULL;
+error:
+    pHost->bFailed = TRUE;
+    goto cleanup;
+}
+
+#if HAVE_DECL_RES_NINIT
+static
+VOID
+LWNetDnsGetQueryIds(
+    OUT PWORD pwIds,
+    IN DWORD dwCount
+    )
+// Fills pwIds with distinct, unpredictable message ids so that an
+// off-path sender cannot guess which ids a batch is waiting for.
+{
+    DWORD i = 0;
+    DWORD j = 0;
+
+    LWNetGetRandomBytes(pwIds, dwCount * sizeof(*pwIds));
+
+    // Replies are matched by id, so no two queries may share one.
+    for (i = 1; i < dwCount; i++)
+    {
+        for (j = 0; j < i; j++)
+        {
+            if (pwIds[j] == pwIds[i])
+            {
+                pwIds[i]++;
+                j = (DWORD) -1;
+            }
         }
-        else if ((pRecord->wType == ns_t_aaaa) &&
-                 (!strcasecmp(pRecord->pszName, pszHostname)))
+    }
+}
+
+static
+BOOLEAN
+LWNetDnsIsReplyToQuery(
+    IN PBYTE pQuery,
+    IN DWORD dwQueryLength,
+    IN PBYTE pResponse,
+    IN size_t sResponseLength
+    )
+// A reply must repeat the query's question: the same name, compared
+// case-insensitively, followed by the same type and class.
+{
+    const size_t headerSize = CT_FIELD_OFFSET(DNS_RESPONSE_HEADER, data);
+    size_t nameEnd = headerSize;
+    size_t i = 0;
+
+    while (nameEnd < dwQueryLength && pQuery[nameEnd])
+    {
+        if (pQuery[nameEnd] & 0xc0)
         {
-            dwError = LwAllocateStringPrintf(
-                        &pszAddress,
-                        "%x:%x:%x:%x:%x:%x:%x:%x",
-                        LW_BTOH16(((UINT16 *)pRecord->pData)[0]),
-                        LW_BTOH16(((UINT16 *)pRecord->pData)[1]),
-                        LW_BTOH16(((UINT16 *)pRecord->pData)[2]),
-                        LW_BTOH16(((UINT16 *)pRecord->pData)[3]),
-                        LW_BTOH16(((UINT16 *)pRecord->pData)[4]),
-                        LW_BTOH16(((UINT16 *)pRecord->pData)[5]),
-                        LW_BTOH16(((UINT16 *)pRecord->pData)[6]),
-                        LW_BTOH16(((UINT16 *)pRecord->pData)[7]));
-            BAIL_ON_LWNET_ERROR(dwError);
+            return FALSE;
+        }
+        nameEnd += pQuery[nameEnd] + 1;
+    }
 
-            dwError = LwDLinkedListAppend(&pAddressList, pszAddress);
-            BAIL_ON_LWNET_ERROR(dwError);
+    // The terminating zero label plus QTYPE and QCLASS
+    if (nameEnd + 1 + 2 * sizeof(WORD) > dwQueryLength ||
+        nameEnd + 1 + 2 * sizeof(WORD) > sResponseLength)
+    {
+        return FALSE;
+    }
 
-            pszAddress = NULL;
+    for (i = headerSize; i <= nameEnd; i++)
+    {
+        if (tolower(pQuery[i]) != tolower(pResponse[i]))
+        {
+            return FALSE;
         }
+    }
+
+    return !memcmp(pQuery + nameEnd + 1,
+                   pResponse + nameEnd + 1,
+                   2 * sizeof(WORD));
+}
+#endif
+
+DWORD
+LWNetDnsQueryHostsInParallel(
+    IN OUT PLWNET_DNS_HOST_QUERY pHosts,
+    IN DWORD dwHostCount
+    )
+// Sends the A and AAAA queries for every unresolved host over a single
+// UDP socket and waits for all of the answers together, so a cold lookup
+// of N SRV targets costs one round trip instead of N.  Unanswered queries
+// are resent to the next name server after the resolver's retransmit
+// interval, as res_query would.  Hosts that get no usable answer are left
+// for the caller to look up some other way.
+{
+#if HAVE_DECL_RES_NINIT
+    DWORD dwError = 0;
+    union
+    {
+        struct __res_state res;
+        // See LWNetDnsQueryWithBuffer
+        char buffer[2048];
+    } resLocal = { {0} };
+    res_state res = &resLocal.res;
+    BOOLEAN bInLock = FALSE;
+    BOOLEAN bResInitialized = FALSE;
+    struct sockaddr_in nameServers[MAXNS];
+    DWORD dwNameServerCount = 0;
+    DWORD dwRetransMilliseconds = 0;
+    DWORD dwAttemptCount = 0;
+    DWORD dwAttempt = 0;
+    DWORD dwQueryCount = 0;
+    DWORD dwOutstanding = 0;
+    PBYTE pQueries = NULL;
+    PDWORD pdwQueryLengths = NULL;
+    PWORD pwQueryIds = NULL;
+    // Large enough for any datagram.  The record parser trusts the lengths
+    // inside the message, so leave as much again behind it for it to read
+    // zeros from rather than running off the end.
+    const size_t responseBufferSize = 2 * 64 * 1024;
+    const size_t maxResponseSize = 64 * 1024;
+    PBYTE pResponse = NULL;
+    PDNS_RESPONSE_HEADER pHeader = NULL;
+    int fd = -1;
+    int flags = 0;
+    int sret = 0;
+    ssize_t received = 0;
+    struct sockaddr_in from;
+    socklen_t fromLength = 0;
+    LWNET_UNIX_MS_TIME_T CurrentTime = 0;
+    LWNET_UNIX_MS_TIME_T StopTime = 0;
+    struct pollfd pollFd = { 0 };
+    DWORD dwQuery = 0;
+    DWORD i = 0;
+
+    dwQueryCount = CT_MIN(dwHostCount, LWNET_DNS_MAX_PARALLEL_HOSTS) *
+                   LWNET_DNS_QUERY_TYPE_COUNT;
+
+    dwError = LWNetAllocateMemory(dwQueryCount * MAX_DNS_UDP_BUFFER,
+                                  OUT_PPVOID(&pQueries));
+    BAIL_ON_LWNET_ERROR(dwError);
+
+    dwError = LWNetAllocateMemory(dwQueryCount * sizeof(*pdwQueryLengths),
+                                  OUT_PPVOID(&pdwQueryLengths));
+    BAIL_ON_LWNET_ERROR(dwError);
 
-        pListMember = pListMember->pNext;
+    dwError = LWNetAllocateMemory(dwQueryCount * sizeof(*pwQueryIds),
+                                  OUT_PPVOID(&pwQueryIds));
+    BAIL_ON_LWNET_ERROR(dwError);
+
+    dwError = LWNetAllocateMemory(responseBufferSize, OUT_PPVOID(&pResponse));
+    BAIL_ON_LWNET_ERROR(dwError);
+
+    LWNetDnsGetQueryIds(pwQueryIds, dwQueryCount);
+
+    LWNET_LOCK_RESOLVER_API(bInLock);
+
+    if (res_ninit(res) != 0)
+    {
+        dwError = ERROR_NOT_FOUND;
+        BAIL_ON_LWNET_ERROR(dwError);
     }
+    bResInitialized = TRUE;
 
-    if (!pAddressList)
+    // Servers configured by IPv6 address are left to res_query.
+    for (i = 0; i < (DWORD) res->nscount && i < MAXNS; i++)
     {
-        dwError = LWNetDnsGetAddressesForServer(
-                        pszHostname,
-                        &pAddressList);
+        if (res->nsaddr_list[i].sin_family == AF_INET)
+        {
+            nameServers[dwNameServerCount++] = res->nsaddr_list[i];
+        }
+    }
+
+    if (!dwNameServerCount)
+    {
+        dwError = ERROR_NOT_SUPPORTED;
         BAIL_ON_LWNET_ERROR(dwError);
     }
 
+    dwRetransMilliseconds = (res->retrans > 0 ?
+                             res->retrans :
+                             LWNET_DNS_DEFAULT_RETRANS_SECONDS) * 1000;
+    dwAttemptCount = CT_MIN(res->retry > 0 ?
+                            res->retry :
+                            LWNET_DNS_DEFAULT_RETRY_COUNT,
+                            LWNET_DNS_MAX_RETRY_COUNT) * dwNameServerCount;
+
+    for (dwQuery = 0; dwQuery < dwQueryCount; dwQuery++)
+    {
+        PLWNET_DNS_HOST_QUERY pHost = &pHosts[dwQuery / LWNET_DNS_QUERY_TYPE_COUNT];
+        PBYTE pQuery = pQueries + dwQuery * MAX_DNS_UDP_BUFFER;
+        WORD wId = pwQueryIds[dwQuery];
+        int queryLength = 0;
+
+        if (pHost->bResolved)
+        {
+            continue;
+        }
+
+        queryLength = res_nmkquery(
+                            res,
+                            ns_o_query,
+                            pHost->pszHostname,
+                            ns_c_in,
+                            (dwQuery % LWNET_DNS_QUERY_TYPE_COUNT) == LWNET_DNS_QUERY_TYPE_A ?
+                                ns_t_a : ns_t_aaaa,
+                            NULL,
+                            0,
+                            NULL,
+                            pQuery,
+                            MAX_DNS_UDP_BUFFER);
+        if (queryLength < (int) CT_FIELD_OFFSET(DNS_RESPONSE_HEADER, data))
+        {
+            pHost->bFailed = TRUE;
+            continue;
+        }
+
+        pQuery[0] = (BYTE) (wId >> 8);
+        pQuery[1] = (BYTE) (wId & 0xff);
+
+        pdwQueryLengths[dwQuery] = queryLength;
+        dwOutstanding++;
+    }
+
+    res_nclose(res);
+    bResInitialized = FALSE;
+
+    LWNET_UNLOCK_RESOLVER_API(bInLock);
+
+    fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd < 0)
+    {
+        dwError = LwMapErrnoToLwError(errno);
+        BAIL_ON_LWNET_ERROR(dwError);
+    }
+
+    flags = fcntl(fd, F_GETFL, 0);
+    if (flags < 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0 ||
+        fcntl(fd, F_SETFD, FD_CLOEXEC) < 0)
+    {
+        dwError = LwMapErrnoToLwError(errno);
+        BAIL_ON_LWNET_ERROR(dwError);
+    }
+
+    pollFd.fd = fd;
+    pollFd.events = POLLIN;
+
+    LWNET_LOG_VERBOSE("Looking up addresses for %u hosts in parallel",
+                      dwOutstanding / LWNET_DNS_QUERY_TYPE_COUNT);
+
+    for (dwAttempt = 0; dwOutstanding && dwAttempt < dwAttemptCount; dwAttempt++)
+    {
+        struct sockaddr_in* pNameServer = &nameServers[dwAttempt % dwNameServerCount];
+
+        for (dwQuery = 0; dwQuery < dwQueryCount; dwQuery++)
+        {
+            if (!pdwQueryLengths[dwQuery] ||
+                pHosts[dwQuery / LWNET_DNS_QUERY_TYPE_COUNT].bAnswered[dwQuery % LWNET_DNS_QUERY_TYPE_COUNT])
+            {
+                continue;
+            }
+
+            // A lost datagram is no different from a lost answer.
+            sendto(fd,
+                   pQueries + dwQuery * MAX_DNS_UDP_BUFFER,
+                   pdwQueryLengths[dwQuery],
+                   0,
+                   (struct sockaddr*) pNameServer,
+                   sizeof(*pNameServer));
+        }
+
+        dwError = LWNetGetSystemTimeInMs(&CurrentTime);
+        BAIL_ON_LWNET_ERROR(dwError);
+
+        StopTime = CurrentTime + dwRetransMilliseconds;
+
+        while (dwOutstanding && CurrentTime < StopTime)
+        {
+            do
+            {
+                sret = poll(&pollFd, 1, (int) (StopTime - CurrentTime));
+            } while (sret < 0 && errno == EINTR);
+
+            if (sret < 0)
+            {
+                dwError = LwMapErrnoToLwError(errno);
+                BAIL_ON_LWNET_ERROR(dwError);
+            }
+
+            // Drain everything that has arrived.
+            while (sret > 0 && dwOutstanding)
+            {
+                PLWNET_DNS_HOST_QUERY pHost = NULL;
+                DWORD dwType = 0;
+
+                fromLength = sizeof(from);
+                received = recvfrom(fd, pResponse, maxResponseSize, 0,
+                                    (struct sockaddr*) &from, &fromLength);
+                if (received < 0)
+                {
+                    break;
+                }
+
+                for (i = 0; i < dwNameServerCount; i++)
+                {
+                    if (from.sin_addr.s_addr == nameServers[i].sin_addr.s_addr &&
+                        from.sin_port == nameServers[i].sin_port)
+                    {
+                        break;
+                    }
+                }
+                if (fromLength != sizeof(from) ||
+                    from.sin_family != AF_INET ||
+                    i == dwNameServerCount ||
+                    received < (ssize_t) CT_FIELD_OFFSET(DNS_RESPONSE_HEADER, data))
+                {
+                    continue;
+                }
+
+                memset(pResponse + received, 0, maxResponseSize - received);
+
+                pHeader = (PDNS_RESPONSE_HEADER) pResponse;
+                LWNetDnsFixHeaderForEndianness(pHeader);
+
+                for (dwQuery = 0; dwQuery < dwQueryCount; dwQuery++)
+                {
+                    if (pdwQueryLengths[dwQuery] &&
+                        pwQueryIds[dwQuery] == pHeader->wId)
+                    {
+                        break;
+                    }
+                }
+                if (dwQuery == dwQueryCount ||
+                    pHeader->flags.B.qr_message_type != 1 ||
+                    pHeader->flags.B.opcode != ns_o_query ||
+                    pHeader->wQuestions != 1 ||
+                    !LWNetDnsIsReplyToQuery(
+                            pQueries + dwQuery * MAX_DNS_UDP_BUFFER,
+                            pdwQueryLengths[dwQuery],
+                            pResponse,
+                            received))
+                {
+                    LWNET_LOG_VERBOSE("Discarding a DNS reply that matches no outstanding query");
+                    continue;
+                }
+
+                pHost = &pHosts[dwQuery / LWNET_DNS_QUERY_TYPE_COUNT];
+                dwType = dwQuery % LWNET_DNS_QUERY_TYPE_COUNT;
+                if (pHost->bAnswered[dwType])
+                {
+                    continue;
+                }
+
+                LWNetDnsProcessHostResponse(pHost, dwType, pHeader);
+                dwOutstanding--;
+            }
+
+            dwError = LWNetGetSystemTimeInMs(&CurrentTime);
+            BAIL_ON_LWNET_ERROR(dwError);
+        }
+    }
+
+    if (dwOutstanding)
+    {
+        LWNET_LOG_VERBOSE("%u DNS address queries went unanswered",
+                          dwOutstanding);
+    }
+
 error:
-    if (dwError)
+    if (bResInitialized)
     {
-        LWNET_SAFE_FREE_PSTR_LINKED_LIST(pAddressList);
+        res_nclose(res);
     }
 
-    LWNET_SAFE_FREE_STRING(pszAddress);
+    LWNET_UNLOCK_RESOLVER_API(bInLock);
 
-    *ppAddressList = pAddressList;
+    if (fd >= 0)
+    {
+        close(fd);
+    }
+
+    LWNET_SAFE_FREE_MEMORY(pQueries);
+    LWNET_SAFE_FREE_MEMORY(pdwQueryLengths);
+    LWNET_SAFE_FREE_MEMORY(pwQueryIds);
+    LWNET_SAFE_FREE_MEMORY(pResponse);
 
     return dwError;
+#else
+    return ERROR_NOT_SUPPORTED;
+#endif
 }
 
 DWORD
@@ -1339,13 +2031,15 @@ LWNetDnsQueryWithBuffer(
     IN BOOLEAN bUseTcp,
     OUT PVOID pBuffer,
     IN DWORD dwBufferSize,
-    OUT PDWORD pdwResponseSize
+    OUT PDWORD pdwResponseSize,
+    OUT OPTIONAL PBOOLEAN pbNoRecords
     )
 {
     DWORD dwError = 0;
     PDNS_RESPONSE_HEADER pHeader = (PDNS_RESPONSE_HEADER)pBuffer;
     int responseSize =  0;
     BOOLEAN bInLock = FALSE;
+    BOOLEAN bNoRecords = FALSE;
 #if HAVE_DECL_RES_NINIT
     union
     {
@@ -1407,6 +2101,8 @@ LWNetDnsQueryWithBuffer(
     if (responseSize < 0)
     {
         LWNET_LOG_VERBOSE("DNS lookup for '%s' failed with errno %d, h_errno = %d", pszQuestion, errno, h_errno);
+        // The name server answered that there is nothing to find.
+        bNoRecords = (h_errno == HOST_NOT_FOUND || h_errno == NO_DATA);
         dwError = DNS_ERROR_BAD_PACKET;
         BAIL_ON_LWNET_ERROR(dwError);
     }
@@ -1448,6 +2144,10 @@ error:
         responseSize = 0;
     }
     *pdwResponseSize = responseSize;
+    if (pbNoRecords)
+    {
+        *pbNoRecords = bNoRecords;
+    }
     return dwError;
 }
 
@@ -1527,8 +2227,12 @@ LWNetDnsSrvQuery(
     PVOID pBuffer = NULL;
     PDNS_RESPONSE_HEADER pResponse = NULL;
     DWORD dwResponseSize = 0;
+    BOOLEAN bFound = FALSE;
+    BOOLEAN bNoRecords = FALSE;
+    DWORD dwTtl = 0;
     PLW_DLINKED_LIST pAnswersList = NULL;
     PLW_DLINKED_LIST pAdditionalsList = NULL;
+    PLW_DLINKED_LIST pSRVTargetList = NULL;
     PLW_DLINKED_LIST pSRVRecordList = NULL;
     PDNS_SERVER_INFO pServerArray = NULL;
     DWORD dwServerCount = 0;
@@ -1540,37 +2244,56 @@ LWNetDnsSrvQuery(
     dwError = LWNetDnsGetSrvRecordQuestion(&pszQuestion, pszDnsDomainName,
                                            pszSiteName, dwDsFlags);
     BAIL_ON_LWNET_ERROR(dwError);
-   
-    dwError = LWNetAllocateMemory(dwBufferSize, &pBuffer);
-    BAIL_ON_LWNET_ERROR(dwError);
 
-    dwError = LWNetDnsQueryWithBuffer(pszQuestion, TRUE, FALSE,
-                                      pBuffer, dwBufferSize,
-                                      &dwResponseSize);
+    dwError = LWNetDnsCacheLookupSrv(pszQuestion, &pSRVTargetList, &bFound);
     BAIL_ON_LWNET_ERROR(dwError);
 
-    pResponse = (PDNS_RESPONSE_HEADER) pBuffer;
-    if (LWNetDnsIsTruncatedResponse(pResponse))
+    if (!bFound)
     {
-        LWNET_LOG_DEBUG("Truncated DNS response");
-        dwError = LWNetDnsQueryWithBuffer(pszQuestion, FALSE, TRUE,
+        dwError = LWNetAllocateMemory(dwBufferSize, &pBuffer);
+        BAIL_ON_LWNET_ERROR(dwError);
+
+        dwError = LWNetDnsQueryWithBuffer(pszQuestion, TRUE, FALSE,
                                           pBuffer, dwBufferSize,
-                                          &dwResponseSize);
+                                          &dwResponseSize, &bNoRecords);
+        if (dwError && bNoRecords)
+        {
+            LWNetDnsCacheAddSrv(pszQuestion, NULL, dwError,
+                                LWNET_DNS_SRV_NEGATIVE_CACHE_TTL);
+        }
         BAIL_ON_LWNET_ERROR(dwError);
-    }
 
-    // TODO: Add dwResponseSize validation to parsing.
+        pResponse = (PDNS_RESPONSE_HEADER) pBuffer;
+        if (LWNetDnsIsTruncatedResponse(pResponse))
+        {
+            LWNET_LOG_DEBUG("Truncated DNS response");
+            dwError = LWNetDnsQueryWithBuffer(pszQuestion, FALSE, TRUE,
+                                              pBuffer, dwBufferSize,
+                                              &dwResponseSize, NULL);
+            BAIL_ON_LWNET_ERROR(dwError);
+        }
 
-    // Decode DNS response w/o taking into account record type
-    dwError = LWNetDnsParseQueryResponse(pResponse,
-                                         &pAnswersList,
-                                         NULL,
-                                         &pAdditionalsList);
-    BAIL_ON_LWNET_ERROR(dwError);
+        // TODO: Add dwResponseSize validation to parsing.
+
+        // Decode DNS response w/o taking into account record type
+        dwError = LWNetDnsParseQueryResponse(pResponse,
+                                             &pAnswersList,
+                                             NULL,
+                                             &pAdditionalsList);
+        BAIL_ON_LWNET_ERROR(dwError);
+
+        // Decode SRV records
+        dwError = LWNetDnsBuildSRVTargetList(pResponse,
+                                             pAnswersList,
+                                             &pSRVTargetList,
+                                             &dwTtl);
+        BAIL_ON_LWNET_ERROR(dwError);
 
-    // Decode SRV records
-    dwError = LWNetDnsBuildSRVRecordList(pResponse,
-                                         pAnswersList,
+        LWNetDnsCacheAddSrv(pszQuestion, pSRVTargetList, 0, dwTtl);
+    }
+
+    // Look up the target addresses
+    dwError = LWNetDnsBuildSRVRecordList(pSRVTargetList,
                                          pAdditionalsList,
                                          &pSRVRecordList);
     BAIL_ON_LWNET_ERROR(dwError);
@@ -1586,6 +2309,7 @@ error:
     LWNET_SAFE_FREE_MEMORY(pBuffer);
     LWNET_SAFE_FREE_DNS_RECORD_LINKED_LIST(pAnswersList);
     LWNET_SAFE_FREE_DNS_RECORD_LINKED_LIST(pAdditionalsList);
+    LWNET_SAFE_FREE_SRV_INFO_LINKED_LIST(pSRVTargetList);
     LWNET_SAFE_FREE_SRV_INFO_LINKED_LIST(pSRVRecordList);
 
     if (dwError)
@@ -1599,4 +2323,3 @@ error:
 
     return dwError;
 }
-
@@ -136,6 +136,43 @@ typedef struct _DNS_RESPONSE_HEADER
 
 #define MAX_DNS_UDP_BUFFER 512
 
+// Slots in each of the SRV and address caches.
+#define LWNET_DNS_CACHE_SIZE 128
+// Upper bounds on how long answers are kept, whatever their TTL says.
+#define LWNET_DNS_CACHE_MAX_TTL 3600
+#define LWNET_DNS_NEGATIVE_CACHE_MAX_TTL 300
+// res_query does not hand back the SOA of a negative SRV answer, so those
+// are kept for a fixed, short time.
+#define LWNET_DNS_SRV_NEGATIVE_CACHE_TTL 60
+
+// SRV targets looked up concurrently by LWNetDnsQueryHostsInParallel.
+#define LWNET_DNS_MAX_PARALLEL_HOSTS 256
+
+#define LWNET_DNS_DEFAULT_RETRANS_SECONDS 5
+#define LWNET_DNS_DEFAULT_RETRY_COUNT 2
+#define LWNET_DNS_MAX_RETRY_COUNT 4
+
+#define LWNET_DNS_QUERY_TYPE_A    0
+#define LWNET_DNS_QUERY_TYPE_AAAA 1
+#define LWNET_DNS_QUERY_TYPE_COUNT 2
+
+typedef struct _LWNET_DNS_HOST_QUERY
+{
+    PCSTR pszHostname;
+    // No further lookups are needed for this host.
+    BOOLEAN bResolved;
+    BOOLEAN bAnswered[LWNET_DNS_QUERY_TYPE_COUNT];
+    // Some answer was neither addresses nor an authoritative "no such
+    // name/no data", so nothing may be negatively cached.
+    BOOLEAN bFailed;
+    // Smallest TTL of the returned addresses, or of the SOA records in
+    // the negative answers.  (DWORD) -1 until something is known.
+    DWORD dwTtl;
+    DWORD dwNegativeTtl;
+    DWORD dwError;
+    PLW_DLINKED_LIST pAddressList;
+} LWNET_DNS_HOST_QUERY, *PLWNET_DNS_HOST_QUERY;
+
 DWORD
 LWNetDnsGetHostInfoEx(
     OUT OPTIONAL PSTR* ppszHostname,
@@ -247,10 +284,17 @@ LWNetDnsGetSrvRecordQuestion(
     );
 
 DWORD
-LWNetDnsBuildSRVRecordList(
+LWNetDnsBuildSRVTargetList(
     IN PDNS_RESPONSE_HEADER pHeader,
     IN PLW_DLINKED_LIST pAnswersList,
-    IN PLW_DLINKED_LIST pAdditionalsList,
+    OUT PLW_DLINKED_LIST* ppSRVTargetList,
+    OUT PDWORD pdwTtl
+    );
+
+DWORD
+LWNetDnsBuildSRVRecordList(
+    IN PLW_DLINKED_LIST pSRVTargetList,
+    IN OPTIONAL PLW_DLINKED_LIST pAdditionalsList,
     OUT PLW_DLINKED_LIST* ppSRVRecordList
     );
 
@@ -265,10 +309,23 @@ LWNetDnsParseSrvRecord(
     );
 
 DWORD
-LWNetDnsParseOrGetAddressesForServer(
-    IN PLW_DLINKED_LIST pAdditionalsList,
-    IN PCSTR pszHostname,
-    OUT PLW_DLINKED_LIST* ppAddressList
+LWNetDnsFormatAddressRecord(
+    IN PDNS_RECORD pRecord,
+    OUT PSTR* ppszAddress
+    );
+
+DWORD
+LWNetDnsParseAddressesForServer(
+    IN PLW_DLINKED_LIST pRecordList,
+    IN OPTIONAL PCSTR pszHostname,
+    OUT PLW_DLINKED_LIST* ppAddressList,
+    OUT PDWORD pdwTtl
+    );
+
+DWORD
+LWNetDnsQueryHostsInParallel(
+    IN OUT PLWNET_DNS_HOST_QUERY pHosts,
+    IN DWORD dwHostCount
     );
 
 DWORD
@@ -288,6 +345,12 @@ LWNetDnsFreeSRVInfoRecord(
     IN OUT PDNS_SRV_INFO_RECORD pRecord
     );
 
+VOID
+LWNetDnsFreePstrInList(
+    IN OUT PVOID pPstr,
+    IN PVOID pUserData
+    );
+
 VOID
 LWNetDnsFreeDnsRecordLinkedList(
     IN OUT PLW_DLINKED_LIST DnsRecordList
@@ -303,6 +366,36 @@ LWNetDnsFreePstrLinkedList(
     IN OUT PLW_DLINKED_LIST PstrList
     );
 
+DWORD
+LWNetDnsCacheLookupSrv(
+    IN PCSTR pszQuestion,
+    OUT PLW_DLINKED_LIST* ppSrvRecordList,
+    OUT PBOOLEAN pbFound
+    );
+
+VOID
+LWNetDnsCacheAddSrv(
+    IN PCSTR pszQuestion,
+    IN OPTIONAL PLW_DLINKED_LIST pSrvRecordList,
+    IN DWORD dwError,
+    IN DWORD dwTtl
+    );
+
+DWORD
+LWNetDnsCacheLookupAddresses(
+    IN PCSTR pszHostname,
+    OUT PLW_DLINKED_LIST* ppAddressList,
+    OUT PBOOLEAN pbFound
+    );
+
+VOID
+LWNetDnsCacheAddAddresses(
+    IN PCSTR pszHostname,
+    IN OPTIONAL PLW_DLINKED_LIST pAddressList,
+    IN DWORD dwError,
+    IN DWORD dwTtl
+    );
+
 #define LWNET_SAFE_FREE_DNS_RECORD_LINKED_LIST(DnsRecordList) \
     _LWNET_MAKE_SAFE_FREE(DnsRecordList, LWNetDnsFreeDnsRecordLinkedList)
 
@@ -0,0 +1,440 @@
+/* Editor Settings: expandtabs and use 4 spaces for indentation
+ * ex: set softtabstop=4 tabstop=8 expandtab shiftwidth=4: *
+ * -*- mode: c, c-basic-offset: 4 -*- */
+
+/*
+ * Copyright © BeyondTrust Software 2004 - 2019
+ * All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * BEYONDTRUST MAKES THIS SOFTWARE AVAILABLE UNDER OTHER LICENSING TERMS AS
+ * WELL. IF YOU HAVE ENTERED INTO A SEPARATE LICENSE AGREEMENT WITH
+ * BEYONDTRUST, THEN YOU MAY ELECT TO USE THE SOFTWARE UNDER THE TERMS OF THAT
+ * SOFTWARE LICENSE AGREEMENT INSTEAD OF THE TERMS OF THE APACHE LICENSE,
+ * NOTWITHSTANDING THE ABOVE NOTICE.  IF YOU HAVE QUESTIONS, OR WISH TO REQUEST
+ * A COPY OF THE ALTERNATE LICENSING TERMS OFFERED BY BEYONDTRUST, PLEASE CONTACT
+ * BEYONDTRUST AT beyondtrust.com/contact
+ */
+
+/*
+ * Copyright (C) BeyondTrust Software. All rights reserved.
+ *
+ * Module Name:
+ *
+ *        lwnet-dnscache.c
+ *
+ * Abstract:
+ *
+ *        BeyondTrust Site Manager
+ *
+ *        DNS Answer Cache
+ *
+ *        Keeps SRV answers (keyed by question) and address answers (keyed
+ *        by host name) for as long as their DNS TTL allows, so repeated
+ *        DC discovery does not go back to the name server.  Failed lookups
+ *        that the server answered authoritatively are cached briefly as
+ *        negative entries.
+ *
+ */
+#include "includes.h"
+
+typedef VOID (*LWNET_DNS_CACHE_FREE_ITEM)(PVOID, PVOID);
+
+typedef DWORD (*LWNET_DNS_CACHE_COPY_ITEM)(PVOID, PVOID*);
+
+typedef struct _LWNET_DNS_CACHE_ENTRY
+{
+    PSTR pszKey;
+    // Non-zero for negative entries
+    DWORD dwError;
+    LWNET_UNIX_TIME_T Expires;
+    PLW_DLINKED_LIST pItemList;
+} LWNET_DNS_CACHE_ENTRY, *PLWNET_DNS_CACHE_ENTRY;
+
+typedef struct _LWNET_DNS_CACHE
+{
+    PLWNET_DNS_CACHE_ENTRY Entries[LWNET_DNS_CACHE_SIZE];
+    LWNET_DNS_CACHE_FREE_ITEM pfnFreeItem;
+    LWNET_DNS_CACHE_COPY_ITEM pfnCopyItem;
+} LWNET_DNS_CACHE, *PLWNET_DNS_CACHE;
+
+static
+DWORD
+LWNetDnsCacheCopySrvInfoRecord(
+    IN PVOID pItem,
+    OUT PVOID* ppCopy
+    );
+
+static
+DWORD
+LWNetDnsCacheCopyPstr(
+    IN PVOID pItem,
+    OUT PVOID* ppCopy
+    );
+
+static pthread_mutex_t gLWNetDnsCacheLock = PTHREAD_MUTEX_INITIALIZER;
+
+static LWNET_DNS_CACHE gLWNetDnsSrvCache = {
+    { NULL },
+    LWNetDnsFreeSRVInfoRecordInList,
+    LWNetDnsCacheCopySrvInfoRecord
+};
+
+static LWNET_DNS_CACHE gLWNetDnsAddressCache = {
+    { NULL },
+    LWNetDnsFreePstrInList,
+    LWNetDnsCacheCopyPstr
+};
+
+static
+DWORD
+LWNetDnsCacheCopySrvInfoRecord(
+    IN PVOID pItem,
+    OUT PVOID* ppCopy
+    )
+{
+    DWORD dwError = 0;
+    PDNS_SRV_INFO_RECORD pRecord = (PDNS_SRV_INFO_RECORD) pItem;
+    PDNS_SRV_INFO_RECORD pCopy = NULL;
+
+    dwError = LWNetAllocateMemory(sizeof(*pCopy), OUT_PPVOID(&pCopy));
+    BAIL_ON_LWNET_ERROR(dwError);
+
+    pCopy->wPriority = pRecord->wPriority;
+    pCopy->wWeight = pRecord->wWeight;
+    pCopy->wPort = pRecord->wPort;
+
+    dwError = LWNetAllocateString(pRecord->pszTarget, &pCopy->pszTarget);
+    BAIL_ON_LWNET_ERROR(dwError);
+
+    if (pRecord->pszAddress)
+    {
+        dwError = LWNetAllocateString(pRecord->pszAddress, &pCopy->pszAddress);
+        BAIL_ON_LWNET_ERROR(dwError);
+    }
+
+error:
+    if (dwError && pCopy)
+    {
+        LWNetDnsFreeSRVInfoRecord(pCopy);
+        pCopy = NULL;
+    }
+
+    *ppCopy = pCopy;
+
+    return dwError;
+}
+
+static
+DWORD
+LWNetDnsCacheCopyPstr(
+    IN PVOID pItem,
+    OUT PVOID* ppCopy
+    )
+{
+    return LWNetAllocateString((PCSTR) pItem, (PSTR*) ppCopy);
+}
+
+static
+VOID
+LWNetDnsCacheFreeEntry(
+    IN PLWNET_DNS_CACHE pCache,
+    IN OUT PLWNET_DNS_CACHE_ENTRY pEntry
+    )
+{
+    LwDLinkedListForEach(pEntry->pItemList, pCache->pfnFreeItem, NULL);
+    LwDLinkedListFree(pEntry->pItemList);
+    LWNET_SAFE_FREE_STRING(pEntry->pszKey);
+    LWNetFreeMemory(pEntry);
+}
+
+static
+DWORD
+LWNetDnsCacheCopyList(
+    IN PLWNET_DNS_CACHE pCache,
+    IN PLW_DLINKED_LIST pItemList,
+    OUT PLW_DLINKED_LIST* ppCopyList
+    )
+{
+    DWORD dwError = 0;
+    PLW_DLINKED_LIST pListMember = NULL;
+    PLW_DLINKED_LIST pCopyList = NULL;
+    PVOID pCopy = NULL;
+
+    for (pListMember = pItemList; pListMember; pListMember = pListMember->pNext)
+    {
+        dwError = pCache->pfnCopyItem(pListMember->pItem, &pCopy);
+        BAIL_ON_LWNET_ERROR(dwError);
+
+        dwError = LwDLinkedListAppend(&pCopyList, pCopy);
+        BAIL_ON_LWNET_ERROR(dwError);
+        pCopy = NULL;
+    }
+
+error:
+    if (dwError)
+    {
+        if (pCopy)
+        {
+            pCache->pfnFreeItem(pCopy, NULL);
+        }
+        LwDLinkedListForEach(pCopyList, pCache->pfnFreeItem, NULL);
+        LwDLinkedListFree(pCopyList);
+        pCopyList = NULL;
+    }
+
+    *ppCopyList = pCopyList;
+
+    return dwError;
+}
+
+static
+DWORD
+LWNetDnsCacheLookup(
+    IN PLWNET_DNS_CACHE pCache,
+    IN PCSTR pszKey,
+    OUT PLW_DLINKED_LIST* ppItemList,
+    OUT PBOOLEAN pbFound
+    )
+{
+    DWORD dwError = 0;
+    DWORD dwCachedError = 0;
+    LWNET_UNIX_TIME_T now = 0;
+    PLWNET_DNS_CACHE_ENTRY pEntry = NULL;
+    PLW_DLINKED_LIST pItemList = NULL;
+    BOOLEAN bFound = FALSE;
+    DWORD i = 0;
+
+    dwError = LWNetGetSystemTime(&now);
+    BAIL_ON_LWNET_ERROR(dwError);
+
+    pthread_mutex_lock(&gLWNetDnsCacheLock);
+
+    for (i = 0; i < LWNET_DNS_CACHE_SIZE; i++)
+    {
+        pEntry = pCache->Entries[i];
+
+        if (pEntry && !strcasecmp(pEntry->pszKey, pszKey))
+        {
+            if (pEntry->Expires <= now)
+            {
+                LWNetDnsCacheFreeEntry(pCache, pEntry);
+                pCache->Entries[i] = NULL;
+            }
+            else if (pEntry->dwError)
+            {
+                dwCachedError = pEntry->dwError;
+                bFound = TRUE;
+            }
+            else
+            {
+                dwError = LWNetDnsCacheCopyList(pCache,
+                                                pEntry->pItemList,
+                                                &pItemList);
+                bFound = !dwError;
+            }
+            break;
+        }
+    }
+
+    pthread_mutex_unlock(&gLWNetDnsCacheLock);
+
+    BAIL_ON_LWNET_ERROR(dwError);
+
+    if (bFound)
+    {
+        LWNET_LOG_DEBUG("DNS cache hit for '%s' (error = %u)",
+                        pszKey, dwCachedError);
+    }
+
+    dwError = dwCachedError;
+
+error:
+    *ppItemList = pItemList;
+    *pbFound = bFound;
+
+    return dwError;
+}
+
+static
+VOID
+LWNetDnsCacheAdd(
+    IN PLWNET_DNS_CACHE pCache,
+    IN PCSTR pszKey,
+    IN OPTIONAL PLW_DLINKED_LIST pItemList,
+    IN DWORD dwError,
+    IN DWORD dwTtl
+    )
+{
+    DWORD dwLocalError = 0;
+    LWNET_UNIX_TIME_T now = 0;
+    PLWNET_DNS_CACHE_ENTRY pEntry = NULL;
+    DWORD dwSlot = 0;
+    DWORD i = 0;
+
+    dwTtl = CT_MIN(dwTtl, dwError ? LWNET_DNS_NEGATIVE_CACHE_MAX_TTL :
+                                    LWNET_DNS_CACHE_MAX_TTL);
+    if (!dwTtl)
+    {
+        goto cleanup;
+    }
+
+    dwLocalError = LWNetGetSystemTime(&now);
+    BAIL_ON_LWNET_ERROR(dwLocalError);
+
+    dwLocalError = LWNetAllocateMemory(sizeof(*pEntry), OUT_PPVOID(&pEntry));
+    BAIL_ON_LWNET_ERROR(dwLocalError);
+
+    dwLocalError = LWNetAllocateString(pszKey, &pEntry->pszKey);
+    BAIL_ON_LWNET_ERROR(dwLocalError);
+
+    if (!dwError)
+    {
+        dwLocalError = LWNetDnsCacheCopyList(pCache, pItemList,
+                                             &pEntry->pItemList);
+        BAIL_ON_LWNET_ERROR(dwLocalError);
+    }
+
+    pEntry->dwError = dwError;
+    pEntry->Expires = now + dwTtl;
+
+    pthread_mutex_lock(&gLWNetDnsCacheLock);
+
+    // Replace an existing entry for the key, else take an empty or
+    // expired slot, else evict whichever entry expires first.
+    for (i = 0; i < LWNET_DNS_CACHE_SIZE; i++)
+    {
+        if (!pCache->Entries[i])
+        {
+            dwSlot = i;
+            continue;
+        }
+
+        if (!strcasecmp(pCache->Entries[i]->pszKey, pszKey))
+        {
+            dwSlot = i;
+            break;
+        }
+
+        if (pCache->Entries[dwSlot] &&
+            pCache->Entries[i]->Expires < pCache->Entries[dwSlot]->Expires)
+        {
+            dwSlot = i;
+        }
+    }
+
+    if (pCache->Entries[dwSlot])
+    {
+        LWNetDnsCacheFreeEntry(pCache, pCache->Entries[dwSlot]);
+    }
+    pCache->Entries[dwSlot] = pEntry;
+    pEntry = NULL;
+
+    pthread_mutex_unlock(&gLWNetDnsCacheLock);
+
+cleanup:
+    if (pEntry)
+    {
+        LWNetDnsCacheFreeEntry(pCache, pEntry);
+    }
+
+    return;
+
+error:
+    LWNET_LOG_WARNING("Failed to cache DNS answer for '%s' (error = %u)",
+                      pszKey, dwLocalError);
+    goto cleanup;
+}
+
+DWORD
+LWNetDnsCacheLookupSrv(
+    IN PCSTR pszQuestion,
+    OUT PLW_DLINKED_LIST* ppSrvRecordList,
+    OUT PBOOLEAN pbFound
+    )
+{
+    return LWNetDnsCacheLookup(&gLWNetDnsSrvCache,
+                               pszQuestion,
+                               ppSrvRecordList,
+                               pbFound);
+}
+
+VOID
+LWNetDnsCacheAddSrv(
+    IN PCSTR pszQuestion,
+    IN OPTIONAL PLW_DLINKED_LIST pSrvRecordList,
+    IN DWORD dwError,
+    IN DWORD dwTtl
+    )
+{
+    LWNetDnsCacheAdd(&gLWNetDnsSrvCache,
+                     pszQuestion,
+                     pSrvRecordList,
+                     dwError,
+                     dwTtl);
+}
+
+DWORD
+LWNetDnsCacheLookupAddresses(
+    IN PCSTR pszHostname,
+    OUT PLW_DLINKED_LIST* ppAddressList,
+    OUT PBOOLEAN pbFound
+    )
+{
+    return LWNetDnsCacheLookup(&gLWNetDnsAddressCache,
+                               pszHostname,
+                               ppAddressList,
+                               pbFound);
+}
+
+VOID
+LWNetDnsCacheAddAddresses(
+    IN PCSTR pszHostname,
+    IN OPTIONAL PLW_DLINKED_LIST pAddressList,
+    IN DWORD dwError,
+    IN DWORD dwTtl
+    )
+{
+    LWNetDnsCacheAdd(&gLWNetDnsAddressCache,
+                     pszHostname,
+                     pAddressList,
+                     dwError,
+                     dwTtl);
+}
+
+VOID
+LWNetDnsCacheFlush(
+    VOID
+    )
+{
+    PLWNET_DNS_CACHE caches[] = { &gLWNetDnsSrvCache, &gLWNetDnsAddressCache };
+    DWORD i = 0;
+    DWORD j = 0;
+
+    pthread_mutex_lock(&gLWNetDnsCacheLock);
+
+    for (i = 0; i < sizeof(caches) / sizeof(caches[0]); i++)
+    {
+        for (j = 0; j < LWNET_DNS_CACHE_SIZE; j++)
+        {
+            if (caches[i]->Entries[j])
+            {
+                LWNetDnsCacheFreeEntry(caches[i], caches[i]->Entries[j]);
+                caches[i]->Entries[j] = NULL;
+            }
+        }
+    }
+
+    pthread_mutex_unlock(&gLWNetDnsCacheLock);
+}
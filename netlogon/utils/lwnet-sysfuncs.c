@@ -70,6 +70,54 @@ lwnet_vsyslog(
 #endif /* ! HAVE_VSYSLOG */
 }
 
+VOID
+LWNetGetRandomBytes(
+    OUT PVOID pBuffer,
+    IN DWORD dwSize
+    )
+// Fills pBuffer with bytes from /dev/urandom. Protocol ids that must not
+// be guessable by an off-path sender (DNS and CLDAP message ids) come from
+// here. Falls back to a time and pid seeded generator if the device
+// cannot be read.
+{
+    int fd = -1;
+    ssize_t got = 0;
+    size_t total = 0;
+    unsigned int seed = 0;
+    DWORD i = 0;
+
+    fd = open("/dev/urandom", O_RDONLY);
+    if (fd >= 0)
+    {
+        while (total < dwSize)
+        {
+            got = read(fd, (PBYTE) pBuffer + total, dwSize - total);
+            if (got < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            if (got <= 0)
+            {
+                break;
+            }
+            total += got;
+        }
+        close(fd);
+    }
+
+    if (total < dwSize)
+    {
+        LWNET_LOG_VERBOSE("Could not read /dev/urandom; using weaker random ids");
+
+        seed = (unsigned int) time(NULL) ^ ((unsigned int) getpid() << 16) ^
+               (unsigned int) (size_t) pBuffer;
+        for (i = 0; i < dwSize; i++)
+        {
+            ((PBYTE) pBuffer)[i] = (BYTE) rand_r(&seed);
+        }
+    }
+}
+
 #if defined(__LWI_AIX__) || defined(__LWI_HP_UX__)
 
 #if !defined(HAVE_RPL_MALLOC)
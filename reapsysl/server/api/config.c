@@ -98,6 +98,7 @@ RSysSrvApiInitConfig(
     pConfig->bLogUnmatchedErrorEvents = FALSE;
     pConfig->bLogUnmatchedWarningEvents = FALSE;
     pConfig->bLogUnmatchedInfoEvents = FALSE;
+    pConfig->dwUserCacheTimeout = 5 * RSYS_SECONDS_IN_MINUTE;
 
     *ppConfig = pConfig;
 
@@ -160,6 +161,15 @@ RSysSrvApiReadConfig(
                 NULL,
                 &pConfig->bLogUnmatchedInfoEvents,
             },
+            {
+                "UserCacheTimeout",
+                TRUE,
+                LwRegTypeDword,
+                0,
+                RSYS_SECONDS_IN_DAY,
+                NULL,
+                &pConfig->dwUserCacheTimeout,
+            },
         };
 
         dwError = RegProcessConfig(
@@ -175,6 +185,11 @@ RSysSrvApiReadConfig(
         BAIL_ON_RSYS_ERROR(dwError);
     }
 
+    dwError = RSysSrvCreatePatternPrefilter(
+                    pConfig->pPatternHead,
+                    &pConfig->pPrefilter);
+    BAIL_ON_RSYS_ERROR(dwError);
+
     *ppConfig = pConfig;
 
 cleanup:
@@ -195,6 +210,8 @@ RSysSrvApiFreeConfig(
 {
     if (pConfig)
     {
+        RSysSrvFreePatternPrefilter(pConfig->pPrefilter);
+
         while (pConfig->pPatternHead)
         {
             PLW_DLINKED_LIST pToDelete = pConfig->pPatternHead;
@@ -285,10 +302,42 @@ error:
     goto cleanup;
 }
 
+DWORD
+RSysSrvGetUserCacheTimeout(
+    HANDLE hServer,
+    DWORD* pdwUserCacheTimeout
+    )
+{
+    DWORD dwError = 0;
+    BOOLEAN bUnlockConfigLock = FALSE;
+
+    BAIL_ON_INVALID_POINTER(pdwUserCacheTimeout);
+
+    pthread_rwlock_rdlock(&gRSysConfigLock);
+    bUnlockConfigLock = TRUE;
+
+    *pdwUserCacheTimeout = gpAPIConfig->dwUserCacheTimeout;
+
+cleanup:
+    if (bUnlockConfigLock)
+    {
+        pthread_rwlock_unlock(&gRSysConfigLock);
+    }
+
+    return dwError;
+
+error:
+
+    *pdwUserCacheTimeout = 0;
+
+    goto cleanup;
+}
+
 DWORD
 RSysSrvLockPatternList(
     HANDLE hServer,
-    PLW_DLINKED_LIST* ppPatternList
+    PLW_DLINKED_LIST* ppPatternList,
+    PRSYS_PATTERN_PREFILTER* ppPrefilter
     )
 {
     DWORD dwError = 0;
@@ -300,6 +349,10 @@ RSysSrvLockPatternList(
     bUnlockConfigLock = TRUE;
 
     *ppPatternList = gpAPIConfig->pPatternHead;
+    if (ppPrefilter)
+    {
+        *ppPrefilter = gpAPIConfig->pPrefilter;
+    }
 
 cleanup:
     return dwError;
@@ -313,6 +366,10 @@ error:
     {
         *ppPatternList = 0;
     }
+    if (ppPrefilter)
+    {
+        *ppPrefilter = NULL;
+    }
 
     goto cleanup;
 }
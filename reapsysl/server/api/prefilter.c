@@ -0,0 +1,694 @@
+/* Editor Settings: expandtabs and use 4 spaces for indentation
+ * ex: set softtabstop=4 tabstop=8 expandtab shiftwidth=4: *
+ * -*- mode: c, c-basic-offset: 4 -*- */
+
+/*
+ * Copyright © BeyondTrust Software 2004 - 2019
+ * All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * BEYONDTRUST MAKES THIS SOFTWARE AVAILABLE UNDER OTHER LICENSING TERMS AS
+ * WELL. IF YOU HAVE ENTERED INTO A SEPARATE LICENSE AGREEMENT WITH
+ * BEYONDTRUST, THEN YOU MAY ELECT TO USE THE SOFTWARE UNDER THE TERMS OF THAT
+ * SOFTWARE LICENSE AGREEMENT INSTEAD OF THE TERMS OF THE APACHE LICENSE,
+ * NOTWITHSTANDING THE ABOVE NOTICE.  IF YOU HAVE QUESTIONS, OR WISH TO REQUEST
+ * A COPY OF THE ALTERNATE LICENSING TERMS OFFERED BY BEYONDTRUST, PLEASE CONTACT
+ * BEYONDTRUST AT beyondtrust.com/contact
+ */
+
+/*
+ * Copyright (C) BeyondTrust Software. All rights reserved.
+ *
+ * Module Name:
+ *
+ *        prefilter.c
+ *
+ * Abstract:
+ *
+ *        Reaper for syslog
+ *
+ *        Literal prefilter for message patterns
+ *
+ *        Each pattern regex is reduced to the longest literal string that
+ *        every match must contain. The literals are compiled into an
+ *        Aho-Corasick automaton so that a single pass over a syslog line
+ *        tells which patterns could possibly match it. Only those
+ *        patterns are then handed to regexec.
+ *
+ */
+
+#include "includes.h"
+
+#define RSYS_PREFILTER_ALPHABET 256
+#define RSYS_PREFILTER_NO_PATTERN ((DWORD)-1)
+
+struct _RSYS_PATTERN_PREFILTER
+{
+    DWORD dwPatternCount;
+    // Number of patterns that have a required literal
+    DWORD dwLiteralCount;
+    // Indexed by pattern. Set for patterns which have no usable literal
+    // and therefore must always be evaluated.
+    PBOOLEAN pbAlwaysCandidate;
+    // Indexed by pattern. Next pattern with an identical literal.
+    PDWORD pdwNextPattern;
+
+    DWORD dwStateCount;
+    // dwStateCount * RSYS_PREFILTER_ALPHABET goto/failure transitions
+    PDWORD pdwTransitions;
+    // Indexed by state. First pattern whose literal ends in this state.
+    PDWORD pdwFirstPattern;
+    // Indexed by state. Closest state on the failure chain which ends a
+    // literal, or 0 for none.
+    PDWORD pdwOutputLink;
+};
+
+static
+BOOLEAN
+RSysIsQuantifier(
+    CHAR c
+    )
+{
+    return c == '*' || c == '+' || c == '?' || c == '{';
+}
+
+static
+PCSTR
+RSysSkipBracketExpression(
+    PCSTR pszPos
+    )
+{
+    // pszPos points at the opening '['
+    pszPos++;
+
+    if (*pszPos == '^')
+    {
+        pszPos++;
+    }
+    // A ']' immediately after the opening bracket is a literal member
+    if (*pszPos == ']')
+    {
+        pszPos++;
+    }
+
+    while (*pszPos && *pszPos != ']')
+    {
+        if (pszPos[0] == '[' &&
+                (pszPos[1] == ':' || pszPos[1] == '.' || pszPos[1] == '='))
+        {
+            CHAR cClose = pszPos[1];
+
+            pszPos += 2;
+            while (*pszPos && !(pszPos[0] == cClose && pszPos[1] == ']'))
+            {
+                pszPos++;
+            }
+            if (*pszPos)
+            {
+                pszPos += 2;
+            }
+            continue;
+        }
+        pszPos++;
+    }
+
+    if (*pszPos)
+    {
+        pszPos++;
+    }
+
+    return pszPos;
+}
+
+static
+PCSTR
+RSysSkipGroup(
+    PCSTR pszPos
+    )
+{
+    DWORD dwDepth = 0;
+
+    // pszPos points at the opening '('
+    while (*pszPos)
+    {
+        if (*pszPos == '\\' && pszPos[1])
+        {
+            pszPos += 2;
+        }
+        else if (*pszPos == '[')
+        {
+            pszPos = RSysSkipBracketExpression(pszPos);
+        }
+        else
+        {
+            if (*pszPos == '(')
+            {
+                dwDepth++;
+            }
+            else if (*pszPos == ')' && --dwDepth == 0)
+            {
+                return pszPos + 1;
+            }
+            pszPos++;
+        }
+    }
+
+    return pszPos;
+}
+
+static
+BOOLEAN
+RSysHasTopLevelAlternation(
+    PCSTR pszRegEx
+    )
+{
+    PCSTR pszPos = pszRegEx;
+
+    while (*pszPos)
+    {
+        if (*pszPos == '\\' && pszPos[1])
+        {
+            pszPos += 2;
+        }
+        else if (*pszPos == '[')
+        {
+            pszPos = RSysSkipBracketExpression(pszPos);
+        }
+        else if (*pszPos == '(')
+        {
+            pszPos = RSysSkipGroup(pszPos);
+        }
+        else if (*pszPos == '|')
+        {
+            return TRUE;
+        }
+        else
+        {
+            pszPos++;
+        }
+    }
+
+    return FALSE;
+}
+
+static
+PCSTR
+RSysSkipQuantifiers(
+    PCSTR pszPos
+    )
+{
+    while (RSysIsQuantifier(*pszPos))
+    {
+        if (*pszPos == '{')
+        {
+            while (*pszPos && *pszPos != '}')
+            {
+                pszPos++;
+            }
+            if (*pszPos)
+            {
+                pszPos++;
+            }
+        }
+        else
+        {
+            pszPos++;
+        }
+    }
+
+    return pszPos;
+}
+
+/*
+ * Finds the longest run of characters that must appear literally in any
+ * string matched by the POSIX extended regex. Anything the scanner does not
+ * fully understand ends the current run, so the result is conservative. A
+ * NULL literal means the pattern cannot be prefiltered.
+ */
+DWORD
+RSysSrvGetRequiredLiteral(
+    IN PCSTR pszRegEx,
+    OUT PSTR* ppszLiteral
+    )
+{
+    DWORD dwError = 0;
+    PCSTR pszPos = pszRegEx;
+    size_t sRunLen = 0;
+    PSTR pszRun = NULL;
+    size_t sBestLen = 0;
+    PSTR pszBest = NULL;
+    PSTR pszLiteral = NULL;
+    CHAR cLiteral = 0;
+    size_t sAtomLen = 0;
+    BOOLEAN bEndRun = FALSE;
+
+    if (RSysHasTopLevelAlternation(pszRegEx))
+    {
+        goto cleanup;
+    }
+
+    // The literal can never be longer than the regex itself
+    dwError = LwNtStatusToWin32Error(
+                  LW_RTL_ALLOCATE(
+                      &pszRun,
+                      CHAR,
+                      strlen(pszRegEx) + 1));
+    BAIL_ON_RSYS_ERROR(dwError);
+
+    dwError = LwNtStatusToWin32Error(
+                  LW_RTL_ALLOCATE(
+                      &pszBest,
+                      CHAR,
+                      strlen(pszRegEx) + 1));
+    BAIL_ON_RSYS_ERROR(dwError);
+
+    while (*pszPos)
+    {
+        sAtomLen = 0;
+        bEndRun = TRUE;
+
+        if (*pszPos == '\\' && pszPos[1] && !isalnum((int)pszPos[1]))
+        {
+            // Escaped punctuation stands for itself
+            cLiteral = pszPos[1];
+            sAtomLen = 2;
+        }
+        else if (!strchr("\\.[]()^$|*+?{}", *pszPos))
+        {
+            cLiteral = *pszPos;
+            sAtomLen = 1;
+        }
+
+        if (sAtomLen)
+        {
+            switch (pszPos[sAtomLen])
+            {
+                case '*':
+                case '?':
+                case '{':
+                    // The literal is optional
+                    break;
+                case '+':
+                    // x+ requires one x, but nothing after it is fixed
+                    pszRun[sRunLen++] = cLiteral;
+                    break;
+                default:
+                    pszRun[sRunLen++] = cLiteral;
+                    bEndRun = FALSE;
+                    break;
+            }
+            pszPos += sAtomLen;
+        }
+        else if (*pszPos == '\\')
+        {
+            // Character class escapes, back references, etc.
+            pszPos += pszPos[1] ? 2 : 1;
+        }
+        else if (*pszPos == '[')
+        {
+            pszPos = RSysSkipBracketExpression(pszPos);
+        }
+        else if (*pszPos == '(')
+        {
+            pszPos = RSysSkipGroup(pszPos);
+        }
+        else
+        {
+            pszPos++;
+        }
+
+        if (bEndRun)
+        {
+            if (sRunLen > sBestLen)
+            {
+                memcpy(pszBest, pszRun, sRunLen);
+                sBestLen = sRunLen;
+            }
+            sRunLen = 0;
+
+            // A quantifier after a skipped atom belongs to it
+            pszPos = RSysSkipQuantifiers(pszPos);
+        }
+    }
+
+    if (sRunLen > sBestLen)
+    {
+        memcpy(pszBest, pszRun, sRunLen);
+        sBestLen = sRunLen;
+    }
+
+    if (sBestLen)
+    {
+        dwError = LwStrndup(pszBest, sBestLen, &pszLiteral);
+        BAIL_ON_RSYS_ERROR(dwError);
+    }
+
+cleanup:
+    LW_RTL_FREE(&pszRun);
+    LW_RTL_FREE(&pszBest);
+    *ppszLiteral = pszLiteral;
+    return dwError;
+
+error:
+    LW_SAFE_FREE_STRING(pszLiteral);
+    goto cleanup;
+}
+
+static
+VOID
+RSysPrefilterAddLiteral(
+    IN OUT PRSYS_PATTERN_PREFILTER pPrefilter,
+    IN PCSTR pszLiteral,
+    IN DWORD dwPattern
+    )
+{
+    DWORD dwState = 0;
+    PDWORD pdwNext = NULL;
+    PCSTR pszPos = NULL;
+
+    for (pszPos = pszLiteral; *pszPos; pszPos++)
+    {
+        pdwNext = &pPrefilter->pdwTransitions[
+                        dwState * RSYS_PREFILTER_ALPHABET +
+                        (UCHAR)*pszPos];
+
+        // State 0 is the root and is never the target of a goto edge, so
+        // 0 means there is no edge yet.
+        if (!*pdwNext)
+        {
+            *pdwNext = pPrefilter->dwStateCount++;
+        }
+        dwState = *pdwNext;
+    }
+
+    pPrefilter->pdwNextPattern[dwPattern] =
+        pPrefilter->pdwFirstPattern[dwState];
+    pPrefilter->pdwFirstPattern[dwState] = dwPattern;
+}
+
+static
+DWORD
+RSysPrefilterLinkStates(
+    IN OUT PRSYS_PATTERN_PREFILTER pPrefilter
+    )
+{
+    DWORD dwError = 0;
+    PDWORD pdwQueue = NULL;
+    PDWORD pdwFailure = NULL;
+    DWORD dwHead = 0;
+    DWORD dwTail = 0;
+    DWORD dwState = 0;
+    DWORD dwChild = 0;
+    DWORD dwFailure = 0;
+    DWORD dwChar = 0;
+    PDWORD pdwRow = NULL;
+
+    dwError = LwNtStatusToWin32Error(
+                  LW_RTL_ALLOCATE_ARRAY_AUTO(
+                      &pdwQueue,
+                      pPrefilter->dwStateCount));
+    BAIL_ON_RSYS_ERROR(dwError);
+
+    dwError = LwNtStatusToWin32Error(
+                  LW_RTL_ALLOCATE_ARRAY_AUTO(
+                      &pdwFailure,
+                      pPrefilter->dwStateCount));
+    BAIL_ON_RSYS_ERROR(dwError);
+
+    // Breadth first, so the failure state of every state has already been
+    // completed by the time the state itself is visited.
+    pdwQueue[dwTail++] = 0;
+
+    while (dwHead < dwTail)
+    {
+        dwState = pdwQueue[dwHead++];
+        pdwRow = &pPrefilter->pdwTransitions[dwState * RSYS_PREFILTER_ALPHABET];
+
+        for (dwChar = 0; dwChar < RSYS_PREFILTER_ALPHABET; dwChar++)
+        {
+            dwChild = pdwRow[dwChar];
+
+            if (dwChild)
+            {
+                dwFailure = dwState ?
+                    pPrefilter->pdwTransitions[
+                        pdwFailure[dwState] * RSYS_PREFILTER_ALPHABET +
+                        dwChar] :
+                    0;
+
+                pdwFailure[dwChild] = dwFailure;
+                pPrefilter->pdwOutputLink[dwChild] =
+                    pPrefilter->pdwFirstPattern[dwFailure] !=
+                            RSYS_PREFILTER_NO_PATTERN ?
+                        dwFailure :
+                        pPrefilter->pdwOutputLink[dwFailure];
+
+                pdwQueue[dwTail++] = dwChild;
+            }
+            else if (dwState)
+            {
+                // Turn the trie into a DFA so scanning never backtracks
+                pdwRow[dwChar] = pPrefilter->pdwTransitions[
+                                    pdwFailure[dwState] *
+                                        RSYS_PREFILTER_ALPHABET +
+                                    dwChar];
+            }
+        }
+    }
+
+cleanup:
+    LW_RTL_FREE(&pdwQueue);
+    LW_RTL_FREE(&pdwFailure);
+    return dwError;
+
+error:
+    goto cleanup;
+}
+
+DWORD
+RSysSrvCreatePatternPrefilter(
+    IN PLW_DLINKED_LIST pPatternList,
+    OUT PRSYS_PATTERN_PREFILTER* ppPrefilter
+    )
+{
+    DWORD dwError = 0;
+    PRSYS_PATTERN_PREFILTER pPrefilter = NULL;
+    PLW_DLINKED_LIST pListPos = NULL;
+    RSYS_MESSAGE_PATTERN* pPattern = NULL;
+    PSTR* ppszLiterals = NULL;
+    DWORD dwPattern = 0;
+    DWORD dwPatternCount = 0;
+    DWORD dwMaxStates = 1;
+    DWORD dwState = 0;
+
+    dwError = LwNtStatusToWin32Error(LW_RTL_ALLOCATE_AUTO(&pPrefilter));
+    BAIL_ON_RSYS_ERROR(dwError);
+
+    for (pListPos = pPatternList; pListPos; pListPos = pListPos->pNext)
+    {
+        dwPatternCount++;
+    }
+    pPrefilter->dwPatternCount = dwPatternCount;
+
+    if (!pPrefilter->dwPatternCount)
+    {
+        goto done;
+    }
+
+    dwError = LwNtStatusToWin32Error(
+                  LW_RTL_ALLOCATE_ARRAY_AUTO(
+                      &ppszLiterals,
+                      pPrefilter->dwPatternCount));
+    BAIL_ON_RSYS_ERROR(dwError);
+
+    dwError = LwNtStatusToWin32Error(
+                  LW_RTL_ALLOCATE_ARRAY_AUTO(
+                      &pPrefilter->pbAlwaysCandidate,
+                      pPrefilter->dwPatternCount));
+    BAIL_ON_RSYS_ERROR(dwError);
+
+    dwError = LwNtStatusToWin32Error(
+                  LW_RTL_ALLOCATE_ARRAY_AUTO(
+                      &pPrefilter->pdwNextPattern,
+                      pPrefilter->dwPatternCount));
+    BAIL_ON_RSYS_ERROR(dwError);
+
+    for (pListPos = pPatternList, dwPattern = 0;
+         pListPos;
+         pListPos = pListPos->pNext, dwPattern++)
+    {
+        pPattern = (RSYS_MESSAGE_PATTERN *)pListPos->pItem;
+        pPattern->dwPrefilterIndex = dwPattern;
+
+        if (pPattern->pszRawMessageRegEx)
+        {
+            dwError = RSysSrvGetRequiredLiteral(
+                            pPattern->pszRawMessageRegEx,
+                            &ppszLiterals[dwPattern]);
+            BAIL_ON_RSYS_ERROR(dwError);
+        }
+
+        if (ppszLiterals[dwPattern])
+        {
+            RSYS_LOG_VERBOSE("Pattern %u requires literal [%s]",
+                    pPattern->ulId,
+                    ppszLiterals[dwPattern]);
+
+            pPrefilter->dwLiteralCount++;
+            dwMaxStates += strlen(ppszLiterals[dwPattern]);
+        }
+        else
+        {
+            RSYS_LOG_VERBOSE("Pattern %u cannot be prefiltered",
+                    pPattern->ulId);
+
+            pPrefilter->pbAlwaysCandidate[dwPattern] = TRUE;
+        }
+    }
+
+    dwError = LwNtStatusToWin32Error(
+                  LW_RTL_ALLOCATE_ARRAY_AUTO(
+                      &pPrefilter->pdwTransitions,
+                      dwMaxStates * RSYS_PREFILTER_ALPHABET));
+    BAIL_ON_RSYS_ERROR(dwError);
+
+    dwError = LwNtStatusToWin32Error(
+                  LW_RTL_ALLOCATE_ARRAY_AUTO(
+                      &pPrefilter->pdwFirstPattern,
+                      dwMaxStates));
+    BAIL_ON_RSYS_ERROR(dwError);
+
+    dwError = LwNtStatusToWin32Error(
+                  LW_RTL_ALLOCATE_ARRAY_AUTO(
+                      &pPrefilter->pdwOutputLink,
+                      dwMaxStates));
+    BAIL_ON_RSYS_ERROR(dwError);
+
+    for (dwState = 0; dwState < dwMaxStates; dwState++)
+    {
+        pPrefilter->pdwFirstPattern[dwState] = RSYS_PREFILTER_NO_PATTERN;
+    }
+
+    // The root state
+    pPrefilter->dwStateCount = 1;
+
+    for (dwPattern = 0; dwPattern < pPrefilter->dwPatternCount; dwPattern++)
+    {
+        pPrefilter->pdwNextPattern[dwPattern] = RSYS_PREFILTER_NO_PATTERN;
+
+        if (ppszLiterals[dwPattern])
+        {
+            RSysPrefilterAddLiteral(
+                pPrefilter,
+                ppszLiterals[dwPattern],
+                dwPattern);
+        }
+    }
+
+    dwError = RSysPrefilterLinkStates(pPrefilter);
+    BAIL_ON_RSYS_ERROR(dwError);
+
+done:
+    *ppPrefilter = pPrefilter;
+
+cleanup:
+    if (ppszLiterals)
+    {
+        for (dwPattern = 0; dwPattern < dwPatternCount; dwPattern++)
+        {
+            LW_SAFE_FREE_STRING(ppszLiterals[dwPattern]);
+        }
+        LW_RTL_FREE(&ppszLiterals);
+    }
+    return dwError;
+
+error:
+    RSysSrvFreePatternPrefilter(pPrefilter);
+    pPrefilter = NULL;
+    *ppPrefilter = NULL;
+    goto cleanup;
+}
+
+DWORD
+RSysSrvGetPatternPrefilterSize(
+    IN PRSYS_PATTERN_PREFILTER pPrefilter
+    )
+{
+    return pPrefilter ? pPrefilter->dwPatternCount : 0;
+}
+
+/*
+ * pbCandidates must have room for RSysSrvGetPatternPrefilterSize() entries
+ * and is indexed by RSYS_MESSAGE_PATTERN.dwPrefilterIndex. Patterns which are
+ * not flagged cannot match the line.
+ */
+VOID
+RSysSrvPrefilterLine(
+    IN PRSYS_PATTERN_PREFILTER pPrefilter,
+    IN PCSTR pszLine,
+    OUT PBOOLEAN pbCandidates
+    )
+{
+    DWORD dwRemaining = pPrefilter->dwLiteralCount;
+    DWORD dwState = 0;
+    DWORD dwOutput = 0;
+    DWORD dwPattern = 0;
+    PCSTR pszPos = NULL;
+
+    memcpy(pbCandidates,
+           pPrefilter->pbAlwaysCandidate,
+           pPrefilter->dwPatternCount * sizeof(pbCandidates[0]));
+
+    for (pszPos = pszLine; dwRemaining && *pszPos; pszPos++)
+    {
+        dwState = pPrefilter->pdwTransitions[
+                        dwState * RSYS_PREFILTER_ALPHABET +
+                        (UCHAR)*pszPos];
+
+        dwOutput = pPrefilter->pdwFirstPattern[dwState] !=
+                        RSYS_PREFILTER_NO_PATTERN ?
+                    dwState :
+                    pPrefilter->pdwOutputLink[dwState];
+
+        for (; dwOutput; dwOutput = pPrefilter->pdwOutputLink[dwOutput])
+        {
+            for (dwPattern = pPrefilter->pdwFirstPattern[dwOutput];
+                 dwPattern != RSYS_PREFILTER_NO_PATTERN;
+                 dwPattern = pPrefilter->pdwNextPattern[dwPattern])
+            {
+                if (!pbCandidates[dwPattern])
+                {
+                    pbCandidates[dwPattern] = TRUE;
+                    dwRemaining--;
+                }
+            }
+        }
+    }
+}
+
+VOID
+RSysSrvFreePatternPrefilter(
+    IN OUT PRSYS_PATTERN_PREFILTER pPrefilter
+    )
+{
+    if (pPrefilter)
+    {
+        LW_RTL_FREE(&pPrefilter->pbAlwaysCandidate);
+        LW_RTL_FREE(&pPrefilter->pdwNextPattern);
+        LW_RTL_FREE(&pPrefilter->pdwTransitions);
+        LW_RTL_FREE(&pPrefilter->pdwFirstPattern);
+        LW_RTL_FREE(&pPrefilter->pdwOutputLink);
+        LW_RTL_FREE(&pPrefilter);
+    }
+}
@@ -55,9 +55,12 @@ typedef struct __RSYS_SRV_API_CONFIG
     BOOLEAN bLogUnmatchedErrorEvents;
     BOOLEAN bLogUnmatchedWarningEvents;
     BOOLEAN bLogUnmatchedInfoEvents;
+    // Seconds to remember whether a user is known to lsass
+    DWORD dwUserCacheTimeout;
     // Items of are type RSYS_MESSAGE_PATTERN
     PLW_DLINKED_LIST pPatternHead;
     PLW_DLINKED_LIST pPatternTail;
+    PRSYS_PATTERN_PREFILTER pPrefilter;
 } RSYS_SRV_API_CONFIG, *PRSYS_SRV_API_CONFIG;
 
 #endif /* __STRUCTS_H__ */
@@ -65,8 +65,14 @@ typedef struct _RSYS_MESSAGE_PATTERN
 
     BOOLEAN bCompiled;
     regex_t compiledRegEx;
+
+    // Position of this pattern in the prefilter candidate array
+    DWORD dwPrefilterIndex;
 } RSYS_MESSAGE_PATTERN;
 
+typedef struct _RSYS_PATTERN_PREFILTER
+    RSYS_PATTERN_PREFILTER, *PRSYS_PATTERN_PREFILTER;
+
 DWORD
 RSysSrvApiInit(
     VOID
@@ -91,10 +97,18 @@ RSysSrvGetLogUnmatchedEvents(
     BOOLEAN* pbLogUnmatchedInfoEvents
     );
 
+DWORD
+RSysSrvGetUserCacheTimeout(
+    HANDLE hServer,
+    DWORD* pdwUserCacheTimeout
+    );
+
+// The prefilter is optional and stays valid until the list is unlocked
 DWORD
 RSysSrvLockPatternList(
     HANDLE hServer,
-    PLW_DLINKED_LIST* ppPatternList
+    PLW_DLINKED_LIST* ppPatternList,
+    PRSYS_PATTERN_PREFILTER* ppPrefilter
     );
 
 DWORD
@@ -108,5 +122,34 @@ RSysSrvRefreshConfiguration(
     VOID
     );
 
+DWORD
+RSysSrvGetRequiredLiteral(
+    IN PCSTR pszRegEx,
+    OUT PSTR* ppszLiteral
+    );
+
+DWORD
+RSysSrvCreatePatternPrefilter(
+    IN PLW_DLINKED_LIST pPatternList,
+    OUT PRSYS_PATTERN_PREFILTER* ppPrefilter
+    );
+
+DWORD
+RSysSrvGetPatternPrefilterSize(
+    IN PRSYS_PATTERN_PREFILTER pPrefilter
+    );
+
+VOID
+RSysSrvPrefilterLine(
+    IN PRSYS_PATTERN_PREFILTER pPrefilter,
+    IN PCSTR pszLine,
+    OUT PBOOLEAN pbCandidates
+    );
+
+VOID
+RSysSrvFreePatternPrefilter(
+    IN OUT PRSYS_PATTERN_PREFILTER pPrefilter
+    );
+
 #endif /* __RSYS_SRVAPI_H__ */
 
@@ -66,6 +66,7 @@
 #include <eventlog.h>
 #include <lsa/lsa.h>
 #include <lwstr.h>
+#include <lwhash.h>
 #include <lwfile.h>
 
 #include "externs_p.h"
@@ -46,6 +46,14 @@
 
 #define ASSERT(x)   assert(x)
 
+// Events are handed to the eventlog client queue, which coalesces them into
+// batches of at most this many records or this much delay
+#define RSYS_EVENT_BATCH_RECORDS 500
+#define RSYS_EVENT_BATCH_DELAY_MS 200
+
+// Only used by the reader thread
+static PLW_EVENTLOG_CONNECTION gpEventlog = NULL;
+
 //Replaces double backslashes with single backslashes
 VOID
 RSysUnescapeUser(
@@ -73,6 +81,7 @@ DWORD
 RSysSrvCheckLineMatch(
     IN PCSTR pszLine,
     IN RSYS_MESSAGE_PATTERN* pPattern,
+    IN DWORD dwUserCacheTimeout,
     IN OUT HANDLE* phLsaConnection,
     OUT PSTR* ppszUser,
     OUT BOOLEAN* pbMatched
@@ -84,6 +93,8 @@ RSysSrvCheckLineMatch(
     BOOLEAN bAdUser = TRUE;
     DWORD dwError = 0;
     PLSA_USER_INFO_0 pUserInfo = NULL;
+    BOOLEAN bCached = FALSE;
+    time_t tNow = 0;
 
     ASSERT(ulUserMatchIndex < sizeof(matches)/sizeof(matches[0]));
 
@@ -128,35 +139,54 @@ RSysSrvCheckLineMatch(
     }
     else
     {
-        if (!*phLsaConnection)
+        tNow = time(NULL);
+
+        dwError = RSysSrvLookupUserType(
+                        pszUser,
+                        tNow,
+                        &bCached,
+                        &bAdUser);
+        BAIL_ON_RSYS_ERROR(dwError);
+
+        if (!bCached)
         {
-            dwError = LsaOpenServer(phLsaConnection);
-            if (dwError == ERROR_FILE_NOT_FOUND ||
-                    dwError == LW_ERROR_ERRNO_ECONNREFUSED)
+            if (!*phLsaConnection)
             {
-                dwError = LW_ERROR_LSA_SERVER_UNREACHABLE;
+                dwError = LsaOpenServer(phLsaConnection);
+                if (dwError == ERROR_FILE_NOT_FOUND ||
+                        dwError == LW_ERROR_ERRNO_ECONNREFUSED)
+                {
+                    dwError = LW_ERROR_LSA_SERVER_UNREACHABLE;
+                }
+                BAIL_ON_RSYS_ERROR(dwError);
             }
-            BAIL_ON_RSYS_ERROR(dwError);
-        }
 
-        /* If lsass knows about the user, it is an AD user (non-/etc/passwd at
-         * least) */
-        dwError = LsaFindUserByName(
-                        *phLsaConnection,
-                        pszUser,
-                        0,
-                        (PVOID*)&pUserInfo);
-        if (dwError == LW_ERROR_NO_SUCH_USER)
-        {
-            bAdUser = FALSE;
-            dwError = 0;
-        }
-        BAIL_ON_RSYS_ERROR(dwError);
+            /* If lsass knows about the user, it is an AD user (non-/etc/passwd
+             * at least) */
+            bAdUser = TRUE;
+            dwError = LsaFindUserByName(
+                            *phLsaConnection,
+                            pszUser,
+                            0,
+                            (PVOID*)&pUserInfo);
+            if (dwError == LW_ERROR_NO_SUCH_USER)
+            {
+                bAdUser = FALSE;
+                dwError = 0;
+            }
+            BAIL_ON_RSYS_ERROR(dwError);
 
+            RSYS_LOG_VERBOSE("User [%s] is owned by %s",
+                    pszUser,
+                    bAdUser ? "lsass" : "local system");
 
-        RSYS_LOG_VERBOSE("User [%s] is owned by %s",
-                pszUser,
-                bAdUser ? "lsass" : "local system");
+            dwError = RSysSrvCacheUserType(
+                            pszUser,
+                            tNow,
+                            dwUserCacheTimeout,
+                            bAdUser);
+            BAIL_ON_RSYS_ERROR(dwError);
+        }
 
         if ((pPattern->filter == RSYS_AD_USER) != bAdUser)
         {
@@ -214,9 +244,13 @@ RSysSrvParseLine(
     PLW_DLINKED_LIST pPatternList = NULL;
     PLW_DLINKED_LIST pListPos = NULL;
     RSYS_MESSAGE_PATTERN* pPattern = NULL;
+    // Do not free
+    PRSYS_PATTERN_PREFILTER pPrefilter = NULL;
+    PBOOLEAN pbCandidates = NULL;
     BOOLEAN bLogUnmatchedError = FALSE;
     BOOLEAN bLogUnmatchedWarning = FALSE;
     BOOLEAN bLogUnmatchedInfo = FALSE;
+    DWORD dwUserCacheTimeout = 0;
 
     dwError = RSysSrvGetLogUnmatchedEvents(
                     NULL,
@@ -225,9 +259,16 @@ RSysSrvParseLine(
                     &bLogUnmatchedInfo);
     BAIL_ON_RSYS_ERROR(dwError);
 
+    // Read before locking the pattern list; both take the config lock
+    dwError = RSysSrvGetUserCacheTimeout(
+                    NULL,
+                    &dwUserCacheTimeout);
+    BAIL_ON_RSYS_ERROR(dwError);
+
     dwError = RSysSrvLockPatternList(
                     NULL,
-                    &pPatternList);
+                    &pPatternList,
+                    &pPrefilter);
     BAIL_ON_RSYS_ERROR(dwError);
     bPatternListLocked = TRUE;
 
@@ -376,14 +417,36 @@ RSysSrvParseLine(
             tmParsed.tm_mon, tmParsed.tm_mday,
             tmParsed.tm_hour, tmParsed.tm_min);
 
+    if (pPrefilter && RSysSrvGetPatternPrefilterSize(pPrefilter))
+    {
+        dwError = LwNtStatusToWin32Error(
+                      LW_RTL_ALLOCATE_ARRAY_AUTO(
+                          &pbCandidates,
+                          RSysSrvGetPatternPrefilterSize(pPrefilter)));
+        BAIL_ON_RSYS_ERROR(dwError);
+
+        // Rule out patterns whose required literal is not in the line
+        RSysSrvPrefilterLine(
+            pPrefilter,
+            pLine->pszData,
+            pbCandidates);
+    }
+
     pListPos = pPatternList;
     while (pListPos)
     {
         pPattern = (RSYS_MESSAGE_PATTERN *)pListPos->pItem;
 
+        if (pbCandidates && !pbCandidates[pPattern->dwPrefilterIndex])
+        {
+            pListPos = pListPos->pNext;
+            continue;
+        }
+
         dwError = RSysSrvCheckLineMatch(
                         pLine->pszData,
                         pPattern,
+                        dwUserCacheTimeout,
                         &hLsaConnection,
                         &pRecord->pszUser,
                         &bIsMatch);
@@ -480,6 +543,7 @@ RSysSrvParseLine(
     *pbNonBlank = TRUE;
 
 cleanup:
+    LW_RTL_FREE(&pbCandidates);
     if (bPatternListLocked)
     {
         RSysSrvUnlockPatternList(
@@ -815,33 +879,51 @@ RSysSrvWriteEvents(
     )
 {
     DWORD dwError = 0;
-    HANDLE hEventLog = NULL;
 
     RSYS_LOG_INFO("Sending %d events to eventlog", dwCount);
 
-    dwError = LWIOpenEventLog(
-                    NULL,
-                    &hEventLog);
-    BAIL_ON_RSYS_ERROR(dwError);
+    if (gpEventlog == NULL)
+    {
+        dwError = LwEvtOpenEventlog(
+                        NULL,
+                        &gpEventlog);
+        BAIL_ON_RSYS_ERROR(dwError);
+
+        dwError = LwEvtEnableWriteQueue(
+                        gpEventlog,
+                        RSYS_EVENT_BATCH_RECORDS,
+                        RSYS_EVENT_BATCH_DELAY_MS);
+        BAIL_ON_RSYS_ERROR(dwError);
+    }
 
+    // The queue retries failed batches itself, so this only fails once it
+    // is full and eventlog is still not accepting records
     dwError = LWIWriteEventLogRecords(
-                    hEventLog,
+                    (HANDLE)gpEventlog,
                     dwCount,
                     pList);
     BAIL_ON_RSYS_ERROR(dwError);
 
 cleanup:
-    if (hEventLog != NULL)
-    {
-        LWICloseEventLog(hEventLog);
-    }
-
     return dwError;
 
 error:
+    RSysSrvCloseEventlog();
     goto cleanup;
 }
 
+VOID
+RSysSrvCloseEventlog(
+    VOID
+    )
+{
+    if (gpEventlog != NULL)
+    {
+        LwEvtCloseEventlog(gpEventlog);
+        gpEventlog = NULL;
+    }
+}
+
 DWORD
 RSysSrvGetSyslogPid(
     pid_t* pdwSyslogPid
@@ -1460,6 +1542,8 @@ RSysSrvReaderThreadRoutine(
     RSYS_LOG_INFO("Syslog reaper reader thread stopped");
 
 cleanup:
+    RSysSrvCloseEventlog();
+    RSysSrvFlushUserCache();
     RSysSrvClosePipes(
             sizeof(sources)/sizeof(sources[0]),
             sources);
@@ -98,11 +98,33 @@ DWORD
 RSysSrvCheckLineMatch(
     IN PCSTR pszLine,
     IN RSYS_MESSAGE_PATTERN* pPattern,
+    IN DWORD dwUserCacheTimeout,
     IN OUT HANDLE* phLsaConnection,
     OUT PSTR* ppszUser,
     OUT BOOLEAN* pbMatched
     );
 
+DWORD
+RSysSrvLookupUserType(
+    IN PCSTR pszUser,
+    IN time_t tNow,
+    OUT PBOOLEAN pbFound,
+    OUT PBOOLEAN pbAdUser
+    );
+
+DWORD
+RSysSrvCacheUserType(
+    IN PCSTR pszUser,
+    IN time_t tNow,
+    IN DWORD dwTimeout,
+    IN BOOLEAN bAdUser
+    );
+
+VOID
+RSysSrvFlushUserCache(
+    VOID
+    );
+
 DWORD
 RSysSrvParseLine(
     IN RSYS_LINE_NODE* pLine,
@@ -178,6 +200,11 @@ RSysSrvWriteEvents(
     PEVENT_LOG_RECORD pList
     );
 
+VOID
+RSysSrvCloseEventlog(
+    VOID
+    );
+
 PVOID
 RSysSrvPollerThreadRoutine(
     IN PVOID pUnused
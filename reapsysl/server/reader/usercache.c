@@ -0,0 +1,277 @@
+/* Editor Settings: expandtabs and use 4 spaces for indentation
+ * ex: set softtabstop=4 tabstop=8 expandtab shiftwidth=4: *
+ * -*- mode: c, c-basic-offset: 4 -*- */
+
+/*
+ * Copyright © BeyondTrust Software 2004 - 2019
+ * All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * BEYONDTRUST MAKES THIS SOFTWARE AVAILABLE UNDER OTHER LICENSING TERMS AS
+ * WELL. IF YOU HAVE ENTERED INTO A SEPARATE LICENSE AGREEMENT WITH
+ * BEYONDTRUST, THEN YOU MAY ELECT TO USE THE SOFTWARE UNDER THE TERMS OF THAT
+ * SOFTWARE LICENSE AGREEMENT INSTEAD OF THE TERMS OF THE APACHE LICENSE,
+ * NOTWITHSTANDING THE ABOVE NOTICE.  IF YOU HAVE QUESTIONS, OR WISH TO REQUEST
+ * A COPY OF THE ALTERNATE LICENSING TERMS OFFERED BY BEYONDTRUST, PLEASE CONTACT
+ * BEYONDTRUST AT beyondtrust.com/contact
+ */
+
+/*
+ * Copyright (C) BeyondTrust Software. All rights reserved.
+ *
+ * Module Name:
+ *
+ *        usercache.c
+ *
+ * Abstract:
+ *
+ *        Event forwarder from eventlogd to collector service
+ *
+ *        Cache of whether users named in syslog lines are known to lsass
+ *
+ *        The cache is only used by the reader thread, so it is not locked.
+ *        Entries expire after the configured UserCacheTimeout and the least
+ *        recently used entry is evicted once the cache is full.
+ *
+ */
+#include "includes.h"
+
+#define RSYS_USER_CACHE_SIZE 512
+
+typedef struct _RSYS_USER_CACHE_ENTRY RSYS_USER_CACHE_ENTRY;
+
+struct _RSYS_USER_CACHE_ENTRY
+{
+    PSTR pszUser;
+    BOOLEAN bAdUser;
+    time_t tExpires;
+    // Most recently used entries are at the head
+    RSYS_USER_CACHE_ENTRY* pPrev;
+    RSYS_USER_CACHE_ENTRY* pNext;
+};
+
+static PLW_HASH_TABLE gpUserCacheTable = NULL;
+static RSYS_USER_CACHE_ENTRY* gpUserCacheHead = NULL;
+static RSYS_USER_CACHE_ENTRY* gpUserCacheTail = NULL;
+
+static
+VOID
+RSysSrvUnlinkUserCacheEntry(
+    RSYS_USER_CACHE_ENTRY* pEntry
+    )
+{
+    if (pEntry->pPrev)
+    {
+        pEntry->pPrev->pNext = pEntry->pNext;
+    }
+    else
+    {
+        gpUserCacheHead = pEntry->pNext;
+    }
+
+    if (pEntry->pNext)
+    {
+        pEntry->pNext->pPrev = pEntry->pPrev;
+    }
+    else
+    {
+        gpUserCacheTail = pEntry->pPrev;
+    }
+
+    pEntry->pPrev = NULL;
+    pEntry->pNext = NULL;
+}
+
+static
+VOID
+RSysSrvLinkUserCacheEntryAtHead(
+    RSYS_USER_CACHE_ENTRY* pEntry
+    )
+{
+    pEntry->pPrev = NULL;
+    pEntry->pNext = gpUserCacheHead;
+
+    if (gpUserCacheHead)
+    {
+        gpUserCacheHead->pPrev = pEntry;
+    }
+    else
+    {
+        gpUserCacheTail = pEntry;
+    }
+    gpUserCacheHead = pEntry;
+}
+
+static
+VOID
+RSysSrvRemoveUserCacheEntry(
+    RSYS_USER_CACHE_ENTRY* pEntry
+    )
+{
+    LwHashRemoveKey(gpUserCacheTable, pEntry->pszUser);
+    RSysSrvUnlinkUserCacheEntry(pEntry);
+    LW_SAFE_FREE_STRING(pEntry->pszUser);
+    LW_RTL_FREE(&pEntry);
+}
+
+DWORD
+RSysSrvLookupUserType(
+    IN PCSTR pszUser,
+    IN time_t tNow,
+    OUT PBOOLEAN pbFound,
+    OUT PBOOLEAN pbAdUser
+    )
+{
+    DWORD dwError = 0;
+    RSYS_USER_CACHE_ENTRY* pEntry = NULL;
+
+    *pbFound = FALSE;
+    *pbAdUser = FALSE;
+
+    if (!gpUserCacheTable)
+    {
+        goto cleanup;
+    }
+
+    dwError = LwHashGetValue(
+                    gpUserCacheTable,
+                    pszUser,
+                    (PVOID*)&pEntry);
+    if (dwError == ERROR_NOT_FOUND)
+    {
+        dwError = 0;
+        goto cleanup;
+    }
+    BAIL_ON_RSYS_ERROR(dwError);
+
+    if (pEntry->tExpires <= tNow)
+    {
+        RSysSrvRemoveUserCacheEntry(pEntry);
+        goto cleanup;
+    }
+
+    RSysSrvUnlinkUserCacheEntry(pEntry);
+    RSysSrvLinkUserCacheEntryAtHead(pEntry);
+
+    *pbFound = TRUE;
+    *pbAdUser = pEntry->bAdUser;
+
+cleanup:
+    return dwError;
+
+error:
+    goto cleanup;
+}
+
+DWORD
+RSysSrvCacheUserType(
+    IN PCSTR pszUser,
+    IN time_t tNow,
+    IN DWORD dwTimeout,
+    IN BOOLEAN bAdUser
+    )
+{
+    DWORD dwError = 0;
+    RSYS_USER_CACHE_ENTRY* pEntry = NULL;
+
+    if (!dwTimeout)
+    {
+        RSysSrvFlushUserCache();
+        goto cleanup;
+    }
+
+    if (!gpUserCacheTable)
+    {
+        dwError = LwHashCreate(
+                        RSYS_USER_CACHE_SIZE * 2,
+                        LwHashStringCompare,
+                        LwHashStringHash,
+                        NULL,
+                        NULL,
+                        &gpUserCacheTable);
+        BAIL_ON_RSYS_ERROR(dwError);
+    }
+
+    dwError = LwHashGetValue(
+                    gpUserCacheTable,
+                    pszUser,
+                    (PVOID*)&pEntry);
+    if (dwError == ERROR_NOT_FOUND)
+    {
+        dwError = 0;
+        pEntry = NULL;
+    }
+    BAIL_ON_RSYS_ERROR(dwError);
+
+    if (pEntry)
+    {
+        RSysSrvUnlinkUserCacheEntry(pEntry);
+    }
+    else
+    {
+        while (gpUserCacheTail &&
+                LwHashGetKeyCount(gpUserCacheTable) >= RSYS_USER_CACHE_SIZE)
+        {
+            RSysSrvRemoveUserCacheEntry(gpUserCacheTail);
+        }
+
+        dwError = LwNtStatusToWin32Error(LW_RTL_ALLOCATE_AUTO(&pEntry));
+        BAIL_ON_RSYS_ERROR(dwError);
+
+        dwError = LwAllocateString(pszUser, &pEntry->pszUser);
+        BAIL_ON_RSYS_ERROR(dwError);
+
+        dwError = LwHashSetValue(gpUserCacheTable, pEntry->pszUser, pEntry);
+        BAIL_ON_RSYS_ERROR(dwError);
+    }
+
+    pEntry->bAdUser = bAdUser;
+    pEntry->tExpires = tNow + dwTimeout;
+
+    RSysSrvLinkUserCacheEntryAtHead(pEntry);
+    pEntry = NULL;
+
+cleanup:
+    return dwError;
+
+error:
+    if (pEntry)
+    {
+        LW_SAFE_FREE_STRING(pEntry->pszUser);
+        LW_RTL_FREE(&pEntry);
+    }
+    goto cleanup;
+}
+
+VOID
+RSysSrvFlushUserCache(
+    VOID
+    )
+{
+    while (gpUserCacheHead)
+    {
+        RSysSrvRemoveUserCacheEntry(gpUserCacheHead);
+    }
+
+    LwHashSafeFree(&gpUserCacheTable);
+}
+
+/*
+local variables:
+mode: c
+c-basic-offset: 4
+indent-tabs-mode: nil
+tab-width: 4
+end:
+*/
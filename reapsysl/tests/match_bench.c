@@ -0,0 +1,205 @@
+/*
+ * Line throughput of the reapsysl pattern matcher.
+ *
+ * Replays a recorded syslog file through the configured message patterns,
+ * once evaluating every regex on every line (the old behaviour) and once
+ * with the literal prefilter in front of regexec, and prints lines/second
+ * for both.
+ *
+ * The pattern file holds one POSIX extended regex per line, e.g. the
+ * "Regex" values from reapsysl.reg.
+ *
+ * Build against a staged tree, for example:
+ *
+ *   cc -DLW_LITTLE_ENDIAN -I<stage>/include -I../include -I../server/include \
+ *      -I../server/api -include ../server/api/includes.h \
+ *      match_bench.c ../server/api/prefilter.c -llwadvapi -llwbase
+ *
+ * Usage: match_bench <pattern file> <syslog file> [iterations]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <regex.h>
+#include <sys/time.h>
+
+static
+char**
+read_lines(
+    const char* path,
+    int* count
+    )
+{
+    FILE* file = fopen(path, "r");
+    char buffer[8192];
+    char** lines = NULL;
+    int capacity = 0;
+    size_t len = 0;
+
+    *count = 0;
+
+    if (!file)
+    {
+        perror(path);
+        exit(1);
+    }
+
+    while (fgets(buffer, sizeof(buffer), file))
+    {
+        len = strlen(buffer);
+        if (len && buffer[len - 1] == '\n')
+        {
+            buffer[--len] = 0;
+        }
+        if (!len)
+        {
+            continue;
+        }
+        if (*count == capacity)
+        {
+            capacity = capacity ? capacity * 2 : 1024;
+            lines = realloc(lines, capacity * sizeof(*lines));
+        }
+        lines[(*count)++] = strdup(buffer);
+    }
+
+    fclose(file);
+    return lines;
+}
+
+static
+double
+now(
+    void
+    )
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+int
+main(
+    int argc,
+    char** argv
+    )
+{
+    char** patterns = NULL;
+    char** lines = NULL;
+    int patternCount = 0;
+    int lineCount = 0;
+    int iterations = 10;
+    int i = 0;
+    int j = 0;
+    int k = 0;
+    regex_t* compiled = NULL;
+    RSYS_MESSAGE_PATTERN* items = NULL;
+    LW_DLINKED_LIST* nodes = NULL;
+    PRSYS_PATTERN_PREFILTER prefilter = NULL;
+    BOOLEAN* candidates = NULL;
+    regmatch_t matches[10];
+    unsigned long matchedPlain = 0;
+    unsigned long matchedFiltered = 0;
+    unsigned long regexCalls = 0;
+    double start = 0;
+    double plain = 0;
+    double filtered = 0;
+
+    if (argc < 3)
+    {
+        fprintf(stderr, "Usage: %s <pattern file> <syslog file> [iterations]\n", argv[0]);
+        return 1;
+    }
+    if (argc > 3)
+    {
+        iterations = atoi(argv[3]);
+    }
+
+    patterns = read_lines(argv[1], &patternCount);
+    lines = read_lines(argv[2], &lineCount);
+
+    compiled = calloc(patternCount, sizeof(*compiled));
+    items = calloc(patternCount, sizeof(*items));
+    nodes = calloc(patternCount, sizeof(*nodes));
+    candidates = calloc(patternCount, sizeof(*candidates));
+
+    for (i = 0; i < patternCount; i++)
+    {
+        if (regcomp(&compiled[i], patterns[i], REG_EXTENDED))
+        {
+            fprintf(stderr, "Invalid pattern: %s\n", patterns[i]);
+            return 1;
+        }
+        items[i].pszRawMessageRegEx = patterns[i];
+        nodes[i].pItem = &items[i];
+        nodes[i].pNext = i + 1 < patternCount ? &nodes[i + 1] : NULL;
+        nodes[i].pPrev = i > 0 ? &nodes[i - 1] : NULL;
+    }
+
+    if (RSysSrvCreatePatternPrefilter(patternCount ? nodes : NULL, &prefilter))
+    {
+        fprintf(stderr, "Could not build prefilter\n");
+        return 1;
+    }
+
+    start = now();
+    for (k = 0; k < iterations; k++)
+    {
+        for (i = 0; i < lineCount; i++)
+        {
+            for (j = 0; j < patternCount; j++)
+            {
+                if (!regexec(&compiled[j], lines[i], 10, matches, 0))
+                {
+                    matchedPlain++;
+                    break;
+                }
+            }
+        }
+    }
+    plain = now() - start;
+
+    start = now();
+    for (k = 0; k < iterations; k++)
+    {
+        for (i = 0; i < lineCount; i++)
+        {
+            RSysSrvPrefilterLine(prefilter, lines[i], candidates);
+
+            for (j = 0; j < patternCount; j++)
+            {
+                if (!candidates[items[j].dwPrefilterIndex])
+                {
+                    continue;
+                }
+                regexCalls++;
+                if (!regexec(&compiled[j], lines[i], 10, matches, 0))
+                {
+                    matchedFiltered++;
+                    break;
+                }
+            }
+        }
+    }
+    filtered = now() - start;
+
+    printf("%d patterns, %d lines, %d iterations\n",
+           patternCount, lineCount, iterations);
+    printf("regex only:     %10.0f lines/s (%lu matches)\n",
+           plain > 0 ? lineCount * (double)iterations / plain : 0,
+           matchedPlain);
+    printf("with prefilter: %10.0f lines/s (%lu matches, %.2f regexec/line)\n",
+           filtered > 0 ? lineCount * (double)iterations / filtered : 0,
+           matchedFiltered,
+           lineCount ? regexCalls / ((double)lineCount * iterations) : 0);
+
+    if (matchedPlain != matchedFiltered)
+    {
+        fprintf(stderr, "Prefilter changed the match results\n");
+        return 1;
+    }
+
+    RSysSrvFreePatternPrefilter(prefilter);
+    return 0;
+}
@@ -45,6 +45,8 @@
 #include "includes.h"
 
 #define NANOSECS_PER_SECOND 1000000000
+#define UMN_EVENT_BATCH_RECORDS 200
+#define UMN_EVENT_BATCH_DELAY_MS 100
 
 VOID
 UmnSrvTimevalToTimespec(
@@ -231,6 +233,14 @@ UmnSrvUpdateAccountInfo(
                     &pConn);
     BAIL_ON_UMN_ERROR(dwError);
 
+    // A poll can produce an event per account; let the eventlog client send
+    // them in batches instead of one transaction each.
+    dwError = LwEvtEnableWriteQueue(
+                    pConn,
+                    UMN_EVENT_BATCH_RECORDS,
+                    UMN_EVENT_BATCH_DELAY_MS);
+    BAIL_ON_UMN_ERROR(dwError);
+
     dwError = LsaOpenServer(&hLsass);
     BAIL_ON_UMN_ERROR(dwError);
 
@@ -318,6 +328,10 @@ UmnSrvUpdateAccountInfo(
                     Now);
     BAIL_ON_UMN_ERROR(dwError);
 
+    // Do not advance LastUpdated past changes whose events were not stored
+    dwError = LwEvtFlushRecords(pConn);
+    BAIL_ON_UMN_ERROR(dwError);
+
     lastUpdated = Now;
     dwError = RegSetValueExA(
                     hReg,